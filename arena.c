@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stddef.h>
+#include <arena.h>
+
+#define ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~(u32)(ARENA_ALIGN - 1))
+
+/* Initialize an arena over size bytes at mem. */
+void arena_init(arena_t *a, void *mem, u32 size)
+{
+  /* Start on an aligned boundary. */
+  u32 skip = ALIGN_UP((u32)(size_t)mem) - (u32)(size_t)mem;
+  if (skip > size)
+    skip = size;
+  a->base = (u8 *)mem + skip;
+  a->size = size - skip;
+  a->used = 0;
+}
+
+/*
+ * Take size bytes from the arena. Arena memory is never given back.
+ * Returns NULL if the arena doesn't have enough left.
+ */
+void *arena_alloc(arena_t *a, u32 size)
+{
+  void *p;
+
+  size = ALIGN_UP(size);
+  if (size > a->size - a->used)
+    return NULL;
+  p = a->base + a->used;
+  a->used += size;
+  return p;
+}
+
+u32 arena_free_bytes(const arena_t *a)
+{
+  return a->size - a->used;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Static memory for run time buffers, so nothing on a hot path has to go near
+ * malloc.
+ *
+ * An arena is a statically allocated block of memory that is carved up once
+ * at startup and never freed. Nothing here masks interrupts, so allocate from
+ * the main loop only.
+ */
+
+#ifndef SBP_TUTORIAL_ARENA_H
+#define SBP_TUTORIAL_ARENA_H
+
+#include <libsbp/common.h>
+
+/* Alignment of everything handed out by arenas. */
+#define ARENA_ALIGN 8
+
+typedef struct {
+  u8 *base;
+  u32 size;
+  u32 used;
+} arena_t;
+
+void arena_init(arena_t *a, void *mem, u32 size);
+void *arena_alloc(arena_t *a, u32 size);
+u32 arena_free_bytes(const arena_t *a);
+
+#endif /* SBP_TUTORIAL_ARENA_H */
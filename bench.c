@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libsbp/sbp.h>
+#include <libsbp/edc.h>
+#include <libsbp/navigation.h>
+
+#include <fifo.h>
+#include <receiver.h>
+#include <enu.h>
+#include <nav_filter.h>
+#include <bench.h>
+
+#define MIX_SOLUTION     0
+#define MIX_SOLUTION_OBS 1
+#define MIX_MAX_LENGTH   2
+#define N_MIXES          3
+
+/* Not handled by the receiver, so it exercises the full callback search. */
+#define BENCH_MSG_OBS 0x0049
+
+static const char *mix_names[N_MIXES] = {
+  "solution", "solution_obs", "max_length"
+};
+
+/* Positions for the ENU stages, scattered around a reference within these
+ * distances (in metres). */
+#define N_ENU_MIXES      2
+#define BENCH_ENU_POINTS 128
+#define BENCH_REF_LAT    37.7749
+#define BENCH_REF_LON    -122.4194
+#define BENCH_REF_HEIGHT 10.0
+
+static const char *enu_mix_names[N_ENU_MIXES] = { "local_1km", "local_50km" };
+static const double enu_mix_radius[N_ENU_MIXES] = { 1000, 50000 };
+
+/* Working state is static, it's too big for the stack on the board. */
+static fifo_t bench_fifo;
+static receiver_t bench_receiver;
+static sbp_state_t bench_state;
+static u8 bench_scratch[FIFO_LEN];
+static enu_ref_t bench_enu_ref;
+static enu_t bench_enu[BENCH_ENU_POINTS];
+static nav_filter_t bench_filter;
+
+/* Write and read ends of an in-memory byte stream. */
+typedef struct {
+  u8 *buf;
+  u32 len;
+  u32 pos;
+} stream_t;
+
+static u32 stream_write(u8 *buff, u32 n, void *context)
+{
+  stream_t *s = context;
+  if (n > s->len - s->pos)
+    return 0;
+  memcpy(s->buf + s->pos, buff, n);
+  s->pos += n;
+  return n;
+}
+
+static u32 stream_read(u8 *buff, u32 n, void *context)
+{
+  stream_t *s = context;
+  if (n > s->len - s->pos)
+    n = s->len - s->pos;
+  memcpy(buff, s->buf + s->pos, n);
+  s->pos += n;
+  return n;
+}
+
+/* Append a frame if it fits. Returns 1 if it did. */
+static u8 add_frame(stream_t *s, u16 msg_type, u8 len, void *payload)
+{
+  u32 pos = s->pos;
+
+  sbp_state_set_io_context(&bench_state, s);
+  if (sbp_send_message(&bench_state, msg_type, SBP_SENDER_ID, len, payload,
+                       &stream_write) != SBP_OK) {
+    s->pos = pos;
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Fill buf with whole frames of the given mix.
+ * Returns the number of bytes used.
+ */
+u32 bench_build_mix(u8 *buf, u32 len, u8 mix)
+{
+  stream_t s = { buf, len, 0 };
+  msg_gps_time_t gps_time;
+  msg_pos_llh_t pos_llh;
+  msg_baseline_ned_t baseline_ned;
+  msg_vel_ned_t vel_ned;
+  msg_dops_t dops;
+  u8 payload[255];
+  u32 epoch, i;
+
+  memset(&gps_time, 0, sizeof(gps_time));
+  memset(&pos_llh, 0, sizeof(pos_llh));
+  memset(&baseline_ned, 0, sizeof(baseline_ned));
+  memset(&vel_ned, 0, sizeof(vel_ned));
+  memset(&dops, 0, sizeof(dops));
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = (u8)(i * 7 + 1);
+
+  sbp_state_init(&bench_state);
+  for (epoch = 0; ; epoch++) {
+    if (mix == MIX_MAX_LENGTH) {
+      payload[0] = (u8)epoch;
+      if (!add_frame(&s, BENCH_MSG_OBS, sizeof(payload), payload))
+        break;
+      continue;
+    }
+
+    gps_time.wn = 1800;
+    gps_time.tow = 100 * epoch;
+    pos_llh.tow = baseline_ned.tow = vel_ned.tow = dops.tow = gps_time.tow;
+    pos_llh.lat = 37.7749 + epoch * 1e-7;
+    pos_llh.lon = -122.4194 + epoch * 1e-7;
+    pos_llh.height = 10.0;
+    pos_llh.n_sats = 9;
+    baseline_ned.n = epoch;
+    baseline_ned.e = -(s32)epoch;
+    vel_ned.n = 100;
+    dops.gdop = 250;
+
+    if (!add_frame(&s, SBP_MSG_GPS_TIME, sizeof(gps_time), &gps_time) ||
+        !add_frame(&s, SBP_MSG_POS_LLH, sizeof(pos_llh), &pos_llh) ||
+        !add_frame(&s, SBP_MSG_BASELINE_NED, sizeof(baseline_ned), &baseline_ned) ||
+        !add_frame(&s, SBP_MSG_VEL_NED, sizeof(vel_ned), &vel_ned))
+      break;
+    if (epoch % 10 == 0 &&
+        !add_frame(&s, SBP_MSG_DOPS, sizeof(dops), &dops))
+      break;
+    /* Two observation frames, about what ten satellites take. */
+    if (mix == MIX_SOLUTION_OBS &&
+        (!add_frame(&s, BENCH_MSG_OBS, 185, payload) ||
+         !add_frame(&s, BENCH_MSG_OBS, 185, payload)))
+      break;
+  }
+  return s.pos;
+}
+
+/*
+ * Each stage makes cfg->repeats passes over the stream and returns the ticks
+ * taken by the fastest pass, which is the least disturbed by interrupts (or on
+ * a host, by the scheduler).
+ */
+
+static u64 bench_fifo_write(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  u64 best = ~0ULL, total;
+  u32 r, pos, i, n, t0;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    total = 0;
+    for (pos = 0; pos < len; pos += n) {
+      n = len - pos < FIFO_LEN - 1 ? len - pos : FIFO_LEN - 1;
+      fifo_init(&bench_fifo);
+      t0 = cfg->ticks();
+      for (i = 0; i < n; i++)
+        fifo_write(&bench_fifo, buf[pos + i]);
+      total += (u32)(cfg->ticks() - t0);
+    }
+    if (total < best)
+      best = total;
+  }
+  return best;
+}
+
+static u64 bench_fifo_read(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  u64 best = ~0ULL, total;
+  u32 r, pos, i, n, t0;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    total = 0;
+    for (pos = 0; pos < len; pos += n) {
+      n = len - pos < FIFO_LEN - 1 ? len - pos : FIFO_LEN - 1;
+      fifo_init(&bench_fifo);
+      for (i = 0; i < n; i++)
+        fifo_write(&bench_fifo, buf[pos + i]);
+      t0 = cfg->ticks();
+      fifo_read(bench_scratch, n, &bench_fifo);
+      total += (u32)(cfg->ticks() - t0);
+    }
+    if (total < best)
+      best = total;
+  }
+  return best;
+}
+
+static u64 bench_crc(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  volatile u16 crc;
+  u32 best = ~0U, r, t0, t;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    crc = crc16_ccitt(buf, len, 0);
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  (void)crc;
+  return best;
+}
+
+/* Run sbp_process over the whole stream. */
+static u64 bench_process(const bench_config_t *cfg, sbp_state_t *s,
+                         u8 *buf, u32 len)
+{
+  stream_t stream;
+  u32 best = ~0U, r, t0, t;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    stream.buf = buf;
+    stream.len = len;
+    stream.pos = 0;
+    sbp_state_set_io_context(s, &stream);
+    t0 = cfg->ticks();
+    while (stream.pos < len)
+      sbp_process(s, &stream_read);
+    /* Complete the last frame. */
+    sbp_process(s, &stream_read);
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+static u64 bench_parse(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  sbp_state_init(&bench_state);
+  return bench_process(cfg, &bench_state, buf, len);
+}
+
+static u64 bench_dispatch(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  receiver_setup(&bench_receiver, &bench_fifo);
+  return bench_process(cfg, &bench_receiver.sbp_state, buf, len);
+}
+
+static u64 bench_pipeline(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  u32 best = ~0U, r, pos, t0, t;
+
+  fifo_init(&bench_fifo);
+  receiver_setup(&bench_receiver, &bench_fifo);
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    for (pos = 0; pos < len; pos++) {
+      while (!fifo_write(&bench_fifo, buf[pos]))
+        receiver_process(&bench_receiver);
+    }
+    while (!fifo_empty(&bench_fifo))
+      receiver_process(&bench_receiver);
+    receiver_process(&bench_receiver);
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+/*
+ * Fill pos with up to len bytes of positions within radius metres of the
+ * reference. Returns the number of positions.
+ */
+static u32 build_positions(msg_pos_llh_t *pos, u32 len, double radius)
+{
+  u32 n = len / sizeof(*pos), seed = 1, i;
+
+  if (n > BENCH_ENU_POINTS)
+    n = BENCH_ENU_POINTS;
+  /* The same pseudo-random scatter every run. Metres per degree of
+   * latitude, and of longitude at the reference latitude. */
+  for (i = 0; i < n; i++) {
+    seed = seed * 1664525 + 1013904223;
+    pos[i].lat = BENCH_REF_LAT + (s32)seed / 2147483648.0 * radius / 111000;
+    seed = seed * 1664525 + 1013904223;
+    pos[i].lon = BENCH_REF_LON + (s32)seed / 2147483648.0 * radius / 88000;
+    seed = seed * 1664525 + 1013904223;
+    pos[i].height = BENCH_REF_HEIGHT + (s32)seed / 2147483648.0 * 50;
+  }
+  return n;
+}
+
+static u64 bench_enu_float(const bench_config_t *cfg, msg_pos_llh_t *pos,
+                           u32 n)
+{
+  u32 best = ~0U, r, i, t0, t;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    for (i = 0; i < n; i++)
+      enu_from_llh(&bench_enu_ref, pos[i].lat, pos[i].lon, pos[i].height,
+                   &bench_enu[i]);
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+static u64 bench_enu_batch(const bench_config_t *cfg, msg_pos_llh_t *pos,
+                           u32 n)
+{
+  u32 best = ~0U, r, t0, t;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    enu_from_pos_llh(&bench_enu_ref, pos, bench_enu, n);
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+static u64 bench_enu_double(const bench_config_t *cfg, msg_pos_llh_t *pos,
+                            u32 n)
+{
+  volatile double sink;
+  double enu[3];
+  u32 best = ~0U, r, i, t0, t;
+
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    for (i = 0; i < n; i++) {
+      enu_from_llh_exact(&bench_enu_ref, pos[i].lat, pos[i].lon,
+                         pos[i].height, enu);
+      sink = enu[0];
+    }
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  (void)sink;
+  return best;
+}
+
+/* A 10 Hz epoch per position: ENU conversion and a filter update. */
+static u64 bench_nav_filter(const bench_config_t *cfg, msg_pos_llh_t *pos,
+                            u32 n)
+{
+  msg_vel_ned_t vel;
+  msg_dops_t dops;
+  enu_t enu;
+  u32 best = ~0U, r, i, t0, t, tow = 0;
+
+  memset(&vel, 0, sizeof(vel));
+  memset(&dops, 0, sizeof(dops));
+  vel.n = 100;
+  dops.hdop = 120;
+  dops.vdop = 180;
+  nav_filter_init(&bench_filter);
+  for (r = 0; r < cfg->repeats; r++) {
+    t0 = cfg->ticks();
+    for (i = 0; i < n; i++) {
+      tow += 100;
+      enu_from_llh(&bench_enu_ref, pos[i].lat, pos[i].lon, pos[i].height,
+                   &enu);
+      nav_filter_update(&bench_filter, tow, &enu, &vel, &dops);
+    }
+    t = cfg->ticks() - t0;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+static void emit_result(const bench_config_t *cfg, const char *stage,
+                        const char *mix, u32 len, u64 ticks)
+{
+  char line[128];
+  double secs = (double)ticks / cfg->tick_hz;
+
+  sprintf(line, "%s,%s,%u,%llu,%u,%.3f,%.3f\n", stage, mix,
+          (unsigned)len, (unsigned long long)ticks, (unsigned)cfg->tick_hz,
+          (double)ticks / len, secs > 0 ? len / secs / 1e6 : 0.0);
+  cfg->emit(line);
+}
+
+/*
+ * Run every stage over every mix, building each mix in buf (len bytes).
+ * Results are passed to cfg->emit, preceded by BENCH_CSV_HEADER.
+ */
+void bench_run(const bench_config_t *cfg, u8 *buf, u32 len)
+{
+  const char *name;
+  msg_pos_llh_t *pos = (msg_pos_llh_t *)buf;
+  u8 mix;
+  u32 n;
+
+  cfg->emit(BENCH_CSV_HEADER "\n");
+  for (mix = 0; mix < N_MIXES; mix++) {
+    n = bench_build_mix(buf, len, mix);
+    name = mix_names[mix];
+    emit_result(cfg, "fifo_write", name, n, bench_fifo_write(cfg, buf, n));
+    emit_result(cfg, "fifo_read", name, n, bench_fifo_read(cfg, buf, n));
+    emit_result(cfg, "crc", name, n, bench_crc(cfg, buf, n));
+    emit_result(cfg, "parse", name, n, bench_parse(cfg, buf, n));
+    emit_result(cfg, "dispatch", name, n, bench_dispatch(cfg, buf, n));
+    emit_result(cfg, "pipeline", name, n, bench_pipeline(cfg, buf, n));
+  }
+
+  /* ENU conversion of MSG_POS_LLH, bytes are those of the messages. */
+  enu_init(&bench_enu_ref, BENCH_REF_LAT, BENCH_REF_LON, BENCH_REF_HEIGHT);
+  for (mix = 0; mix < N_ENU_MIXES; mix++) {
+    n = build_positions(pos, len, enu_mix_radius[mix]);
+    name = enu_mix_names[mix];
+    emit_result(cfg, "enu_float", name, n * sizeof(*pos),
+                bench_enu_float(cfg, pos, n));
+    emit_result(cfg, "enu_batch", name, n * sizeof(*pos),
+                bench_enu_batch(cfg, pos, n));
+    emit_result(cfg, "enu_double", name, n * sizeof(*pos),
+                bench_enu_double(cfg, pos, n));
+    emit_result(cfg, "nav_filter", name, n * sizeof(*pos),
+                bench_nav_filter(cfg, pos, n));
+  }
+}
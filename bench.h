@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * bench measures the throughput of each stage of the receive path over
+ * a few realistic message mixes. It runs on the board (timed with the DWT
+ * cycle counter) and on a host (timed in nanoseconds), and writes one CSV line
+ * per stage and mix:
+ *
+ *   stage,mix,bytes,ticks,tick_hz,ticks_per_byte,mb_per_s
+ *
+ * where ticks is the time taken by the fastest of cfg->repeats passes over a
+ * stream of the given number of bytes.
+ *
+ * Stages:
+ *   fifo_write  bytes written to the FIFO one at a time, as the UART
+ *               interrupt does
+ *   fifo_read   bytes read back out of the FIFO with fifo_read
+ *   crc         crc16_ccitt over the raw stream
+ *   parse       sbp_process with no callbacks registered (framing and CRC)
+ *   dispatch    sbp_process with the receiver's callbacks (framing, CRC,
+ *               callback lookup and the copy into the solution)
+ *   pipeline    fifo_write followed by receiver_process, end to end
+ *
+ * Mixes:
+ *   solution      10 Hz GPS time, position, baseline and velocity, 1 Hz DOPs
+ *   solution_obs  the same plus two observation frames per epoch
+ *   max_length    frames with 255 byte payloads only
+ *
+ * followed by the conversion of MSG_POS_LLH positions to local east, north
+ * and up (see enu.h), where bytes counts the messages converted:
+ *
+ *   enu_float   enu_from_llh, one call per position
+ *   enu_batch   enu_from_pos_llh over all of them
+ *   enu_double  enu_from_llh_exact, the full double precision conversion
+ *   nav_filter  enu_from_llh and a nav_filter_update per position, as for
+ *               each 10 Hz epoch on the board
+ *
+ * over positions within 1 km (local_1km) and 50 km (local_50km) of the
+ * reference.
+ */
+
+#ifndef SBP_TUTORIAL_BENCH_H
+#define SBP_TUTORIAL_BENCH_H
+
+#include <libsbp/common.h>
+
+#define BENCH_CSV_HEADER "stage,mix,bytes,ticks,tick_hz,ticks_per_byte,mb_per_s"
+
+typedef struct {
+  u32 (*ticks)(void);              /* Free running tick counter. */
+  u32 tick_hz;                     /* Rate of ticks. */
+  u32 repeats;                     /* Passes over the stream per stage. */
+  void (*emit)(const char *line);  /* Called with each result line. */
+} bench_config_t;
+
+u32 bench_build_mix(u8 *buf, u32 len, u8 mix);
+void bench_run(const bench_config_t *cfg, u8 *buf, u32 len);
+
+#endif /* SBP_TUTORIAL_BENCH_H */
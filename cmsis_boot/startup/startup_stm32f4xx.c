@@ -135,6 +135,8 @@ extern unsigned long _sdata;     /*!< Start address for the .data section     */
 extern unsigned long _edata;     /*!< End address for the .data section       */
 extern unsigned long _sbss;      /*!< Start address for the .bss section      */
 extern unsigned long _ebss;      /*!< End address for the .bss section        */
+extern unsigned long _sccmbss;   /*!< Start address for the CCM .bss section  */
+extern unsigned long _eccmbss;   /*!< End address for the CCM .bss section    */
 extern void _eram;               /*!< End address for ram                     */
 
 
@@ -287,6 +289,12 @@ void Default_Reset_Handler(void)
         "    it      lt\n"
         "    strlt   r2, [r0], #4\n"
         "    blt     zero_loop");
+
+  /* Zero fill the CCM bss segment (see sections.h). */
+  for(pulDest = &_sccmbss; pulDest < &_eccmbss; )
+  {
+    *(pulDest++) = 0;
+  }
 #ifdef __FPU_USED
   /* Enable FPU.*/ 
   __asm("  LDR.W R0, =0xE000ED88\n"
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+
+#include <enu.h>
+
+/* WGS84 ellipsoid. */
+#define WGS84_A   6378137.0
+#define WGS84_E2  6.69437999014e-3
+
+#define D2R       0.017453292519943295
+#define D2R_F     0.017453292519943295f
+
+static void llh_to_ecef(double lat, double lon, double height, double ecef[3])
+{
+  double s = sin(lat * D2R), c = cos(lat * D2R);
+  double n = WGS84_A / sqrt(1 - WGS84_E2 * s * s);
+
+  ecef[0] = (n + height) * c * cos(lon * D2R);
+  ecef[1] = (n + height) * c * sin(lon * D2R);
+  ecef[2] = (n * (1 - WGS84_E2) + height) * s;
+}
+
+/* Set the reference point, latitude and longitude in degrees. */
+void enu_init(enu_ref_t *ref, double lat, double lon, double height)
+{
+  double s = sin(lat * D2R), c = cos(lat * D2R);
+  double w = 1 - WGS84_E2 * s * s;
+  double n = WGS84_A / sqrt(w);
+
+  ref->lat = lat;
+  ref->lon = lon;
+  ref->height = height;
+  llh_to_ecef(lat, lon, height, ref->ecef);
+  ref->sin_lat = s;
+  ref->cos_lat = c;
+  ref->sin_lon = sin(lon * D2R);
+  ref->cos_lon = cos(lon * D2R);
+
+  ref->s0 = s;
+  ref->c0 = c;
+  ref->n0 = n;
+  ref->nh0 = n + height;
+  ref->nb0 = n * (1 - WGS84_E2) + height;
+  ref->p0 = (n + height) * c;
+  ref->w0_inv = 1 / w;
+}
+
+/* Longitude difference in degrees, across the antimeridian the short way. */
+static inline double lon_delta(double lon, double lon0)
+{
+  double d = lon - lon0;
+
+  if (d > 180)
+    d -= 360;
+  else if (d < -180)
+    d += 360;
+  return d;
+}
+
+/*
+ * Single precision conversion from the differences to the reference,
+ * dlat and dlon in radians.
+ *
+ * Working in the meridian plane of the reference, a point is at distance p
+ * from the polar axis and height z above the equator. With N the prime
+ * vertical radius of curvature,
+ *
+ *   p = (N + h) cos(lat),  z = (N (1 - e^2) + h) sin(lat)
+ *
+ * and each is written as the reference value plus a difference that only
+ * involves small quantities, so nothing is lost to cancellation.
+ */
+static inline void enu_delta(const enu_ref_t *ref, float dlat, float dlon,
+                             float dh, enu_t *enu)
+{
+  float x2, sd, cd1, sl, cl1, ds, dc, dw, r, dn, dp, dz, p, dx;
+
+  /* sin(x) and cos(x) - 1 for |x| <= ENU_MAX_DELTA, the next terms are
+   * below float precision. */
+  x2 = dlat * dlat;
+  sd = dlat * (1 - x2 / 6 * (1 - x2 / 20));
+  cd1 = -x2 / 2 * (1 - x2 / 12 * (1 - x2 / 30));
+  x2 = dlon * dlon;
+  sl = dlon * (1 - x2 / 6 * (1 - x2 / 20));
+  cl1 = -x2 / 2 * (1 - x2 / 12 * (1 - x2 / 30));
+
+  /* Changes in sin(lat) and cos(lat). */
+  ds = ref->s0 * cd1 + ref->c0 * sd;
+  dc = ref->c0 * cd1 - ref->s0 * sd;
+
+  /* N = a / sqrt(w), w = 1 - e^2 sin^2(lat), so with r = dw / w0,
+   * N - N0 = N0 ((1 + r)^-1/2 - 1) = N0 (-r / 2 + 3 r^2 / 8 - ...). */
+  dw = -(float)WGS84_E2 * ds * (2 * ref->s0 + ds);
+  r = dw * ref->w0_inv;
+  dn = ref->n0 * r * (-0.5f + 0.375f * r);
+
+  dp = (ref->nh0 + dn + dh) * dc + (dn + dh) * ref->c0;
+  dz = (ref->nb0 + dn * (1 - (float)WGS84_E2) + dh) * ds +
+       (dn * (1 - (float)WGS84_E2) + dh) * ref->s0;
+
+  /* Rotate by the longitude difference about the polar axis, then by the
+   * reference latitude into east, north and up. */
+  p = ref->p0 + dp;
+  dx = dp + p * cl1;
+  enu->e = p * sl;
+  enu->n = ref->c0 * dz - ref->s0 * dx;
+  enu->u = ref->c0 * dx + ref->s0 * dz;
+}
+
+static inline void convert(const enu_ref_t *ref, double lat, double lon,
+                           double height, enu_t *enu)
+{
+  float dlat = (float)(lat - ref->lat) * D2R_F;
+  float dlon = (float)lon_delta(lon, ref->lon) * D2R_F;
+  double exact[3];
+
+  if (fabsf(dlat) <= ENU_MAX_DELTA && fabsf(dlon) <= ENU_MAX_DELTA) {
+    enu_delta(ref, dlat, dlon, (float)(height - ref->height), enu);
+    return;
+  }
+  enu_from_llh_exact(ref, lat, lon, height, exact);
+  enu->e = exact[0];
+  enu->n = exact[1];
+  enu->u = exact[2];
+}
+
+/* Convert one point, latitude and longitude in degrees. */
+void enu_from_llh(const enu_ref_t *ref, double lat, double lon, double height,
+                  enu_t *enu)
+{
+  convert(ref, lat, lon, height, enu);
+}
+
+/* Convert n positions, e.g. a run of MSG_POS_LLH from a log. */
+void enu_from_pos_llh(const enu_ref_t *ref, const msg_pos_llh_t *pos,
+                      enu_t *enu, u32 n)
+{
+  u32 i;
+
+  for (i = 0; i < n; i++)
+    convert(ref, pos[i].lat, pos[i].lon, pos[i].height, &enu[i]);
+}
+
+/* Full double precision conversion through ECEF, for any distance. */
+void enu_from_llh_exact(const enu_ref_t *ref, double lat, double lon,
+                        double height, double enu[3])
+{
+  double ecef[3], dx, dy, dz, t;
+
+  llh_to_ecef(lat, lon, height, ecef);
+  dx = ecef[0] - ref->ecef[0];
+  dy = ecef[1] - ref->ecef[1];
+  dz = ecef[2] - ref->ecef[2];
+  t = ref->cos_lon * dx + ref->sin_lon * dy;
+  enu[0] = ref->cos_lon * dy - ref->sin_lon * dx;
+  enu[1] = ref->cos_lat * dz - ref->sin_lat * t;
+  enu[2] = ref->cos_lat * t + ref->sin_lat * dz;
+}
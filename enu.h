@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * enu converts WGS84 latitude, longitude and height (as in MSG_POS_LLH) to
+ * east, north and up in metres relative to a fixed reference point, e.g. a
+ * survey marker.
+ *
+ * Everything that depends only on the reference (its sines and cosines, the
+ * radius of curvature, its distance from the polar axis) is worked out once
+ * in double by enu_init. Per point, only the differences from the reference
+ * are taken in double, since the absolute angles need more precision than a
+ * float has. The rest runs in single precision, which the Cortex-M4 FPU does
+ * in hardware: the sines and cosines of the small angle differences are
+ * short series rather than calls to sinf / cosf, and the change in the
+ * radius of curvature is expanded to second order.
+ *
+ * Within ENU_MAX_DELTA of the reference (about 60 km) the result agrees with
+ * a full double conversion to about 0.3 ppm of the distance, a few float
+ * roundings: 0.3 mm at 1 km, 3 mm at 10 km and 16 mm at 50 km at worst.
+ * Points further away are converted in double, the slow way, so the result
+ * is always right.
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_ENU_H
+#define SBP_TUTORIAL_ENU_H
+
+#include <libsbp/common.h>
+#include <libsbp/navigation.h>
+
+/* Largest latitude or longitude difference from the reference handled in
+ * single precision, in radians. */
+#define ENU_MAX_DELTA 0.01f
+
+typedef struct {
+  float e;
+  float n;
+  float u;
+} enu_t;
+
+typedef struct {
+  /* Reference point as given, degrees and metres. */
+  double lat;
+  double lon;
+  double height;
+  /* For the double conversion: the reference in ECEF and the sines and
+   * cosines of its latitude and longitude. */
+  double ecef[3];
+  double sin_lat, cos_lat, sin_lon, cos_lon;
+  /* For the single precision conversion. */
+  float s0, c0;       /* Sine and cosine of the reference latitude. */
+  float n0;           /* Prime vertical radius of curvature at it. */
+  float nh0;          /* n0 + height. */
+  float nb0;          /* n0 * (1 - e^2) + height. */
+  float p0;           /* Distance from the polar axis, nh0 * c0. */
+  float w0_inv;       /* 1 / (1 - e^2 * s0^2). */
+} enu_ref_t;
+
+void enu_init(enu_ref_t *ref, double lat, double lon, double height);
+void enu_from_llh(const enu_ref_t *ref, double lat, double lon, double height,
+                  enu_t *enu);
+void enu_from_pos_llh(const enu_ref_t *ref, const msg_pos_llh_t *pos,
+                      enu_t *enu, u32 n);
+void enu_from_llh_exact(const enu_ref_t *ref, double lat, double lon,
+                        double height, double enu[3]);
+
+#endif /* SBP_TUTORIAL_ENU_H */
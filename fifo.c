@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <fifo.h>
+#include <sections.h>
+
+void fifo_init(fifo_t *f){
+  f->head = 0;
+  f->tail = 0;
+  f->bytes_read = 0;
+}
+
+/* Return 1 if true, 0 otherwise. */
+RAMFUNC u8 fifo_empty(fifo_t *f){
+  if (f->head == f->tail)
+    return 1;
+  return 0;
+}
+
+/* Return 1 if true, 0 otherwise. */
+u8 fifo_full(fifo_t *f){
+  if (((f->tail+1) & FIFO_MASK) == f->head) {
+    return 1;
+  }
+  return 0;
+}
+
+/* Number of bytes waiting to be read. */
+u16 fifo_count(fifo_t *f){
+  return (f->tail - f->head) & FIFO_MASK;
+}
+
+/*
+ * Append a character to the FIFO. This is called from the UART receive
+ * interrupt for every byte, so it just stores the byte and publishes the new
+ * tail.
+ * Returns 1 if char successfully appended to fifo.
+ * Returns 0 if fifo is full.
+ */
+RAMFUNC u8 fifo_write(fifo_t *f, u8 c){
+  u16 t = f->tail;
+  u16 next = (t + 1) & FIFO_MASK;
+
+  if (next == f->head)
+    return 0;
+
+  f->buf[t] = c;
+  f->tail = next;
+  return 1;
+}
+
+/*
+ * Read 1 char from fifo.
+ * Returns 0 if fifo is empty, otherwise 1.
+ */
+RAMFUNC u8 fifo_read_char(fifo_t *f, u8 *c) {
+  if (fifo_empty(f))
+    return 0;
+
+  *c = f->buf[f->head];
+  f->head = (f->head+1) & FIFO_MASK;
+  return 1;
+}
+
+/*
+ * Read arbitrary number of chars from FIFO. Must conform to
+ * function definition that is passed to the function
+ * sbp_process(); context is the fifo_t to read from (see
+ * sbp_state_set_io_context).
+ * Returns the number of characters successfully read.
+ */
+RAMFUNC u32 fifo_read(u8 *buff, u32 n, void *context) {
+  fifo_t *f = context;
+  u32 i;
+  for (i=0; i<n; i++)
+    if (!fifo_read_char(f, buff + i))
+      break;
+  f->bytes_read += i;
+  return i;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * FIFO to hold received UART bytes before libsbp parses them.
+ *
+ * The FIFO has a single producer (the UART receive interrupt, which calls
+ * fifo_write) and a single consumer (the main loop, which passes fifo_read to
+ * sbp_process). tail is only written by the producer and head only by the
+ * consumer, so neither side needs to mask interrupts.
+ */
+
+#ifndef SBP_TUTORIAL_FIFO_H
+#define SBP_TUTORIAL_FIFO_H
+
+#include <libsbp/common.h>
+
+/*
+ * Must be a power of two so indices can wrap with a mask, and no more than
+ * 32768. Builds that erase flash need room for all that arrives while an
+ * erase holds up the main loop, -DFIFO_LEN=32768 (see FLASH_ERASE_MAX_MS).
+ */
+#ifndef FIFO_LEN
+#define FIFO_LEN 512
+#endif
+#define FIFO_MASK (FIFO_LEN - 1)
+
+typedef struct {
+  u8 buf[FIFO_LEN];
+  volatile u16 head;
+  volatile u16 tail;
+  u32 bytes_read;    /* Total bytes handed to the consumer. */
+} fifo_t;
+
+void fifo_init(fifo_t *f);
+u8 fifo_empty(fifo_t *f);
+u8 fifo_full(fifo_t *f);
+u16 fifo_count(fifo_t *f);
+u8 fifo_write(fifo_t *f, u8 c);
+u8 fifo_read_char(fifo_t *f, u8 *c);
+u32 fifo_read(u8 *buff, u32 n, void *context);
+
+#endif /* SBP_TUTORIAL_FIFO_H */
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <string.h>
+
+#include <libsbp/edc.h>
+#include <libsbp/sbp.h>
+
+#include <flash_log.h>
+
+#define ERASED 0xFFFFFFFF
+
+static inline u32 read_word(const flash_log_region_t *g, u32 sector,
+                            u32 offset)
+{
+  u32 w;
+
+  memcpy(&w, g->mem + sector * g->sector_size + offset, sizeof(w));
+  return w;
+}
+
+static u16 header_crc(u32 seq, u32 erases)
+{
+  u32 v[2] = { seq, erases };
+
+  return crc16_ccitt((const u8 *)v, sizeof(v), 0);
+}
+
+/* Read the header of sector. Returns 1 if it is a valid one. */
+u8 flash_log_read_header(const flash_log_region_t *region, u32 sector,
+                         flash_log_header_t *h)
+{
+  memcpy(h, region->mem + sector * region->sector_size, sizeof(*h));
+  return h->magic == FLASH_LOG_MAGIC && h->crc == header_crc(h->seq, h->erases);
+}
+
+/*
+ * The record at offset in sector: returns its size in flash, 0 if there is
+ * an erased word there (or no room for one), which is the end of the
+ * records, or -1 if it isn't a whole, valid record.
+ */
+static s32 record_at(const flash_log_region_t *g, u32 sector, u32 offset,
+                     u16 *len)
+{
+  const u8 *f = g->mem + sector * g->sector_size + offset + 4;
+  u32 w, size;
+  u16 n;
+
+  if (offset + 4 > g->sector_size)
+    return 0;
+  w = read_word(g, sector, offset);
+  if (w == ERASED)
+    return 0;
+  n = w & 0xFFFF;
+  size = (4 + n + 3) & ~3;
+  if ((w & 0xFFFF0000) != FLASH_LOG_RECORD || n < 8 ||
+      n > FLASH_LOG_MAX_FRAME || offset + size > g->sector_size)
+    return -1;
+  /* The frame's own length and CRC. */
+  if (f[0] != SBP_PREAMBLE || f[5] != n - 8 ||
+      crc16_ccitt(f + 1, n - 3, 0) != (f[n - 2] | (u16)f[n - 1] << 8))
+    return -1;
+  *len = n;
+  return size;
+}
+
+/*
+ * Where to carry on writing in sector: after its last valid record, or after
+ * whatever follows that isn't erased, e.g. a record cut short. Records are
+ * walked from the header, as the reader does, because a valid record can
+ * end in a word of 0xFF bytes that looks erased.
+ */
+static u32 resume_offset(const flash_log_region_t *g, u32 sector)
+{
+  u32 offset = FLASH_LOG_HEADER_LEN, end = offset;
+  s32 size;
+  u16 len;
+
+  while (offset + 4 <= g->sector_size) {
+    size = record_at(g, sector, offset, &len);
+    if (size > 0) {
+      offset += size;
+      end = offset;
+      continue;
+    }
+    if (read_word(g, sector, offset) != ERASED)
+      end = offset + 4;
+    offset += 4;
+  }
+  return end;
+}
+
+/*
+ * Erase sector and give it the next sequence number, carrying its erase
+ * count over. The magic number is programmed last.
+ */
+static s8 start_sector(flash_log_t *l, u32 sector)
+{
+  const flash_log_ops_t *ops = &l->ops;
+  u32 base = sector * l->region.sector_size;
+  flash_log_header_t h;
+  u32 erases = 0;
+
+  if (flash_log_read_header(&l->region, sector, &h))
+    erases = h.erases;
+  erases++;
+
+  l->sector = sector;
+  l->seq++;
+  l->erases++;
+  if (ops->erase(ops->context, sector) != 0 ||
+      ops->program(ops->context, base + 4, l->seq) != 0 ||
+      ops->program(ops->context, base + 8, erases) != 0 ||
+      ops->program(ops->context, base + 12,
+                   0xFFFF0000 | header_crc(l->seq, erases)) != 0 ||
+      ops->program(ops->context, base, FLASH_LOG_MAGIC) != 0) {
+    /* Leave the sector full so the next record moves on. */
+    l->errors++;
+    l->offset = l->region.sector_size;
+    return -1;
+  }
+  l->offset = FLASH_LOG_HEADER_LEN;
+  return 0;
+}
+
+/*
+ * Set up l to log into region, carrying on after the last record in its
+ * newest sector, and after anything written since, so a record cut short by
+ * a reset is left behind rather than programmed over. A region with no valid
+ * sectors is started afresh from its first sector. Returns 0, or -1 if flash
+ * couldn't be written.
+ */
+s8 flash_log_open(flash_log_t *l, const flash_log_region_t *region,
+                  const flash_log_ops_t *ops)
+{
+  flash_log_header_t h;
+  u8 found = 0;
+  u32 s;
+
+  memset(l, 0, sizeof(*l));
+  l->region = *region;
+  l->ops = *ops;
+
+  for (s = 0; s < region->n_sectors; s++) {
+    if (flash_log_read_header(region, s, &h) && (!found || h.seq > l->seq)) {
+      l->sector = s;
+      l->seq = h.seq;
+      found = 1;
+    }
+  }
+  if (!found)
+    return start_sector(l, 0);
+
+  l->offset = resume_offset(region, l->sector);
+  return 0;
+}
+
+static void stage_put(flash_log_t *l, const void *src, u32 n)
+{
+  u32 head = l->stage_head & FLASH_LOG_STAGE_MASK;
+  u32 first = n < FLASH_LOG_STAGE_LEN - head ? n : FLASH_LOG_STAGE_LEN - head;
+
+  memcpy(&l->stage[head], src, first);
+  memcpy(l->stage, (const u8 *)src + first, n - first);
+  l->stage_head += n;
+}
+
+/*
+ * Stage a frame with a good CRC to be written, e.g. from the receiver.
+ * Either the whole frame is staged, or, if the ring has no room for it,
+ * nothing is and 0 is returned.
+ */
+u8 flash_log_frame(flash_log_t *l, u16 msg_type, u16 sender, u8 len,
+                   const u8 *payload, u16 crc)
+{
+  u32 n = 8 + len, size = (4 + n + 3) & ~3;
+  u32 word = FLASH_LOG_RECORD | n;
+  u8 hdr[6] = { SBP_PREAMBLE, msg_type & 0xFF, msg_type >> 8,
+                sender & 0xFF, sender >> 8, len };
+  u8 tail[5] = { crc & 0xFF, crc >> 8, 0xFF, 0xFF, 0xFF };
+
+  if (size > FLASH_LOG_STAGE_LEN - (l->stage_head - l->stage_tail)) {
+    l->dropped++;
+    return 0;
+  }
+  /* The padding is left erased. */
+  stage_put(l, &word, 4);
+  stage_put(l, hdr, sizeof(hdr));
+  stage_put(l, payload, len);
+  stage_put(l, tail, size - 4 - 6 - len);
+  return 1;
+}
+
+static inline u32 stage_word(const flash_log_t *l, u32 i)
+{
+  u32 w;
+
+  memcpy(&w, &l->stage[(l->stage_tail + 4 * i) & FLASH_LOG_STAGE_MASK], 4);
+  return w;
+}
+
+/*
+ * Write up to max_words staged words to flash, from the main loop. Moving
+ * on to a new sector erases it, which takes far longer than a word. Returns
+ * the number of words written.
+ */
+u32 flash_log_poll(flash_log_t *l, u32 max_words)
+{
+  const flash_log_ops_t *ops = &l->ops;
+  u32 done = 0, base;
+
+  while (done < max_words) {
+    if (l->rec_words == 0) {
+      if (l->stage_head == l->stage_tail)
+        break;
+      l->rec_words = ((stage_word(l, 0) & 0xFFFF) + 4 + 3) / 4;
+      l->rec_pos = 1;
+      if (l->offset + 4 * l->rec_words > l->region.sector_size &&
+          start_sector(l, (l->sector + 1) % l->region.n_sectors) != 0) {
+        /* Drop the record rather than retry a failing sector forever. */
+        l->stage_tail += 4 * l->rec_words;
+        l->rec_words = 0;
+        break;
+      }
+    }
+
+    /* The body of the record first, then the word that makes it valid. */
+    base = l->sector * l->region.sector_size + l->offset;
+    if (l->rec_pos < l->rec_words) {
+      if (ops->program(ops->context, base + 4 * l->rec_pos,
+                       stage_word(l, l->rec_pos)) != 0)
+        goto fail;
+      l->rec_pos++;
+    } else {
+      if (ops->program(ops->context, base, stage_word(l, 0)) != 0)
+        goto fail;
+      l->offset += 4 * l->rec_words;
+      l->stage_tail += 4 * l->rec_words;
+      l->rec_words = 0;
+      l->records++;
+    }
+    done++;
+  }
+  return done;
+
+fail:
+  /* Start the record again in a new sector. */
+  l->errors++;
+  l->offset = l->region.sector_size;
+  l->rec_words = 0;
+  return done;
+}
+
+/* Bytes staged and not yet written. */
+u32 flash_log_pending(const flash_log_t *l)
+{
+  return l->stage_head - l->stage_tail;
+}
+
+void flash_log_read_init(flash_log_reader_t *r)
+{
+  memset(r, 0, sizeof(*r));
+}
+
+/* The valid sector with the lowest sequence number above seq, or above
+ * nothing if first. Returns 0 if there is none. */
+static u8 next_sector(const flash_log_region_t *g, u32 seq, u8 first,
+                      flash_log_reader_t *r)
+{
+  flash_log_header_t h;
+  u8 found = 0;
+  u32 s;
+
+  for (s = 0; s < g->n_sectors; s++) {
+    if (!flash_log_read_header(g, s, &h) || (!first && h.seq <= seq))
+      continue;
+    if (!found || h.seq < r->seq) {
+      r->seq = h.seq;
+      r->sector = s;
+      found = 1;
+    }
+  }
+  if (found)
+    r->offset = FLASH_LOG_HEADER_LEN;
+  return found;
+}
+
+/*
+ * The next record in region, oldest first: points frame at the frame and
+ * sets len. Returns 0 when there are no more. Anything that isn't a record,
+ * e.g. one cut short by a reset, is skipped a word at a time, and counted in
+ * r->bad.
+ */
+u8 flash_log_read_next(const flash_log_region_t *region,
+                       flash_log_reader_t *r, const u8 **frame, u16 *len)
+{
+  u8 skipped = 0;
+  s32 size;
+
+  if (!r->started) {
+    r->started = 1;
+    r->offset = region->sector_size;
+    next_sector(region, 0, 1, r);
+  }
+  while (1) {
+    size = record_at(region, r->sector, r->offset, len);
+    if (size > 0) {
+      r->bad += skipped;
+      *frame = region->mem + r->sector * region->sector_size + r->offset + 4;
+      r->offset += size;
+      return 1;
+    }
+    if (r->offset + 4 <= region->sector_size) {
+      if (read_word(region, r->sector, r->offset) != ERASED)
+        skipped = 1;
+      r->offset += 4;
+      continue;
+    }
+    r->bad += skipped;
+    skipped = 0;
+    if (!next_sector(region, r->seq, 0, r)) {
+      /* Stay at the end. */
+      r->offset = region->sector_size;
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * flash_log records raw SBP frames in a region of flash, as a ring of
+ * sectors, so there is a record of what a unit received.
+ *
+ * Each sector starts with a header giving its place in the ring (a sequence
+ * number that goes up by one per sector) and how often it has been erased,
+ * with a CRC-16. Records follow, word aligned: a word holding a marker and
+ * the frame length, then the whole frame as received, from the preamble to
+ * its CRC, which the reader checks along with the length. So a record costs
+ * no CRC work to write. When the next record doesn't fit, the sector
+ * after the current one is erased and the log carries on there, so the
+ * oldest sector is always the one overwritten and every sector is erased
+ * equally often.
+ *
+ * A record's first word is programmed last, and a sector header's magic
+ * number last, so a write cut short by a reset never looks valid. After a
+ * reset, flash_log_open finds the newest sector and carries on after the
+ * last record in it, leaving whatever was cut short behind, and
+ * the reader skips over it to the next valid record.
+ *
+ * Frames are staged in a RAM ring by flash_log_frame, which is quick and
+ * never touches flash, and written out a few words at a time by
+ * flash_log_poll from the main loop. Flash is reached through
+ * flash_log_ops_t, which host/flash_emu.c emulates.
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_FLASH_LOG_H
+#define SBP_TUTORIAL_FLASH_LOG_H
+
+#include <libsbp/common.h>
+
+/* RAM staging ring, bytes. Must be a power of two. */
+#ifndef FLASH_LOG_STAGE_LEN
+#define FLASH_LOG_STAGE_LEN 4096
+#endif
+#define FLASH_LOG_STAGE_MASK (FLASH_LOG_STAGE_LEN - 1)
+
+#define FLASH_LOG_MAGIC      0x4C504253 /* "SBPL" */
+/* First word of a record, with the frame length in the low half. */
+#define FLASH_LOG_RECORD     0x5AA50000
+#define FLASH_LOG_HEADER_LEN 16
+/* Longest SBP frame: preamble, type, sender, length, 255 bytes, CRC. */
+#define FLASH_LOG_MAX_FRAME  263
+#define FLASH_LOG_MAX_RECORD ((4 + FLASH_LOG_MAX_FRAME + 3) & ~3)
+
+/* Sector header, as stored. */
+typedef struct {
+  u32 magic;
+  u32 seq;     /* Place in the ring, one more than the sector before. */
+  u32 erases;  /* Times this sector has been erased. */
+  u16 crc;     /* Of seq and erases. */
+  u16 pad;
+} flash_log_header_t;
+
+/*
+ * Flash access, with sectors numbered and offsets counted from the start of
+ * the region. Both return 0 on success and -1 on failure. program writes a
+ * whole word to an erased, word aligned location.
+ */
+typedef struct {
+  s8 (*erase)(void *context, u32 sector);
+  s8 (*program)(void *context, u32 offset, u32 word);
+  void *context;
+} flash_log_ops_t;
+
+/* Region of flash holding a log, for writing or reading. */
+typedef struct {
+  const u8 *mem;       /* Memory mapped, or an image of it. */
+  u32 sector_size;
+  u32 n_sectors;
+} flash_log_region_t;
+
+typedef struct {
+  flash_log_region_t region;
+  flash_log_ops_t ops;
+
+  u32 sector;          /* Sector being written. */
+  u32 seq;             /* Its sequence number. */
+  u32 offset;          /* Where its next record goes. */
+
+  u8 stage[FLASH_LOG_STAGE_LEN] __attribute__ ((aligned(4)));
+  u32 stage_head;      /* Free running byte counts. */
+  u32 stage_tail;
+  u32 rec_words;       /* Words in the record being written, 0 for none. */
+  u32 rec_pos;         /* Words of it written, after the first. */
+
+  u32 records;         /* Records written. */
+  u32 dropped;         /* Frames not staged because the ring was full. */
+  u32 erases;          /* Sectors erased. */
+  u32 errors;          /* Failed erases and programs. */
+} flash_log_t;
+
+/* Position of a reader, oldest record first. */
+typedef struct {
+  u32 seq;             /* Sequence number of the sector being read. */
+  u32 sector;
+  u32 offset;
+  u8 started;
+  u32 bad;             /* Runs of words skipped that weren't erased. */
+} flash_log_reader_t;
+
+s8 flash_log_open(flash_log_t *l, const flash_log_region_t *region,
+                  const flash_log_ops_t *ops);
+u8 flash_log_frame(flash_log_t *l, u16 msg_type, u16 sender, u8 len,
+                   const u8 *payload, u16 crc);
+u32 flash_log_poll(flash_log_t *l, u32 max_words);
+u32 flash_log_pending(const flash_log_t *l);
+
+u8 flash_log_read_header(const flash_log_region_t *region, u32 sector,
+                         flash_log_header_t *h);
+void flash_log_read_init(flash_log_reader_t *r);
+u8 flash_log_read_next(const flash_log_region_t *region,
+                       flash_log_reader_t *r, const u8 **frame, u16 *len);
+
+#endif /* SBP_TUTORIAL_FLASH_LOG_H */
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <string.h>
+
+#include <libsbp/navigation.h>
+
+#include <geofence.h>
+
+#define GRID_CELLS (GEOFENCE_GRID * GEOFENCE_GRID)
+
+/* Set up an empty set of fences around a reference point, latitude and
+ * longitude in degrees. Fences should be within about 60 km of it (see
+ * ENU_MAX_DELTA) for the conversion to stay fast. */
+void geofence_init(geofence_t *g, double lat, double lon, double height)
+{
+  memset(g, 0, sizeof(*g));
+  enu_init(&g->ref, lat, lon, height);
+}
+
+void geofence_set_hook(geofence_t *g, geofence_hook_t hook, void *context)
+{
+  g->hook = hook;
+  g->hook_context = context;
+}
+
+/* East and north of a point, projected to the reference height. */
+static void to_point(const geofence_t *g, double lat, double lon,
+                     geofence_point_t *p)
+{
+  enu_t enu;
+
+  enu_from_llh(&g->ref, lat, lon, g->ref.height, &enu);
+  p->e = enu.e;
+  p->n = enu.n;
+}
+
+/* Add a circle, radius in metres. Returns -1 if there's no room. */
+s8 geofence_add_circle(geofence_t *g, u16 id, double lat, double lon,
+                       double radius)
+{
+  geofence_fence_t *f;
+
+  if (g->n_fences == GEOFENCE_MAX_FENCES)
+    return -1;
+  f = &g->fences[g->n_fences++];
+  memset(f, 0, sizeof(*f));
+  f->id = id;
+  f->type = GEOFENCE_CIRCLE;
+  to_point(g, lat, lon, &f->centre);
+  f->radius2 = radius * radius;
+  f->min.e = f->centre.e - radius;
+  f->min.n = f->centre.n - radius;
+  f->max.e = f->centre.e + radius;
+  f->max.n = f->centre.n + radius;
+  g->compiled = 0;
+  return 0;
+}
+
+/*
+ * Add a polygon of n vertices, ll[i][0] latitude and ll[i][1] longitude in
+ * degrees, in either winding order. Returns -1 if there's no room.
+ */
+s8 geofence_add_polygon(geofence_t *g, u16 id, const double (*ll)[2], u16 n)
+{
+  geofence_fence_t *f;
+  geofence_point_t *v;
+  u16 i;
+
+  if (n < 3 || g->n_fences == GEOFENCE_MAX_FENCES ||
+      g->n_vertices + n > GEOFENCE_MAX_VERTICES)
+    return -1;
+  f = &g->fences[g->n_fences++];
+  memset(f, 0, sizeof(*f));
+  f->id = id;
+  f->type = GEOFENCE_POLYGON;
+  f->first = g->n_vertices;
+  f->n = n;
+  v = &g->vertices[f->first];
+  for (i = 0; i < n; i++) {
+    to_point(g, ll[i][0], ll[i][1], &v[i]);
+    if (i == 0 || v[i].e < f->min.e)
+      f->min.e = v[i].e;
+    if (i == 0 || v[i].n < f->min.n)
+      f->min.n = v[i].n;
+    if (i == 0 || v[i].e > f->max.e)
+      f->max.e = v[i].e;
+    if (i == 0 || v[i].n > f->max.n)
+      f->max.n = v[i].n;
+  }
+  g->n_vertices += n;
+  g->compiled = 0;
+  return 0;
+}
+
+/* Grid column or row of x, clamped to the grid. */
+static inline u16 cell_coord(float x, float min, float inv)
+{
+  float c = (x - min) * inv;
+
+  if (c < 0)
+    return 0;
+  if (c >= GEOFENCE_GRID)
+    return GEOFENCE_GRID - 1;
+  return (u16)c;
+}
+
+/*
+ * Build the grid index. Must be called after adding fences and before
+ * testing positions. Returns -1 if the grid needs more than
+ * GEOFENCE_MAX_ENTRIES entries, i.e. too many fences overlap too many cells.
+ */
+s8 geofence_compile(geofence_t *g)
+{
+  geofence_point_t max = { 0, 0 };
+  geofence_fence_t *f;
+  u16 i, e0, e1, n0, n1, ce, cn;
+  u32 total = 0;
+  float size;
+
+  g->compiled = 0;
+  g->grid_min.e = g->grid_min.n = 0;
+  for (i = 0; i < g->n_fences; i++) {
+    f = &g->fences[i];
+    if (i == 0 || f->min.e < g->grid_min.e)
+      g->grid_min.e = f->min.e;
+    if (i == 0 || f->min.n < g->grid_min.n)
+      g->grid_min.n = f->min.n;
+    if (i == 0 || f->max.e > max.e)
+      max.e = f->max.e;
+    if (i == 0 || f->max.n > max.n)
+      max.n = f->max.n;
+  }
+  g->grid_max = max;
+  size = (max.e - g->grid_min.e) / GEOFENCE_GRID;
+  g->cell_size_inv[0] = size > 0 ? 1 / size : 1;
+  size = (max.n - g->grid_min.n) / GEOFENCE_GRID;
+  g->cell_size_inv[1] = size > 0 ? 1 / size : 1;
+
+  /* Count the entries of each cell, then turn the counts into the end of
+   * each cell's entries and fill them in backwards, leaving cell_start at
+   * the start. */
+  memset(g->cell_start, 0, sizeof(g->cell_start));
+  for (i = 0; i < g->n_fences; i++) {
+    f = &g->fences[i];
+    e0 = cell_coord(f->min.e, g->grid_min.e, g->cell_size_inv[0]);
+    e1 = cell_coord(f->max.e, g->grid_min.e, g->cell_size_inv[0]);
+    n0 = cell_coord(f->min.n, g->grid_min.n, g->cell_size_inv[1]);
+    n1 = cell_coord(f->max.n, g->grid_min.n, g->cell_size_inv[1]);
+    total += (u32)(e1 - e0 + 1) * (n1 - n0 + 1);
+    if (total > GEOFENCE_MAX_ENTRIES)
+      return -1;
+    for (cn = n0; cn <= n1; cn++)
+      for (ce = e0; ce <= e1; ce++)
+        g->cell_start[cn * GEOFENCE_GRID + ce]++;
+  }
+  for (i = 1; i <= GRID_CELLS; i++)
+    g->cell_start[i] += g->cell_start[i - 1];
+  for (i = g->n_fences; i-- > 0;) {
+    f = &g->fences[i];
+    e0 = cell_coord(f->min.e, g->grid_min.e, g->cell_size_inv[0]);
+    e1 = cell_coord(f->max.e, g->grid_min.e, g->cell_size_inv[0]);
+    n0 = cell_coord(f->min.n, g->grid_min.n, g->cell_size_inv[1]);
+    n1 = cell_coord(f->max.n, g->grid_min.n, g->cell_size_inv[1]);
+    for (cn = n0; cn <= n1; cn++)
+      for (ce = e0; ce <= e1; ce++)
+        g->entries[--g->cell_start[cn * GEOFENCE_GRID + ce]] = i;
+  }
+
+  /* Nothing is inside anything until the next test says so. */
+  for (i = 0; i < g->n_fences; i++)
+    g->fences[i].inside = 0;
+  g->n_inside = 0;
+  g->compiled = 1;
+  return 0;
+}
+
+/* Crossing number test: count the edges a ray to the east crosses. */
+static inline u8 in_polygon(const geofence_point_t *v, u16 n,
+                            const geofence_point_t *p)
+{
+  u16 i, j;
+  u8 in = 0;
+
+  for (i = 0, j = n - 1; i < n; j = i++)
+    if ((v[i].n > p->n) != (v[j].n > p->n) &&
+        p->e < (v[j].e - v[i].e) * (p->n - v[i].n) / (v[j].n - v[i].n) +
+               v[i].e)
+      in = !in;
+  return in;
+}
+
+static inline u8 contains(const geofence_t *g, const geofence_fence_t *f,
+                          const geofence_point_t *p)
+{
+  float de, dn;
+
+  if (p->e < f->min.e || p->e > f->max.e || p->n < f->min.n ||
+      p->n > f->max.n)
+    return 0;
+  if (f->type == GEOFENCE_CIRCLE) {
+    de = p->e - f->centre.e;
+    dn = p->n - f->centre.n;
+    return de * de + dn * dn <= f->radius2;
+  }
+  return in_polygon(&g->vertices[f->first], f->n, p);
+}
+
+/*
+ * Test a position, east and north of the reference in metres, at time of
+ * week tow. Calls the hook for each fence left, then for each fence entered,
+ * and returns the number of events.
+ */
+u16 geofence_test(geofence_t *g, const geofence_point_t *p, u32 tow)
+{
+  geofence_fence_t *f;
+  u16 events = 0, i, start = 0, end = 0, ce, cn;
+  u32 test;
+
+  if (!g->compiled)
+    return 0;
+  test = ++g->tests;
+
+  /* Fences in this cell that contain the position. Outside the grid there
+   * are none. The cell is found as geofence_compile found the fences' cells,
+   * so a position on the grid's far edges falls in the last cell like the
+   * boxes that reach it. */
+  if (p->e >= g->grid_min.e && p->e <= g->grid_max.e &&
+      p->n >= g->grid_min.n && p->n <= g->grid_max.n) {
+    ce = cell_coord(p->e, g->grid_min.e, g->cell_size_inv[0]);
+    cn = cell_coord(p->n, g->grid_min.n, g->cell_size_inv[1]);
+    i = cn * GEOFENCE_GRID + ce;
+    start = g->cell_start[i];
+    end = g->cell_start[i + 1];
+  }
+  for (i = start; i < end; i++) {
+    f = &g->fences[g->entries[i]];
+    if (contains(g, f, p))
+      f->seen = test;
+  }
+
+  /* Exits: fences it was inside that didn't contain it this time. */
+  for (i = 0; i < g->n_inside;) {
+    f = &g->fences[g->inside[i]];
+    if (f->seen == test) {
+      i++;
+      continue;
+    }
+    f->inside = 0;
+    g->inside[i] = g->inside[--g->n_inside];
+    events++;
+    if (g->hook)
+      g->hook(g, f->id, GEOFENCE_EXIT, tow, g->hook_context);
+  }
+
+  /* Enters. */
+  for (i = start; i < end; i++) {
+    f = &g->fences[g->entries[i]];
+    if (f->seen != test || f->inside)
+      continue;
+    f->inside = 1;
+    g->inside[g->n_inside++] = g->entries[i];
+    events++;
+    if (g->hook)
+      g->hook(g, f->id, GEOFENCE_ENTER, tow, g->hook_context);
+  }
+  return events;
+}
+
+/*
+ * Feed a message the receiver has just stored in sol, from the receiver hook.
+ * Tests each MSG_POS_LLH and returns the number of events.
+ */
+u16 geofence_message(geofence_t *g, const solution_t *sol, u16 msg_type)
+{
+  geofence_point_t p;
+
+  if (msg_type != SBP_MSG_POS_LLH || !g->compiled)
+    return 0;
+  to_point(g, sol->pos_llh.lat, sol->pos_llh.lon, &p);
+  return geofence_test(g, &p, sol->pos_llh.tow);
+}
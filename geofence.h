@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * geofence raises an event through a hook when a position enters or leaves
+ * one of a set of circles and polygons, given in latitude and longitude.
+ *
+ * As fences are added, their vertices and centres are converted to east and
+ * north in metres from a reference point (see enu.h) and each gets a
+ * bounding box. geofence_compile then lays a GEOFENCE_GRID x GEOFENCE_GRID
+ * grid over all of them, listing the fences whose box overlaps each cell. A
+ * position is then only tested against the fences in its own cell (bounding
+ * box, then the circle or a crossing number test on the polygon), and against
+ * those it was already inside, to catch it leaving. The work per position is
+ * bounded by the fences sharing a cell, not by the number of fences.
+ *
+ * geofence_message is called with each message from the receiver hook, and
+ * tests every MSG_POS_LLH as it arrives. Heights are ignored.
+ *
+ * Everything lives in fixed size arrays in geofence_t; the limits below can
+ * be overridden at build time. It contains no hardware access, so the same
+ * code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_GEOFENCE_H
+#define SBP_TUTORIAL_GEOFENCE_H
+
+#include <libsbp/common.h>
+
+#include <enu.h>
+#include <receiver.h>
+
+#ifndef GEOFENCE_MAX_FENCES
+#define GEOFENCE_MAX_FENCES   256
+#endif
+/* Polygon vertices, over all fences. */
+#ifndef GEOFENCE_MAX_VERTICES
+#define GEOFENCE_MAX_VERTICES 1024
+#endif
+/* Cells per side of the grid. */
+#ifndef GEOFENCE_GRID
+#define GEOFENCE_GRID         16
+#endif
+/* Fence entries, over all cells. */
+#ifndef GEOFENCE_MAX_ENTRIES
+#define GEOFENCE_MAX_ENTRIES  2048
+#endif
+
+#define GEOFENCE_CIRCLE  0
+#define GEOFENCE_POLYGON 1
+
+#define GEOFENCE_ENTER 0
+#define GEOFENCE_EXIT  1
+
+typedef struct {
+  float e;
+  float n;
+} geofence_point_t;
+
+typedef struct {
+  u16 id;           /* Given by the caller, passed to the hook. */
+  u8 type;
+  u8 inside;
+  u16 first;        /* Polygon vertices, in vertices[first, first + n). */
+  u16 n;
+  geofence_point_t centre;
+  float radius2;    /* Circle radius squared, m^2. */
+  geofence_point_t min, max; /* Bounding box. */
+  u32 seen;         /* Last test that found the position inside. */
+} geofence_fence_t;
+
+typedef struct geofence geofence_t;
+
+/* Called when a position enters or leaves a fence. */
+typedef void (*geofence_hook_t)(geofence_t *g, u16 id, u8 event, u32 tow,
+                                void *context);
+
+struct geofence {
+  enu_ref_t ref;
+  u8 compiled;
+
+  geofence_fence_t fences[GEOFENCE_MAX_FENCES];
+  u16 n_fences;
+  geofence_point_t vertices[GEOFENCE_MAX_VERTICES];
+  u16 n_vertices;
+
+  /* Grid over the bounding boxes of all fences; the fences overlapping
+   * cell c are entries[cell_start[c], cell_start[c + 1]). */
+  geofence_point_t grid_min;
+  geofence_point_t grid_max;
+  float cell_size_inv[2];
+  u16 cell_start[GEOFENCE_GRID * GEOFENCE_GRID + 1];
+  u16 entries[GEOFENCE_MAX_ENTRIES];
+
+  /* Fences the position is inside. */
+  u16 inside[GEOFENCE_MAX_FENCES];
+  u16 n_inside;
+  u32 tests;
+
+  geofence_hook_t hook;
+  void *hook_context;
+};
+
+void geofence_init(geofence_t *g, double lat, double lon, double height);
+s8 geofence_add_circle(geofence_t *g, u16 id, double lat, double lon,
+                       double radius);
+s8 geofence_add_polygon(geofence_t *g, u16 id, const double (*ll)[2], u16 n);
+s8 geofence_compile(geofence_t *g);
+void geofence_set_hook(geofence_t *g, geofence_hook_t hook, void *context);
+u16 geofence_test(geofence_t *g, const geofence_point_t *p, u32 tow);
+u16 geofence_message(geofence_t *g, const solution_t *sol, u16 msg_type);
+
+#endif /* SBP_TUTORIAL_GEOFENCE_H */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flash_emu.h"
+
+/* An erased region, as a new part comes. Returns -1 if out of memory. */
+s8 flash_emu_init(flash_emu_t *e, u32 sector_size, u32 n_sectors)
+{
+  memset(e, 0, sizeof(*e));
+  e->mem = malloc((size_t)sector_size * n_sectors);
+  e->erases = calloc(n_sectors, sizeof(*e->erases));
+  if (e->mem == NULL || e->erases == NULL) {
+    flash_emu_free(e);
+    return -1;
+  }
+  memset(e->mem, 0xFF, (size_t)sector_size * n_sectors);
+  e->sector_size = sector_size;
+  e->n_sectors = n_sectors;
+  return 0;
+}
+
+void flash_emu_free(flash_emu_t *e)
+{
+  free(e->mem);
+  free(e->erases);
+  e->mem = NULL;
+  e->erases = NULL;
+}
+
+/* Power back on after a cut, with no further cut planned. */
+void flash_emu_power_on(flash_emu_t *e)
+{
+  e->cut = 0;
+  e->cut_after = 0;
+}
+
+/* Count an operation. Returns 1 if this is the one the power is cut in. */
+static u8 cutting(flash_emu_t *e)
+{
+  e->ops++;
+  if (e->cut_after && e->ops == e->cut_after) {
+    e->cut = 1;
+    return 1;
+  }
+  return 0;
+}
+
+s8 flash_emu_erase(void *context, u32 sector)
+{
+  flash_emu_t *e = context;
+  u8 *p;
+
+  if (e->cut || sector >= e->n_sectors)
+    return -1;
+  p = e->mem + (size_t)sector * e->sector_size;
+  if (cutting(e)) {
+    memset(p + e->sector_size / 2, 0xFF, e->sector_size / 2);
+    return -1;
+  }
+  memset(p, 0xFF, e->sector_size);
+  e->erases[sector]++;
+  return 0;
+}
+
+s8 flash_emu_program(void *context, u32 offset, u32 word)
+{
+  flash_emu_t *e = context;
+  u32 old;
+
+  if (e->cut || (offset & 3) ||
+      offset + 4 > e->sector_size * e->n_sectors)
+    return -1;
+  memcpy(&old, e->mem + offset, 4);
+  if (old != 0xFFFFFFFF) {
+    e->violations++;
+    return -1;
+  }
+  /* A cut word gets only some of its zero bits. */
+  if (cutting(e))
+    word |= 0x0F0F0F0F;
+  memcpy(e->mem + offset, &word, 4);
+  return e->cut ? -1 : 0;
+}
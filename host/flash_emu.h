@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * flash_emu emulates a region of NOR flash in memory for flash_log on a
+ * host, with the rules of the real thing: erasing sets a whole sector to
+ * 0xFF, and programming can only clear bits, so programming a word that
+ * isn't erased is refused and counted. Erases are counted per sector.
+ *
+ * The power can be cut after a given number of operations. The operation
+ * it cuts is left half done, a word programmed with only some of its bits
+ * or a sector half erased, and every operation after it fails, as a reset
+ * would leave things.
+ */
+
+#ifndef SBP_TUTORIAL_FLASH_EMU_H
+#define SBP_TUTORIAL_FLASH_EMU_H
+
+#include <libsbp/common.h>
+
+typedef struct {
+  u8 *mem;
+  u32 sector_size;
+  u32 n_sectors;
+  u32 *erases;       /* Per sector. */
+  u32 ops;           /* Erases and programs so far. */
+  u32 cut_after;     /* Cut the power at this operation, 0 for never. */
+  u8 cut;
+  u32 violations;    /* Programs of words that weren't erased. */
+} flash_emu_t;
+
+s8 flash_emu_init(flash_emu_t *e, u32 sector_size, u32 n_sectors);
+void flash_emu_free(flash_emu_t *e);
+void flash_emu_power_on(flash_emu_t *e);
+s8 flash_emu_erase(void *context, u32 sector);
+s8 flash_emu_program(void *context, u32 offset, u32 word);
+
+#endif /* SBP_TUTORIAL_FLASH_EMU_H */
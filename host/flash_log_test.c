@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Drives flash_log.c over flash_emu with a generated capture of frames of
+ * varying lengths, and reads the log back to check it: appending to a fresh
+ * region, rotating through the ring with even wear, the offset writing
+ * resumes at after a reset (including after a record whose last word is all
+ * 0xFF) and a record cut short by a power cut. The region is small so the
+ * ring wraps many times.
+ *
+ * Usage: flash_log_test
+ *
+ * Prints each failed check and exits non-zero if there were any; `make test`
+ * runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsbp/edc.h>
+#include <flash_log.h>
+
+#include "flash_emu.h"
+
+#define SECTOR_SIZE 1024
+#define N_SECTORS   4
+#define POLL_WORDS  16
+#define N_FRAMES    1000
+#define SENDER      0x42
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, \
+           #cond); \
+    failures++; \
+  } \
+} while (0)
+
+typedef struct {
+  u8 buf[FLASH_LOG_MAX_FRAME];
+  u16 len;
+} frame_t;
+
+/* The generated capture. */
+static frame_t frames[N_FRAMES];
+
+static flash_emu_t emu;
+static flash_log_t flash_log;
+static flash_log_region_t region;
+static const flash_log_ops_t ops = {
+  &flash_emu_erase, &flash_emu_program, &emu
+};
+
+/* A whole frame, preamble to CRC, with a CRC that checks. */
+static void make_frame(frame_t *f, u16 msg_type, u16 sender, u8 len,
+                       const u8 *payload)
+{
+  u16 crc;
+
+  f->buf[0] = 0x55;
+  f->buf[1] = msg_type & 0xFF;
+  f->buf[2] = msg_type >> 8;
+  f->buf[3] = sender & 0xFF;
+  f->buf[4] = sender >> 8;
+  f->buf[5] = len;
+  memcpy(&f->buf[6], payload, len);
+  crc = crc16_ccitt(&f->buf[1], 5 + len, 0);
+  f->buf[6 + len] = crc & 0xFF;
+  f->buf[7 + len] = crc >> 8;
+  f->len = 8 + len;
+}
+
+/* Frames of every length up to 60 bytes of payload, and some longer. */
+static void make_capture(void)
+{
+  u8 payload[255];
+  u32 i, k;
+  u8 len;
+
+  for (i = 0; i < N_FRAMES; i++) {
+    len = i % 50 == 49 ? 255 : i * 7 % 61;
+    for (k = 0; k < len; k++)
+      payload[k] = i * 13 + k;
+    make_frame(&frames[i], 0x100 + i % 7, SENDER, len, payload);
+  }
+}
+
+static void log_frame(const frame_t *f)
+{
+  u8 len = f->buf[5];
+
+  CHECK(flash_log_frame(&flash_log, f->buf[1] | f->buf[2] << 8,
+                        f->buf[3] | f->buf[4] << 8, len, &f->buf[6],
+                        f->buf[6 + len] | f->buf[7 + len] << 8));
+}
+
+static void drain(void)
+{
+  while (flash_log_pending(&flash_log))
+    flash_log_poll(&flash_log, POLL_WORDS);
+}
+
+/* An erased region with the log opened on it. */
+static void fresh(void)
+{
+  flash_emu_free(&emu);
+  CHECK(flash_emu_init(&emu, SECTOR_SIZE, N_SECTORS) == 0);
+  region.mem = emu.mem;
+  region.sector_size = SECTOR_SIZE;
+  region.n_sectors = N_SECTORS;
+  CHECK(flash_log_open(&flash_log, &region, &ops) == 0);
+}
+
+/* Read the log back, checking it holds exactly the n frames in expect, in
+ * order. Returns the runs of other words the reader skipped. */
+static u32 check_log(const frame_t *const *expect, u32 n)
+{
+  flash_log_reader_t r;
+  const u8 *frame;
+  u32 records = 0;
+  u16 len;
+
+  flash_log_read_init(&r);
+  while (flash_log_read_next(&region, &r, &frame, &len)) {
+    if (records < n && (len != expect[records]->len ||
+                        memcmp(frame, expect[records]->buf, len) != 0)) {
+      printf("%s: record %u isn't the frame expected\n", __func__, records);
+      failures++;
+    }
+    records++;
+  }
+  if (records != n) {
+    printf("%s: %u records, expected %u\n", __func__, records, n);
+    failures++;
+  }
+  CHECK(emu.violations == 0);
+  return r.bad;
+}
+
+static void append(void)
+{
+  const frame_t *expect[10];
+  u32 i;
+
+  fresh();
+  for (i = 0; i < 10; i++) {
+    log_frame(&frames[i]);
+    expect[i] = &frames[i];
+  }
+  drain();
+  CHECK(flash_log.records == 10);
+  CHECK(flash_log.sector == 0);
+  CHECK(check_log(expect, 10) == 0);
+}
+
+static void rotation(void)
+{
+  static const frame_t *expect[N_FRAMES];
+  flash_log_reader_t r;
+  flash_log_header_t h;
+  const u8 *frame;
+  u32 i, n = 0, first, min = ~0U, max = 0, seqs = 0;
+  u16 len;
+
+  fresh();
+  for (i = 0; i < N_FRAMES; i++) {
+    log_frame(&frames[i]);
+    drain();
+  }
+  CHECK(flash_log.records == N_FRAMES);
+  CHECK(flash_log.errors == 0);
+
+  /* The log holds the newest frames, ending with the last. */
+  flash_log_read_init(&r);
+  CHECK(flash_log_read_next(&region, &r, &frame, &len));
+  for (first = 0; first < N_FRAMES; first++)
+    if (frames[first].len == len &&
+        memcmp(frames[first].buf, frame, len) == 0)
+      break;
+  CHECK(first > 0 && first < N_FRAMES);
+  for (i = first; i < N_FRAMES; i++)
+    expect[n++] = &frames[i];
+  CHECK(check_log(expect, n) == 0);
+
+  /* Every sector is in the ring, and worn as much as the others. */
+  for (i = 0; i < N_SECTORS; i++) {
+    CHECK(flash_log_read_header(&region, i, &h));
+    seqs += h.seq;
+    if (emu.erases[i] < min)
+      min = emu.erases[i];
+    if (emu.erases[i] > max)
+      max = emu.erases[i];
+  }
+  CHECK(min >= 2 && max - min <= 1);
+  /* Consecutive sequence numbers, ending with the sector being written. */
+  CHECK(flash_log_read_header(&region, flash_log.sector, &h));
+  CHECK(seqs == N_SECTORS * h.seq - N_SECTORS * (N_SECTORS - 1) / 2);
+}
+
+static void resume(void)
+{
+  const frame_t *expect[4];
+  frame_t ff;
+  u32 sender, offset;
+  u8 payload;
+
+  /* A one byte frame is a four word record, the last word holding the top
+   * of the CRC and three bytes of padding. Find one where that is 0xFF. */
+  for (sender = 0; sender < 0x10000; sender++) {
+    for (payload = 0; payload < 255; payload++) {
+      make_frame(&ff, 0x100, sender, 1, &payload);
+      if (ff.buf[8] == 0xFF)
+        break;
+    }
+    if (payload < 255)
+      break;
+  }
+  CHECK(ff.buf[8] == 0xFF);
+
+  fresh();
+  log_frame(&frames[1]);
+  log_frame(&ff);
+  drain();
+  offset = flash_log.offset;
+
+  /* As after a reset: the log carries on right after the last record. */
+  CHECK(flash_log_open(&flash_log, &region, &ops) == 0);
+  CHECK(flash_log.offset == offset);
+  CHECK(flash_log.sector == 0);
+  log_frame(&frames[2]);
+  log_frame(&frames[3]);
+  drain();
+  expect[0] = &frames[1];
+  expect[1] = &ff;
+  expect[2] = &frames[2];
+  expect[3] = &frames[3];
+  CHECK(check_log(expect, 4) == 0);
+}
+
+static void cut_record(void)
+{
+  const frame_t *expect[5];
+  u32 offset;
+
+  fresh();
+  log_frame(&frames[1]);
+  log_frame(&frames[2]);
+  log_frame(&frames[3]);
+  drain();
+  offset = flash_log.offset;
+
+  /* Cut the power a few words into the body of the next record. */
+  emu.cut_after = emu.ops + 3;
+  log_frame(&frames[8]);
+  drain();
+  CHECK(emu.cut);
+  CHECK(flash_log.records == 3);
+
+  /* Writing resumes after the words the cut record left behind, and the
+   * reader skips them. */
+  flash_emu_power_on(&emu);
+  CHECK(flash_log_open(&flash_log, &region, &ops) == 0);
+  CHECK(flash_log.offset == offset + 4 * 4);
+  log_frame(&frames[4]);
+  log_frame(&frames[5]);
+  drain();
+  expect[0] = &frames[1];
+  expect[1] = &frames[2];
+  expect[2] = &frames[3];
+  expect[3] = &frames[4];
+  expect[4] = &frames[5];
+  CHECK(check_log(expect, 5) == 1);
+}
+
+int main(void)
+{
+  make_capture();
+  append();
+  rotation();
+  resume();
+  cut_record();
+  flash_emu_free(&emu);
+  if (failures) {
+    printf("flash_log_test: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("flash_log_test: all passed\n");
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Checks geofence.c on positions at the edges of its grid, where the cell
+ * lookup in geofence_test has to agree with the clamping geofence_compile
+ * used to place the fences: points exactly on the east and north edges of
+ * the rightmost circle, on the grid's near edges, and just outside.
+ *
+ * The rightmost circle is centred on the reference point with a power of two
+ * radius, so its edges, which are also the grid's east and north edges, are
+ * exact in float.
+ *
+ * Usage: geofence_test
+ *
+ * Prints each failed check and exits non-zero if there were any; `make test`
+ * runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <geofence.h>
+
+#define REF_LAT    37.7750
+#define REF_LON    -122.4192
+#define RADIUS     64
+/* About 200 m west of the reference. */
+#define WEST_LON   (REF_LON - 0.0023)
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, \
+           #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static u16 last_id;
+static u8 last_event;
+
+static void hook(geofence_t *g, u16 id, u8 event, u32 tow, void *context)
+{
+  (void)g;
+  (void)tow;
+  (void)context;
+  last_id = id;
+  last_event = event;
+}
+
+/* Test p, expecting a single event for fence id, or none if id is 0. */
+static void check_event(geofence_t *g, float e, float n, u16 id, u8 event)
+{
+  geofence_point_t p = { e, n };
+  u16 events;
+
+  last_id = 0;
+  events = geofence_test(g, &p, 0);
+  if (events != (id ? 1 : 0) || last_id != id ||
+      (id && last_event != event)) {
+    printf("%s: at %g,%g: %u events, last fence %u event %u, expected "
+           "fence %u event %u\n", __func__, e, n, events, last_id,
+           last_event, id, event);
+    failures++;
+  }
+}
+
+/* One circle on the reference point, and a smaller one to the west of it. */
+static void setup(geofence_t *g)
+{
+  geofence_init(g, REF_LAT, REF_LON, 0);
+  CHECK(geofence_add_circle(g, 1, REF_LAT, REF_LON, RADIUS) == 0);
+  CHECK(geofence_add_circle(g, 2, REF_LAT, WEST_LON, RADIUS / 2) == 0);
+  CHECK(geofence_compile(g) == 0);
+  CHECK(g->fences[0].centre.e == 0 && g->fences[0].centre.n == 0);
+  CHECK(g->grid_max.e == RADIUS && g->grid_max.n == RADIUS);
+  geofence_set_hook(g, hook, NULL);
+}
+
+static void east_edge(void)
+{
+  static geofence_t g;
+
+  setup(&g);
+  check_event(&g, RADIUS, 0, 1, GEOFENCE_ENTER);
+  check_event(&g, RADIUS + 1, 0, 1, GEOFENCE_EXIT);
+  check_event(&g, RADIUS, 0, 1, GEOFENCE_ENTER);
+}
+
+static void north_edge(void)
+{
+  static geofence_t g;
+
+  setup(&g);
+  check_event(&g, 0, RADIUS, 1, GEOFENCE_ENTER);
+  check_event(&g, 0, RADIUS + 1, 1, GEOFENCE_EXIT);
+}
+
+static void near_edges(void)
+{
+  static geofence_t g;
+  const geofence_fence_t *west = &g.fences[1];
+
+  setup(&g);
+  /* Just inside the west edge of circle 2, which is the grid's. */
+  check_event(&g, west->min.e + 0.5f, west->centre.n, 2, GEOFENCE_ENTER);
+  check_event(&g, west->min.e - 0.5f, west->centre.n, 2, GEOFENCE_EXIT);
+  /* On the south edge of circle 1. */
+  check_event(&g, 0, -RADIUS, 1, GEOFENCE_ENTER);
+  check_event(&g, 0, -RADIUS - 1, 1, GEOFENCE_EXIT);
+}
+
+static void outside(void)
+{
+  static geofence_t g;
+
+  setup(&g);
+  /* Inside the grid but in neither circle, then off each side of it. */
+  check_event(&g, RADIUS, RADIUS, 0, 0);
+  check_event(&g, RADIUS + 1, 0, 0, 0);
+  check_event(&g, 0, RADIUS + 1, 0, 0);
+  check_event(&g, g.grid_min.e - 1, 0, 0, 0);
+  check_event(&g, 0, -2 * RADIUS, 0, 0);
+}
+
+int main(void)
+{
+  east_edge();
+  north_edge();
+  near_edges();
+  outside();
+  if (failures) {
+    printf("geofence_test: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("geofence_test: all passed\n");
+  return 0;
+}
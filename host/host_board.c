@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "host_board.h"
+
+/*
+ * Simulated USART1. usart1_rx puts a byte in the data register and raises the
+ * receive interrupt, which hands it to the FIFO exactly as the board does.
+ */
+static fifo_t *usart1_rx_fifo;
+static u8 usart1_dr;
+/* Bytes dropped because the FIFO was full. */
+u32 usart1_overruns = 0;
+
+void USART1_IRQHandler(void)
+{
+  if (!fifo_write(usart1_rx_fifo, usart1_dr))
+    usart1_overruns++;
+}
+
+/* Receive one byte. Returns 0 if it was dropped because the FIFO was full. */
+u8 usart1_rx(u8 c)
+{
+  u32 overruns = usart1_overruns;
+
+  usart1_dr = c;
+  USART1_IRQHandler();
+  return usart1_overruns == overruns;
+}
+
+void usarts_setup(fifo_t *rx_fifo)
+{
+  usart1_rx_fifo = rx_fifo;
+}
+
+static struct timespec timebase_start;
+
+void timebase_setup(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &timebase_start);
+}
+
+/* Milliseconds since timebase_setup. */
+u32 timebase_ms(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u32)((now.tv_sec - timebase_start.tv_sec) * 1000 +
+               (now.tv_nsec - timebase_start.tv_nsec) / 1000000);
+}
+
+void cycle_counter_setup(void)
+{
+}
+
+/* There's no portable cycle counter, so count nanoseconds instead. */
+u32 cycle_count(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u32)((u64)now.tv_sec * 1000000000 + now.tv_nsec);
+}
+
+/* The LEDs don't exist on a host. */
+void leds_set(void)
+{
+}
+
+void leds_unset(void)
+{
+}
+
+void leds_toggle(void)
+{
+}
+
+void leds_setup(void)
+{
+}
+
+void SH_SendString(const char *str)
+{
+  fputs(str, stdout);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * host_board stands in for the board layer (tutorial_implementation.c) when
+ * building for Linux. It provides the same UART, timebase, cycle counter and
+ * LED functions, plus a way to feed bytes through a simulated USART1 receive
+ * interrupt.
+ */
+
+#ifndef SBP_TUTORIAL_HOST_BOARD_H
+#define SBP_TUTORIAL_HOST_BOARD_H
+
+#include <libsbp/common.h>
+
+#include <fifo.h>
+
+#define DO_EVERY(n, cmd) do { \
+  static u32 do_every_count = 0; \
+  if (do_every_count % (n) == 0) { \
+    cmd; \
+  } \
+  do_every_count++; \
+} while(0)
+
+/* UART functions */
+void usarts_setup(fifo_t *rx_fifo);
+void USART1_IRQHandler(void);
+u8 usart1_rx(u8 c);
+extern u32 usart1_overruns;
+
+/* Timebase functions */
+void timebase_setup(void);
+u32 timebase_ms(void);
+
+/* Cycle counter functions */
+void cycle_counter_setup(void);
+u32 cycle_count(void);
+
+/* LED functions */
+void leds_set(void);
+void leds_unset(void);
+void leds_toggle(void);
+void leds_setup(void);
+
+/* Semihosting stand-in */
+void SH_SendString(const char *str);
+
+#endif /* SBP_TUTORIAL_HOST_BOARD_H */
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include "log_index.h"
+
+#define WEEK_MS 604800000ULL
+
+/* Layout of a saved index: this header, the frames, then the epochs. */
+typedef struct {
+  char magic[8];
+  u32 version;
+  u32 n_frames;
+  u32 n_epochs;
+  u32 n_crc_errors;
+  u64 capture_size;
+  u64 capture_mtime;
+  u32 monotonic;
+  u32 reserved;
+} log_index_header_t;
+
+/*
+ * Map a capture read only. Returns 0 on success, -1 on failure (with errno
+ * set). The index is empty until built or loaded.
+ */
+int log_open(log_index_t *ix, const char *path)
+{
+  struct stat st;
+  int fd;
+
+  memset(ix, 0, sizeof(*ix));
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  ix->size = st.st_size;
+  ix->mtime = st.st_mtime;
+  if (ix->size) {
+    ix->data = mmap(NULL, ix->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ix->data == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+static void free_tables(log_index_t *ix)
+{
+  if (ix->index_map) {
+    munmap(ix->index_map, ix->index_map_size);
+    ix->index_map = NULL;
+  } else {
+    free(ix->frames);
+    free(ix->epochs);
+  }
+  ix->frames = NULL;
+  ix->epochs = NULL;
+  ix->n_frames = 0;
+  ix->n_epochs = 0;
+}
+
+void log_close(log_index_t *ix)
+{
+  free_tables(ix);
+  if (ix->size)
+    munmap((void *)ix->data, ix->size);
+  ix->data = NULL;
+  ix->size = 0;
+}
+
+/* Time of week carried by a frame, for the messages that have one. */
+static u8 frame_tow(const sbp_frame_t *f, u32 *tow, u16 *wn)
+{
+  const u8 *p = f->payload;
+
+  switch (f->msg_type) {
+  case SBP_MSG_GPS_TIME:
+    if (f->len < sizeof(msg_gps_time_t))
+      return 0;
+    *wn = p[0] | (p[1] << 8);
+    *tow = p[2] | (p[3] << 8) | (p[4] << 16) | ((u32)p[5] << 24);
+    return 1;
+  case SBP_MSG_POS_ECEF:
+  case SBP_MSG_POS_LLH:
+  case SBP_MSG_BASELINE_ECEF:
+  case SBP_MSG_BASELINE_NED:
+  case SBP_MSG_VEL_ECEF:
+  case SBP_MSG_VEL_NED:
+  case SBP_MSG_DOPS:
+    if (f->len < 4)
+      return 0;
+    *tow = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static u64 epoch_key(const log_epoch_t *e)
+{
+  return (e->wn == LOG_WN_UNKNOWN ? 0 : e->wn * WEEK_MS) + e->tow;
+}
+
+/* Grow an array to hold at least n + 1 elements. */
+static int reserve(void **array, u32 *cap, u32 n, size_t elem)
+{
+  void *p;
+
+  if (n < *cap)
+    return 0;
+  *cap = *cap ? *cap * 2 : 4096;
+  p = realloc(*array, (size_t)*cap * elem);
+  if (p == NULL)
+    return -1;
+  *array = p;
+  return 0;
+}
+
+/*
+ * Scan the whole capture once and build the index.
+ * Returns 0 on success, -1 if out of memory.
+ */
+int log_index_build(log_index_t *ix)
+{
+  u32 frame_cap = 0, epoch_cap = 0;
+  log_epoch_t *e = NULL;
+  u16 wn = LOG_WN_UNKNOWN, frame_wn;
+  sbp_frame_t f;
+  u64 pos = 0;
+  u32 tow;
+  u8 ret;
+
+  free_tables(ix);
+  ix->n_crc_errors = 0;
+  ix->monotonic = 1;
+  madvise((void *)ix->data, ix->size, MADV_SEQUENTIAL);
+
+  while ((ret = sbp_frame_next(ix->data, ix->size, pos, &f)) != SBP_FRAME_END) {
+    pos = f.end;
+    if (ret == SBP_FRAME_CRC_ERROR) {
+      ix->n_crc_errors++;
+      continue;
+    }
+
+    frame_wn = wn;
+    if (frame_tow(&f, &tow, &frame_wn) &&
+        (e == NULL || (e->flags & LOG_EPOCH_NO_TIME) ||
+         tow != e->tow || frame_wn != e->wn)) {
+      if (reserve((void **)&ix->epochs, &epoch_cap, ix->n_epochs,
+                  sizeof(log_epoch_t)) != 0)
+        return -1;
+      e = &ix->epochs[ix->n_epochs];
+      e->tow = tow;
+      e->wn = frame_wn;
+      e->flags = 0;
+      e->first_frame = ix->n_frames;
+      if (ix->n_epochs && epoch_key(e) < epoch_key(e - 1))
+        ix->monotonic = 0;
+      ix->n_epochs++;
+    }
+    wn = frame_wn;
+
+    /* Frames before the first time of week get an epoch with no time. */
+    if (e == NULL) {
+      if (reserve((void **)&ix->epochs, &epoch_cap, 0,
+                  sizeof(log_epoch_t)) != 0)
+        return -1;
+      e = &ix->epochs[0];
+      e->tow = 0;
+      e->wn = LOG_WN_UNKNOWN;
+      e->flags = LOG_EPOCH_NO_TIME;
+      e->first_frame = 0;
+      ix->n_epochs = 1;
+    }
+
+    if (reserve((void **)&ix->frames, &frame_cap, ix->n_frames,
+                sizeof(log_frame_t)) != 0)
+      return -1;
+    ix->frames[ix->n_frames].offset = f.offset;
+    ix->frames[ix->n_frames].msg_type = f.msg_type;
+    ix->frames[ix->n_frames].sender = f.sender;
+    ix->frames[ix->n_frames].epoch = ix->n_epochs - 1;
+    ix->n_frames++;
+  }
+  madvise((void *)ix->data, ix->size, MADV_NORMAL);
+  return 0;
+}
+
+/* Write the index to path. Returns 0 on success, -1 on failure. */
+int log_index_save(const log_index_t *ix, const char *path)
+{
+  log_index_header_t h;
+  FILE *f;
+  int ok;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, LOG_INDEX_MAGIC, sizeof(h.magic));
+  h.version = LOG_INDEX_VERSION;
+  h.n_frames = ix->n_frames;
+  h.n_epochs = ix->n_epochs;
+  h.n_crc_errors = ix->n_crc_errors;
+  h.capture_size = ix->size;
+  h.capture_mtime = ix->mtime;
+  h.monotonic = ix->monotonic;
+
+  f = fopen(path, "wb");
+  if (f == NULL)
+    return -1;
+  ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+       fwrite(ix->frames, sizeof(log_frame_t), ix->n_frames, f) == ix->n_frames &&
+       fwrite(ix->epochs, sizeof(log_epoch_t), ix->n_epochs, f) == ix->n_epochs;
+  if (fclose(f) != 0)
+    ok = 0;
+  return ok ? 0 : -1;
+}
+
+/*
+ * Map a saved index for the open capture. Returns 0 on success, -1 if the
+ * file can't be read, isn't an index, or was built from a different capture.
+ */
+int log_index_load(log_index_t *ix, const char *path)
+{
+  const log_index_header_t *h;
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || (u64)st.st_size < sizeof(*h)) {
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  h = map;
+  if (memcmp(h->magic, LOG_INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != LOG_INDEX_VERSION ||
+      h->capture_size != ix->size || h->capture_mtime != ix->mtime ||
+      (u64)st.st_size != sizeof(*h) + (u64)h->n_frames * sizeof(log_frame_t) +
+                         (u64)h->n_epochs * sizeof(log_epoch_t)) {
+    munmap(map, st.st_size);
+    return -1;
+  }
+
+  free_tables(ix);
+  ix->index_map = map;
+  ix->index_map_size = st.st_size;
+  ix->n_frames = h->n_frames;
+  ix->n_epochs = h->n_epochs;
+  ix->n_crc_errors = h->n_crc_errors;
+  ix->monotonic = h->monotonic;
+  ix->frames = (log_frame_t *)(h + 1);
+  ix->epochs = (log_epoch_t *)(ix->frames + ix->n_frames);
+  return 0;
+}
+
+/* Decode frame k. Returns 1 if there is such a frame, 0 otherwise. */
+u8 log_frame(const log_index_t *ix, u32 k, sbp_frame_t *f)
+{
+  if (k >= ix->n_frames)
+    return 0;
+  return sbp_frame_at(ix->data, ix->size, ix->frames[k].offset, f) ==
+         SBP_FRAME_OK;
+}
+
+/* First epoch with a key of at least key, epochs must be monotonic. */
+static u32 epoch_lower_bound(const log_index_t *ix, u64 key)
+{
+  u32 lo = 0, hi = ix->n_epochs, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (epoch_key(&ix->epochs[mid]) < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/*
+ * Call cb for each frame of type msg_type (or any type, for LOG_ANY_TYPE)
+ * in an epoch with a time of week from tow_start to tow_end inclusive, in
+ * week wn (or any week, for LOG_WN_UNKNOWN). Frames before the first time of
+ * week never match. Returns the number of matching frames.
+ */
+u32 log_query(const log_index_t *ix, u16 msg_type, u16 wn,
+              u32 tow_start, u32 tow_end, log_query_cb_t cb, void *context)
+{
+  u32 first = 0, last = ix->n_epochs, i, k, end, n = 0;
+  const log_epoch_t *e;
+
+  /* With a known week and ordered epochs, only look at the matching ones. */
+  if (wn != LOG_WN_UNKNOWN && ix->monotonic) {
+    first = epoch_lower_bound(ix, wn * WEEK_MS + tow_start);
+    last = epoch_lower_bound(ix, wn * WEEK_MS + (u64)tow_end + 1);
+  }
+
+  for (i = first; i < last; i++) {
+    e = &ix->epochs[i];
+    if ((e->flags & LOG_EPOCH_NO_TIME) ||
+        e->tow < tow_start || e->tow > tow_end ||
+        (wn != LOG_WN_UNKNOWN && e->wn != wn))
+      continue;
+    end = i + 1 < ix->n_epochs ? ix->epochs[i + 1].first_frame : ix->n_frames;
+    for (k = e->first_frame; k < end; k++) {
+      if (msg_type != LOG_ANY_TYPE && ix->frames[k].msg_type != msg_type)
+        continue;
+      n++;
+      if (cb)
+        cb(ix, k, context);
+    }
+  }
+  return n;
+}
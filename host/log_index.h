@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * log_index gives random access to a raw SBP capture. The capture is memory
+ * mapped and scanned once to build a side index: one entry per good frame
+ * (offset, message type, sender and epoch) and one entry per epoch (GPS week,
+ * time of week and first frame). After that, frame k is one array lookup
+ * and a time range is a binary search over the epochs.
+ *
+ * An epoch starts whenever a frame carries a time of week different from the
+ * current one. Frames that carry no time of week (e.g. observations) belong
+ * to the epoch they arrived in. The GPS week comes from MSG_GPS_TIME.
+ *
+ * The index can be saved next to the capture and loaded again, and is
+ * rebuilt if the capture has changed size or modification time since.
+ */
+
+#ifndef SBP_TUTORIAL_LOG_INDEX_H
+#define SBP_TUTORIAL_LOG_INDEX_H
+
+#include <libsbp/common.h>
+
+#include "sbp_frame.h"
+
+#define LOG_INDEX_MAGIC   "SBPINDEX"
+#define LOG_INDEX_VERSION 1
+/* Week number of epochs before the first MSG_GPS_TIME, and the week to
+ * query with to match any week. */
+#define LOG_WN_UNKNOWN    0xFFFF
+/* Epoch flag: frames before the first time of week, tow is meaningless. */
+#define LOG_EPOCH_NO_TIME 0x0001
+/* Message type to query with to match any type. */
+#define LOG_ANY_TYPE      0xFFFF
+
+typedef struct {
+  u64 offset;     /* Offset of the frame's preamble in the capture. */
+  u16 msg_type;
+  u16 sender;
+  u32 epoch;      /* Index into the epoch table. */
+} log_frame_t;
+
+typedef struct {
+  u32 tow;          /* GPS time of week, milliseconds. */
+  u16 wn;           /* GPS week, or LOG_WN_UNKNOWN. */
+  u16 flags;
+  u32 first_frame;  /* First frame of the epoch. */
+} log_epoch_t;
+
+typedef struct {
+  /* The memory mapped capture. */
+  const u8 *data;
+  u64 size;
+  u64 mtime;
+
+  log_frame_t *frames;
+  u32 n_frames;
+  log_epoch_t *epochs;
+  u32 n_epochs;
+  u32 n_crc_errors;
+  u8 monotonic;     /* Epoch times never go backwards, so they can be
+                       binary searched. */
+
+  /* The mapped index file when loaded, NULL when the tables were built and
+   * are on the heap. */
+  void *index_map;
+  u64 index_map_size;
+} log_index_t;
+
+int log_open(log_index_t *ix, const char *path);
+void log_close(log_index_t *ix);
+int log_index_build(log_index_t *ix);
+int log_index_save(const log_index_t *ix, const char *path);
+int log_index_load(log_index_t *ix, const char *path);
+
+/* Called by log_query with the number of each matching frame. */
+typedef void (*log_query_cb_t)(const log_index_t *ix, u32 k, void *context);
+
+u8 log_frame(const log_index_t *ix, u32 k, sbp_frame_t *f);
+u32 log_query(const log_index_t *ix, u16 msg_type, u16 wn,
+              u32 tow_start, u32 tow_end, log_query_cb_t cb, void *context);
+
+#endif /* SBP_TUTORIAL_LOG_INDEX_H */
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Drives pps_clock.c with synthetic PPS edge sequences, at the board's 16 MHz
+ * timer clock, and checks the GPS times it gives back: a steady 1 Hz
+ * sequence, a missed edge, a glitch edge, a drifting oscillator and a GPS
+ * week rollover. Each sequence starts just before the 32 bit tick counter
+ * wraps, so that is covered too.
+ *
+ * Usage: pps_clock_test
+ *
+ * Prints each failed check and exits non-zero if there were any; `make test`
+ * runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pps_clock.h>
+
+#define TICK_HZ   16000000
+#define START     0xFF000000U
+#define WN        2000
+#define TOW_MS    100000
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, \
+           #cond); \
+    failures++; \
+  } \
+} while (0)
+
+/* Check the GPS time at ticks, to within tol_ns. */
+static void check_time(const pps_clock_t *c, u32 ticks, u16 wn, u32 tow,
+                       u32 ns, u32 tol_ns)
+{
+  gps_stamp_t t;
+  s64 err;
+
+  CHECK(pps_clock_gps_time(c, ticks, &t));
+  CHECK(t.wn == wn);
+  err = ((s64)t.tow - tow) * 1000000 + (s64)t.ns - ns;
+  if (err < -(s64)tol_ns || err > (s64)tol_ns) {
+    printf("%s: at %u ticks: %u:%u.%06u, expected %u:%u.%06u\n", __func__,
+           ticks, t.wn, t.tow, t.ns, wn, tow, ns);
+    failures++;
+  }
+}
+
+/* Edges every period ticks from START, labelled on the first. */
+static void start(pps_clock_t *c, u32 period, u16 wn, u32 tow, u32 n)
+{
+  u32 i;
+
+  pps_clock_init(c, TICK_HZ);
+  pps_clock_edge(c, START);
+  CHECK(pps_clock_label(c, wn, tow, START + 1000));
+  for (i = 1; i < n; i++)
+    pps_clock_edge(c, START + i * period);
+}
+
+static void steady(void)
+{
+  pps_clock_t c;
+  u32 last = START + 9 * TICK_HZ;
+
+  start(&c, TICK_HZ, WN, TOW_MS, 10);
+  CHECK(c.n_edges == 10);
+  CHECK(c.n_rejected == 0);
+  CHECK(pps_clock_drift_ppb(&c) == 0);
+  /* On the last edge, half a second after it and a quarter before. */
+  check_time(&c, last, WN, TOW_MS + 9000, 0, 0);
+  check_time(&c, last + TICK_HZ / 2, WN, TOW_MS + 9500, 0, 0);
+  check_time(&c, last - TICK_HZ / 4, WN, TOW_MS + 8750, 0, 0);
+  /* One tick is 62.5 ns. */
+  check_time(&c, last + 1, WN, TOW_MS + 9000, 62, 1);
+
+  /* Labels only apply to whole seconds within a second of the edge. */
+  CHECK(!pps_clock_label(&c, WN, TOW_MS + 9500, last + 1000));
+  CHECK(!pps_clock_label(&c, WN, TOW_MS + 9000, last + TICK_HZ + 1));
+}
+
+static void missed_edge(void)
+{
+  pps_clock_t c;
+
+  start(&c, TICK_HZ, WN, TOW_MS, 5);
+  /* No edge at 5 s, the next is at 6 s. */
+  pps_clock_edge(&c, START + 6 * TICK_HZ);
+  CHECK(c.n_edges == 6);
+  CHECK(c.n_rejected == 0);
+  check_time(&c, START + 6 * TICK_HZ, WN, TOW_MS + 6000, 0, 0);
+  check_time(&c, START + 7 * TICK_HZ, WN, TOW_MS + 7000, 0, 0);
+}
+
+static void glitch(void)
+{
+  pps_clock_t c;
+  u32 i;
+
+  start(&c, TICK_HZ, WN, TOW_MS, 5);
+  /* Half a second after an edge, and one 2000 ppm late. */
+  pps_clock_edge(&c, START + 4 * TICK_HZ + TICK_HZ / 2);
+  pps_clock_edge(&c, START + 5 * TICK_HZ + 2 * (TICK_HZ / 1000));
+  CHECK(c.n_rejected == 2);
+  CHECK(c.n_edges == 5);
+  CHECK(c.locked);
+  CHECK(pps_clock_drift_ppb(&c) == 0);
+  check_time(&c, START + 4 * TICK_HZ, WN, TOW_MS + 4000, 0, 0);
+
+  /* The next good edge is taken, and the label carried to it. */
+  pps_clock_edge(&c, START + 6 * TICK_HZ);
+  CHECK(c.n_edges == 6);
+  CHECK(c.rejects == 0);
+  check_time(&c, START + 6 * TICK_HZ, WN, TOW_MS + 6000, 0, 0);
+
+  /* PPS_CLOCK_MAX_REJECTS glitches in a row restart the model. */
+  for (i = 0; i < PPS_CLOCK_MAX_REJECTS; i++)
+    pps_clock_edge(&c, START + 6 * TICK_HZ + i * TICK_HZ + TICK_HZ / 2);
+  CHECK(!c.locked);
+}
+
+static void drift(void)
+{
+  /* 12.5 ppm fast: 200 extra ticks a second. */
+  u32 period = TICK_HZ + 200, last = START + 99 * period;
+  pps_clock_t c;
+  s32 ppb;
+
+  start(&c, period, WN, TOW_MS, 100);
+  ppb = pps_clock_drift_ppb(&c);
+  CHECK(ppb > 12500 - 10 && ppb < 12500 + 10);
+  check_time(&c, last, WN, TOW_MS + 99000, 0, 0);
+  /* Half a GPS second is period / 2 local ticks. */
+  check_time(&c, last + period / 2, WN, TOW_MS + 99500, 0, 100);
+
+  /* The estimate follows a change of rate, e.g. with temperature. */
+  period = TICK_HZ - 80;
+  for (ppb = 1; ppb <= 100; ppb++)
+    pps_clock_edge(&c, last + ppb * period);
+  ppb = pps_clock_drift_ppb(&c);
+  CHECK(ppb > -5000 - 10 && ppb < -5000 + 10);
+}
+
+static void week_rollover(void)
+{
+  pps_clock_t c;
+
+  /* Labelled two seconds before the end of the week. */
+  start(&c, TICK_HZ, WN, 604798000, 4);
+  CHECK(c.ref_wn == WN + 1);
+  CHECK(c.ref_tow_s == 1);
+  check_time(&c, START + 2 * TICK_HZ, WN + 1, 0, 0, 0);
+  check_time(&c, START + 3 * TICK_HZ, WN + 1, 1000, 0, 0);
+  /* Back across the rollover from the newest edge. */
+  check_time(&c, START + 2 * TICK_HZ - TICK_HZ / 2, WN, 604799500, 0, 0);
+}
+
+int main(void)
+{
+  steady();
+  missed_edge();
+  glitch();
+  drift();
+  week_rollover();
+  if (failures) {
+    printf("pps_clock_test: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("pps_clock_test: all passed\n");
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Runs the receive path benchmarks in bench.c on the host, and compares a set
+ * of results against a stored baseline.
+ *
+ * Usage: sbp_bench [-r repeats] [-s bytes] [-o results.csv]
+ *                  [-c baseline.csv] [-t percent] [-i results.csv]
+ *   -r n     passes over each stream per stage (default 200)
+ *   -s n     stream size in bytes (default 65536)
+ *   -o file  also write the results to file
+ *   -c file  compare ticks per byte against a baseline written with -o
+ *   -t n     regression threshold in percent (default 10)
+ *   -i file  don't run anything, compare the results in file instead, e.g.
+ *            results captured from the board over semihosting
+ *
+ * With -c, exits with status 2 if any stage is slower than the baseline by
+ * more than the threshold.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bench.h>
+
+#include "host_board.h"
+
+#define MAX_RESULTS 64
+
+typedef struct {
+  char stage[32];
+  char mix[32];
+  double ticks_per_byte;
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static u32 n_results;
+static FILE *out;
+
+static u8 parse_line(const char *line, result_t *r)
+{
+  return sscanf(line, "%31[^,],%31[^,],%*[^,],%*[^,],%*[^,],%lf",
+                r->stage, r->mix, &r->ticks_per_byte) == 3;
+}
+
+static void emit(const char *line)
+{
+  fputs(line, stdout);
+  if (out)
+    fputs(line, out);
+  if (n_results < MAX_RESULTS && parse_line(line, &results[n_results]))
+    n_results++;
+}
+
+static u32 read_results(const char *path, result_t *r, u32 max)
+{
+  char line[256];
+  u32 n = 0;
+  FILE *f;
+
+  f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while (n < max && fgets(line, sizeof(line), f)) {
+    if (strncmp(line, BENCH_CSV_HEADER, strlen(BENCH_CSV_HEADER)) == 0)
+      continue;
+    if (parse_line(line, &r[n]))
+      n++;
+  }
+  fclose(f);
+  return n;
+}
+
+/* Returns the number of stages slower than the baseline by over threshold. */
+static u32 compare(const char *path, double threshold)
+{
+  static result_t base[MAX_RESULTS];
+  u32 n_base, i, j, regressions = 0;
+  double change;
+
+  n_base = read_results(path, base, MAX_RESULTS);
+  printf("\n%-12s %-14s %10s %10s %8s\n",
+         "stage", "mix", "baseline", "current", "change");
+  for (i = 0; i < n_results; i++) {
+    for (j = 0; j < n_base; j++)
+      if (strcmp(results[i].stage, base[j].stage) == 0 &&
+          strcmp(results[i].mix, base[j].mix) == 0)
+        break;
+    if (j == n_base) {
+      printf("%-12s %-14s %10s %10.3f\n", results[i].stage, results[i].mix,
+             "-", results[i].ticks_per_byte);
+      continue;
+    }
+    change = 100.0 * (results[i].ticks_per_byte - base[j].ticks_per_byte) /
+             base[j].ticks_per_byte;
+    printf("%-12s %-14s %10.3f %10.3f %+7.1f%%%s\n",
+           results[i].stage, results[i].mix, base[j].ticks_per_byte,
+           results[i].ticks_per_byte, change,
+           change > threshold ? "  REGRESSION" : "");
+    if (change > threshold)
+      regressions++;
+  }
+  return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+  bench_config_t cfg = { &cycle_count, 1000000000, 200, &emit };
+  const char *out_path = NULL;
+  const char *baseline_path = NULL;
+  const char *in_path = NULL;
+  double threshold = 10;
+  u32 size = 65536;
+  u32 regressions;
+  u8 *buf;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:s:o:c:t:i:")) != -1) {
+    switch (opt) {
+    case 'r':
+      cfg.repeats = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      size = strtoul(optarg, NULL, 0);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'c':
+      baseline_path = optarg;
+      break;
+    case 't':
+      threshold = strtod(optarg, NULL);
+      break;
+    case 'i':
+      in_path = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-r repeats] [-s bytes] [-o results.csv] "
+              "[-c baseline.csv] [-t percent] [-i results.csv]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (in_path) {
+    n_results = read_results(in_path, results, MAX_RESULTS);
+  } else {
+    if (out_path) {
+      out = fopen(out_path, "w");
+      if (out == NULL) {
+        perror(out_path);
+        return 1;
+      }
+    }
+    buf = malloc(size);
+    if (buf == NULL || cfg.repeats == 0) {
+      fprintf(stderr, "bad stream size or repeat count\n");
+      return 1;
+    }
+    cycle_counter_setup();
+    bench_run(&cfg, buf, size);
+    free(buf);
+    if (out)
+      fclose(out);
+  }
+
+  if (baseline_path) {
+    regressions = compare(baseline_path, threshold);
+    if (regressions) {
+      printf("%u stage(s) regressed by more than %.1f%%\n",
+             regressions, threshold);
+      return 2;
+    }
+  }
+  return 0;
+}
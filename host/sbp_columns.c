@@ -0,0 +1,590 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include "sbp_columns.h"
+
+#define FIELD(msg, field, type) { #field, type, offsetof(msg, field) }
+
+static const cols_field_t gps_time_fields[] = {
+  FIELD(msg_gps_time_t, wn, COLS_U16),
+  FIELD(msg_gps_time_t, tow, COLS_U32),
+  FIELD(msg_gps_time_t, ns, COLS_S32),
+  FIELD(msg_gps_time_t, flags, COLS_U8),
+};
+
+static const cols_field_t pos_ecef_fields[] = {
+  FIELD(msg_pos_ecef_t, tow, COLS_U32),
+  FIELD(msg_pos_ecef_t, x, COLS_F64),
+  FIELD(msg_pos_ecef_t, y, COLS_F64),
+  FIELD(msg_pos_ecef_t, z, COLS_F64),
+  FIELD(msg_pos_ecef_t, accuracy, COLS_U16),
+  FIELD(msg_pos_ecef_t, n_sats, COLS_U8),
+  FIELD(msg_pos_ecef_t, flags, COLS_U8),
+};
+
+static const cols_field_t pos_llh_fields[] = {
+  FIELD(msg_pos_llh_t, tow, COLS_U32),
+  FIELD(msg_pos_llh_t, lat, COLS_F64),
+  FIELD(msg_pos_llh_t, lon, COLS_F64),
+  FIELD(msg_pos_llh_t, height, COLS_F64),
+  FIELD(msg_pos_llh_t, h_accuracy, COLS_U16),
+  FIELD(msg_pos_llh_t, v_accuracy, COLS_U16),
+  FIELD(msg_pos_llh_t, n_sats, COLS_U8),
+  FIELD(msg_pos_llh_t, flags, COLS_U8),
+};
+
+static const cols_field_t baseline_ecef_fields[] = {
+  FIELD(msg_baseline_ecef_t, tow, COLS_U32),
+  FIELD(msg_baseline_ecef_t, x, COLS_S32),
+  FIELD(msg_baseline_ecef_t, y, COLS_S32),
+  FIELD(msg_baseline_ecef_t, z, COLS_S32),
+  FIELD(msg_baseline_ecef_t, accuracy, COLS_U16),
+  FIELD(msg_baseline_ecef_t, n_sats, COLS_U8),
+  FIELD(msg_baseline_ecef_t, flags, COLS_U8),
+};
+
+static const cols_field_t baseline_ned_fields[] = {
+  FIELD(msg_baseline_ned_t, tow, COLS_U32),
+  FIELD(msg_baseline_ned_t, n, COLS_S32),
+  FIELD(msg_baseline_ned_t, e, COLS_S32),
+  FIELD(msg_baseline_ned_t, d, COLS_S32),
+  FIELD(msg_baseline_ned_t, h_accuracy, COLS_U16),
+  FIELD(msg_baseline_ned_t, v_accuracy, COLS_U16),
+  FIELD(msg_baseline_ned_t, n_sats, COLS_U8),
+  FIELD(msg_baseline_ned_t, flags, COLS_U8),
+};
+
+static const cols_field_t vel_ecef_fields[] = {
+  FIELD(msg_vel_ecef_t, tow, COLS_U32),
+  FIELD(msg_vel_ecef_t, x, COLS_S32),
+  FIELD(msg_vel_ecef_t, y, COLS_S32),
+  FIELD(msg_vel_ecef_t, z, COLS_S32),
+  FIELD(msg_vel_ecef_t, accuracy, COLS_U16),
+  FIELD(msg_vel_ecef_t, n_sats, COLS_U8),
+  FIELD(msg_vel_ecef_t, flags, COLS_U8),
+};
+
+static const cols_field_t vel_ned_fields[] = {
+  FIELD(msg_vel_ned_t, tow, COLS_U32),
+  FIELD(msg_vel_ned_t, n, COLS_S32),
+  FIELD(msg_vel_ned_t, e, COLS_S32),
+  FIELD(msg_vel_ned_t, d, COLS_S32),
+  FIELD(msg_vel_ned_t, h_accuracy, COLS_U16),
+  FIELD(msg_vel_ned_t, v_accuracy, COLS_U16),
+  FIELD(msg_vel_ned_t, n_sats, COLS_U8),
+  FIELD(msg_vel_ned_t, flags, COLS_U8),
+};
+
+static const cols_field_t dops_fields[] = {
+  FIELD(msg_dops_t, tow, COLS_U32),
+  FIELD(msg_dops_t, gdop, COLS_U16),
+  FIELD(msg_dops_t, pdop, COLS_U16),
+  FIELD(msg_dops_t, tdop, COLS_U16),
+  FIELD(msg_dops_t, hdop, COLS_U16),
+  FIELD(msg_dops_t, vdop, COLS_U16),
+};
+
+#undef FIELD
+
+#define TABLE(name, msg) \
+  { #name, SBP_MSG_##msg, sizeof(msg_##name##_t), name##_fields, \
+    sizeof(name##_fields) / sizeof(name##_fields[0]) }
+
+static const cols_schema_t schema[] = {
+  TABLE(gps_time, GPS_TIME),
+  TABLE(pos_ecef, POS_ECEF),
+  TABLE(pos_llh, POS_LLH),
+  TABLE(baseline_ecef, BASELINE_ECEF),
+  TABLE(baseline_ned, BASELINE_NED),
+  TABLE(vel_ecef, VEL_ECEF),
+  TABLE(vel_ned, VEL_NED),
+  TABLE(dops, DOPS),
+};
+
+#undef TABLE
+
+#define N_TABLES (sizeof(schema) / sizeof(schema[0]))
+
+const cols_schema_t *cols_schema(u32 *n)
+{
+  *n = N_TABLES;
+  return schema;
+}
+
+static u32 n_columns_total(void)
+{
+  u32 t, n = 0;
+
+  for (t = 0; t < N_TABLES; t++)
+    n += schema[t].n_fields;
+  return n;
+}
+
+/* A field's value as the 64 bit pattern that gets delta encoded: integers
+ * sign or zero extended, doubles as their bits. */
+static u64 field_raw(const cols_field_t *field, const u8 *payload)
+{
+  const u8 *p = payload + field->offset;
+  u64 raw;
+
+  switch (field->type) {
+  case COLS_U8:
+    return p[0];
+  case COLS_U16:
+    return p[0] | (p[1] << 8);
+  case COLS_U32:
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+  case COLS_S32:
+    return (u64)(s64)(s32)(p[0] | (p[1] << 8) | (p[2] << 16) |
+                           ((u32)p[3] << 24));
+  default:
+    memcpy(&raw, p, sizeof(raw));
+    return raw;
+  }
+}
+
+static double raw_value(u32 type, u64 raw)
+{
+  double d;
+
+  switch (type) {
+  case COLS_S32:
+    return (double)(s64)raw;
+  case COLS_F64:
+    memcpy(&d, &raw, sizeof(d));
+    return d;
+  default:
+    return (double)raw;
+  }
+}
+
+double cols_field_value(const cols_field_t *field, const u8 *payload)
+{
+  return raw_value(field->type, field_raw(field, payload));
+}
+
+/* Varints and zigzag. */
+
+static u64 zigzag(u64 v)
+{
+  return (v << 1) ^ (0 - (v >> 63));
+}
+
+static u64 unzigzag(u64 z)
+{
+  return (z >> 1) ^ (0 - (z & 1));
+}
+
+static u32 varint_len(u64 v)
+{
+  u32 n = 1;
+
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static u8 *varint_put(u8 *p, u64 v)
+{
+  while (v >= 0x80) {
+    *p++ = (u8)v | 0x80;
+    v >>= 7;
+  }
+  *p++ = (u8)v;
+  return p;
+}
+
+/* Returns NULL if the varint runs past end or is too long. */
+static const u8 *varint_get(const u8 *p, const u8 *end, u64 *v)
+{
+  u64 x = 0;
+  u32 shift = 0;
+
+  while (p < end && shift < 64) {
+    x |= (u64)(*p & 0x7F) << shift;
+    if (!(*p++ & 0x80)) {
+      *v = x;
+      return p;
+    }
+    shift += 7;
+  }
+  return NULL;
+}
+
+/* Writer. */
+
+int cols_writer_init(cols_writer_t *w)
+{
+  memset(w, 0, sizeof(*w));
+  w->columns = calloc(n_columns_total(), sizeof(cols_column_buf_t));
+  w->rows = calloc(N_TABLES, sizeof(u32));
+  if (w->columns == NULL || w->rows == NULL) {
+    cols_writer_free(w);
+    return -1;
+  }
+  return 0;
+}
+
+void cols_writer_free(cols_writer_t *w)
+{
+  u32 i;
+
+  if (w->columns) {
+    for (i = 0; i < n_columns_total(); i++) {
+      free(w->columns[i].data);
+      free(w->columns[i].blocks);
+    }
+  }
+  free(w->columns);
+  free(w->rows);
+  w->columns = NULL;
+  w->rows = NULL;
+}
+
+/* Encode a column's pending values as a block. Returns 0, or -1 if out of
+ * memory. */
+static int flush_block(cols_column_buf_t *c, u32 type)
+{
+  u64 size_delta = 0, size_delta2 = 0, prev = 0, prev_delta = 0, delta;
+  cols_block_t *b;
+  double v;
+  u8 *p;
+  u32 i;
+
+  if (c->n_pending == 0)
+    return 0;
+
+  if (c->n_blocks == c->cap_blocks) {
+    c->cap_blocks = c->cap_blocks ? c->cap_blocks * 2 : 64;
+    b = realloc(c->blocks, c->cap_blocks * sizeof(cols_block_t));
+    if (b == NULL)
+      return -1;
+    c->blocks = b;
+  }
+  if (c->data_len + (u64)c->n_pending * 10 > c->data_cap) {
+    c->data_cap = (c->data_len + (u64)c->n_pending * 10) * 2;
+    p = realloc(c->data, c->data_cap);
+    if (p == NULL)
+      return -1;
+    c->data = p;
+  }
+
+  b = &c->blocks[c->n_blocks++];
+  memset(b, 0, sizeof(*b));
+  b->offset = c->data_len;
+  b->rows = c->n_pending;
+  b->min = b->max = raw_value(type, c->pending[0]);
+
+  /* Size both encodings and pick the smaller. */
+  for (i = 0; i < c->n_pending; i++) {
+    delta = c->pending[i] - prev;
+    size_delta += varint_len(zigzag(delta));
+    size_delta2 += varint_len(zigzag(delta - prev_delta));
+    prev = c->pending[i];
+    prev_delta = delta;
+    v = raw_value(type, c->pending[i]);
+    if (v < b->min)
+      b->min = v;
+    if (v > b->max)
+      b->max = v;
+  }
+  b->encoding = size_delta2 < size_delta ? COLS_ENC_DELTA2 : COLS_ENC_DELTA;
+
+  p = c->data + c->data_len;
+  prev = prev_delta = 0;
+  for (i = 0; i < c->n_pending; i++) {
+    delta = c->pending[i] - prev;
+    p = varint_put(p, zigzag(b->encoding == COLS_ENC_DELTA2 ?
+                             delta - prev_delta : delta));
+    prev = c->pending[i];
+    prev_delta = delta;
+  }
+  b->bytes = p - (c->data + c->data_len);
+  c->data_len += b->bytes;
+  c->n_pending = 0;
+  return 0;
+}
+
+/*
+ * Add a frame as a row of its message's table. Returns 1 if it was added, 0
+ * if it isn't a stored message or is too short. Out of memory is fatal.
+ */
+u8 cols_writer_add(cols_writer_t *w, const sbp_frame_t *f)
+{
+  cols_column_buf_t *c = w->columns;
+  u32 t, i;
+
+  w->n_frames++;
+  for (t = 0; t < N_TABLES; t++) {
+    if (schema[t].msg_type == f->msg_type)
+      break;
+    c += schema[t].n_fields;
+  }
+  if (t == N_TABLES || f->len < schema[t].len)
+    return 0;
+
+  for (i = 0; i < schema[t].n_fields; i++) {
+    c[i].pending[c[i].n_pending++] = field_raw(&schema[t].fields[i],
+                                               f->payload);
+    if (c[i].n_pending == COLS_BLOCK_ROWS &&
+        flush_block(&c[i], schema[t].fields[i].type) != 0) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  w->rows[t]++;
+  w->n_rows++;
+  return 1;
+}
+
+/*
+ * Write everything added so far to path, and the file's size to *bytes if
+ * bytes isn't NULL. Returns 0 on success, -1 on failure.
+ */
+int cols_writer_save(cols_writer_t *w, const char *path, u64 *bytes)
+{
+  u32 n_columns = n_columns_total(), n_blocks = 0, t, i, k, col;
+  cols_header_t h;
+  cols_table_t tab;
+  cols_column_t cc;
+  cols_block_t b;
+  u64 data_offset, dir_end;
+  FILE *f;
+  int ok = 1;
+
+  col = 0;
+  for (t = 0; t < N_TABLES; t++)
+    for (i = 0; i < schema[t].n_fields; i++, col++)
+      if (flush_block(&w->columns[col], schema[t].fields[i].type) != 0)
+        return -1;
+  for (col = 0; col < n_columns; col++)
+    n_blocks += w->columns[col].n_blocks;
+
+  f = fopen(path, "wb");
+  if (f == NULL)
+    return -1;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, COLS_MAGIC, sizeof(COLS_MAGIC));
+  h.version = COLS_VERSION;
+  h.n_tables = N_TABLES;
+  h.n_columns = n_columns;
+  h.n_blocks = n_blocks;
+  h.capture_size = w->capture_size;
+  h.n_frames = w->n_frames;
+  h.n_rows = w->n_rows;
+  ok &= fwrite(&h, sizeof(h), 1, f) == 1;
+
+  col = 0;
+  for (t = 0; t < N_TABLES; t++) {
+    memset(&tab, 0, sizeof(tab));
+    strncpy(tab.name, schema[t].name, sizeof(tab.name) - 1);
+    tab.msg_type = schema[t].msg_type;
+    tab.n_columns = schema[t].n_fields;
+    tab.first_column = col;
+    tab.n_rows = w->rows[t];
+    ok &= fwrite(&tab, sizeof(tab), 1, f) == 1;
+    col += schema[t].n_fields;
+  }
+
+  dir_end = sizeof(h) + N_TABLES * sizeof(cols_table_t) +
+            n_columns * sizeof(cols_column_t) + n_blocks * sizeof(cols_block_t);
+  data_offset = dir_end;
+  col = 0;
+  n_blocks = 0;
+  for (t = 0; t < N_TABLES; t++) {
+    for (i = 0; i < schema[t].n_fields; i++, col++) {
+      memset(&cc, 0, sizeof(cc));
+      strncpy(cc.name, schema[t].fields[i].name, sizeof(cc.name) - 1);
+      cc.table = t;
+      cc.type = schema[t].fields[i].type;
+      cc.first_block = n_blocks;
+      cc.n_blocks = w->columns[col].n_blocks;
+      cc.offset = data_offset;
+      cc.bytes = w->columns[col].data_len;
+      ok &= fwrite(&cc, sizeof(cc), 1, f) == 1;
+      n_blocks += cc.n_blocks;
+      data_offset += cc.bytes;
+    }
+  }
+
+  /* Block offsets were relative to their column's data. */
+  data_offset = dir_end;
+  for (col = 0; col < n_columns; col++) {
+    for (k = 0; k < w->columns[col].n_blocks; k++) {
+      b = w->columns[col].blocks[k];
+      b.offset += data_offset;
+      ok &= fwrite(&b, sizeof(b), 1, f) == 1;
+    }
+    data_offset += w->columns[col].data_len;
+  }
+
+  /* A column that never got a value has no data buffer at all. */
+  for (col = 0; col < n_columns; col++)
+    if (w->columns[col].data_len)
+      ok &= fwrite(w->columns[col].data, 1, w->columns[col].data_len, f) ==
+            w->columns[col].data_len;
+
+  if (bytes)
+    *bytes = ftell(f);
+  if (fclose(f) != 0)
+    ok = 0;
+  return ok ? 0 : -1;
+}
+
+/* Reader. */
+
+/*
+ * Map a column file. Returns 0 on success, -1 if it can't be read or isn't a
+ * valid column file.
+ */
+int cols_open(cols_file_t *c, const char *path)
+{
+  const cols_header_t *h;
+  struct stat st;
+  u64 dir_size;
+  u32 i;
+  int fd;
+
+  memset(c, 0, sizeof(*c));
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || (u64)st.st_size < sizeof(*h)) {
+    close(fd);
+    return -1;
+  }
+  c->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (c->map == MAP_FAILED) {
+    c->map = NULL;
+    return -1;
+  }
+  c->map_size = st.st_size;
+
+  h = c->header = c->map;
+  dir_size = sizeof(*h) + (u64)h->n_tables * sizeof(cols_table_t) +
+             (u64)h->n_columns * sizeof(cols_column_t) +
+             (u64)h->n_blocks * sizeof(cols_block_t);
+  if (memcmp(h->magic, COLS_MAGIC, sizeof(COLS_MAGIC)) != 0 ||
+      h->version != COLS_VERSION || dir_size > c->map_size)
+    goto invalid;
+  c->tables = (const cols_table_t *)(h + 1);
+  c->columns = (const cols_column_t *)(c->tables + h->n_tables);
+  c->blocks = (const cols_block_t *)(c->columns + h->n_columns);
+
+  for (i = 0; i < h->n_tables; i++)
+    if ((u64)c->tables[i].first_column + c->tables[i].n_columns > h->n_columns)
+      goto invalid;
+  for (i = 0; i < h->n_columns; i++)
+    if ((u64)c->columns[i].first_block + c->columns[i].n_blocks > h->n_blocks)
+      goto invalid;
+  for (i = 0; i < h->n_blocks; i++)
+    if (c->blocks[i].offset + c->blocks[i].bytes > c->map_size ||
+        c->blocks[i].rows > COLS_BLOCK_ROWS)
+      goto invalid;
+  return 0;
+
+invalid:
+  cols_close(c);
+  return -1;
+}
+
+void cols_close(cols_file_t *c)
+{
+  if (c->map)
+    munmap(c->map, c->map_size);
+  memset(c, 0, sizeof(*c));
+}
+
+const cols_table_t *cols_table(const cols_file_t *c, const char *table)
+{
+  u32 i;
+
+  for (i = 0; i < c->header->n_tables; i++)
+    if (strncmp(c->tables[i].name, table, COLS_NAME_LEN) == 0)
+      return &c->tables[i];
+  return NULL;
+}
+
+const cols_column_t *cols_column(const cols_file_t *c, const char *table,
+                                 const char *column)
+{
+  const cols_table_t *t = cols_table(c, table);
+  u32 i;
+
+  if (t == NULL)
+    return NULL;
+  for (i = 0; i < t->n_columns; i++)
+    if (strncmp(c->columns[t->first_column + i].name, column,
+                COLS_NAME_LEN) == 0)
+      return &c->columns[t->first_column + i];
+  return NULL;
+}
+
+/*
+ * Decode block number block of a column into out, which must have room for
+ * COLS_BLOCK_ROWS values. Returns the number of values, 0 if the block is
+ * corrupt or there is no such block.
+ */
+u32 cols_read_block(const cols_file_t *c, const cols_column_t *col, u32 block,
+                    double *out)
+{
+  const cols_block_t *b;
+  const u8 *p, *end;
+  u64 z, prev = 0, delta = 0;
+  u32 i;
+
+  if (block >= col->n_blocks)
+    return 0;
+  b = &c->blocks[col->first_block + block];
+  p = (const u8 *)c->map + b->offset;
+  end = p + b->bytes;
+  for (i = 0; i < b->rows; i++) {
+    p = varint_get(p, end, &z);
+    if (p == NULL)
+      return 0;
+    if (b->encoding == COLS_ENC_DELTA2)
+      delta += unzigzag(z);
+    else
+      delta = unzigzag(z);
+    prev += delta;
+    out[i] = raw_value(col->type, prev);
+  }
+  return b->rows;
+}
+
+/*
+ * Decode a whole column into out, which must have room for the table's
+ * n_rows values. Returns the number of values.
+ */
+u32 cols_read(const cols_file_t *c, const cols_column_t *col, double *out)
+{
+  u32 b, n = 0;
+
+  for (b = 0; b < col->n_blocks; b++)
+    n += cols_read_block(c, col, b, out + n);
+  return n;
+}
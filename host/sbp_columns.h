@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Column store for decoded navigation messages.
+ *
+ * Each message type is a table and each of its fields a column. A column is
+ * stored in blocks of up to COLS_BLOCK_ROWS values. Within a block, values
+ * are delta or delta of delta encoded (whichever is smaller for that block),
+ * zigzag mapped and written as LEB128 varints. Doubles are encoded losslessly
+ * through their bit patterns. Every block starts from zero, so it can be
+ * decoded on its own, and the block directory holds its minimum and maximum
+ * so a reader can skip blocks that can't match.
+ *
+ * All columns of a table cut blocks at the same rows, so block b of the tow
+ * column covers the same rows as block b of any other column in the table.
+ *
+ * File layout: cols_header_t, the tables, the columns, the blocks, then the
+ * data of each column in turn.
+ */
+
+#ifndef SBP_TUTORIAL_SBP_COLUMNS_H
+#define SBP_TUTORIAL_SBP_COLUMNS_H
+
+#include <libsbp/common.h>
+
+#include "sbp_frame.h"
+
+#define COLS_MAGIC      "SBPCOLS"
+#define COLS_VERSION    1
+#define COLS_BLOCK_ROWS 4096
+#define COLS_NAME_LEN   16
+
+/* Column types, as the field is in the message. */
+#define COLS_U8  0
+#define COLS_U16 1
+#define COLS_U32 2
+#define COLS_S32 3
+#define COLS_F64 4
+
+/* Block encodings. */
+#define COLS_ENC_DELTA  0 /* Difference from the previous value. */
+#define COLS_ENC_DELTA2 1 /* Difference from the previous difference. */
+
+/* Schema: which messages are stored and where their fields are. */
+typedef struct {
+  const char *name;
+  u8 type;
+  u8 offset;      /* In the payload. */
+} cols_field_t;
+
+typedef struct {
+  const char *name;
+  u16 msg_type;
+  u8 len;         /* Shortest payload with all the fields. */
+  const cols_field_t *fields;
+  u8 n_fields;
+} cols_schema_t;
+
+/* On disk. */
+typedef struct {
+  char magic[8];
+  u32 version;
+  u32 n_tables;
+  u32 n_columns;
+  u32 n_blocks;
+  u64 capture_size;
+  u32 n_frames;     /* Good frames in the capture. */
+  u32 n_rows;       /* Frames stored as rows. */
+} cols_header_t;
+
+typedef struct {
+  char name[COLS_NAME_LEN];
+  u16 msg_type;
+  u16 n_columns;
+  u32 first_column;
+  u32 n_rows;
+  u32 reserved;
+} cols_table_t;
+
+typedef struct {
+  char name[COLS_NAME_LEN];
+  u32 table;
+  u32 type;
+  u32 first_block;
+  u32 n_blocks;
+  u64 offset;       /* Of the column's data in the file. */
+  u64 bytes;
+} cols_column_t;
+
+typedef struct {
+  u64 offset;       /* Of the block's data in the file. */
+  u32 bytes;
+  u32 rows;
+  u32 encoding;
+  u32 reserved;
+  double min;
+  double max;
+} cols_block_t;
+
+/* Writer. Values are held back until a block is full, data and the block
+ * directory are kept in memory until cols_writer_save. */
+typedef struct {
+  u64 pending[COLS_BLOCK_ROWS];
+  u32 n_pending;
+  u8 *data;
+  u64 data_len;
+  u64 data_cap;
+  cols_block_t *blocks;
+  u32 n_blocks;
+  u32 cap_blocks;
+} cols_column_buf_t;
+
+typedef struct {
+  cols_column_buf_t *columns;
+  u32 *rows;        /* Per table. */
+  u32 n_frames;
+  u32 n_rows;
+  u64 capture_size;
+} cols_writer_t;
+
+/* Reader, over the memory mapped file. */
+typedef struct {
+  void *map;
+  u64 map_size;
+  const cols_header_t *header;
+  const cols_table_t *tables;
+  const cols_column_t *columns;
+  const cols_block_t *blocks;
+} cols_file_t;
+
+const cols_schema_t *cols_schema(u32 *n);
+double cols_field_value(const cols_field_t *field, const u8 *payload);
+
+int cols_writer_init(cols_writer_t *w);
+u8 cols_writer_add(cols_writer_t *w, const sbp_frame_t *f);
+int cols_writer_save(cols_writer_t *w, const char *path, u64 *bytes);
+void cols_writer_free(cols_writer_t *w);
+
+int cols_open(cols_file_t *c, const char *path);
+void cols_close(cols_file_t *c);
+const cols_table_t *cols_table(const cols_file_t *c, const char *table);
+const cols_column_t *cols_column(const cols_file_t *c, const char *table,
+                                 const char *column);
+u32 cols_read_block(const cols_file_t *c, const cols_column_t *col, u32 block,
+                    double *out);
+u32 cols_read(const cols_file_t *c, const cols_column_t *col, double *out);
+
+#endif /* SBP_TUTORIAL_SBP_COLUMNS_H */
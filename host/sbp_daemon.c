@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Receiver daemon for several Piksis on serial ports (or ptys, see
+ * sbp_pty_feed). Each port has its own FIFO and receiver from the core layer,
+ * exactly like the board has one for USART1.
+ *
+ * The main thread waits for input on all ports with epoll. Ports with input
+ * are queued for a pool of worker threads, which read everything available
+ * with large non-blocking reads and parse it. A port is registered with
+ * EPOLLONESHOT, so only one worker handles it at a time and its parser needs
+ * no locking; the worker re-arms it when done. After each pass the worker
+ * publishes a snapshot of the latest solution, its nav_filter state and
+ * statistics, which the main thread reports periodically. With -m it is also
+ * published in shared memory, one slot per port in the order given, for
+ * sbp_shm_read and other local consumers.
+ *
+ * Usage: sbp_daemon [-b baud] [-j workers] [-i seconds] [-m name] [-v] [-x]
+ *                   port...
+ *   -b n  baud rate for serial ports (default 1000000, ignored for ptys)
+ *   -j n  worker threads (default 4)
+ *   -i n  report every n seconds (default 1, 0 to only report on exit)
+ *   -m s  publish each port's solution in the shared memory segment s
+ *   -v    include the full status of each port in reports
+ *   -x    exit once every port has closed
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fifo.h>
+#include <nav_filter.h>
+#include <receiver.h>
+#include <status.h>
+
+#include "sbp_shm.h"
+
+#define MAX_PORTS       128
+#define MAX_WORKERS     64
+#define READ_SIZE       65536
+/* Reads per turn, so one busy port can't hold a worker indefinitely. */
+#define READS_PER_TURN  8
+
+typedef struct {
+  u64 bytes;         /* Bytes read from the port. */
+  u64 reads;         /* Non-empty reads. */
+  u32 max_read;      /* Largest single read. */
+  u32 frames;        /* Frames with a good CRC. */
+  u32 crc_errors;    /* Frames with a bad CRC. */
+  u32 short_frames;  /* Frames too short for their message type. */
+} port_stats_t;
+
+typedef struct port {
+  const char *path;
+  int fd;
+
+  /* Only touched by the worker that holds the port. */
+  fifo_t fifo;
+  receiver_t receiver;
+  nav_filter_t filter;
+  port_stats_t work_stats;
+
+  /* Published copies, guarded by lock. */
+  pthread_mutex_t lock;
+  solution_t snapshot;
+  nav_state_t nav;
+  port_stats_t stats;
+  u32 snapshot_seq;  /* Bumped on every publish that saw new frames. */
+  u8 open;
+
+  struct port *next; /* Work queue link. */
+} port_t;
+
+static port_t ports[MAX_PORTS];
+static u32 n_ports;
+static int epfd;
+static sbp_shm_t shm;
+static u8 shm_enabled;
+
+/* Queue of ports with input waiting for a worker. */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static port_t *queue_head, *queue_tail;
+static u8 stopping;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig)
+{
+  (void)sig;
+  stop_requested = 1;
+}
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void queue_push(port_t *p)
+{
+  pthread_mutex_lock(&queue_lock);
+  p->next = NULL;
+  if (queue_tail)
+    queue_tail->next = p;
+  else
+    queue_head = p;
+  queue_tail = p;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+}
+
+/* Returns NULL once the daemon is stopping. */
+static port_t *queue_pop(void)
+{
+  port_t *p;
+
+  pthread_mutex_lock(&queue_lock);
+  while (!queue_head && !stopping)
+    pthread_cond_wait(&queue_cond, &queue_lock);
+  p = queue_head;
+  if (p) {
+    queue_head = p->next;
+    if (!queue_head)
+      queue_tail = NULL;
+  }
+  pthread_mutex_unlock(&queue_lock);
+  return stopping ? NULL : p;
+}
+
+/* Hand received bytes to the port's FIFO and parse them, as the USART1
+ * interrupt and main loop do on the board. */
+static void port_feed(port_t *p, const u8 *buf, u32 n)
+{
+  u32 i;
+
+  for (i = 0; i < n; i++) {
+    while (fifo_full(&p->fifo))
+      receiver_process(&p->receiver);
+    fifo_write(&p->fifo, buf[i]);
+  }
+  while (!fifo_empty(&p->fifo))
+    receiver_process(&p->receiver);
+  /* The last frame may need one more pass to complete. */
+  receiver_process(&p->receiver);
+}
+
+static void port_publish(port_t *p, u8 open)
+{
+  port_stats_t *w = &p->work_stats;
+  sbp_shm_data_t d;
+  u8 changed;
+
+  w->frames = p->receiver.n_frames;
+  w->crc_errors = p->receiver.n_crc_errors;
+  w->short_frames = p->receiver.n_short_frames;
+
+  pthread_mutex_lock(&p->lock);
+  changed = w->frames != p->stats.frames || open != p->open;
+  if (w->frames != p->stats.frames) {
+    p->snapshot = p->receiver.sol;
+    nav_filter_snapshot(&p->filter, &p->nav);
+    p->snapshot_seq++;
+  }
+  p->stats = *w;
+  p->open = open;
+  pthread_mutex_unlock(&p->lock);
+
+  /* Only the worker holding the port gets here, so one publisher per slot. */
+  if (shm_enabled && changed) {
+    d.time_ns = (u64)(now_s() * 1e9);
+    d.publishes = p->snapshot_seq;
+    d.bytes = w->bytes;
+    d.frames = w->frames;
+    d.crc_errors = w->crc_errors;
+    d.short_frames = w->short_frames;
+    d.open = open;
+    d.sol = p->receiver.sol;
+    nav_filter_snapshot(&p->filter, &d.nav);
+    sbp_shm_publish(&shm, p - ports, &d);
+  }
+}
+
+static void port_close(port_t *p, const char *why)
+{
+  fprintf(stderr, "%s: closed (%s)\n", p->path, why);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL);
+  close(p->fd);
+  p->fd = -1;
+  port_publish(p, 0);
+}
+
+static void port_hook(receiver_t *r, u16 msg_type, void *context)
+{
+  port_t *p = context;
+
+  nav_filter_message(&p->filter, &r->sol, msg_type);
+}
+
+/* Read and parse everything available on a port, then re-arm it. */
+static void port_service(port_t *p, u8 *buf)
+{
+  struct epoll_event ev;
+  ssize_t n;
+  u32 reads = 0;
+
+  while (reads < READS_PER_TURN) {
+    n = read(p->fd, buf, READ_SIZE);
+    if (n > 0) {
+      reads++;
+      p->work_stats.bytes += n;
+      p->work_stats.reads++;
+      if ((u32)n > p->work_stats.max_read)
+        p->work_stats.max_read = n;
+      port_feed(p, buf, n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN)
+      break;
+    /* End of file, or EIO once the other end of a pty has gone. */
+    port_close(p, n == 0 ? "end of file" : strerror(errno));
+    return;
+  }
+
+  port_publish(p, 1);
+
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.ptr = p;
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, p->fd, &ev) != 0)
+    port_close(p, strerror(errno));
+}
+
+static void *worker(void *arg)
+{
+  u8 *buf = malloc(READ_SIZE);
+  port_t *p;
+
+  (void)arg;
+  while ((p = queue_pop()) != NULL)
+    port_service(p, buf);
+  free(buf);
+  return NULL;
+}
+
+static speed_t baud_to_speed(u32 baud)
+{
+  static const struct { u32 baud; speed_t speed; } speeds[] = {
+    { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+    { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 },
+    { 460800, B460800 }, { 921600, B921600 }, { 1000000, B1000000 },
+    { 2000000, B2000000 }, { 3000000, B3000000 },
+  };
+  u32 i;
+
+  for (i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    if (speeds[i].baud == baud)
+      return speeds[i].speed;
+  return 0;
+}
+
+static int port_open(port_t *p, const char *path, u32 baud)
+{
+  struct termios tio;
+  struct epoll_event ev;
+  speed_t speed;
+
+  p->path = path;
+  p->fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+  if (p->fd < 0) {
+    perror(path);
+    return -1;
+  }
+
+  if (tcgetattr(p->fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    speed = baud_to_speed(baud);
+    if (speed)
+      cfsetspeed(&tio, speed);
+    else
+      fprintf(stderr, "%s: unsupported baud rate %u\n", path, baud);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(p->fd, TCSANOW, &tio);
+  }
+
+  fifo_init(&p->fifo);
+  receiver_setup(&p->receiver, &p->fifo);
+  nav_filter_init(&p->filter);
+  receiver_set_hook(&p->receiver, &port_hook, p);
+  memset(&p->work_stats, 0, sizeof(p->work_stats));
+  memset(&p->stats, 0, sizeof(p->stats));
+  memset(&p->snapshot, 0, sizeof(p->snapshot));
+  memset(&p->nav, 0, sizeof(p->nav));
+  p->snapshot_seq = 0;
+  p->open = 1;
+  pthread_mutex_init(&p->lock, NULL);
+
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.ptr = p;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, p->fd, &ev) != 0) {
+    perror(path);
+    close(p->fd);
+    return -1;
+  }
+  return 0;
+}
+
+/* Latest published state of a port. Returns the snapshot sequence number. */
+static u32 port_snapshot(port_t *p, solution_t *sol, nav_state_t *nav,
+                         port_stats_t *stats, u8 *open)
+{
+  u32 seq;
+
+  pthread_mutex_lock(&p->lock);
+  *sol = p->snapshot;
+  *nav = p->nav;
+  *stats = p->stats;
+  *open = p->open;
+  seq = p->snapshot_seq;
+  pthread_mutex_unlock(&p->lock);
+  return seq;
+}
+
+static u32 ports_open(void)
+{
+  u32 i, n_open = 0;
+
+  for (i = 0; i < n_ports; i++) {
+    pthread_mutex_lock(&ports[i].lock);
+    n_open += ports[i].open;
+    pthread_mutex_unlock(&ports[i].lock);
+  }
+  return n_open;
+}
+
+/* Print one line per port, plus its full status if verbose. */
+static void report(u64 *last_bytes, double dt, u8 verbose)
+{
+  char str[STATUS_MAX_LEN];
+  port_stats_t stats, total;
+  solution_t sol;
+  nav_state_t nav;
+  u32 i, seq, n_open = 0;
+  u8 open;
+
+  memset(&total, 0, sizeof(total));
+  printf("%-20s %4s %10s %8s %9s %6s %6s %10s %12s %12s\n",
+         "port", "up", "bytes", "kB/s", "frames", "crc", "short",
+         "tow (ms)", "lat", "lon");
+  for (i = 0; i < n_ports; i++) {
+    seq = port_snapshot(&ports[i], &sol, &nav, &stats, &open);
+    n_open += open;
+    printf("%-20s %4s %10llu %8.1f %9u %6u %6u %10u %12.7f %12.7f\n",
+           ports[i].path, open ? "yes" : "no",
+           (unsigned long long)stats.bytes,
+           dt > 0 ? (stats.bytes - last_bytes[i]) / dt / 1e3 : 0.0,
+           stats.frames, stats.crc_errors, stats.short_frames,
+           seq ? sol.gps_time.tow : 0, sol.pos_llh.lat, sol.pos_llh.lon);
+    last_bytes[i] = stats.bytes;
+    total.bytes += stats.bytes;
+    total.reads += stats.reads;
+    total.frames += stats.frames;
+    total.crc_errors += stats.crc_errors;
+    if (verbose && seq) {
+      status_format(str, &sol);
+      fputs(str, stdout);
+      if (nav.valid)
+        printf("Filtered ENU (m)\t: %10.3f %10.3f %10.3f, "
+               "sigma %.3f %.3f %.3f\n\n", nav.pos[0], nav.pos[1],
+               nav.pos[2], nav.pos_sigma[0], nav.pos_sigma[1],
+               nav.pos_sigma[2]);
+    }
+  }
+  printf("%-20s %4u %10llu %8s %9u %6u %6s %10s (avg read %llu bytes)\n\n",
+         "total", n_open, (unsigned long long)total.bytes, "",
+         total.frames, total.crc_errors, "", "",
+         (unsigned long long)(total.reads ? total.bytes / total.reads : 0));
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  pthread_t threads[MAX_WORKERS];
+  struct epoll_event events[MAX_PORTS];
+  u64 last_bytes[MAX_PORTS] = { 0 };
+  u32 baud = 1000000, n_workers = 4, i;
+  double interval = 1, last_report, t;
+  const char *shm_name = NULL;
+  u8 verbose = 0, exit_when_closed = 0;
+  int opt, n, timeout_ms;
+
+  while ((opt = getopt(argc, argv, "b:j:i:m:vx")) != -1) {
+    switch (opt) {
+    case 'b':
+      baud = strtoul(optarg, NULL, 0);
+      break;
+    case 'j':
+      n_workers = strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      interval = strtod(optarg, NULL);
+      break;
+    case 'm':
+      shm_name = optarg;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'x':
+      exit_when_closed = 1;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind == argc || argc - optind > MAX_PORTS ||
+      n_workers == 0 || n_workers > MAX_WORKERS)
+    goto usage;
+
+  epfd = epoll_create1(0);
+  if (epfd < 0) {
+    perror("epoll_create1");
+    return 1;
+  }
+  if (shm_name) {
+    if (sbp_shm_create(&shm, shm_name, argc - optind) != 0) {
+      perror(shm_name);
+      return 1;
+    }
+    shm_enabled = 1;
+  }
+  for (; optind < argc; optind++) {
+    if (port_open(&ports[n_ports], argv[optind], baud) != 0)
+      return 1;
+    if (shm_enabled)
+      sbp_shm_set_name(&shm, n_ports, argv[optind]);
+    n_ports++;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  for (i = 0; i < n_workers; i++)
+    pthread_create(&threads[i], NULL, worker, NULL);
+
+  last_report = now_s();
+  while (!stop_requested) {
+    timeout_ms = interval > 0 ? (int)(interval * 1000) : 1000;
+    n = epoll_wait(epfd, events, MAX_PORTS, timeout_ms);
+    for (i = 0; n > 0 && i < (u32)n; i++)
+      queue_push(events[i].data.ptr);
+
+    t = now_s();
+    if (interval > 0 && t - last_report >= interval) {
+      report(last_bytes, t - last_report, verbose);
+      last_report = t;
+    }
+    if (exit_when_closed && ports_open() == 0)
+      break;
+  }
+
+  pthread_mutex_lock(&queue_lock);
+  stopping = 1;
+  pthread_cond_broadcast(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+  for (i = 0; i < n_workers; i++)
+    pthread_join(threads[i], NULL);
+
+  report(last_bytes, now_s() - last_report, verbose);
+  if (shm_enabled)
+    sbp_shm_destroy(&shm);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-b baud] [-j workers] [-i seconds] [-m name] "
+          "[-v] [-x] port...\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Decodes a raw SBP capture to one line of text per frame, on as many threads
+ * as there are cores.
+ *
+ * The capture is memory mapped and cut into chunks, which worker threads
+ * decode independently. A frame belongs to the chunk its preamble is in, and
+ * may run past the end of it. A worker can't know where the parser would be
+ * at the start of its chunk, so it starts at the first preamble that is
+ * followed by a frame with a good CRC.
+ *
+ * The main thread writes the chunks out in order. It carries the position the
+ * parser would have reached at the end of the previous chunk. If the first
+ * frame from there is one the worker decoded, the worker's output is used as
+ * it is. Otherwise (the worker started on a different frame, e.g. because the
+ * real parser swallowed a corrupted frame that ran into this chunk) the main
+ * thread decodes frames itself until it lands on one the worker decoded. The
+ * output is therefore always exactly what the sequential parser produces.
+ *
+ * Usage: sbp_decode [-j threads] [-C chunk_mb] [-s] [-c] [-o out] capture.sbp
+ *   -j n  worker threads (default: number of cores)
+ *   -C n  chunk size in MB (default 4)
+ *   -s    decode sequentially with sbp_process instead
+ *   -c    decode both ways, check the outputs match and report the speedup
+ *   -o f  write the decoded frames to f (default stdout, not with -c)
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/sbp.h>
+#include <libsbp/navigation.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define MAX_THREADS 256
+
+/* Growable text buffer. */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t cap;
+} text_t;
+
+static void text_reserve(text_t *t, size_t n)
+{
+  if (t->len + n <= t->cap)
+    return;
+  t->cap = (t->len + n) * 2;
+  t->buf = realloc(t->buf, t->cap);
+  if (t->buf == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+}
+
+static void text_printf(text_t *t, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  text_reserve(t, 256);
+  va_start(ap, fmt);
+  n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+  va_end(ap);
+  if ((size_t)n >= t->cap - t->len) {
+    text_reserve(t, n + 1);
+    va_start(ap, fmt);
+    vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+    va_end(ap);
+  }
+  t->len += n;
+}
+
+/* One line per frame: offset, type, sender, length, then the decoded fields
+ * of the navigation messages, or the payload in hex. */
+static void format_frame(text_t *t, u64 offset, u16 msg_type, u16 sender,
+                         u8 len, const u8 *payload)
+{
+  msg_gps_time_t gps_time;
+  msg_pos_llh_t pos_llh;
+  msg_baseline_ned_t baseline_ned;
+  msg_vel_ned_t vel_ned;
+  msg_dops_t dops;
+  u32 i;
+
+  text_printf(t, "%llu,0x%04X,0x%04X,%u,", (unsigned long long)offset,
+              msg_type, sender, len);
+
+#define DECODE(var) \
+  (len >= sizeof(var) && (memcpy(&var, payload, sizeof(var)), 1))
+
+  if (msg_type == SBP_MSG_GPS_TIME && DECODE(gps_time)) {
+    text_printf(t, "gps_time,%u,%u,%d\n", gps_time.wn, gps_time.tow,
+                gps_time.ns);
+  } else if (msg_type == SBP_MSG_POS_LLH && DECODE(pos_llh)) {
+    text_printf(t, "pos_llh,%u,%.9f,%.9f,%.4f,%u\n", pos_llh.tow,
+                pos_llh.lat, pos_llh.lon, pos_llh.height, pos_llh.n_sats);
+  } else if (msg_type == SBP_MSG_BASELINE_NED &&
+             DECODE(baseline_ned)) {
+    text_printf(t, "baseline_ned,%u,%d,%d,%d,%u\n", baseline_ned.tow,
+                baseline_ned.n, baseline_ned.e, baseline_ned.d,
+                baseline_ned.n_sats);
+  } else if (msg_type == SBP_MSG_VEL_NED && DECODE(vel_ned)) {
+    text_printf(t, "vel_ned,%u,%d,%d,%d,%u\n", vel_ned.tow,
+                vel_ned.n, vel_ned.e, vel_ned.d, vel_ned.n_sats);
+  } else if (msg_type == SBP_MSG_DOPS && DECODE(dops)) {
+    text_printf(t, "dops,%u,%u,%u,%u,%u,%u\n", dops.tow, dops.gdop,
+                dops.pdop, dops.tdop, dops.hdop, dops.vdop);
+  } else {
+    text_reserve(t, 2 * len + 2);
+    for (i = 0; i < len; i++) {
+      t->buf[t->len++] = "0123456789abcdef"[payload[i] >> 4];
+      t->buf[t->len++] = "0123456789abcdef"[payload[i] & 0xF];
+    }
+    t->buf[t->len++] = '\n';
+  }
+#undef DECODE
+}
+
+typedef struct {
+  u32 frames;
+  u32 crc_errors;
+} decode_stats_t;
+
+/*
+ * Sequential reference: the whole capture through sbp_process, one frame at a
+ * time, using the frame it leaves in its state after each good CRC.
+ */
+typedef struct {
+  const u8 *data;
+  u64 size;
+  u64 pos;
+} mem_reader_t;
+
+static u32 mem_read(u8 *buff, u32 n, void *context)
+{
+  mem_reader_t *m = context;
+
+  if (n > m->size - m->pos)
+    n = m->size - m->pos;
+  memcpy(buff, m->data + m->pos, n);
+  m->pos += n;
+  return n;
+}
+
+static void decode_sequential(const u8 *data, u64 size, text_t *out,
+                              decode_stats_t *stats)
+{
+  static sbp_state_t s;
+  mem_reader_t m = { data, size, 0 };
+  s8 ret;
+
+  sbp_state_init(&s);
+  sbp_state_set_io_context(&s, &m);
+  while (m.pos < size || s.state != WAITING) {
+    ret = sbp_process(&s, &mem_read);
+    if (ret == SBP_OK_CALLBACK_EXECUTED || ret == SBP_OK_CALLBACK_UNDEFINED) {
+      stats->frames++;
+      format_frame(out, m.pos - SBP_FRAME_OVERHEAD - s.msg_len, s.msg_type,
+                   s.sender_id, s.msg_len, s.msg_buff);
+    } else if (ret == SBP_CRC_ERROR) {
+      stats->crc_errors++;
+    }
+    if (m.pos == size && ret == SBP_OK && s.state != WAITING)
+      break;
+  }
+}
+
+/* Parallel path. */
+
+typedef struct {
+  u64 offset;       /* Preamble of the frame. */
+  u64 end;          /* Just past its CRC. */
+  size_t text_end;  /* End of its line in the chunk's text. */
+  u8 status;        /* SBP_FRAME_OK or SBP_FRAME_CRC_ERROR. */
+} record_t;
+
+typedef struct {
+  u64 start;        /* Frames with a preamble in [start, stop) are ours. */
+  u64 stop;
+  record_t *recs;
+  u32 n_recs;
+  u32 cap_recs;
+  text_t text;
+  u8 done;
+} chunk_t;
+
+typedef struct {
+  const u8 *data;
+  u64 size;
+  chunk_t *chunks;
+  u32 n_chunks;
+  u32 next_chunk;   /* Next chunk for a worker to take. */
+  pthread_mutex_t lock;
+  pthread_cond_t chunk_done;
+} decoder_t;
+
+static void chunk_record(chunk_t *c, const sbp_frame_t *f, u8 status)
+{
+  record_t *r;
+
+  if (c->n_recs == c->cap_recs) {
+    c->cap_recs = c->cap_recs ? c->cap_recs * 2 : 1024;
+    c->recs = realloc(c->recs, c->cap_recs * sizeof(record_t));
+    if (c->recs == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  r = &c->recs[c->n_recs++];
+  r->offset = f->offset;
+  r->end = f->end;
+  r->status = status;
+  r->text_end = c->text.len;
+}
+
+static void chunk_decode(decoder_t *d, chunk_t *c)
+{
+  sbp_frame_t f;
+  u64 pos = c->start;
+  u8 ret;
+
+  /* Synchronise on a frame with a good CRC. */
+  for (;;) {
+    ret = sbp_frame_next(d->data, d->size, pos, &f);
+    if (ret == SBP_FRAME_END || f.offset >= c->stop)
+      return;
+    if (ret == SBP_FRAME_OK)
+      break;
+    pos = f.offset + 1;
+  }
+
+  /* From there on, exactly as the sequential parser would. */
+  while (ret != SBP_FRAME_END && f.offset < c->stop) {
+    if (ret == SBP_FRAME_OK)
+      format_frame(&c->text, f.offset, f.msg_type, f.sender, f.len, f.payload);
+    chunk_record(c, &f, ret);
+    ret = sbp_frame_next(d->data, d->size, f.end, &f);
+  }
+}
+
+static void *worker(void *arg)
+{
+  decoder_t *d = arg;
+  chunk_t *c;
+  u32 i;
+
+  for (;;) {
+    pthread_mutex_lock(&d->lock);
+    i = d->next_chunk++;
+    pthread_mutex_unlock(&d->lock);
+    if (i >= d->n_chunks)
+      return NULL;
+    c = &d->chunks[i];
+    chunk_decode(d, c);
+
+    pthread_mutex_lock(&d->lock);
+    c->done = 1;
+    pthread_cond_broadcast(&d->chunk_done);
+    pthread_mutex_unlock(&d->lock);
+  }
+}
+
+/* Index of the record for the frame at offset, or n_recs if there's none. */
+static u32 find_record(const chunk_t *c, u64 offset)
+{
+  u32 lo = 0, hi = c->n_recs, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (c->recs[mid].offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return (lo < c->n_recs && c->recs[lo].offset == offset) ? lo : c->n_recs;
+}
+
+/*
+ * Append chunk c's frames to out, starting from *pos, where the sequential
+ * parser would be. Returns the number of frames the main thread had to
+ * decode itself.
+ */
+static u32 chunk_merge(decoder_t *d, chunk_t *c, u64 *pos, text_t *out,
+                       decode_stats_t *stats)
+{
+  size_t text_start;
+  sbp_frame_t f;
+  u32 fixed = 0, j, k;
+  u8 ret;
+
+  for (;;) {
+    ret = sbp_frame_next(d->data, d->size, *pos, &f);
+    if (ret == SBP_FRAME_END || f.offset >= c->stop)
+      return fixed;
+
+    j = find_record(c, f.offset);
+    if (j < c->n_recs) {
+      /* In step with the worker, take the rest of its output. */
+      text_start = j ? c->recs[j - 1].text_end : 0;
+      text_reserve(out, c->text.len - text_start);
+      memcpy(out->buf + out->len, c->text.buf + text_start,
+             c->text.len - text_start);
+      out->len += c->text.len - text_start;
+      for (k = j; k < c->n_recs; k++) {
+        if (c->recs[k].status == SBP_FRAME_OK)
+          stats->frames++;
+        else
+          stats->crc_errors++;
+      }
+      *pos = c->recs[c->n_recs - 1].end;
+      return fixed;
+    }
+
+    /* Not a frame the worker saw, decode it here. */
+    fixed++;
+    if (ret == SBP_FRAME_OK) {
+      stats->frames++;
+      format_frame(out, f.offset, f.msg_type, f.sender, f.len, f.payload);
+    } else {
+      stats->crc_errors++;
+    }
+    *pos = f.end;
+  }
+}
+
+/*
+ * Decode in parallel. Each chunk's output is appended to out as soon as it and
+ * all earlier chunks are done, and then written to out_file if there is one.
+ * Returns the number of frames the main thread had to decode itself.
+ */
+static u32 decode_parallel(const u8 *data, u64 size, u32 n_threads,
+                           u64 chunk_size, text_t *out, FILE *out_file,
+                           decode_stats_t *stats)
+{
+  pthread_t threads[MAX_THREADS];
+  decoder_t d;
+  chunk_t *c;
+  u64 pos = 0;
+  u32 i, fixed = 0;
+
+  d.data = data;
+  d.size = size;
+  d.n_chunks = size ? (size + chunk_size - 1) / chunk_size : 0;
+  d.chunks = calloc(d.n_chunks ? d.n_chunks : 1, sizeof(chunk_t));
+  d.next_chunk = 0;
+  pthread_mutex_init(&d.lock, NULL);
+  pthread_cond_init(&d.chunk_done, NULL);
+  for (i = 0; i < d.n_chunks; i++) {
+    d.chunks[i].start = i * chunk_size;
+    d.chunks[i].stop = (i + 1) * chunk_size < size ? (i + 1) * chunk_size : size;
+  }
+
+  for (i = 0; i < n_threads; i++)
+    pthread_create(&threads[i], NULL, worker, &d);
+
+  for (i = 0; i < d.n_chunks; i++) {
+    c = &d.chunks[i];
+    pthread_mutex_lock(&d.lock);
+    while (!c->done)
+      pthread_cond_wait(&d.chunk_done, &d.lock);
+    pthread_mutex_unlock(&d.lock);
+
+    fixed += chunk_merge(&d, c, &pos, out, stats);
+    if (out_file) {
+      fwrite(out->buf, 1, out->len, out_file);
+      out->len = 0;
+    }
+    free(c->recs);
+    free(c->text.buf);
+  }
+
+  for (i = 0; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+  free(d.chunks);
+  return fixed;
+}
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+  u32 n_threads = sysconf(_SC_NPROCESSORS_ONLN), fixed;
+  u64 chunk_size = 4 << 20;
+  u8 sequential = 0, check = 0;
+  decode_stats_t seq_stats = { 0 }, par_stats = { 0 };
+  text_t seq_out = { 0 }, par_out = { 0 };
+  double t_seq, t_par;
+  const char *out_path = NULL;
+  FILE *out = stdout;
+  log_index_t cap;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:C:sco:")) != -1) {
+    switch (opt) {
+    case 'j':
+      n_threads = strtoul(optarg, NULL, 0);
+      break;
+    case 'C':
+      chunk_size = (u64)(strtod(optarg, NULL) * (1 << 20));
+      break;
+    case 's':
+      sequential = 1;
+      break;
+    case 'c':
+      check = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1 || n_threads == 0 || n_threads > MAX_THREADS ||
+      chunk_size == 0)
+    goto usage;
+
+  /* Only the mapping is used, the capture isn't indexed. */
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  if (check) {
+    t_seq = now_s();
+    decode_sequential(cap.data, cap.size, &seq_out, &seq_stats);
+    t_seq = now_s() - t_seq;
+    t_par = now_s();
+    fixed = decode_parallel(cap.data, cap.size, n_threads, chunk_size,
+                            &par_out, NULL, &par_stats);
+    t_par = now_s() - t_par;
+
+    printf("Sequential\t: %.1f ms, %u frames, %u CRC errors\n",
+           t_seq * 1e3, seq_stats.frames, seq_stats.crc_errors);
+    printf("Parallel\t: %.1f ms, %u frames, %u CRC errors, %u threads\n",
+           t_par * 1e3, par_stats.frames, par_stats.crc_errors, n_threads);
+    printf("Speedup\t\t: %.2fx (%.1f MB/s)\n", t_seq / t_par,
+           cap.size / t_par / 1e6);
+    printf("Resync fixups\t: %u frames\n", fixed);
+    if (seq_out.len != par_out.len ||
+        memcmp(seq_out.buf, par_out.buf, seq_out.len) != 0 ||
+        seq_stats.frames != par_stats.frames ||
+        seq_stats.crc_errors != par_stats.crc_errors) {
+      printf("Output\t\t: MISMATCH\n");
+      return 2;
+    }
+    printf("Output\t\t: identical (%zu bytes)\n", seq_out.len);
+    free(seq_out.buf);
+    free(par_out.buf);
+    log_close(&cap);
+    return 0;
+  }
+
+  if (out_path) {
+    out = fopen(out_path, "w");
+    if (out == NULL) {
+      perror(out_path);
+      return 1;
+    }
+  }
+  if (sequential) {
+    decode_sequential(cap.data, cap.size, &seq_out, &seq_stats);
+    fwrite(seq_out.buf, 1, seq_out.len, out);
+  } else {
+    decode_parallel(cap.data, cap.size, n_threads, chunk_size, &par_out, out,
+                    &par_stats);
+  }
+  if (out != stdout)
+    fclose(out);
+  free(seq_out.buf);
+  free(par_out.buf);
+  log_close(&cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-j threads] [-C chunk_mb] [-s] [-c] [-o out] "
+          "capture.sbp\n", argv[0]);
+  return 1;
+}
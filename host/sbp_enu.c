@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Converts the positions in a raw SBP capture to east, north and up relative
+ * to a reference point with enu.c, and checks its accuracy and speed.
+ *
+ * Usage: sbp_enu [-r lat,lon,height] [-o out.csv] capture.sbp
+ *        sbp_enu -B
+ *   -r       reference point, degrees and metres (default: the first
+ *            position in the capture)
+ *   -o file  write to file instead of stdout
+ *   -B       compare the single precision conversion against the double one
+ *            for points scattered at increasing distances from references
+ *            at several latitudes, then time both
+ *
+ * The output is CSV: time of week (ms), east, north and up (m).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include <enu.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define BENCH_POINTS (1 << 20)
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Returns the number of positions converted. */
+static int convert(const log_index_t *cap, const double *ref_llh, FILE *out)
+{
+  msg_pos_llh_t *pos = NULL;
+  enu_ref_t ref;
+  enu_t *enu;
+  sbp_frame_t f;
+  u64 pos_off = 0;
+  u32 n = 0, size = 0, i;
+  u8 ret;
+
+  while ((ret = sbp_frame_next(cap->data, cap->size, pos_off, &f)) !=
+         SBP_FRAME_END) {
+    pos_off = f.end;
+    if (ret != SBP_FRAME_OK || f.msg_type != SBP_MSG_POS_LLH ||
+        f.len < sizeof(msg_pos_llh_t))
+      continue;
+    if (n == size) {
+      size = size ? size * 2 : 1024;
+      pos = realloc(pos, size * sizeof(*pos));
+      if (pos == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+    memcpy(&pos[n++], f.payload, sizeof(*pos));
+  }
+  if (n == 0)
+    return 0;
+
+  if (ref_llh)
+    enu_init(&ref, ref_llh[0], ref_llh[1], ref_llh[2]);
+  else
+    enu_init(&ref, pos[0].lat, pos[0].lon, pos[0].height);
+  enu = malloc(n * sizeof(*enu));
+  if (enu == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  enu_from_pos_llh(&ref, pos, enu, n);
+
+  fprintf(out, "tow,e,n,u\n");
+  for (i = 0; i < n; i++)
+    fprintf(out, "%u,%.4f,%.4f,%.4f\n", pos[i].tow, enu[i].e, enu[i].n,
+            enu[i].u);
+  free(enu);
+  free(pos);
+  return n;
+}
+
+/* Uniform in [-1, 1). */
+static double uniform(void)
+{
+  return drand48() * 2 - 1;
+}
+
+/* Positions within radius metres of ref horizontally and 100 m vertically. */
+static void scatter(msg_pos_llh_t *pos, u32 n, const double *ref,
+                    double radius)
+{
+  double m_per_deg = 111320, cos_lat = cos(ref[0] * M_PI / 180);
+  u32 i;
+
+  for (i = 0; i < n; i++) {
+    pos[i].lat = ref[0] + uniform() * radius / m_per_deg;
+    pos[i].lon = ref[1] + uniform() * radius / (m_per_deg * cos_lat);
+    pos[i].height = ref[2] + uniform() * 100;
+  }
+}
+
+static void accuracy(msg_pos_llh_t *pos, enu_t *enu, u32 n)
+{
+  static const double refs[][3] = {
+    { 0, 0, 0 }, { 37.7749, -122.4194, 10 }, { -33.87, 151.21, 50 },
+    { 60.17, 24.94, 20 }, { 78.22, 15.65, 500 }, { 0, 179.99, 0 },
+  };
+  static const double radii[] = { 10, 100, 1000, 10000, 50000 };
+  double exact[3], err, max, sum;
+  enu_ref_t ref;
+  u32 r, d, i;
+
+  printf("%-10s %12s %12s\n", "radius (m)", "rms (mm)", "max (mm)");
+  for (d = 0; d < sizeof(radii) / sizeof(radii[0]); d++) {
+    max = sum = 0;
+    for (r = 0; r < sizeof(refs) / sizeof(refs[0]); r++) {
+      enu_init(&ref, refs[r][0], refs[r][1], refs[r][2]);
+      scatter(pos, n, refs[r], radii[d]);
+      enu_from_pos_llh(&ref, pos, enu, n);
+      for (i = 0; i < n; i++) {
+        enu_from_llh_exact(&ref, pos[i].lat, pos[i].lon, pos[i].height, exact);
+        err = sqrt((enu[i].e - exact[0]) * (enu[i].e - exact[0]) +
+                   (enu[i].n - exact[1]) * (enu[i].n - exact[1]) +
+                   (enu[i].u - exact[2]) * (enu[i].u - exact[2]));
+        sum += err * err;
+        if (err > max)
+          max = err;
+      }
+    }
+    printf("%-10.0f %12.4f %12.4f\n", radii[d],
+           sqrt(sum / (n * (sizeof(refs) / sizeof(refs[0])))) * 1e3,
+           max * 1e3);
+  }
+}
+
+static void timing(msg_pos_llh_t *pos, enu_t *enu, u32 n)
+{
+  static const double ref_llh[3] = { 37.7749, -122.4194, 10 };
+  volatile double sink = 0;
+  double t, exact[3];
+  enu_ref_t ref;
+  u32 i;
+
+  enu_init(&ref, ref_llh[0], ref_llh[1], ref_llh[2]);
+  scatter(pos, n, ref_llh, 10000);
+
+  printf("\n%-22s %12s\n", "", "ns/position");
+  t = now_s();
+  for (i = 0; i < n; i++)
+    enu_from_llh(&ref, pos[i].lat, pos[i].lon, pos[i].height, &enu[i]);
+  printf("%-22s %12.1f\n", "enu_from_llh", (now_s() - t) * 1e9 / n);
+
+  t = now_s();
+  enu_from_pos_llh(&ref, pos, enu, n);
+  printf("%-22s %12.1f\n", "enu_from_pos_llh", (now_s() - t) * 1e9 / n);
+
+  t = now_s();
+  for (i = 0; i < n; i++) {
+    enu_from_llh_exact(&ref, pos[i].lat, pos[i].lon, pos[i].height, exact);
+    sink += exact[0];
+  }
+  printf("%-22s %12.1f\n", "enu_from_llh_exact", (now_s() - t) * 1e9 / n);
+  (void)sink;
+}
+
+static int benchmark(void)
+{
+  msg_pos_llh_t *pos = malloc(BENCH_POINTS * sizeof(*pos));
+  enu_t *enu = malloc(BENCH_POINTS * sizeof(*enu));
+
+  if (pos == NULL || enu == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  memset(pos, 0, BENCH_POINTS * sizeof(*pos));
+  srand48(1);
+  accuracy(pos, enu, BENCH_POINTS / 16);
+  timing(pos, enu, BENCH_POINTS);
+  free(pos);
+  free(enu);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out_path = NULL;
+  double ref_llh[3], *ref = NULL;
+  log_index_t cap;
+  FILE *out = stdout;
+  int opt, n;
+
+  while ((opt = getopt(argc, argv, "r:o:B")) != -1) {
+    switch (opt) {
+    case 'r':
+      if (sscanf(optarg, "%lf,%lf,%lf", &ref_llh[0], &ref_llh[1],
+                 &ref_llh[2]) != 3)
+        goto usage;
+      ref = ref_llh;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'B':
+      return benchmark();
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1)
+    goto usage;
+
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (out_path && (out = fopen(out_path, "w")) == NULL) {
+    perror(out_path);
+    return 1;
+  }
+  n = convert(&cap, ref, out);
+  if (out != stdout && fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  fprintf(stderr, "%d positions\n", n);
+  log_close(&cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-r lat,lon,height] [-o out.csv] capture.sbp\n"
+          "       %s -B\n", argv[0], argv[0]);
+  return 1;
+}
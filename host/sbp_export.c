@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Converts a raw SBP capture to the column store in sbp_columns.h, or to CSV,
+ * and reads columns back out.
+ *
+ * Usage: sbp_export [-f cols|csv] [-o out] capture.sbp
+ *        sbp_export -r file.cols [-c table.column,...] [-t start:end]
+ *        sbp_export -B capture.sbp
+ *   -f fmt   output format (default cols)
+ *   -o file  output file (default capture.sbp.cols or capture.sbp.csv)
+ *   -r       read a column file: print a summary of its tables and columns,
+ *            or with -c the given columns of one table as CSV
+ *   -t a:b   with -c, only rows with a time of week from a to b seconds. Only
+ *            the blocks whose tow range overlaps are decoded.
+ *   -B       benchmark converting to columns and to CSV, and reading lat and
+ *            lon back from each
+ *
+ * The CSV has one line per message, the table name followed by the fields in
+ * the same order as the columns. Doubles are printed with 17 significant
+ * digits so the CSV is as lossless as the column file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/common.h>
+
+#include "log_index.h"
+#include "sbp_columns.h"
+#include "sbp_frame.h"
+
+#define MAX_SELECT 16
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void print_value(FILE *out, u32 type, double v)
+{
+  if (type == COLS_F64)
+    fprintf(out, "%.17g", v);
+  else
+    fprintf(out, "%lld", (long long)v);
+}
+
+/* Returns the number of rows written. */
+static u32 convert_cols(const log_index_t *cap, const char *path, u64 *bytes)
+{
+  cols_writer_t w;
+  sbp_frame_t f;
+  u64 pos = 0;
+  u32 rows;
+  u8 ret;
+
+  if (cols_writer_init(&w) != 0) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  w.capture_size = cap->size;
+  while ((ret = sbp_frame_next(cap->data, cap->size, pos, &f)) !=
+         SBP_FRAME_END) {
+    pos = f.end;
+    if (ret == SBP_FRAME_OK)
+      cols_writer_add(&w, &f);
+  }
+  if (cols_writer_save(&w, path, bytes) != 0) {
+    perror(path);
+    exit(1);
+  }
+  rows = w.n_rows;
+  cols_writer_free(&w);
+  return rows;
+}
+
+/* Returns the number of rows written. */
+static u32 convert_csv(const log_index_t *cap, const char *path, u64 *bytes)
+{
+  const cols_schema_t *schema;
+  u32 n_tables, t, i, rows = 0;
+  sbp_frame_t f;
+  u64 pos = 0;
+  FILE *out;
+  u8 ret;
+
+  schema = cols_schema(&n_tables);
+  out = fopen(path, "w");
+  if (out == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while ((ret = sbp_frame_next(cap->data, cap->size, pos, &f)) !=
+         SBP_FRAME_END) {
+    pos = f.end;
+    if (ret != SBP_FRAME_OK)
+      continue;
+    for (t = 0; t < n_tables; t++)
+      if (schema[t].msg_type == f.msg_type)
+        break;
+    if (t == n_tables || f.len < schema[t].len)
+      continue;
+    fputs(schema[t].name, out);
+    for (i = 0; i < schema[t].n_fields; i++) {
+      fputc(',', out);
+      print_value(out, schema[t].fields[i].type,
+                  cols_field_value(&schema[t].fields[i], f.payload));
+    }
+    fputc('\n', out);
+    rows++;
+  }
+  *bytes = ftell(out);
+  if (fclose(out) != 0) {
+    perror(path);
+    exit(1);
+  }
+  return rows;
+}
+
+static const char *encoding_name(const cols_file_t *c, const cols_column_t *col)
+{
+  u32 b, n_delta2 = 0;
+
+  for (b = 0; b < col->n_blocks; b++)
+    if (c->blocks[col->first_block + b].encoding == COLS_ENC_DELTA2)
+      n_delta2++;
+  if (n_delta2 == 0)
+    return "delta";
+  return n_delta2 == col->n_blocks ? "delta2" : "mixed";
+}
+
+static void print_summary(const cols_file_t *c)
+{
+  const cols_header_t *h = c->header;
+  const cols_column_t *col;
+  const cols_block_t *b;
+  double min, max;
+  u32 t, i, k;
+
+  printf("Capture bytes\t: %llu\n", (unsigned long long)h->capture_size);
+  printf("File bytes\t: %llu\n", (unsigned long long)c->map_size);
+  printf("Frames\t\t: %u, %u stored\n\n", h->n_frames, h->n_rows);
+  printf("%-14s %-12s %8s %10s %8s %-7s %14s %14s\n", "table", "column",
+         "rows", "bytes", "B/row", "enc", "min", "max");
+  for (t = 0; t < h->n_tables; t++) {
+    if (c->tables[t].n_rows == 0)
+      continue;
+    for (i = 0; i < c->tables[t].n_columns; i++) {
+      col = &c->columns[c->tables[t].first_column + i];
+      b = &c->blocks[col->first_block];
+      min = b->min;
+      max = b->max;
+      for (k = 1; k < col->n_blocks; k++) {
+        if (b[k].min < min)
+          min = b[k].min;
+        if (b[k].max > max)
+          max = b[k].max;
+      }
+      printf("%-14.16s %-12.16s %8u %10llu %8.2f %-7s %14.10g %14.10g\n",
+             c->tables[t].name, col->name, c->tables[t].n_rows,
+             (unsigned long long)col->bytes,
+             (double)col->bytes / c->tables[t].n_rows, encoding_name(c, col),
+             min, max);
+    }
+  }
+}
+
+/*
+ * Print columns of one table as CSV, rows with tow_start <= tow <= tow_end
+ * only. Blocks whose tow range doesn't overlap aren't decoded.
+ */
+static int print_columns(const cols_file_t *c, char *list, u32 tow_start,
+                         u32 tow_end)
+{
+  const cols_column_t *cols[MAX_SELECT], *tow;
+  static double values[MAX_SELECT][COLS_BLOCK_ROWS];
+  static double tows[COLS_BLOCK_ROWS];
+  const cols_block_t *b;
+  char *name, *dot, *save;
+  char table[COLS_NAME_LEN + 1] = "";
+  u32 n = 0, i, k, blk, rows;
+
+  for (name = strtok_r(list, ",", &save); name;
+       name = strtok_r(NULL, ",", &save)) {
+    dot = strchr(name, '.');
+    if (dot == NULL || n == MAX_SELECT) {
+      fprintf(stderr, "columns are given as table.column, at most %u\n",
+              MAX_SELECT);
+      return -1;
+    }
+    *dot = '\0';
+    if (table[0] && strcmp(table, name) != 0) {
+      fprintf(stderr, "columns must all be from the same table\n");
+      return -1;
+    }
+    snprintf(table, sizeof(table), "%s", name);
+    cols[n] = cols_column(c, name, dot + 1);
+    if (cols[n] == NULL) {
+      fprintf(stderr, "no column %s.%s\n", name, dot + 1);
+      return -1;
+    }
+    n++;
+  }
+  if (n == 0)
+    return -1;
+  tow = cols_column(c, table, "tow");
+
+  for (i = 0; i < n; i++)
+    printf("%s%.16s", i ? "," : "", cols[i]->name);
+  printf("\n");
+
+  for (blk = 0; blk < cols[0]->n_blocks; blk++) {
+    if (tow) {
+      b = &c->blocks[tow->first_block + blk];
+      if (b->max < tow_start || b->min > tow_end)
+        continue;
+      cols_read_block(c, tow, blk, tows);
+    }
+    rows = 0;
+    for (i = 0; i < n; i++)
+      rows = cols_read_block(c, cols[i], blk, values[i]);
+    for (k = 0; k < rows; k++) {
+      if (tow && (tows[k] < tow_start || tows[k] > tow_end))
+        continue;
+      for (i = 0; i < n; i++) {
+        if (i)
+          putchar(',');
+        print_value(stdout, cols[i]->type, values[i][k]);
+      }
+      putchar('\n');
+    }
+  }
+  return 0;
+}
+
+/* Read lat and lon of every pos_llh back from the CSV, as a script would. */
+static u32 csv_read_lat_lon(const char *path, double *lat, double *lon)
+{
+  char line[512], *p;
+  u32 n = 0;
+  FILE *f;
+
+  f = fopen(path, "r");
+  if (f == NULL)
+    return 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (strncmp(line, "pos_llh,", 8) != 0)
+      continue;
+    p = strchr(line + 8, ',');   /* Past the tow. */
+    if (p == NULL)
+      continue;
+    lat[n] = strtod(p + 1, &p);
+    lon[n] = strtod(p + 1, NULL);
+    n++;
+  }
+  fclose(f);
+  return n;
+}
+
+static void benchmark(const log_index_t *cap)
+{
+  char cols_path[] = "/tmp/sbp_export_XXXXXX", csv_path[] = "/tmp/sbp_export_XXXXXX";
+  u64 cols_bytes, csv_bytes;
+  double t, cols_s, csv_s, *lat, *lon, *csv_lat, *csv_lon;
+  const cols_column_t *lat_col, *lon_col;
+  cols_file_t c;
+  u32 rows, n, csv_n;
+  int fd;
+
+  fd = mkstemp(cols_path);
+  if (fd < 0 || close(fd) != 0 || (fd = mkstemp(csv_path)) < 0 ||
+      close(fd) != 0) {
+    perror("mkstemp");
+    exit(1);
+  }
+
+  t = now_s();
+  convert_cols(cap, cols_path, &cols_bytes);
+  cols_s = now_s() - t;
+  t = now_s();
+  rows = convert_csv(cap, csv_path, &csv_bytes);
+  csv_s = now_s() - t;
+
+  printf("%-22s %12s %12s %10s\n", "", "time (ms)", "MB/s in", "bytes");
+  printf("%-22s %12s %12s %10llu\n", "capture", "", "",
+         (unsigned long long)cap->size);
+  printf("%-22s %12.1f %12.1f %10llu\n", "convert to columns", cols_s * 1e3,
+         cap->size / cols_s / 1e6, (unsigned long long)cols_bytes);
+  printf("%-22s %12.1f %12.1f %10llu\n", "convert to CSV", csv_s * 1e3,
+         cap->size / csv_s / 1e6, (unsigned long long)csv_bytes);
+  printf("Rows\t\t: %u, columns are %.1fx smaller than CSV\n", rows,
+         (double)csv_bytes / cols_bytes);
+
+  if (cols_open(&c, cols_path) != 0) {
+    fprintf(stderr, "%s: can't read back\n", cols_path);
+    exit(1);
+  }
+  lat_col = cols_column(&c, "pos_llh", "lat");
+  lon_col = cols_column(&c, "pos_llh", "lon");
+  rows = cols_table(&c, "pos_llh")->n_rows;
+  lat = malloc((rows + 1) * sizeof(double));
+  lon = malloc((rows + 1) * sizeof(double));
+  csv_lat = malloc((rows + 1) * sizeof(double));
+  csv_lon = malloc((rows + 1) * sizeof(double));
+
+  t = now_s();
+  n = cols_read(&c, lat_col, lat);
+  n = cols_read(&c, lon_col, lon) < n ? 0 : n;
+  cols_s = now_s() - t;
+  printf("Read pos_llh lat, lon\t: columns %.2f ms (%llu of %llu bytes), ",
+         cols_s * 1e3,
+         (unsigned long long)(lat_col->bytes + lon_col->bytes),
+         (unsigned long long)c.map_size);
+  cols_close(&c);
+
+  t = now_s();
+  csv_n = csv_read_lat_lon(csv_path, csv_lat, csv_lon);
+  csv_s = now_s() - t;
+  printf("CSV %.2f ms, %u rows%s\n", csv_s * 1e3, n,
+         csv_n == n && memcmp(lat, csv_lat, n * sizeof(double)) == 0 &&
+         memcmp(lon, csv_lon, n * sizeof(double)) == 0 ? "" : " (MISMATCH)");
+
+  free(lat);
+  free(lon);
+  free(csv_lat);
+  free(csv_lon);
+  unlink(cols_path);
+  unlink(csv_path);
+}
+
+int main(int argc, char *argv[])
+{
+  char out_path[4096], *select = NULL;
+  const char *out = NULL, *format = "cols";
+  u8 read = 0, bench = 0;
+  u32 tow_start = 0, tow_end = 0xFFFFFFFF, n;
+  double start, end, t;
+  log_index_t cap;
+  cols_file_t c;
+  u64 bytes;
+  int opt, ret;
+
+  while ((opt = getopt(argc, argv, "f:o:rc:t:B")) != -1) {
+    switch (opt) {
+    case 'f':
+      format = optarg;
+      if (strcmp(format, "cols") != 0 && strcmp(format, "csv") != 0)
+        goto usage;
+      break;
+    case 'o':
+      out = optarg;
+      break;
+    case 'r':
+      read = 1;
+      break;
+    case 'c':
+      select = optarg;
+      break;
+    case 't':
+      if (sscanf(optarg, "%lf:%lf", &start, &end) != 2 || start < 0 ||
+          end < start)
+        goto usage;
+      tow_start = (u32)(start * 1000 + 0.5);
+      tow_end = (u32)(end * 1000 + 0.5);
+      break;
+    case 'B':
+      bench = 1;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1)
+    goto usage;
+
+  if (read) {
+    if (cols_open(&c, argv[optind]) != 0) {
+      fprintf(stderr, "%s: not a column file\n", argv[optind]);
+      return 1;
+    }
+    if (select)
+      ret = print_columns(&c, select, tow_start, tow_end);
+    else
+      ret = (print_summary(&c), 0);
+    cols_close(&c);
+    return ret ? 1 : 0;
+  }
+
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (bench) {
+    benchmark(&cap);
+    log_close(&cap);
+    return 0;
+  }
+
+  if (out == NULL) {
+    snprintf(out_path, sizeof(out_path), "%s.%s", argv[optind], format);
+    out = out_path;
+  }
+  t = now_s();
+  if (strcmp(format, "csv") == 0)
+    n = convert_csv(&cap, out, &bytes);
+  else
+    n = convert_cols(&cap, out, &bytes);
+  t = now_s() - t;
+  fprintf(stderr, "Wrote %s: %llu bytes, %u rows in %.1f ms\n", out,
+          (unsigned long long)bytes, n, t * 1e3);
+  log_close(&cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-f cols|csv] [-o out] capture.sbp\n"
+          "       %s -r file.cols [-c table.column,...] [-t start:end]\n"
+          "       %s -B capture.sbp\n", argv[0], argv[0], argv[0]);
+  return 1;
+}
@@ -0,0 +1,747 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Forwards the raw SBP frames from a Piksi (serial port, pipe or capture file)
+ * to TCP clients and to a UDP multicast group.
+ *
+ * Frames are found and CRC checked as they are read (see sbp_frame.c), and
+ * each good frame is copied once, as it is, into a ring shared by all
+ * outputs. From there nothing is copied or re-encoded in user space: TCP
+ * clients are sent straight from the ring with writev, and UDP datagrams,
+ * each holding as many whole frames as fit, are built from iovecs into the
+ * ring and sent in batches with sendmmsg.
+ *
+ * Every TCP client has its own position in the ring and a limit on how far
+ * behind it may fall. A client past its limit loses its oldest frames, down
+ * to half the limit, so a slow consumer always gets recent data and never
+ * holds up the others. A frame is never cut: one that was partly written
+ * when the frames after it were dropped is finished first. UDP has no
+ * backlog; datagrams the kernel won't take are dropped.
+ *
+ * Usage: sbp_fanout [-t port] [-u group:port] [-I addr] [-q kb] [-i seconds]
+ *                   [-G rate [-s len] [-d seconds]] [input]
+ *   -t n     TCP port to listen on (default 55555, 0 for none)
+ *   -u g:p   also send to UDP multicast group g, port p
+ *   -I addr  local interface address for multicast (default: routing table)
+ *   -q n     per client limit in kB (default 1024)
+ *   -i n     print statistics every n seconds (default 0, only at the end)
+ *   -G n     instead of reading input, generate n probe frames per second
+ *            (0 for as fast as possible) for sbp_fanout_client to measure
+ *   -s n     payload length of probe frames (default 34, like MSG_POS_LLH)
+ *   -d n     stop generating after n seconds (default 10)
+ *
+ * input is a file, serial port or fifo (default stdin). Once it ends, clients
+ * are given up to two seconds to catch up before exiting.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/sbp.h>
+
+#include "sbp_fanout.h"
+#include "sbp_frame.h"
+#include "sbp_simd.h"
+
+/* The ring, sized so that a client at the largest limit plus one batch of
+ * input can never be overwritten. */
+#define RING_BYTES     (16 << 20)
+#define RING_FRAMES    (1 << 20)
+#define MAX_LIMIT      (RING_BYTES / 4)
+#define IN_BUF_SIZE    (256 << 10)
+#define GEN_BATCH      8192
+
+#define MAX_CLIENTS    64
+#define IOV_BATCH      256
+/* Kernel send buffer per client. Left alone it grows to megabytes, which
+ * would hide how far behind a slow client is from the limit. */
+#define CLIENT_SNDBUF  (128 << 10)
+#define UDP_BATCH      64
+#define DRAIN_S        2.0
+
+typedef struct {
+  u64 pos;           /* Absolute byte position of the frame in the ring. */
+  u32 len;
+} frame_ref_t;
+
+typedef struct {
+  u8 *bytes;
+  frame_ref_t *frames;
+  u64 head_frame;    /* Frames appended so far. */
+  u64 head_pos;      /* Bytes appended so far, including padding. */
+} ring_t;
+
+typedef struct {
+  int fd;
+  char addr[48];
+  u64 next_frame;    /* Next frame to send. */
+  u32 sent;          /* Bytes of it already written. */
+  /* Rest of a frame that was partly written when the frames after it were
+   * dropped, sent before next_frame. It is copied out of the ring, which may
+   * overwrite it before a slow client gets round to it. */
+  u8 partial[SBP_FRAME_OVERHEAD + 255];
+  u32 partial_off;
+  u32 partial_len;
+  u64 frames_sent;
+  u64 bytes_sent;
+  u64 frames_dropped;
+  u8 blocked;        /* Last write hit EAGAIN, wait for EPOLLOUT. */
+} client_t;
+
+typedef struct {
+  int fd;
+  struct sockaddr_in dest;
+  u64 next_frame;
+  u64 datagrams;
+  u64 frames_sent;
+  u64 bytes_sent;
+  u64 frames_dropped;
+} udp_out_t;
+
+static ring_t ring;
+static client_t clients[MAX_CLIENTS];
+static udp_out_t udp;
+static u8 udp_enabled;
+static u32 limit = 1024 << 10;
+static int epfd, listen_fd = -1, in_fd = -1;
+
+static u64 in_bytes, in_frames, in_crc_errors;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig)
+{
+  (void)sig;
+  stop_requested = 1;
+}
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static u64 now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/* Ring. */
+
+static const u8 *ring_ptr(u64 pos)
+{
+  return ring.bytes + (pos & (RING_BYTES - 1));
+}
+
+static const frame_ref_t *ring_frame(u64 k)
+{
+  return &ring.frames[k & (RING_FRAMES - 1)];
+}
+
+/* Append a frame, padding to the start of the ring if it wouldn't fit before
+ * the end, so every frame is contiguous. */
+static void ring_append(const u8 *frame, u32 len)
+{
+  u64 off = ring.head_pos & (RING_BYTES - 1);
+  frame_ref_t *r;
+
+  if (off + len > RING_BYTES) {
+    ring.head_pos += RING_BYTES - off;
+    off = 0;
+  }
+  memcpy(ring.bytes + off, frame, len);
+  r = &ring.frames[ring.head_frame & (RING_FRAMES - 1)];
+  r->pos = ring.head_pos;
+  r->len = len;
+  ring.head_frame++;
+  ring.head_pos += len;
+}
+
+/* TCP clients. */
+
+static u64 client_backlog(const client_t *c)
+{
+  u64 pos = ring.head_pos;
+
+  if (c->next_frame < ring.head_frame)
+    pos = ring_frame(c->next_frame)->pos + c->sent;
+  return ring.head_pos - pos + c->partial_len;
+}
+
+static void client_close(client_t *c, const char *why)
+{
+  fprintf(stderr, "%s: disconnected (%s), %llu frames sent, %llu dropped\n",
+          c->addr, why, (unsigned long long)c->frames_sent,
+          (unsigned long long)c->frames_dropped);
+  close(c->fd);
+  c->fd = -1;
+}
+
+/*
+ * Slow consumer policy: past the limit, skip the oldest frames until the
+ * backlog is half the limit.
+ */
+static void client_trim(client_t *c)
+{
+  const frame_ref_t *r;
+  u64 lo, hi, mid;
+
+  if (client_backlog(c) <= limit)
+    return;
+
+  /* First frame that leaves at most limit / 2 behind it. */
+  lo = c->next_frame;
+  hi = ring.head_frame;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ring.head_pos - ring_frame(mid)->pos > limit / 2)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo <= c->next_frame)
+    return;
+  if (c->sent) {
+    r = ring_frame(c->next_frame);
+    c->partial_off = 0;
+    c->partial_len = r->len - c->sent;
+    memcpy(c->partial, ring_ptr(r->pos) + c->sent, c->partial_len);
+    c->sent = 0;
+    c->next_frame++;
+  }
+  c->frames_dropped += lo - c->next_frame;
+  c->next_frame = lo;
+}
+
+/* Write as much of the backlog as the socket takes. */
+static void client_flush(client_t *c)
+{
+  struct iovec iov[IOV_BATCH];
+  const frame_ref_t *r;
+  const u8 *p;
+  u32 n_iov = 0, rem, skip, len;
+  u64 k;
+  ssize_t n;
+
+  while (c->fd >= 0 && !c->blocked &&
+         (c->partial_len || c->next_frame < ring.head_frame)) {
+    n_iov = 0;
+    if (c->partial_len) {
+      iov[0].iov_base = c->partial + c->partial_off;
+      iov[0].iov_len = c->partial_len;
+      n_iov = 1;
+    }
+    /* Consecutive frames are usually adjacent in the ring, so merge them. */
+    for (k = c->next_frame; k < ring.head_frame; k++) {
+      r = ring_frame(k);
+      skip = k == c->next_frame ? c->sent : 0;
+      p = ring_ptr(r->pos) + skip;
+      len = r->len - skip;
+      if (n_iov && (const u8 *)iov[n_iov - 1].iov_base +
+                   iov[n_iov - 1].iov_len == p) {
+        iov[n_iov - 1].iov_len += len;
+        continue;
+      }
+      if (n_iov == IOV_BATCH)
+        break;
+      iov[n_iov].iov_base = (void *)p;
+      iov[n_iov].iov_len = len;
+      n_iov++;
+    }
+
+    n = writev(c->fd, iov, n_iov);
+    if (n < 0) {
+      if (errno == EAGAIN)
+        c->blocked = 1;
+      else if (errno != EINTR)
+        client_close(c, strerror(errno));
+      return;
+    }
+    c->bytes_sent += n;
+
+    if (c->partial_len) {
+      rem = (u64)n < c->partial_len ? (u32)n : c->partial_len;
+      c->partial_off += rem;
+      c->partial_len -= rem;
+      n -= rem;
+      if (c->partial_len == 0)
+        c->frames_sent++;
+    }
+    while (n > 0) {
+      rem = ring_frame(c->next_frame)->len - c->sent;
+      if ((u64)n < rem) {
+        c->sent += n;
+        break;
+      }
+      n -= rem;
+      c->sent = 0;
+      c->next_frame++;
+      c->frames_sent++;
+    }
+  }
+}
+
+static void client_accept(void)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  struct epoll_event ev;
+  client_t *c = NULL;
+  int fd, one = 1, sndbuf = CLIENT_SNDBUF;
+  u32 i;
+
+  while ((fd = accept4(listen_fd, (struct sockaddr *)&addr, &addr_len,
+                       SOCK_NONBLOCK)) >= 0) {
+    for (i = 0; i < MAX_CLIENTS; i++)
+      if (clients[i].fd < 0)
+        break;
+    if (i == MAX_CLIENTS) {
+      close(fd);
+      continue;
+    }
+    c = &clients[i];
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    snprintf(c->addr, sizeof(c->addr), "%s:%u", inet_ntoa(addr.sin_addr),
+             ntohs(addr.sin_port));
+    /* Start live, from the next frame. */
+    c->next_frame = ring.head_frame;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    fprintf(stderr, "%s: connected\n", c->addr);
+    addr_len = sizeof(addr);
+  }
+}
+
+/* Anything a client sends is ignored, but reading shows when it has gone. */
+static void client_event(client_t *c, u32 events)
+{
+  char buf[256];
+  ssize_t n;
+
+  if (events & EPOLLIN) {
+    while ((n = read(c->fd, buf, sizeof(buf))) > 0)
+      ;
+    if (n == 0) {
+      client_close(c, "closed");
+      return;
+    }
+  }
+  if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+    client_close(c, "closed");
+    return;
+  }
+  if (events & EPOLLOUT) {
+    c->blocked = 0;
+    client_flush(c);
+  }
+}
+
+/* UDP multicast. */
+
+static void udp_flush(void)
+{
+  static struct mmsghdr msgs[UDP_BATCH];
+  static struct iovec iovs[UDP_BATCH][4];
+  u32 n_msgs, n_iov, size, first_frames[UDP_BATCH + 1];
+  const frame_ref_t *r;
+  const u8 *p;
+  u64 k = udp.next_frame;
+  int sent, i;
+
+  while (k < ring.head_frame) {
+    /* Pack whole frames into up to UDP_BATCH datagrams. */
+    for (n_msgs = 0; n_msgs < UDP_BATCH && k < ring.head_frame; n_msgs++) {
+      first_frames[n_msgs] = k - udp.next_frame;
+      n_iov = 0;
+      size = 0;
+      for (; k < ring.head_frame; k++) {
+        r = ring_frame(k);
+        if (size + r->len > FANOUT_DATAGRAM)
+          break;
+        p = ring_ptr(r->pos);
+        if (n_iov && (const u8 *)iovs[n_msgs][n_iov - 1].iov_base +
+                     iovs[n_msgs][n_iov - 1].iov_len == p) {
+          iovs[n_msgs][n_iov - 1].iov_len += r->len;
+        } else {
+          if (n_iov == 4)
+            break;
+          iovs[n_msgs][n_iov].iov_base = (void *)p;
+          iovs[n_msgs][n_iov].iov_len = r->len;
+          n_iov++;
+        }
+        size += r->len;
+      }
+      memset(&msgs[n_msgs], 0, sizeof(msgs[n_msgs]));
+      msgs[n_msgs].msg_hdr.msg_name = &udp.dest;
+      msgs[n_msgs].msg_hdr.msg_namelen = sizeof(udp.dest);
+      msgs[n_msgs].msg_hdr.msg_iov = iovs[n_msgs];
+      msgs[n_msgs].msg_hdr.msg_iovlen = n_iov;
+    }
+    first_frames[n_msgs] = k - udp.next_frame;
+
+    sent = sendmmsg(udp.fd, msgs, n_msgs, 0);
+    if (sent < 0)
+      sent = 0;
+    for (i = 0; i < sent; i++)
+      udp.bytes_sent += msgs[i].msg_len;
+    udp.datagrams += sent;
+    udp.frames_sent += first_frames[sent];
+    /* Whatever the kernel didn't take is dropped, UDP has no backlog. */
+    udp.frames_dropped += first_frames[n_msgs] - first_frames[sent];
+    udp.next_frame = k;
+  }
+}
+
+static int udp_setup(const char *group_port, const char *iface)
+{
+  char group[64], *colon;
+  struct in_addr if_addr;
+  u8 ttl = 1;
+
+  snprintf(group, sizeof(group), "%s", group_port);
+  colon = strchr(group, ':');
+  if (colon == NULL)
+    return -1;
+  *colon = '\0';
+  memset(&udp.dest, 0, sizeof(udp.dest));
+  udp.dest.sin_family = AF_INET;
+  udp.dest.sin_port = htons(atoi(colon + 1));
+  if (inet_aton(group, &udp.dest.sin_addr) == 0)
+    return -1;
+
+  udp.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (udp.fd < 0)
+    return -1;
+  setsockopt(udp.fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  if (iface) {
+    if (inet_aton(iface, &if_addr) == 0 ||
+        setsockopt(udp.fd, IPPROTO_IP, IP_MULTICAST_IF, &if_addr,
+                   sizeof(if_addr)) != 0)
+      return -1;
+  }
+  udp.next_frame = ring.head_frame;
+  udp_enabled = 1;
+  return 0;
+}
+
+static int tcp_setup(u16 port)
+{
+  struct sockaddr_in addr;
+  struct epoll_event ev;
+  int one = 1;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (listen_fd < 0)
+    return -1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 16) != 0)
+    return -1;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listen_fd;
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+}
+
+/* Input. */
+
+static u8 in_buf[IN_BUF_SIZE];
+static u32 in_len;
+
+/* Read what's available and move the good frames into the ring. Returns 0 at
+ * end of input, 1 otherwise. */
+static int input_read(void)
+{
+  sbp_frame_t f;
+  u64 pos = 0;
+  ssize_t n;
+  u8 ret;
+
+  n = read(in_fd, in_buf + in_len, sizeof(in_buf) - in_len);
+  if (n < 0)
+    return errno == EAGAIN || errno == EINTR;
+  if (n == 0)
+    return 0;
+  in_bytes += n;
+  in_len += n;
+
+  while ((ret = sbp_frame_next(in_buf, in_len, pos, &f)) != SBP_FRAME_END) {
+    if (ret == SBP_FRAME_OK) {
+      ring_append(in_buf + f.offset, f.end - f.offset);
+      in_frames++;
+    } else {
+      in_crc_errors++;
+    }
+    pos = f.end;
+  }
+  /* Keep the start of an incomplete frame for the next read. */
+  memmove(in_buf, in_buf + f.offset, in_len - f.offset);
+  in_len -= f.offset;
+  return 1;
+}
+
+/* Append the probe frames due by now. */
+static void generate(double start, double rate, u8 payload_len)
+{
+  static u8 frame[SBP_FRAME_OVERHEAD + 255];
+  static u64 seq;
+  fanout_probe_t probe;
+  u64 due, n, i;
+  u16 crc;
+
+  due = rate > 0 ? (u64)((now_s() - start) * rate) : seq + GEN_BATCH;
+  n = due - seq < GEN_BATCH ? due - seq : GEN_BATCH;
+
+  frame[0] = SBP_PREAMBLE;
+  frame[1] = FANOUT_PROBE_MSG & 0xFF;
+  frame[2] = FANOUT_PROBE_MSG >> 8;
+  frame[3] = SBP_SENDER_ID & 0xFF;
+  frame[4] = SBP_SENDER_ID >> 8;
+  frame[5] = payload_len;
+  for (i = 0; i < n; i++) {
+    probe.seq = seq++;
+    probe.time_ns = now_ns();
+    memcpy(frame + SBP_FRAME_HEADER, &probe, sizeof(probe));
+    crc = sbp_crc16(frame + 1, SBP_FRAME_HEADER - 1 + payload_len, 0);
+    frame[SBP_FRAME_HEADER + payload_len] = crc & 0xFF;
+    frame[SBP_FRAME_HEADER + payload_len + 1] = crc >> 8;
+    ring_append(frame, SBP_FRAME_OVERHEAD + payload_len);
+  }
+  in_frames += n;
+  in_bytes += n * (SBP_FRAME_OVERHEAD + payload_len);
+}
+
+static int input_setup(const char *path)
+{
+  struct epoll_event ev;
+  struct termios tio;
+  struct stat st;
+
+  in_fd = path ? open(path, O_RDONLY | O_NOCTTY) : STDIN_FILENO;
+  if (in_fd < 0 || fstat(in_fd, &st) != 0)
+    return -1;
+  if (tcgetattr(in_fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(in_fd, TCSANOW, &tio);
+  }
+  /* Files can't be waited on, they're read whenever the loop comes round. */
+  if (S_ISREG(st.st_mode))
+    return 1;
+  fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) | O_NONBLOCK);
+  ev.events = EPOLLIN;
+  ev.data.ptr = &in_fd;
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, in_fd, &ev);
+}
+
+static void report(double elapsed)
+{
+  u32 i;
+
+  fprintf(stderr, "in: %llu frames, %llu CRC errors, %.1f MB/s, "
+          "%.0f frames/s\n", (unsigned long long)in_frames,
+          (unsigned long long)in_crc_errors, in_bytes / elapsed / 1e6,
+          in_frames / elapsed);
+  if (udp_enabled)
+    fprintf(stderr, "udp: %llu datagrams, %llu frames, %.1f MB/s, "
+            "%llu dropped\n", (unsigned long long)udp.datagrams,
+            (unsigned long long)udp.frames_sent,
+            udp.bytes_sent / elapsed / 1e6,
+            (unsigned long long)udp.frames_dropped);
+  for (i = 0; i < MAX_CLIENTS; i++) {
+    if (clients[i].fd < 0)
+      continue;
+    fprintf(stderr, "%s: %llu frames, %.1f MB/s, backlog %llu bytes, "
+            "%llu dropped\n", clients[i].addr,
+            (unsigned long long)clients[i].frames_sent,
+            clients[i].bytes_sent / elapsed / 1e6,
+            (unsigned long long)client_backlog(&clients[i]),
+            (unsigned long long)clients[i].frames_dropped);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  struct epoll_event events[MAX_CLIENTS + 2];
+  const char *udp_group = NULL, *iface = NULL;
+  double interval = 0, rate = -1, duration = 10, start, last_report;
+  double drain_start = 0;
+  u32 port = FANOUT_TCP_PORT, payload_len = 34, i;
+  u8 input_open = 1, in_is_file = 0, pending;
+  int opt, n, k, timeout_ms;
+  client_t *c;
+
+  while ((opt = getopt(argc, argv, "t:u:I:q:i:G:s:d:")) != -1) {
+    switch (opt) {
+    case 't':
+      port = strtoul(optarg, NULL, 0);
+      break;
+    case 'u':
+      udp_group = optarg;
+      break;
+    case 'I':
+      iface = optarg;
+      break;
+    case 'q':
+      limit = strtoul(optarg, NULL, 0) << 10;
+      break;
+    case 'i':
+      interval = strtod(optarg, NULL);
+      break;
+    case 'G':
+      rate = strtod(optarg, NULL);
+      break;
+    case 's':
+      payload_len = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      duration = strtod(optarg, NULL);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind < argc - 1 || limit == 0 || limit > MAX_LIMIT ||
+      payload_len < sizeof(fanout_probe_t) || payload_len > 255 ||
+      port > 65535)
+    goto usage;
+
+  ring.bytes = malloc(RING_BYTES);
+  ring.frames = malloc(RING_FRAMES * sizeof(frame_ref_t));
+  if (ring.bytes == NULL || ring.frames == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (i = 0; i < MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+
+  epfd = epoll_create1(0);
+  if (port && tcp_setup(port) != 0) {
+    perror("tcp");
+    return 1;
+  }
+  if (udp_group && udp_setup(udp_group, iface) != 0) {
+    fprintf(stderr, "%s: bad multicast group or interface\n", udp_group);
+    return 1;
+  }
+  if (rate < 0) {
+    k = input_setup(optind < argc ? argv[optind] : NULL);
+    if (k < 0) {
+      perror(optind < argc ? argv[optind] : "stdin");
+      return 1;
+    }
+    in_is_file = k == 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  start = last_report = now_s();
+  while (!stop_requested) {
+    /* Block on input if it can be waited on, otherwise keep coming round to
+     * read the file or generate frames. */
+    if (!input_open)
+      timeout_ms = 10;
+    else if (rate > 0)
+      timeout_ms = 1;
+    else if (rate == 0 || in_is_file)
+      timeout_ms = 0;
+    else
+      timeout_ms = 1000;
+    n = epoll_wait(epfd, events, MAX_CLIENTS + 2, timeout_ms);
+
+    for (k = 0; k < n; k++) {
+      if (events[k].data.ptr == &listen_fd)
+        client_accept();
+      else if (events[k].data.ptr == &in_fd && !input_read()) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, in_fd, NULL);
+        input_open = 0;
+      }
+      else if (((client_t *)events[k].data.ptr)->fd >= 0)
+        client_event(events[k].data.ptr, events[k].events);
+    }
+
+    if (input_open && in_is_file)
+      input_open = input_read();
+    if (input_open && rate >= 0) {
+      generate(start, rate, payload_len);
+      if (now_s() - start >= duration)
+        input_open = 0;
+    }
+
+    /* Send whatever is new. */
+    if (udp_enabled)
+      udp_flush();
+    pending = 0;
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      c = &clients[i];
+      if (c->fd < 0)
+        continue;
+      client_trim(c);
+      client_flush(c);
+      pending |= c->fd >= 0 && client_backlog(c) > 0;
+    }
+
+    if (interval > 0 && now_s() - last_report >= interval) {
+      report(now_s() - start);
+      last_report = now_s();
+    }
+    if (!input_open) {
+      if (drain_start == 0)
+        drain_start = now_s();
+      if (!pending || now_s() - drain_start > DRAIN_S)
+        break;
+    }
+  }
+
+  report((drain_start ? drain_start : now_s()) - start);
+  for (i = 0; i < MAX_CLIENTS; i++)
+    if (clients[i].fd >= 0)
+      client_close(&clients[i], "exiting");
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-t port] [-u group:port] [-I addr] [-q kb] "
+          "[-i seconds]\n          [-G rate [-s len] [-d seconds]] [input]\n",
+          argv[0]);
+  return 1;
+}
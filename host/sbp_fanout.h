@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Shared between sbp_fanout and its test client, sbp_fanout_client.
+ */
+
+#ifndef SBP_TUTORIAL_SBP_FANOUT_H
+#define SBP_TUTORIAL_SBP_FANOUT_H
+
+#include <libsbp/common.h>
+
+#define FANOUT_TCP_PORT  55555
+#define FANOUT_UDP_GROUP "239.255.83.66"
+#define FANOUT_UDP_PORT  55556
+/* Largest UDP payload that fits an Ethernet frame unfragmented. Datagrams
+ * carry whole SBP frames only. */
+#define FANOUT_DATAGRAM  1472
+
+/*
+ * Probe frames from sbp_fanout -G, sent as SBP user data. The client takes
+ * latency from the time and losses from gaps in the sequence number. Both
+ * ends run on the same host, so CLOCK_MONOTONIC is comparable.
+ */
+#define FANOUT_PROBE_MSG 0x0800
+
+typedef struct __attribute__((packed)) {
+  u64 seq;
+  u64 time_ns;      /* CLOCK_MONOTONIC when the frame was generated. */
+} fanout_probe_t;
+
+#endif /* SBP_TUTORIAL_SBP_FANOUT_H */
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Test client for sbp_fanout. Receives frames over TCP or UDP multicast,
+ * checks every CRC, and reports throughput. For the probe frames that
+ * sbp_fanout -G generates it also reports the latency from generation to
+ * receipt and how many were lost.
+ *
+ * Usage: sbp_fanout_client [-t host:port | -u group:port] [-I addr]
+ *                          [-d seconds] [-S kB/s]
+ *   -t h:p   connect to sbp_fanout over TCP (default 127.0.0.1:55555)
+ *   -u g:p   join multicast group g and receive on port p instead
+ *   -I addr  local interface address to join the group on
+ *   -d n     stop after n seconds (default: when the server closes, or 10 s
+ *            with UDP)
+ *   -S n     read at most n kB/s, to act as a slow consumer
+ *
+ * Example:
+ *   ./sbp_fanout -G 10000 -d 5 -u 239.255.83.66:55556 &
+ *   ./sbp_fanout_client & ./sbp_fanout_client -u 239.255.83.66:55556
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/common.h>
+
+#include "sbp_fanout.h"
+#include "sbp_frame.h"
+
+#define BUF_SIZE    (256 << 10)
+#define UDP_BATCH   64
+#define MAX_SAMPLES (4 << 20)
+
+typedef struct {
+  u64 bytes;
+  u64 frames;
+  u64 crc_errors;
+  u64 probes;
+  u64 lost;          /* Gaps in the probe sequence numbers. */
+  u64 next_seq;
+  u64 *latency_ns;
+  u32 n_samples;
+} client_stats_t;
+
+static u64 now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static void probe_received(client_stats_t *s, const sbp_frame_t *f, u64 now)
+{
+  fanout_probe_t probe;
+
+  if (f->msg_type != FANOUT_PROBE_MSG || f->len < sizeof(probe))
+    return;
+  memcpy(&probe, f->payload, sizeof(probe));
+  if (s->probes && probe.seq > s->next_seq)
+    s->lost += probe.seq - s->next_seq;
+  s->next_seq = probe.seq + 1;
+  s->probes++;
+  if (s->n_samples < MAX_SAMPLES)
+    s->latency_ns[s->n_samples++] = now - probe.time_ns;
+}
+
+/* Scan buf for frames. Returns the offset of an incomplete frame at the end,
+ * or len if there is none. */
+static u32 scan(client_stats_t *s, const u8 *buf, u32 len)
+{
+  u64 pos = 0, now = now_ns();
+  sbp_frame_t f;
+  u8 ret;
+
+  while ((ret = sbp_frame_next(buf, len, pos, &f)) != SBP_FRAME_END) {
+    if (ret == SBP_FRAME_OK) {
+      s->frames++;
+      probe_received(s, &f, now);
+    } else {
+      s->crc_errors++;
+    }
+    pos = f.end;
+  }
+  return f.offset;
+}
+
+static int parse_addr(const char *s, struct sockaddr_in *addr)
+{
+  char host[64], *colon;
+
+  snprintf(host, sizeof(host), "%s", s);
+  colon = strchr(host, ':');
+  if (colon == NULL)
+    return -1;
+  *colon = '\0';
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(atoi(colon + 1));
+  return inet_aton(host, &addr->sin_addr) ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+  u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void report(client_stats_t *s, double elapsed)
+{
+  printf("Received\t: %llu bytes, %llu frames, %.1f MB/s, %.0f frames/s\n",
+         (unsigned long long)s->bytes, (unsigned long long)s->frames,
+         s->bytes / elapsed / 1e6, s->frames / elapsed);
+  printf("CRC errors\t: %llu\n", (unsigned long long)s->crc_errors);
+  if (s->probes == 0)
+    return;
+  printf("Probes\t\t: %llu, %llu lost (%.3f%%)\n",
+         (unsigned long long)s->probes, (unsigned long long)s->lost,
+         100.0 * s->lost / (s->probes + s->lost));
+  qsort(s->latency_ns, s->n_samples, sizeof(u64), cmp_u64);
+  printf("Latency (us)\t: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         s->latency_ns[s->n_samples / 2] / 1e3,
+         s->latency_ns[(u64)s->n_samples * 99 / 100] / 1e3,
+         s->latency_ns[(u64)s->n_samples * 999 / 1000] / 1e3,
+         s->latency_ns[s->n_samples - 1] / 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+  static u8 buf[BUF_SIZE], dgrams[UDP_BATCH][FANOUT_DATAGRAM];
+  struct mmsghdr msgs[UDP_BATCH];
+  struct iovec iovs[UDP_BATCH];
+  struct sockaddr_in addr;
+  struct ip_mreq mreq;
+  struct timeval tv = { 0, 100000 };
+  const char *tcp_addr = "127.0.0.1:55555", *udp_group = NULL, *iface = NULL;
+  double duration = 0, rate_kb = 0, elapsed;
+  client_stats_t s;
+  u64 start, end;
+  u32 len = 0, keep;
+  int fd, opt, n, i, one = 1, rcvbuf = 4096;
+
+  while ((opt = getopt(argc, argv, "t:u:I:d:S:")) != -1) {
+    switch (opt) {
+    case 't':
+      tcp_addr = optarg;
+      break;
+    case 'u':
+      udp_group = optarg;
+      break;
+    case 'I':
+      iface = optarg;
+      break;
+    case 'd':
+      duration = strtod(optarg, NULL);
+      break;
+    case 'S':
+      rate_kb = strtod(optarg, NULL);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc || parse_addr(udp_group ? udp_group : tcp_addr, &addr))
+    goto usage;
+  if (udp_group && duration == 0)
+    duration = 10;
+
+  memset(&s, 0, sizeof(s));
+  s.latency_ns = malloc(MAX_SAMPLES * sizeof(u64));
+  if (s.latency_ns == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  if (udp_group) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    mreq.imr_multiaddr = addr.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (iface)
+      inet_aton(iface, &mreq.imr_interface);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                   sizeof(mreq)) != 0) {
+      perror(udp_group);
+      return 1;
+    }
+  } else {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    /* A small receive buffer makes a slow reader show up at the server
+     * quickly. */
+    if (rate_kb > 0)
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      perror(tcp_addr);
+      return 1;
+    }
+  }
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  for (i = 0; i < UDP_BATCH; i++) {
+    iovs[i].iov_base = dgrams[i];
+    iovs[i].iov_len = FANOUT_DATAGRAM;
+    memset(&msgs[i], 0, sizeof(msgs[i]));
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  start = now_ns();
+  end = duration > 0 ? start + (u64)(duration * 1e9) : (u64)-1;
+  while (now_ns() < end) {
+    if (udp_group) {
+      /* Datagrams hold whole frames, each is scanned on its own. */
+      n = recvmmsg(fd, msgs, UDP_BATCH, MSG_WAITFORONE, NULL);
+      for (i = 0; i < n; i++) {
+        s.bytes += msgs[i].msg_len;
+        scan(&s, dgrams[i], msgs[i].msg_len);
+      }
+      continue;
+    }
+
+    n = recv(fd, buf + len, sizeof(buf) - len, 0);
+    if (n == 0)
+      break;
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+        continue;
+      perror("recv");
+      break;
+    }
+    s.bytes += n;
+    len += n;
+    keep = scan(&s, buf, len);
+    memmove(buf, buf + keep, len - keep);
+    len -= keep;
+
+    /* Slow consumer: sleep off reading faster than rate_kb. */
+    if (rate_kb > 0) {
+      elapsed = (now_ns() - start) / 1e9;
+      if (s.bytes / 1e3 > rate_kb * elapsed)
+        usleep((useconds_t)((s.bytes / 1e3 / rate_kb - elapsed) * 1e6));
+    }
+  }
+
+  report(&s, (now_ns() - start) / 1e9);
+  close(fd);
+  free(s.latency_ns);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-t host:port | -u group:port] [-I addr] "
+          "[-d seconds] [-S kB/s]\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Dumps the frame log that flash_log.c keeps in flash, from an image of the
+ * region read off a board, and writes logs into an emulated flash from a
+ * capture to test it.
+ *
+ * Usage: sbp_flash_log -d [-z size] [-o out.sbp] image.bin
+ *        sbp_flash_log [-z size] [-n sectors] [-p words] [-c n] -o image.bin
+ *                      capture.sbp
+ *   -d       dump: write the frames in the log to a capture, oldest first,
+ *            and describe its sectors
+ *   -z size  sector size (default FLASH_LOG_SECTOR_SIZE, as on the board)
+ *   -n n     sectors in the region (default FLASH_LOG_N_SECTORS)
+ *   -p n     words written per poll, one poll per frame (default
+ *            FLASH_LOG_POLL_WORDS)
+ *   -c n     cut the power every n flash operations, then open the log
+ *            again and carry on, as after a reset. Starting a sector takes
+ *            5 operations, so n must be at least 8 for the log to get on.
+ *   -o file  write to file instead of stdout (the image must be named)
+ *
+ * Without -d, every good frame in the capture is logged as the board would
+ * log it, with flash_emu standing in for the flash. The image is saved, and
+ * the log is read back and checked against the capture: the records must be
+ * frames of the capture, in order, ending with the last one logged.
+ *
+ * To read the region off the board (with its defaults), e.g.
+ *   st-flash read image.bin 0x08080000 0x80000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <flash_log.h>
+
+#include "flash_emu.h"
+#include "log_index.h"
+#include "sbp_frame.h"
+
+/* As set up in main.c. */
+#define FLASH_LOG_SECTOR_SIZE 0x20000
+#define FLASH_LOG_N_SECTORS   4
+#define FLASH_LOG_POLL_WORDS  16
+
+static flash_log_t flash_log;
+static flash_emu_t emu;
+
+static void describe(const flash_log_region_t *region)
+{
+  flash_log_header_t h;
+  u32 s;
+
+  fprintf(stderr, "%-8s %10s %10s\n", "sector", "seq", "erases");
+  for (s = 0; s < region->n_sectors; s++) {
+    if (flash_log_read_header(region, s, &h))
+      fprintf(stderr, "%-8u %10u %10u\n", s, h.seq, h.erases);
+    else
+      fprintf(stderr, "%-8u %10s %10s\n", s, "-", "-");
+  }
+}
+
+static int dump(const char *path, u32 sector_size, FILE *out)
+{
+  flash_log_region_t region;
+  flash_log_reader_t r;
+  const u8 *frame;
+  u32 records = 0;
+  long size;
+  FILE *in;
+  u8 *buf;
+  u16 len;
+
+  if ((in = fopen(path, "rb")) == NULL || fseek(in, 0, SEEK_END) != 0 ||
+      (size = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0) {
+    perror(path);
+    return 1;
+  }
+  if (size < (long)sector_size || size % sector_size) {
+    fprintf(stderr, "%s: not a whole number of %u byte sectors\n", path,
+            sector_size);
+    return 1;
+  }
+  if ((buf = malloc(size)) == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  if (fread(buf, 1, size, in) != (size_t)size) {
+    perror(path);
+    return 1;
+  }
+  fclose(in);
+
+  region.mem = buf;
+  region.sector_size = sector_size;
+  region.n_sectors = size / sector_size;
+  describe(&region);
+
+  flash_log_read_init(&r);
+  while (flash_log_read_next(&region, &r, &frame, &len)) {
+    fwrite(frame, 1, len, out);
+    records++;
+  }
+  fprintf(stderr, "%u records, %u runs of other words skipped\n", records,
+          r.bad);
+  free(buf);
+  return 0;
+}
+
+/* Write up to words words, and after a power cut start again from flash. */
+static void poll(const flash_log_region_t *region, const flash_log_ops_t *ops,
+                 u32 words, u32 cut_every, u32 *cuts)
+{
+  flash_log_t *l = &flash_log;
+  u32 records, dropped, erases;
+
+  flash_log_poll(l, words);
+  if (!emu.cut)
+    return;
+  (*cuts)++;
+  flash_emu_power_on(&emu);
+  emu.cut_after = emu.ops + cut_every;
+  /* Staged frames are lost with the RAM, the counts are kept. */
+  records = l->records;
+  dropped = l->dropped;
+  erases = l->erases;
+  while (flash_log_open(l, region, ops) != 0) {
+    flash_emu_power_on(&emu);
+    emu.cut_after = emu.ops + cut_every;
+    (*cuts)++;
+  }
+  l->records += records;
+  l->dropped += dropped;
+  l->erases += erases;
+}
+
+static int write_log(const log_index_t *cap, u32 sector_size, u32 n_sectors,
+                     u32 words, u32 cut_every, FILE *out)
+{
+  flash_log_region_t region;
+  flash_log_ops_t ops = { &flash_emu_erase, &flash_emu_program, &emu };
+  flash_log_reader_t r;
+  u64 *frames = NULL, off = 0;
+  u32 n = 0, cap_n = 0, cuts = 0, records = 0, errors = 0, j = 0, first = 0;
+  const u8 *frame;
+  sbp_frame_t f;
+  u16 len, crc;
+  u8 ret;
+  u32 s;
+
+  if (flash_emu_init(&emu, sector_size, n_sectors) != 0) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  emu.cut_after = cut_every;
+  region.mem = emu.mem;
+  region.sector_size = sector_size;
+  region.n_sectors = n_sectors;
+  if (flash_log_open(&flash_log, &region, &ops) != 0 && !emu.cut) {
+    fprintf(stderr, "can't start the log\n");
+    return 1;
+  }
+
+  while ((ret = sbp_frame_next(cap->data, cap->size, off, &f)) !=
+         SBP_FRAME_END) {
+    off = f.end;
+    if (ret != SBP_FRAME_OK)
+      continue;
+    if (n == cap_n) {
+      cap_n = cap_n ? cap_n * 2 : 1024;
+      frames = realloc(frames, cap_n * sizeof(*frames));
+      if (frames == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+    frames[n++] = f.offset;
+    crc = cap->data[f.end - 2] | (u16)cap->data[f.end - 1] << 8;
+    flash_log_frame(&flash_log, f.msg_type, f.sender, f.len, f.payload, crc);
+    poll(&region, &ops, words, cut_every, &cuts);
+  }
+  while (flash_log_pending(&flash_log))
+    poll(&region, &ops, words, cut_every, &cuts);
+
+  if (fwrite(emu.mem, 1, (size_t)sector_size * n_sectors, out) !=
+      (size_t)sector_size * n_sectors) {
+    perror("write");
+    return 1;
+  }
+
+  /* Each record must be the next frame logged, or a later one. */
+  flash_log_read_init(&r);
+  while (flash_log_read_next(&region, &r, &frame, &len)) {
+    while (j < n && (sbp_frame_at(cap->data, cap->size, frames[j], &f),
+                     f.end - f.offset != len ||
+                     memcmp(cap->data + f.offset, frame, len) != 0))
+      j++;
+    if (j == n) {
+      if (errors++ < 10)
+        fprintf(stderr, "record %u isn't the next frame of the capture\n",
+                records);
+      j = 0;
+      continue;
+    }
+    if (records++ == 0)
+      first = j;
+    j++;
+  }
+
+  describe(&region);
+  fprintf(stderr, "Frames\t\t: %u, %u dropped by staging\n", n,
+          flash_log.dropped);
+  fprintf(stderr, "Records\t\t: %u, frames %u to %u of the capture\n",
+          records, first, j ? j - 1 : 0);
+  fprintf(stderr, "Flash\t\t: %u erases, %u errors, %u violations, "
+          "%u power cuts\n", flash_log.erases, flash_log.errors,
+          emu.violations, cuts);
+  fprintf(stderr, "Erases/sector\t:");
+  for (s = 0; s < n_sectors; s++)
+    fprintf(stderr, " %u", emu.erases[s]);
+  fprintf(stderr, "\n");
+  if (!cut_every && records && j != n)
+    errors++;
+  if (errors)
+    fprintf(stderr, "%u errors\n", errors);
+  free(frames);
+  flash_emu_free(&emu);
+  return errors != 0 || emu.violations != 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out_path = NULL;
+  u32 sector_size = FLASH_LOG_SECTOR_SIZE, n_sectors = FLASH_LOG_N_SECTORS;
+  u32 words = FLASH_LOG_POLL_WORDS, cut_every = 0;
+  log_index_t cap;
+  FILE *out = stdout;
+  int opt, do_dump = 0, ret;
+
+  while ((opt = getopt(argc, argv, "dz:n:p:c:o:")) != -1) {
+    switch (opt) {
+    case 'd':
+      do_dump = 1;
+      break;
+    case 'z':
+      sector_size = strtoul(optarg, NULL, 0);
+      if (sector_size < 1024 || sector_size % 4)
+        goto usage;
+      break;
+    case 'n':
+      n_sectors = strtoul(optarg, NULL, 0);
+      if (n_sectors < 2)
+        goto usage;
+      break;
+    case 'p':
+      words = strtoul(optarg, NULL, 0);
+      if (words == 0)
+        goto usage;
+      break;
+    case 'c':
+      cut_every = strtoul(optarg, NULL, 0);
+      if (cut_every && cut_every < 8)
+        goto usage;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1 || (!do_dump && out_path == NULL))
+    goto usage;
+
+  if (out_path && (out = fopen(out_path, "wb")) == NULL) {
+    perror(out_path);
+    return 1;
+  }
+  if (do_dump) {
+    ret = dump(argv[optind], sector_size, out);
+  } else {
+    if (log_open(&cap, argv[optind]) != 0) {
+      perror(argv[optind]);
+      return 1;
+    }
+    ret = write_log(&cap, sector_size, n_sectors, words, cut_every, out);
+    log_close(&cap);
+  }
+  if (out != stdout && fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  return ret;
+
+usage:
+  fprintf(stderr, "usage: %s -d [-z size] [-o out.sbp] image.bin\n"
+          "       %s [-z size] [-n sectors] [-p words] [-c n] -o image.bin "
+          "capture.sbp\n", argv[0], argv[0]);
+  return 1;
+}
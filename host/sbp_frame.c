@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <libsbp/sbp.h>
+
+#include "sbp_frame.h"
+#include "sbp_simd.h"
+
+/*
+ * Decode the frame whose preamble is at offset, which must be in the buffer.
+ * Returns SBP_FRAME_OK or SBP_FRAME_CRC_ERROR with f filled in, or
+ * SBP_FRAME_END if the buffer ends before the frame does (f->offset and
+ * f->end are still set, f->end past the end of the buffer).
+ */
+u8 sbp_frame_at(const u8 *buf, u64 size, u64 offset, sbp_frame_t *f)
+{
+  const u8 *p = buf + offset;
+  u16 crc;
+
+  f->offset = offset;
+  if (size - offset < SBP_FRAME_HEADER) {
+    f->end = offset + SBP_FRAME_OVERHEAD;
+    return SBP_FRAME_END;
+  }
+  f->msg_type = p[1] | (p[2] << 8);
+  f->sender = p[3] | (p[4] << 8);
+  f->len = p[5];
+  f->payload = p + SBP_FRAME_HEADER;
+  f->end = offset + SBP_FRAME_OVERHEAD + f->len;
+  if (f->end > size)
+    return SBP_FRAME_END;
+
+  /* The CRC covers everything between the preamble and the CRC itself. */
+  crc = sbp_crc16(p + 1, SBP_FRAME_HEADER - 1 + f->len, 0);
+  if ((p[SBP_FRAME_HEADER + f->len] | (p[SBP_FRAME_HEADER + f->len + 1] << 8))
+      != crc)
+    return SBP_FRAME_CRC_ERROR;
+  return SBP_FRAME_OK;
+}
+
+/*
+ * Find the next frame that starts at or after pos. To continue scanning,
+ * call again with pos set to f->end, whatever the result was.
+ * Returns SBP_FRAME_OK or SBP_FRAME_CRC_ERROR with f filled in, or
+ * SBP_FRAME_END if there are no more complete frames.
+ */
+u8 sbp_frame_next(const u8 *buf, u64 size, u64 pos, sbp_frame_t *f)
+{
+  const u8 *p;
+
+  if (pos >= size) {
+    f->offset = f->end = size;
+    return SBP_FRAME_END;
+  }
+  p = sbp_find_preamble(buf + pos, buf + size);
+  if (p == buf + size) {
+    f->offset = f->end = size;
+    return SBP_FRAME_END;
+  }
+  return sbp_frame_at(buf, size, p - buf, f);
+}
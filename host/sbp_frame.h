@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * sbp_frame finds SBP frames in a buffer that holds the whole capture (e.g.
+ * a memory mapped file), for the host tools that work on captures rather
+ * than streams. It accepts and rejects exactly the frames sbp_process would
+ * when fed the same bytes: a preamble starts a frame, and a frame with a bad
+ * CRC is skipped as a whole.
+ */
+
+#ifndef SBP_TUTORIAL_SBP_FRAME_H
+#define SBP_TUTORIAL_SBP_FRAME_H
+
+#include <libsbp/common.h>
+
+/* Preamble, message type, sender, length and CRC. */
+#define SBP_FRAME_OVERHEAD 8
+#define SBP_FRAME_HEADER   6
+
+/* Results of sbp_frame_next. */
+#define SBP_FRAME_OK        0 /* A frame with a good CRC. */
+#define SBP_FRAME_CRC_ERROR 1 /* A frame with a bad CRC. */
+#define SBP_FRAME_END       2 /* No complete frame before the end of buffer. */
+
+typedef struct {
+  u64 offset;        /* Offset of the preamble. */
+  u64 end;           /* Offset just past the CRC. */
+  u16 msg_type;
+  u16 sender;
+  u8 len;
+  const u8 *payload;
+} sbp_frame_t;
+
+u8 sbp_frame_next(const u8 *buf, u64 size, u64 pos, sbp_frame_t *f);
+u8 sbp_frame_at(const u8 *buf, u64 size, u64 offset, sbp_frame_t *f);
+
+#endif /* SBP_TUTORIAL_SBP_FRAME_H */
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Fuzz target for the receive path. Each input is fed byte by byte through
+ * the simulated USART1 interrupt into the FIFO, and parsed by the receiver,
+ * exactly as sbp_host does. The first byte of the input isn't part of the
+ * stream, it sets how many bytes arrive between main loop passes, so the
+ * fuzzer also explores how frames are split across calls to sbp_process.
+ *
+ * Every message the receiver stores is also formatted, as the status report,
+ * NMEA sentences and telemetry, so values from frames with a good CRC but
+ * nonsense contents (a latitude of 1e300, INT32_MIN) reach that code too.
+ *
+ * Besides crashes (caught by the sanitizers), an input fails if a byte is
+ * lost between the UART and the parser, if the parser stops consuming bytes
+ * while the FIFO holds some, or if the report overruns STATUS_MAX_LEN.
+ *
+ * Built with SBP_FUZZ_LIBFUZZER defined, this is a libFuzzer target.
+ * Otherwise it has its own main, which runs inputs from files (or stdin, for
+ * AFL) and reports throughput:
+ *
+ * Usage: sbp_fuzz_driver [-n runs] [-g dir] [file | dir ...]
+ *   -n n    run each input n times (default 1)
+ *   -g dir  write a seed corpus of valid and damaged frames to dir and exit
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsbp/sbp.h>
+#include <libsbp/navigation.h>
+
+#include <fifo.h>
+#include <receiver.h>
+#include <status.h>
+#include <nmea.h>
+#include <telemetry.h>
+
+#include "host_board.h"
+
+static fifo_t rx_fifo;
+static receiver_t receiver;
+static nmea_t nmea;
+static telemetry_t telemetry;
+
+/* sbp_process may take a pass without reading anything when it changes
+ * state (e.g. past the payload of a zero length frame), but never several in
+ * a row. */
+#define MAX_IDLE_PASSES 2
+
+static u32 idle_passes;
+
+static void fail(const char *why, size_t pos)
+{
+  fprintf(stderr, "sbp_fuzz: %s at byte %zu\n", why, pos);
+  abort();
+}
+
+/* Format the solution each time a message is stored in it. */
+static void receiver_hook(receiver_t *r, u16 msg_type, void *context)
+{
+  char str[STATUS_MAX_LEN + 1];
+
+  (void)context;
+  if (status_format(str, &r->sol) > STATUS_MAX_LEN)
+    fail("status report longer than STATUS_MAX_LEN", rx_fifo.bytes_read);
+  nmea_message(&nmea, &r->sol, msg_type);
+  telemetry_message(&telemetry, r, msg_type);
+}
+
+/* One main loop pass. The parser must make progress if there's input. */
+static void process(size_t pos)
+{
+  u32 bytes_read = rx_fifo.bytes_read;
+  u8 was_empty = fifo_empty(&rx_fifo);
+
+  receiver_process(&receiver);
+  if (was_empty || rx_fifo.bytes_read != bytes_read)
+    idle_passes = 0;
+  else if (++idle_passes > MAX_IDLE_PASSES)
+    fail("parser stopped consuming from a non-empty FIFO", pos);
+}
+
+static void run_input(const u8 *data, size_t size)
+{
+  size_t i, stride, since = 0;
+
+  if (size == 0)
+    return;
+  stride = (size_t)data[0] + 1;
+  data++;
+  size--;
+
+  idle_passes = 0;
+  fifo_init(&rx_fifo);
+  usarts_setup(&rx_fifo);
+  receiver_setup(&receiver, &rx_fifo);
+  receiver_set_hook(&receiver, &receiver_hook, NULL);
+  nmea_init(&nmea);
+  telemetry_init(&telemetry);
+
+  for (i = 0; i < size; i++) {
+    while (fifo_full(&rx_fifo))
+      process(i);
+    if (!usart1_rx(data[i]))
+      fail("byte dropped by the UART", i);
+    if (++since == stride) {
+      process(i);
+      since = 0;
+    }
+  }
+  while (!fifo_empty(&rx_fifo))
+    process(size);
+  receiver_process(&receiver);
+
+  if (rx_fifo.bytes_read != size)
+    fail("bytes written and read differ", size);
+}
+
+#ifdef SBP_FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+  run_input(data, size);
+  return 0;
+}
+
+#else
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_INPUT_SIZE (1 << 20)
+
+static u8 input[MAX_INPUT_SIZE];
+static u32 runs = 1;
+static u64 total_execs, total_bytes, total_ns;
+static double slowest_ns_per_byte;
+static char slowest[1024];
+
+static u64 now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (u64)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void run_file(const char *path, FILE *f)
+{
+  size_t size;
+  u64 start, ns;
+  u32 i;
+
+  size = fread(input, 1, sizeof(input), f);
+  start = now_ns();
+  for (i = 0; i < runs; i++)
+    run_input(input, size);
+  ns = now_ns() - start;
+
+  total_execs += runs;
+  total_bytes += (u64)size * runs;
+  total_ns += ns;
+  /* Track the input the parser spends the longest on per byte, as a pointer
+   * to slow paths such as long resynchronisation loops. */
+  if (size > 1 && (double)ns / runs / size > slowest_ns_per_byte) {
+    slowest_ns_per_byte = (double)ns / runs / size;
+    snprintf(slowest, sizeof(slowest), "%s", path);
+  }
+}
+
+static void run_path(const char *path)
+{
+  char child[1024];
+  struct dirent *e;
+  struct stat st;
+  FILE *f;
+  DIR *d;
+
+  if (stat(path, &st) != 0) {
+    perror(path);
+    exit(1);
+  }
+  if (S_ISDIR(st.st_mode)) {
+    d = opendir(path);
+    while ((e = readdir(d)) != NULL) {
+      if (e->d_name[0] == '.')
+        continue;
+      snprintf(child, sizeof(child), "%s/%s", path, e->d_name);
+      run_path(child);
+    }
+    closedir(d);
+    return;
+  }
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  run_file(path, f);
+  fclose(f);
+}
+
+/* Seed corpus generation. Frames are built with sbp_send_message. */
+
+typedef struct {
+  u8 buf[4096];
+  u32 len;
+} seed_t;
+
+static u32 seed_write(u8 *buff, u32 n, void *context)
+{
+  seed_t *s = context;
+
+  if (n > sizeof(s->buf) - s->len)
+    return 0;
+  memcpy(s->buf + s->len, buff, n);
+  s->len += n;
+  return n;
+}
+
+static void seed_frame(seed_t *s, u16 msg_type, u8 len, void *payload)
+{
+  sbp_state_t state;
+
+  sbp_state_init(&state);
+  sbp_state_set_io_context(&state, s);
+  sbp_send_message(&state, msg_type, SBP_SENDER_ID, len, payload, &seed_write);
+}
+
+static void seed_save(const char *dir, const char *name, seed_t *s)
+{
+  char path[1024];
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  f = fopen(path, "wb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fwrite(s->buf, 1, s->len, f);
+  fclose(f);
+  s->len = 1; /* Keep the stride byte. */
+}
+
+static void write_seeds(const char *dir)
+{
+  static const struct {
+    const char *name;
+    u16 msg_type;
+    u8 len;
+  } msgs[] = {
+    { "gps_time", SBP_MSG_GPS_TIME, sizeof(msg_gps_time_t) },
+    { "pos_llh", SBP_MSG_POS_LLH, sizeof(msg_pos_llh_t) },
+    { "baseline_ned", SBP_MSG_BASELINE_NED, sizeof(msg_baseline_ned_t) },
+    { "vel_ned", SBP_MSG_VEL_NED, sizeof(msg_vel_ned_t) },
+    { "dops", SBP_MSG_DOPS, sizeof(msg_dops_t) },
+  };
+  u8 payload[255];
+  char name[64];
+  seed_t s;
+  u32 i;
+
+  mkdir(dir, 0755);
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = (u8)(i * 37 + 11);
+
+  s.buf[0] = 0xFF; /* Only parse when the FIFO fills. */
+  s.len = 1;
+
+  /* Each message on its own, full length and one byte short. */
+  for (i = 0; i < sizeof(msgs) / sizeof(msgs[0]); i++) {
+    seed_frame(&s, msgs[i].msg_type, msgs[i].len, payload);
+    snprintf(name, sizeof(name), "%s", msgs[i].name);
+    seed_save(dir, name, &s);
+    seed_frame(&s, msgs[i].msg_type, msgs[i].len - 1, payload);
+    snprintf(name, sizeof(name), "%s_short", msgs[i].name);
+    seed_save(dir, name, &s);
+  }
+
+  /* A whole epoch, parsed a byte at a time. */
+  s.buf[0] = 0;
+  for (i = 0; i < sizeof(msgs) / sizeof(msgs[0]); i++)
+    seed_frame(&s, msgs[i].msg_type, msgs[i].len, payload);
+  seed_save(dir, "epoch", &s);
+  s.buf[0] = 0xFF;
+
+  /* Largest payload, of a message the receiver doesn't handle. */
+  seed_frame(&s, 0x0049, sizeof(payload), payload);
+  seed_save(dir, "max_length", &s);
+
+  /* Truncated frame followed by a good one. */
+  seed_frame(&s, SBP_MSG_POS_LLH, sizeof(msg_pos_llh_t), payload);
+  s.len -= 10;
+  seed_frame(&s, SBP_MSG_GPS_TIME, sizeof(msg_gps_time_t), payload);
+  seed_save(dir, "truncated", &s);
+
+  /* Bad CRC followed by a good frame. */
+  seed_frame(&s, SBP_MSG_VEL_NED, sizeof(msg_vel_ned_t), payload);
+  s.buf[s.len - 1] ^= 0xFF;
+  seed_frame(&s, SBP_MSG_VEL_NED, sizeof(msg_vel_ned_t), payload);
+  seed_save(dir, "bad_crc", &s);
+
+  /* An epoch with good CRCs and values no receiver would send. */
+  {
+    msg_gps_time_t t = { 0xFFFF, 0xFFFFFFFF, -1, 0 };
+    msg_pos_llh_t pos = { 0xFFFFFFFF, 1e300, -1e300, -1e300, 0xFFFF, 0xFFFF,
+                          0xFF, 0xFF };
+    msg_baseline_ned_t b = { 0xFFFFFFFF, INT32_MIN, INT32_MIN, INT32_MIN,
+                             0xFFFF, 0xFFFF, 0xFF, 0xFF };
+    msg_vel_ned_t v = { 0xFFFFFFFF, INT32_MIN, INT32_MIN, INT32_MIN, 0xFFFF,
+                        0xFFFF, 0xFF, 0xFF };
+    msg_dops_t d = { 0xFFFFFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF };
+
+    seed_frame(&s, SBP_MSG_GPS_TIME, sizeof(t), &t);
+    seed_frame(&s, SBP_MSG_POS_LLH, sizeof(pos), &pos);
+    seed_frame(&s, SBP_MSG_BASELINE_NED, sizeof(b), &b);
+    seed_frame(&s, SBP_MSG_VEL_NED, sizeof(v), &v);
+    seed_frame(&s, SBP_MSG_DOPS, sizeof(d), &d);
+    seed_frame(&s, SBP_MSG_POS_LLH, sizeof(pos), &pos);
+    seed_save(dir, "extreme", &s);
+  }
+
+  /* Line noise full of preambles before a good frame. */
+  for (i = 0; i < 64; i++)
+    s.buf[s.len++] = (i % 3) ? 0x55 : (u8)i;
+  seed_frame(&s, SBP_MSG_DOPS, sizeof(msg_dops_t), payload);
+  seed_save(dir, "noise", &s);
+}
+
+int main(int argc, char *argv[])
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:g:")) != -1) {
+    switch (opt) {
+    case 'n':
+      runs = strtoul(optarg, NULL, 0);
+      break;
+    case 'g':
+      write_seeds(optarg);
+      return 0;
+    default:
+      fprintf(stderr, "usage: %s [-n runs] [-g dir] [file | dir ...]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind == argc)
+    run_file("<stdin>", stdin);
+  for (; optind < argc; optind++)
+    run_path(argv[optind]);
+
+  if (total_ns) {
+    fprintf(stderr, "Execs\t\t: %llu\n", (unsigned long long)total_execs);
+    fprintf(stderr, "Execs/s\t\t: %.0f\n", total_execs * 1e9 / total_ns);
+    fprintf(stderr, "MB/s\t\t: %.2f\n", total_bytes * 1e3 / total_ns);
+    if (slowest[0])
+      fprintf(stderr, "Slowest input\t: %s (%.1f ns/byte)\n",
+              slowest, slowest_ns_per_byte);
+  }
+  return 0;
+}
+
+#endif /* SBP_FUZZ_LIBFUZZER */
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Runs the positions in a raw SBP capture past a set of geofences (see
+ * geofence.h), and writes each enter and exit event as CSV: time of week
+ * (ms), fence id and "enter" or "exit".
+ *
+ * Usage: sbp_geofence -f fences.txt [-r lat,lon,height] capture.sbp
+ *        sbp_geofence -B n
+ *   -f file  fences, one per line, latitude and longitude in degrees:
+ *              circle <id> <lat> <lon> <radius m>
+ *              polygon <id> <lat>,<lon> <lat>,<lon> <lat>,<lon> ...
+ *            Blank lines and lines starting with # are skipped.
+ *   -r       reference point (default: the first point in the fence file)
+ *   -B n     time the test against n random fences, and check it against
+ *            testing every fence
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include <geofence.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define LINE_MAX_LEN  8192
+#define BENCH_POSITIONS 1000000
+#define M_PER_DEG     111320.0
+
+static geofence_t fences;
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void print_event(geofence_t *g, u16 id, u8 event, u32 tow,
+                        void *context)
+{
+  (void)g;
+  fprintf(context, "%u,%u,%s\n", tow, id,
+          event == GEOFENCE_ENTER ? "enter" : "exit");
+}
+
+/*
+ * Add the fences in path. With ref NULL, the reference is the first point
+ * in the file. Returns -1 on a malformed line or too many fences.
+ */
+static int load_fences(const char *path, const double *ref)
+{
+  static double ll[GEOFENCE_MAX_VERTICES][2];
+  char line[LINE_MAX_LEN], kind[16], *p;
+  double lat, lon, radius;
+  u32 line_no = 0;
+  u16 n;
+  int id, used;
+  u8 ref_set = 0;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  if (ref) {
+    geofence_init(&fences, ref[0], ref[1], ref[2]);
+    ref_set = 1;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    line_no++;
+    if (sscanf(line, "%15s %d%n", kind, &id, &used) != 2 || kind[0] == '#')
+      continue;
+    p = line + used;
+    if (strcmp(kind, "circle") == 0) {
+      if (sscanf(p, "%lf %lf %lf", &lat, &lon, &radius) != 3)
+        goto bad;
+      if (!ref_set) {
+        geofence_init(&fences, lat, lon, 0);
+        ref_set = 1;
+      }
+      if (geofence_add_circle(&fences, id, lat, lon, radius) != 0)
+        goto full;
+    } else if (strcmp(kind, "polygon") == 0) {
+      for (n = 0; n < GEOFENCE_MAX_VERTICES &&
+           sscanf(p, " %lf,%lf%n", &ll[n][0], &ll[n][1], &used) == 2; n++)
+        p += used;
+      if (n < 3)
+        goto bad;
+      if (!ref_set) {
+        geofence_init(&fences, ll[0][0], ll[0][1], 0);
+        ref_set = 1;
+      }
+      if (geofence_add_polygon(&fences, id, ll, n) != 0)
+        goto full;
+    } else {
+      goto bad;
+    }
+  }
+  fclose(f);
+  if (geofence_compile(&fences) != 0) {
+    fprintf(stderr, "%s: too many grid entries, raise "
+            "GEOFENCE_MAX_ENTRIES\n", path);
+    return -1;
+  }
+  return 0;
+
+bad:
+  fprintf(stderr, "%s:%u: can't parse fence\n", path, line_no);
+  fclose(f);
+  return -1;
+full:
+  fprintf(stderr, "%s:%u: too many fences or vertices\n", path, line_no);
+  fclose(f);
+  return -1;
+}
+
+static u32 run_capture(const log_index_t *cap)
+{
+  solution_t sol;
+  sbp_frame_t f;
+  u64 off = 0;
+  u32 n = 0;
+  u8 ret;
+
+  while ((ret = sbp_frame_next(cap->data, cap->size, off, &f)) !=
+         SBP_FRAME_END) {
+    off = f.end;
+    if (ret != SBP_FRAME_OK || f.msg_type != SBP_MSG_POS_LLH ||
+        f.len < sizeof(sol.pos_llh))
+      continue;
+    memcpy(&sol.pos_llh, f.payload, sizeof(sol.pos_llh));
+    geofence_message(&fences, &sol, f.msg_type);
+    n++;
+  }
+  return n;
+}
+
+/* Uniform in [-1, 1). */
+static double uniform(void)
+{
+  return drand48() * 2 - 1;
+}
+
+/* Whether fence i contains p, testing it directly. */
+static u8 brute_contains(u16 i, const geofence_point_t *p)
+{
+  const geofence_fence_t *f = &fences.fences[i];
+  const geofence_point_t *v = &fences.vertices[f->first];
+  float de, dn;
+  u16 k, j;
+  u8 in = 0;
+
+  if (f->type == GEOFENCE_CIRCLE) {
+    de = p->e - f->centre.e;
+    dn = p->n - f->centre.n;
+    return de * de + dn * dn <= f->radius2;
+  }
+  for (k = 0, j = f->n - 1; k < f->n; j = k++)
+    if ((v[k].n > p->n) != (v[j].n > p->n) &&
+        p->e < (v[j].e - v[k].e) * (p->n - v[k].n) / (v[j].n - v[k].n) +
+               v[k].e)
+      in = !in;
+  return in;
+}
+
+/*
+ * n fences scattered over 10 km: circles of 20 to 200 m, and octagons of
+ * about the same size. Positions are a random walk through them.
+ */
+static int benchmark(u32 n)
+{
+  static const double ref[3] = { 37.7749, -122.4194, 10 };
+  static geofence_point_t pos[BENCH_POSITIONS];
+  double ll[8][2], lat, lon, r, t, cos_lat = cos(ref[0] * M_PI / 180);
+  u32 i, k, events = 0, mismatches = 0;
+  u16 j;
+
+  srand48(1);
+  geofence_init(&fences, ref[0], ref[1], ref[2]);
+  for (i = 0; i < n; i++) {
+    lat = ref[0] + uniform() * 5000 / M_PER_DEG;
+    lon = ref[1] + uniform() * 5000 / (M_PER_DEG * cos_lat);
+    r = 20 + drand48() * 180;
+    if (i % 2 == 0) {
+      if (geofence_add_circle(&fences, i, lat, lon, r) != 0)
+        break;
+      continue;
+    }
+    for (k = 0; k < 8; k++) {
+      t = k * M_PI / 4;
+      ll[k][0] = lat + r * (0.7 + 0.3 * drand48()) * sin(t) / M_PER_DEG;
+      ll[k][1] = lon + r * (0.7 + 0.3 * drand48()) * cos(t) /
+                 (M_PER_DEG * cos_lat);
+    }
+    if (geofence_add_polygon(&fences, i, ll, 8) != 0)
+      break;
+  }
+  if (geofence_compile(&fences) != 0) {
+    fprintf(stderr, "too many grid entries for %u fences\n", n);
+    return 1;
+  }
+
+  pos[0].e = pos[0].n = 0;
+  for (i = 1; i < BENCH_POSITIONS; i++) {
+    pos[i].e = fmaxf(-5500, fminf(5500, pos[i - 1].e + uniform() * 20));
+    pos[i].n = fmaxf(-5500, fminf(5500, pos[i - 1].n + uniform() * 20));
+  }
+
+  /* Check the inside set after every step against testing every fence. */
+  for (i = 0; i < BENCH_POSITIONS / 10; i++) {
+    geofence_test(&fences, &pos[i], i);
+    for (j = 0; j < fences.n_fences; j++)
+      if (fences.fences[j].inside != brute_contains(j, &pos[i]))
+        mismatches++;
+  }
+
+  geofence_compile(&fences);
+  t = now_s();
+  for (i = 0; i < BENCH_POSITIONS; i++)
+    events += geofence_test(&fences, &pos[i], i);
+  t = now_s() - t;
+
+  printf("Fences\t\t: %u (%u vertices)\n", fences.n_fences,
+         fences.n_vertices);
+  printf("Grid entries\t: %u\n",
+         fences.cell_start[GEOFENCE_GRID * GEOFENCE_GRID]);
+  printf("Positions\t: %u\n", BENCH_POSITIONS);
+  printf("Events\t\t: %u\n", events);
+  printf("ns/position\t: %.1f\n", t * 1e9 / BENCH_POSITIONS);
+  printf("Mismatches\t: %u\n", mismatches);
+  return mismatches != 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *fence_path = NULL;
+  double ref_llh[3], *ref = NULL;
+  log_index_t cap;
+  int opt;
+  u32 n;
+
+  while ((opt = getopt(argc, argv, "f:r:B:")) != -1) {
+    switch (opt) {
+    case 'f':
+      fence_path = optarg;
+      break;
+    case 'r':
+      if (sscanf(optarg, "%lf,%lf,%lf", &ref_llh[0], &ref_llh[1],
+                 &ref_llh[2]) != 3)
+        goto usage;
+      ref = ref_llh;
+      break;
+    case 'B':
+      return benchmark(strtoul(optarg, NULL, 0));
+    default:
+      goto usage;
+    }
+  }
+  if (fence_path == NULL || optind != argc - 1)
+    goto usage;
+
+  if (load_fences(fence_path, ref) != 0)
+    return 1;
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  geofence_set_hook(&fences, &print_event, stdout);
+  printf("tow,id,event\n");
+  n = run_capture(&cap);
+  fprintf(stderr, "%u positions, %u fences\n", n, fences.n_fences);
+  log_close(&cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s -f fences.txt [-r lat,lon,height] capture.sbp\n"
+          "       %s -B n\n", argv[0], argv[0]);
+  return 1;
+}
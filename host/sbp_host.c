@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Host equivalent of main.c: raw SBP bytes from a file (or stdin) are fed
+ * through the simulated USART1 interrupt into the FIFO, and the main loop
+ * parses them with the same receiver and status code the board uses.
+ *
+ * Usage: sbp_host [-p n] [-d kv|ansi] [-m name] [capture.sbp]
+ *   -p n     print the status report every n frames (default: only at the end)
+ *   -d mode  print only the fields that changed since the last print, as
+ *            key=value lines or as in place updates to the report on a
+ *            terminal (see status_diff_format), and how many bytes that took
+ *            against the whole report each time
+ *   -m name  publish the solution in the shared memory segment name after
+ *            every message, for sbp_shm_read and other local consumers
+ *
+ * Positions are smoothed with nav_filter as main.c does, and the filtered
+ * state is published and printed at the end along with the solution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fifo.h>
+#include <nav_filter.h>
+#include <receiver.h>
+#include <status.h>
+
+#include "host_board.h"
+#include "sbp_shm.h"
+
+fifo_t rx_fifo;
+receiver_t receiver;
+nav_filter_t nav_filter;
+sbp_shm_t shm;
+u8 shm_enabled;
+status_diff_t status_diff;
+u8 diff_enabled;
+u64 diff_bytes, full_bytes;
+
+static void print_status(void)
+{
+  char str[STATUS_DIFF_MAX_LEN];
+  int len;
+
+  full_bytes += status_format(str, &receiver.sol);
+  if (diff_enabled) {
+    len = status_diff_format(&status_diff, str, &receiver.sol);
+    if (len == 0)
+      return;
+    diff_bytes += len;
+  }
+  SH_SendString(str);
+}
+
+static void publish(u8 open)
+{
+  static sbp_shm_data_t d;
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  d.time_ns = t.tv_sec * 1000000000ULL + t.tv_nsec;
+  d.publishes++;
+  d.bytes = rx_fifo.bytes_read;
+  d.frames = receiver.n_frames;
+  d.crc_errors = receiver.n_crc_errors;
+  d.short_frames = receiver.n_short_frames;
+  d.open = open;
+  d.sol = receiver.sol;
+  nav_filter_snapshot(&nav_filter, &d.nav);
+  sbp_shm_publish(&shm, 0, &d);
+}
+
+static void receiver_hook(receiver_t *r, u16 msg_type, void *context)
+{
+  (void)context;
+  nav_filter_message(&nav_filter, &r->sol, msg_type);
+  if (shm_enabled)
+    publish(1);
+}
+
+static void print_filter(void)
+{
+  nav_state_t s;
+
+  nav_filter_snapshot(&nav_filter, &s);
+  if (!s.valid)
+    return;
+  printf("Filtered (ENU from %.7f, %.7f, %.2f):\n", s.ref_lat, s.ref_lon,
+         s.ref_height);
+  printf("\tPosition (m)\t: %10.3f %10.3f %10.3f\n", s.pos[0], s.pos[1],
+         s.pos[2]);
+  printf("\tSigma (m)\t: %10.3f %10.3f %10.3f\n", s.pos_sigma[0],
+         s.pos_sigma[1], s.pos_sigma[2]);
+  printf("\tVelocity (m/s)\t: %10.3f %10.3f %10.3f\n", s.vel[0], s.vel[1],
+         s.vel[2]);
+  printf("\tUpdates\t\t: %u, %u restarts\n\n", s.updates, s.resets);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *shm_name = NULL;
+  FILE *in = stdin;
+  u32 print_every = 0;
+  u32 last_print = 0;
+  u8 buf[4096];
+  size_t n, i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:d:m:")) != -1) {
+    switch (opt) {
+    case 'p':
+      print_every = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      if (strcmp(optarg, "kv") == 0)
+        status_diff_init(&status_diff, STATUS_DIFF_KV);
+      else if (strcmp(optarg, "ansi") == 0)
+        status_diff_init(&status_diff, STATUS_DIFF_ANSI);
+      else
+        goto usage;
+      diff_enabled = 1;
+      break;
+    case 'm':
+      shm_name = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind < argc) {
+    in = fopen(argv[optind], "rb");
+    if (in == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+
+  timebase_setup();
+  cycle_counter_setup();
+  leds_setup();
+  fifo_init(&rx_fifo);
+  usarts_setup(&rx_fifo);
+  receiver_setup(&receiver, &rx_fifo);
+  nav_filter_init(&nav_filter);
+  receiver_set_hook(&receiver, &receiver_hook, NULL);
+  if (shm_name) {
+    if (sbp_shm_create(&shm, shm_name, 1) != 0) {
+      perror(shm_name);
+      return 1;
+    }
+    sbp_shm_set_name(&shm, 0, optind < argc ? argv[optind] : "stdin");
+    shm_enabled = 1;
+  }
+
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    for (i = 0; i < n; i++) {
+      /* Run the main loop whenever the FIFO fills, so nothing is dropped. */
+      while (fifo_full(&rx_fifo))
+        receiver_process(&receiver);
+      usart1_rx(buf[i]);
+
+      if (print_every && receiver.n_frames - last_print >= print_every) {
+        last_print = receiver.n_frames;
+        print_status();
+      }
+    }
+  }
+  /* Drain whatever is left; the parser may need several calls per frame. */
+  while (!fifo_empty(&rx_fifo))
+    receiver_process(&receiver);
+  receiver_process(&receiver);
+
+  print_status();
+  print_filter();
+  printf("Frames\t\t: %u\n", receiver.n_frames);
+  printf("CRC errors\t: %u\n", receiver.n_crc_errors);
+  printf("Short frames\t: %u\n", receiver.n_short_frames);
+  printf("Bytes\t\t: %u\n", rx_fifo.bytes_read);
+  if (diff_enabled)
+    printf("Status\t\t: %llu bytes for %u fields in %u prints, "
+           "%llu as whole reports\n", (unsigned long long)diff_bytes,
+           status_diff.sent, status_diff.renders,
+           (unsigned long long)full_bytes);
+
+  if (shm_name) {
+    publish(0);
+    sbp_shm_destroy(&shm);
+  }
+  if (in != stdin)
+    fclose(in);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-p n] [-d kv|ansi] [-m name] [capture.sbp]\n",
+          argv[0]);
+  return 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Random access to raw SBP captures through a side index, see log_index.h.
+ * The index is kept in <capture>.idx and rebuilt when the capture changes.
+ *
+ * Usage: sbp_index [-r] [-k frame] [-m type] [-w week] [-t start:end]
+ *                  [-o out.sbp] [-B] capture.sbp
+ *   -r           rebuild the index even if the saved one is current
+ *   -k n         print frame n (counting good frames from 0)
+ *   -m type      only frames of this message type, e.g. 0x0201
+ *   -w week      only frames in this GPS week
+ *   -t start:end only frames with a time of week from start to end seconds
+ *   -o file      write the matching frames to file instead of listing them
+ *   -B           benchmark building the index and querying it
+ *
+ * With none of -k, -m, -w or -t, prints a summary of the capture.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/sbp.h>
+#include <libsbp/navigation.h>
+
+#include "log_index.h"
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void print_frame(const log_index_t *ix, u32 k, void *context)
+{
+  const log_epoch_t *e = &ix->epochs[ix->frames[k].epoch];
+  FILE *out = context;
+  sbp_frame_t f;
+  u32 i;
+
+  if (!log_frame(ix, k, &f))
+    return;
+  if (out) {
+    fwrite(ix->data + f.offset, 1, f.end - f.offset, out);
+    return;
+  }
+  printf("%10u %12llu 0x%04X 0x%04X %3u ", k, (unsigned long long)f.offset,
+         f.msg_type, f.sender, f.len);
+  if (e->flags & LOG_EPOCH_NO_TIME)
+    printf("%4s %10s ", "-", "-");
+  else if (e->wn == LOG_WN_UNKNOWN)
+    printf("%4s %10.3f ", "-", e->tow / 1000.0);
+  else
+    printf("%4u %10.3f ", e->wn, e->tow / 1000.0);
+  for (i = 0; i < f.len && i < 16; i++)
+    printf("%02x", f.payload[i]);
+  printf("%s\n", f.len > 16 ? "..." : "");
+}
+
+static void print_header(void)
+{
+  printf("%10s %12s %6s %6s %3s %4s %10s %s\n",
+         "frame", "offset", "type", "sender", "len", "week", "tow (s)",
+         "payload");
+}
+
+static void print_summary(const log_index_t *ix)
+{
+  const log_epoch_t *first = NULL, *last = NULL;
+  u32 i;
+
+  for (i = 0; i < ix->n_epochs; i++) {
+    if (ix->epochs[i].flags & LOG_EPOCH_NO_TIME)
+      continue;
+    if (!first)
+      first = &ix->epochs[i];
+    last = &ix->epochs[i];
+  }
+  printf("Capture bytes\t: %llu\n", (unsigned long long)ix->size);
+  printf("Frames\t\t: %u\n", ix->n_frames);
+  printf("CRC errors\t: %u\n", ix->n_crc_errors);
+  printf("Epochs\t\t: %u%s\n", ix->n_epochs,
+         ix->monotonic ? "" : " (not in time order)");
+  if (first) {
+    printf("First epoch\t: week %d, tow %.3f s\n",
+           first->wn == LOG_WN_UNKNOWN ? -1 : first->wn, first->tow / 1000.0);
+    printf("Last epoch\t: week %d, tow %.3f s\n",
+           last->wn == LOG_WN_UNKNOWN ? -1 : last->wn, last->tow / 1000.0);
+  }
+  printf("Index bytes\t: %llu\n",
+         (unsigned long long)((u64)ix->n_frames * sizeof(log_frame_t) +
+                              (u64)ix->n_epochs * sizeof(log_epoch_t)));
+}
+
+/* Byte-wise reference scan, what finding a time range costs without an
+ * index: run the whole capture through sbp_process. */
+typedef struct {
+  const u8 *data;
+  u64 size;
+  u64 pos;
+  u32 tow_start, tow_end;
+  u32 matches;
+} linear_scan_t;
+
+static u32 linear_read(u8 *buff, u32 n, void *context)
+{
+  linear_scan_t *l = context;
+
+  if (n > l->size - l->pos)
+    n = l->size - l->pos;
+  memcpy(buff, l->data + l->pos, n);
+  l->pos += n;
+  return n;
+}
+
+static void linear_pos_llh(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  linear_scan_t *l = context;
+  msg_pos_llh_t *pos = (msg_pos_llh_t *)msg;
+
+  (void)sender_id;
+  if (len >= sizeof(*pos) && pos->tow >= l->tow_start && pos->tow <= l->tow_end)
+    l->matches++;
+}
+
+static u32 linear_query(const log_index_t *ix, u32 tow_start, u32 tow_end)
+{
+  static sbp_state_t s;
+  static sbp_msg_callbacks_node_t node;
+  linear_scan_t l = { ix->data, ix->size, 0, tow_start, tow_end, 0 };
+
+  sbp_state_init(&s);
+  sbp_state_set_io_context(&s, &l);
+  sbp_register_callback(&s, SBP_MSG_POS_LLH, &linear_pos_llh, &l, &node);
+  while (l.pos < l.size)
+    sbp_process(&s, &linear_read);
+  sbp_process(&s, &linear_read);
+  return l.matches;
+}
+
+static u32 rand_state = 2463534242U;
+
+static u32 xorshift(void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static void benchmark(log_index_t *ix)
+{
+  const u32 n_lookups = 1000000, n_queries = 10000;
+  double t, best = 1e30, lookup_s, query_s, linear_s;
+  u32 i, k, matches = 0, linear_matches;
+  const log_epoch_t *e;
+  sbp_frame_t f;
+  u64 sum = 0;
+
+  for (i = 0; i < 3; i++) {
+    t = now_s();
+    if (log_index_build(ix) != 0) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    t = now_s() - t;
+    if (t < best)
+      best = t;
+  }
+  printf("Index build\t: %.1f ms, %.1f MB/s, %.2f M frames/s\n", best * 1e3,
+         ix->size / best / 1e6, ix->n_frames / best / 1e6);
+  if (ix->n_frames == 0 || ix->n_epochs == 0)
+    return;
+
+  t = now_s();
+  for (i = 0; i < n_lookups; i++) {
+    k = xorshift() % ix->n_frames;
+    if (log_frame(ix, k, &f))
+      sum += f.len;
+  }
+  lookup_s = now_s() - t;
+  printf("Frame lookup\t: %.0f ns (checksum %llu)\n",
+         lookup_s / n_lookups * 1e9, (unsigned long long)sum);
+
+  /* Random one second windows of MSG_POS_LLH. */
+  t = now_s();
+  for (i = 0; i < n_queries; i++) {
+    e = &ix->epochs[xorshift() % ix->n_epochs];
+    matches += log_query(ix, SBP_MSG_POS_LLH, e->wn, e->tow, e->tow + 999,
+                         NULL, NULL);
+  }
+  query_s = now_s() - t;
+  printf("Range query\t: %.2f us, %.1f frames per query\n",
+         query_s / n_queries * 1e6, (double)matches / n_queries);
+
+  e = &ix->epochs[ix->n_epochs / 2];
+  t = now_s();
+  linear_matches = linear_query(ix, e->tow, e->tow + 999);
+  linear_s = now_s() - t;
+  matches = log_query(ix, SBP_MSG_POS_LLH, LOG_WN_UNKNOWN, e->tow,
+                      e->tow + 999, NULL, NULL);
+  printf("Linear scan\t: %.1f ms for the same query (%u vs %u frames)\n",
+         linear_s * 1e3, linear_matches, matches);
+}
+
+int main(int argc, char *argv[])
+{
+  char idx_path[4096];
+  log_index_t ix;
+  u8 rebuild = 0, bench = 0, query = 0;
+  u16 msg_type = LOG_ANY_TYPE, wn = LOG_WN_UNKNOWN;
+  u32 tow_start = 0, tow_end = 0xFFFFFFFF;
+  double start, end, t;
+  const char *out_path = NULL;
+  FILE *out = NULL;
+  long frame = -1;
+  u32 n;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "rk:m:w:t:o:B")) != -1) {
+    switch (opt) {
+    case 'r':
+      rebuild = 1;
+      break;
+    case 'k':
+      frame = strtol(optarg, NULL, 0);
+      break;
+    case 'm':
+      msg_type = strtoul(optarg, NULL, 0);
+      query = 1;
+      break;
+    case 'w':
+      wn = strtoul(optarg, NULL, 0);
+      query = 1;
+      break;
+    case 't':
+      if (sscanf(optarg, "%lf:%lf", &start, &end) != 2 || start < 0 ||
+          end < start)
+        goto usage;
+      tow_start = (u32)(start * 1000 + 0.5);
+      tow_end = (u32)(end * 1000 + 0.5);
+      query = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'B':
+      bench = 1;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1)
+    goto usage;
+
+  if (log_open(&ix, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (bench) {
+    benchmark(&ix);
+    log_close(&ix);
+    return 0;
+  }
+
+  snprintf(idx_path, sizeof(idx_path), "%s.idx", argv[optind]);
+  t = now_s();
+  if (rebuild || log_index_load(&ix, idx_path) != 0) {
+    if (log_index_build(&ix) != 0) {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+    t = now_s() - t;
+    if (log_index_save(&ix, idx_path) != 0)
+      perror(idx_path);
+    fprintf(stderr, "Built %s in %.1f ms (%.1f MB/s)\n", idx_path, t * 1e3,
+            t > 0 ? ix.size / t / 1e6 : 0.0);
+  }
+
+  if (out_path) {
+    out = fopen(out_path, "wb");
+    if (out == NULL) {
+      perror(out_path);
+      return 1;
+    }
+  }
+
+  if (frame >= 0) {
+    if (frame >= ix.n_frames) {
+      fprintf(stderr, "no frame %ld, the capture has %u\n", frame,
+              ix.n_frames);
+      return 1;
+    }
+    if (!out)
+      print_header();
+    print_frame(&ix, frame, out);
+  } else if (query) {
+    if (!out)
+      print_header();
+    n = log_query(&ix, msg_type, wn, tow_start, tow_end, &print_frame, out);
+    fprintf(stderr, "%u frames\n", n);
+  } else {
+    print_summary(&ix);
+  }
+
+  if (out)
+    fclose(out);
+  log_close(&ix);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-r] [-k frame] [-m type] [-w week] "
+          "[-t start:end] [-o out.sbp] [-B] capture.sbp\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Converts a raw SBP capture to NMEA with nmea.c, and checks the sentences
+ * with an independent parser.
+ *
+ * Usage: sbp_nmea [-c] [-o out.nmea] capture.sbp
+ *        sbp_nmea -t | -B
+ *   -c       parse every sentence written and compare it with the SBP
+ *            messages it came from, worked out in double with the C library
+ *   -o file  write to file instead of stdout
+ *   -t       check random epochs all over the globe and across week
+ *            boundaries; `make test` runs this
+ *   -B       as -t, then time nmea_epoch
+ *
+ * The checks cover the framing (length, checksum, CR LF), the number of
+ * fields, and every value against the source to within the resolution of
+ * its field. Times and dates are checked against gmtime.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include <nmea.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define MAX_FIELDS      24
+#define BENCH_EPOCHS    1000000
+#define CHECK_EPOCHS    200000
+/* Unix time of the start of GPS time, 1980-01-06. */
+#define GPS_EPOCH_UNIX  315964800
+
+static nmea_t nmea;
+static u32 errors;
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void fail(const char *sentence, const char *what)
+{
+  if (errors++ < 10)
+    fprintf(stderr, "%s: %.*s\n", what, (int)strcspn(sentence, "\r\n"),
+            sentence);
+}
+
+/* Fields of one sentence, split at the commas, without the checksum. */
+typedef struct {
+  char text[NMEA_MAX_SENTENCE + 1];
+  char *f[MAX_FIELDS];
+  int n;
+} sentence_t;
+
+/*
+ * Check the framing of the sentence at s and split it. Returns its length
+ * including "\r\n", or 0 if it is malformed.
+ */
+static int split(const char *s, const char *end, sentence_t *out)
+{
+  const char *eol = memchr(s, '\n', end - s), *star, *p;
+  unsigned cs_given;
+  u8 cs = 0;
+  int len;
+
+  if (eol == NULL || s[0] != '$')
+    return 0;
+  len = eol + 1 - s;
+  if (len > NMEA_MAX_SENTENCE || eol[-1] != '\r')
+    return 0;
+  star = eol - 4;
+  if (star <= s || *star != '*' || sscanf(star + 1, "%2X", &cs_given) != 1)
+    return 0;
+  for (p = s + 1; p < star; p++)
+    cs ^= *p;
+  if (cs != cs_given)
+    return 0;
+
+  memcpy(out->text, s + 1, star - s - 1);
+  out->text[star - s - 1] = 0;
+  out->n = 0;
+  for (p = out->text; out->n < MAX_FIELDS;) {
+    out->f[out->n++] = (char *)p;
+    p = strchr(p, ',');
+    if (p == NULL)
+      break;
+    *(char *)p++ = 0;
+  }
+  return len;
+}
+
+/* (d)ddmm.mmmmm and a hemisphere back to signed degrees. */
+static double parse_angle(const char *v, const char *hemi)
+{
+  double x = strtod(v, NULL);
+  double deg = floor(x / 100) + fmod(x, 100) / 60;
+
+  return (*hemi == 'S' || *hemi == 'W') ? -deg : deg;
+}
+
+static u8 near(double a, double b, double tol)
+{
+  return fabs(a - b) <= tol;
+}
+
+/* Reference UTC time and date strings for a GPS time. */
+static void utc(u16 wn, u32 tow, char *hms, char *dmy)
+{
+  s64 ms = (s64)wn * 604800000 + tow - NMEA_LEAP_SECONDS * 1000LL;
+  time_t t = GPS_EPOCH_UNIX + ms / 1000;
+  struct tm tm;
+
+  gmtime_r(&t, &tm);
+  sprintf(hms, "%02d%02d%02d.%02d", tm.tm_hour, tm.tm_min, tm.tm_sec,
+          (int)(ms % 1000 / 10));
+  strftime(dmy, 8, "%d%m%y", &tm);
+}
+
+/* Check the sentences of one epoch against the solution they came from.
+ * Returns the number of sentences. */
+static u32 check_epoch(const char *buf, u16 len, const solution_t *sol)
+{
+  const msg_pos_llh_t *pos = &sol->pos_llh;
+  const msg_vel_ned_t *vel = &sol->vel_ned;
+  const char *p = buf, *end = buf + len;
+  double speed = hypot(vel->n, vel->e) * 1e-3, course, knots, kmh;
+  double lat_tol = 0.5e-5 / 60 + 1e-12, alt;
+  char hms[16], dmy[8];
+  sentence_t s;
+  u8 fix = pos->n_sats > 0, mode = pos->flags & 7;
+  const char *quality = !fix ? "0" : mode == 1 ? "4" : mode == 2 ? "5" : "1";
+  const char *faa = !fix ? "N" : mode == 1 || mode == 2 ? "D" : "A";
+  u32 n = 0;
+  int l;
+
+  course = atan2(vel->e, vel->n) * 180 / M_PI;
+  if (course < 0)
+    course += 360;
+  knots = fmin(speed * 3600 / 1852, 99999.99);
+  kmh = fmin(speed * 3.6, 99999.99);
+  alt = fmax(-99999.999, fmin(99999.999, pos->height));
+  utc(sol->gps_time.wn, pos->tow, hms, dmy);
+
+  while (p < end) {
+    if ((l = split(p, end, &s)) == 0) {
+      fail(p, "bad framing or checksum");
+      return n;
+    }
+    n++;
+    if (strcmp(s.f[0], "GPGGA") == 0) {
+      if (s.n != 15)
+        fail(p, "GGA field count");
+      else if (strcmp(s.f[1], hms) != 0)
+        fail(p, "GGA time");
+      else if (!near(parse_angle(s.f[2], s.f[3]), pos->lat, lat_tol) ||
+               !near(parse_angle(s.f[4], s.f[5]), pos->lon, lat_tol))
+        fail(p, "GGA position");
+      else if (strcmp(s.f[6], quality) != 0 || atoi(s.f[7]) != pos->n_sats)
+        fail(p, "GGA quality or satellites");
+      else if (!near(strtod(s.f[8], NULL), sol->dops.hdop / 100.0, 1e-9) ||
+               !near(strtod(s.f[9], NULL), alt, 0.0005 + 1e-9))
+        fail(p, "GGA HDOP or altitude");
+    } else if (strcmp(s.f[0], "GPRMC") == 0) {
+      if (s.n != 13)
+        fail(p, "RMC field count");
+      else if (strcmp(s.f[1], hms) != 0 || strcmp(s.f[9], dmy) != 0)
+        fail(p, "RMC time or date");
+      else if (strcmp(s.f[2], fix ? "A" : "V") != 0 ||
+               strcmp(s.f[12], faa) != 0)
+        fail(p, "RMC status or mode");
+      else if (!near(parse_angle(s.f[3], s.f[4]), pos->lat, lat_tol) ||
+               !near(parse_angle(s.f[5], s.f[6]), pos->lon, lat_tol))
+        fail(p, "RMC position");
+      else if (!near(strtod(s.f[7], NULL), knots, 0.005 + knots * 1e-6))
+        fail(p, "RMC speed");
+      else if (speed > 0.01 &&
+               fabs(remainder(strtod(s.f[8], NULL) - course, 360)) > 0.051)
+        fail(p, "RMC course");
+    } else if (strcmp(s.f[0], "GPVTG") == 0) {
+      if (s.n != 10)
+        fail(p, "VTG field count");
+      else if (!near(strtod(s.f[5], NULL), knots, 0.005 + knots * 1e-6) ||
+               !near(strtod(s.f[7], NULL), kmh, 0.005 + kmh * 1e-6))
+        fail(p, "VTG speed");
+      else if (speed > 0.01 &&
+               fabs(remainder(strtod(s.f[1], NULL) - course, 360)) > 0.051)
+        fail(p, "VTG course");
+    } else if (strcmp(s.f[0], "GPGSA") == 0) {
+      if (s.n != 18)
+        fail(p, "GSA field count");
+      else if (!near(strtod(s.f[15], NULL), sol->dops.pdop / 100.0, 1e-9) ||
+               !near(strtod(s.f[16], NULL), sol->dops.hdop / 100.0, 1e-9) ||
+               !near(strtod(s.f[17], NULL), sol->dops.vdop / 100.0, 1e-9))
+        fail(p, "GSA DOPs");
+    } else {
+      fail(p, "unknown sentence");
+    }
+    p += l;
+  }
+  return n;
+}
+
+/* Store a frame's payload in sol as the receiver would. Returns 0 for
+ * messages nmea doesn't use and frames too short for their type. */
+static u8 store(solution_t *sol, const sbp_frame_t *f)
+{
+  void *dst;
+  u32 size;
+
+  switch (f->msg_type) {
+  case SBP_MSG_GPS_TIME:
+    dst = &sol->gps_time;
+    size = sizeof(sol->gps_time);
+    break;
+  case SBP_MSG_POS_LLH:
+    dst = &sol->pos_llh;
+    size = sizeof(sol->pos_llh);
+    break;
+  case SBP_MSG_VEL_NED:
+    dst = &sol->vel_ned;
+    size = sizeof(sol->vel_ned);
+    break;
+  case SBP_MSG_DOPS:
+    dst = &sol->dops;
+    size = sizeof(sol->dops);
+    break;
+  default:
+    return 0;
+  }
+  if (f->len < size)
+    return 0;
+  memcpy(dst, f->payload, size);
+  return 1;
+}
+
+/* Uniform in [-1, 1). */
+static double uniform(void)
+{
+  return drand48() * 2 - 1;
+}
+
+static void random_epoch(solution_t *sol)
+{
+  sol->gps_time.wn = 1000 + lrand48() % 2000;
+  /* Near the start and end of the week half the time. */
+  sol->pos_llh.tow = lrand48() % 2 ? lrand48() % 604800000 :
+                     (lrand48() % 40000 + 604780000) % 604800000;
+  sol->pos_llh.lat = uniform() * 90;
+  sol->pos_llh.lon = uniform() * 180;
+  sol->pos_llh.height = uniform() * (lrand48() % 2 ? 200 : 200000);
+  sol->pos_llh.n_sats = lrand48() % 13;
+  sol->pos_llh.flags = lrand48() % 3;
+  sol->vel_ned.tow = sol->pos_llh.tow;
+  sol->vel_ned.n = uniform() * (lrand48() % 2 ? 2000 : 2e9);
+  sol->vel_ned.e = uniform() * (lrand48() % 2 ? 2000 : 2e9);
+  sol->vel_ned.d = uniform() * 1000;
+  sol->dops.pdop = lrand48() % 65536;
+  sol->dops.hdop = lrand48() % 65536;
+  sol->dops.vdop = lrand48() % 65536;
+}
+
+/* Check random epochs. Returns non-zero if any sentence was wrong. */
+static int check_random(void)
+{
+  solution_t sol;
+  u32 i, sentences = 0;
+  u16 len;
+
+  memset(&sol, 0, sizeof(sol));
+  srand48(1);
+  for (i = 0; i < CHECK_EPOCHS; i++) {
+    random_epoch(&sol);
+    len = nmea_epoch(&nmea, &sol);
+    sentences += check_epoch(nmea.buf, len, &sol);
+  }
+  printf("Random epochs\t: %u (%u sentences), %u errors\n", CHECK_EPOCHS,
+         sentences, errors);
+  return errors != 0;
+}
+
+static int benchmark(void)
+{
+  static solution_t sols[1024];
+  double t;
+  u32 i;
+
+  check_random();
+  for (i = 0; i < 1024; i++) {
+    memset(&sols[i], 0, sizeof(sols[i]));
+    random_epoch(&sols[i]);
+  }
+  t = now_s();
+  for (i = 0; i < BENCH_EPOCHS; i++)
+    nmea_epoch(&nmea, &sols[i & 1023]);
+  printf("ns/epoch\t: %.1f\n", (now_s() - t) * 1e9 / BENCH_EPOCHS);
+  return errors != 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out_path = NULL;
+  u32 epochs = 0, sentences = 0;
+  solution_t sol;
+  log_index_t cap;
+  sbp_frame_t f;
+  FILE *out = stdout;
+  u8 check = 0, ret;
+  u64 off = 0;
+  u16 len;
+  int opt;
+
+  nmea_init(&nmea);
+  while ((opt = getopt(argc, argv, "co:tB")) != -1) {
+    switch (opt) {
+    case 'c':
+      check = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 't':
+      return check_random();
+    case 'B':
+      return benchmark();
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1)
+    goto usage;
+
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (out_path && (out = fopen(out_path, "w")) == NULL) {
+    perror(out_path);
+    return 1;
+  }
+
+  memset(&sol, 0, sizeof(sol));
+  while ((ret = sbp_frame_next(cap.data, cap.size, off, &f)) !=
+         SBP_FRAME_END) {
+    off = f.end;
+    if (ret != SBP_FRAME_OK || !store(&sol, &f))
+      continue;
+    len = nmea_message(&nmea, &sol, f.msg_type);
+    if (len == 0)
+      continue;
+    fwrite(nmea.buf, 1, len, out);
+    epochs++;
+    if (check)
+      sentences += check_epoch(nmea.buf, len, &sol);
+  }
+  if (out != stdout && fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  fprintf(stderr, "%u epochs\n", epochs);
+  if (check)
+    fprintf(stderr, "%u sentences checked, %u errors\n", sentences, errors);
+  log_close(&cap);
+  return errors != 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-c] [-o out.nmea] capture.sbp\n"
+          "       %s -t | -B\n", argv[0], argv[0]);
+  return 1;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Load generator for sbp_daemon. Creates a number of ptys, prints the path of
+ * each one, then streams a capture into all of them at a given baud rate as
+ * if a Piksi was on each port. The ptys are closed at the end, which the
+ * daemon sees as the ports going away.
+ *
+ * Usage: sbp_pty_feed [-n ports] [-B baud] [-l loops] [-d seconds] capture.sbp
+ *   -n n  number of ptys (default 4)
+ *   -B n  baud rate to pace each pty at, 10 bits per byte (default 1000000)
+ *   -l n  stream the capture n times (default 1)
+ *   -d n  wait n seconds after printing the paths before streaming, to give
+ *         the daemon time to open them (default 1)
+ *
+ * Example:
+ *   ./sbp_pty_feed -n 32 capture.sbp > ports &
+ *   sleep 0.5; ./sbp_daemon -x $(cat ports)
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/common.h>
+
+#define MAX_PTYS 128
+
+typedef struct {
+  int master;
+  int slave;     /* Held open so the pty stays raw until the daemon opens it. */
+  u64 sent;      /* Bytes of the stream written or dropped so far. */
+  u64 dropped;   /* Bytes the daemon didn't read in time. */
+} pty_t;
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int pty_open(pty_t *p)
+{
+  struct termios tio;
+  char *name;
+
+  p->master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (p->master < 0 || grantpt(p->master) || unlockpt(p->master))
+    return -1;
+  name = ptsname(p->master);
+  p->slave = open(name, O_RDWR | O_NOCTTY);
+  if (p->slave < 0)
+    return -1;
+  /* No line discipline processing on the way through. */
+  tcgetattr(p->slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(p->slave, TCSANOW, &tio);
+  fcntl(p->master, F_SETFL, O_NONBLOCK);
+  p->sent = 0;
+  p->dropped = 0;
+  printf("%s\n", name);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  static pty_t ptys[MAX_PTYS];
+  u32 n_ptys = 4, baud = 1000000, loops = 1, i;
+  double delay = 1, start, elapsed;
+  u64 total, due, n, off;
+  ssize_t w;
+  u8 *cap;
+  long len;
+  FILE *f;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:B:l:d:")) != -1) {
+    switch (opt) {
+    case 'n':
+      n_ptys = strtoul(optarg, NULL, 0);
+      break;
+    case 'B':
+      baud = strtoul(optarg, NULL, 0);
+      break;
+    case 'l':
+      loops = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      delay = strtod(optarg, NULL);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1 || n_ptys == 0 || n_ptys > MAX_PTYS || baud == 0)
+    goto usage;
+
+  f = fopen(argv[optind], "rb");
+  if (f == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  len = ftell(f);
+  rewind(f);
+  cap = malloc(len > 0 ? len : 1);
+  if (len <= 0 || fread(cap, 1, len, f) != (size_t)len) {
+    fprintf(stderr, "%s: empty or unreadable\n", argv[optind]);
+    return 1;
+  }
+  fclose(f);
+
+  for (i = 0; i < n_ptys; i++) {
+    if (pty_open(&ptys[i]) != 0) {
+      perror("pty");
+      return 1;
+    }
+  }
+  fflush(stdout);
+  usleep((useconds_t)(delay * 1e6));
+
+  /* Every millisecond, top each pty up to where the baud rate says it
+   * should be. A write the daemon hasn't made room for counts as dropped,
+   * like an overrun on a real UART. */
+  total = (u64)len * loops;
+  start = now_s();
+  do {
+    elapsed = now_s() - start;
+    due = (u64)(elapsed * baud / 10);
+    if (due > total)
+      due = total;
+    for (i = 0; i < n_ptys; i++) {
+      while (ptys[i].sent < due) {
+        off = ptys[i].sent % len;
+        n = due - ptys[i].sent;
+        if (n > (u64)len - off)
+          n = len - off;
+        w = write(ptys[i].master, cap + off, n);
+        if (w < 0 && errno == EAGAIN) {
+          ptys[i].dropped += n;
+          ptys[i].sent += n;
+          continue;
+        }
+        if (w <= 0) {
+          perror("write");
+          return 1;
+        }
+        ptys[i].sent += w;
+      }
+    }
+    usleep(1000);
+  } while (due < total);
+
+  /* Let the daemon drain what's buffered before hanging up. */
+  usleep(200000);
+  for (i = 0; i < n_ptys; i++) {
+    if (ptys[i].dropped)
+      fprintf(stderr, "pty %u: %llu of %llu bytes dropped\n", i,
+              (unsigned long long)ptys[i].dropped,
+              (unsigned long long)ptys[i].sent);
+    close(ptys[i].slave);
+    close(ptys[i].master);
+  }
+  fprintf(stderr, "Streamed %llu bytes to each of %u ptys in %.2f s\n",
+          (unsigned long long)total, n_ptys, now_s() - start);
+  free(cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-n ports] [-B baud] [-l loops] [-d seconds] "
+          "capture.sbp\n", argv[0]);
+  return 1;
+}
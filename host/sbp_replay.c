@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Replay a raw SBP capture through the simulated USART1 interrupt with the
+ * timing of a real UART, against a main loop with a configurable cost model,
+ * to see whether the FIFO keeps up.
+ *
+ * Time is simulated: bytes arrive one every 10 bit times at the chosen baud
+ * rate, and each pass of the main loop (one receiver_process call, as in
+ * main.c) advances the clock by
+ *
+ *   loop cost + bytes consumed * byte cost [+ print cost every n loops]
+ *
+ * Bytes that arrived while the main loop was busy are then delivered through
+ * the interrupt, and dropped if the FIFO is full - just like on the board.
+ * With -x the replay is also paced against the wall clock.
+ *
+ * The upsampler (see upsampler.h) runs alongside, ticked every
+ * UPSAMPLER_PERIOD_MS of simulated time as the SysTick interrupt does on the
+ * board, and its residuals are reported at the end.
+ *
+ * Usage: sbp_replay [options] capture.sbp
+ *   -B baud   UART baud rate (default 115200)
+ *   -l ns     main loop cost per pass (default 2000)
+ *   -b ns     parse cost per byte consumed (default 1000)
+ *   -n loops  passes between status prints (default 10000, 0 for none)
+ *   -P ns     cost of a status print (default 50000000)
+ *   -x speed  pace against the wall clock at speed times real time
+ *             (default 0, as fast as possible)
+ *   -v        print the status report at each simulated status print
+ *   -u file   write each upsampled position to file as CSV: time of week
+ *             (ms), age (ms), stale, east, north and up (m)
+ *   -N        upsample MSG_BASELINE_NED rather than MSG_POS_LLH
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fifo.h>
+#include <receiver.h>
+#include <status.h>
+#include <upsampler.h>
+
+#include "host_board.h"
+
+#define NS_PER_S 1000000000ULL
+
+fifo_t rx_fifo;
+receiver_t receiver;
+upsampler_t upsampler;
+/* Simulated time, for the receiver hook. */
+static u64 now_ns;
+
+typedef struct {
+  u32 baud;
+  u64 loop_ns;
+  u64 byte_ns;
+  u32 print_every;
+  u64 print_ns;
+  double speed;
+  u8 verbose;
+  const char *upsample_path;
+  u8 upsample_source;
+} replay_config_t;
+
+static u8 *load_file(const char *path, size_t *len)
+{
+  FILE *f = fopen(path, "rb");
+  u8 *buf;
+  long size;
+
+  if (f == NULL)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = malloc(size > 0 ? size : 1);
+  if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+    free(buf);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  *len = size;
+  return buf;
+}
+
+/* Count the good frames in the capture when nothing is dropped. */
+static u32 count_frames(const u8 *cap, size_t len)
+{
+  static fifo_t fifo;
+  static receiver_t r;
+  size_t i;
+
+  fifo_init(&fifo);
+  receiver_setup(&r, &fifo);
+  for (i = 0; i < len; i++) {
+    while (fifo_full(&fifo))
+      receiver_process(&r);
+    fifo_write(&fifo, cap[i]);
+  }
+  while (!fifo_empty(&fifo))
+    receiver_process(&r);
+  receiver_process(&r);
+  return r.n_frames;
+}
+
+static void receiver_hook(receiver_t *r, u16 msg_type, void *context)
+{
+  (void)context;
+  upsampler_message(&upsampler, &r->sol, msg_type, now_ns / 1000000);
+}
+
+static void upsample_hook(upsampler_t *u, const upsample_t *out,
+                          void *context)
+{
+  FILE *f = context;
+
+  (void)u;
+  fprintf(f, "%u,%u,%u,%.4f,%.4f,%.4f\n", out->tow, out->age_ms, out->stale,
+          out->pos[0], out->pos[1], out->pos[2]);
+}
+
+/* Sleep until the wall clock catches up with simulated time. */
+static void pace(const struct timespec *start, u64 sim_ns, double speed)
+{
+  struct timespec now, ts;
+  u64 target_ns = (u64)(sim_ns / speed);
+  u64 elapsed_ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed_ns = (u64)(now.tv_sec - start->tv_sec) * NS_PER_S +
+               now.tv_nsec - start->tv_nsec;
+  if (elapsed_ns >= target_ns)
+    return;
+  ts.tv_sec = (target_ns - elapsed_ns) / NS_PER_S;
+  ts.tv_nsec = (target_ns - elapsed_ns) % NS_PER_S;
+  nanosleep(&ts, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+  replay_config_t cfg = {
+    .baud = 115200,
+    .loop_ns = 2000,
+    .byte_ns = 1000,
+    .print_every = 10000,
+    .print_ns = 50000000,
+    .speed = 0,
+    .verbose = 0,
+    .upsample_path = NULL,
+    .upsample_source = UPSAMPLER_POS_LLH,
+  };
+  struct timespec start;
+  char str[STATUS_MAX_LEN];
+  FILE *upsample_out = NULL;
+  u8 *cap;
+  size_t len, pos = 0;
+  u64 byte_period_ns, loops = 0, prints = 0, tick_ns = 0;
+  u64 tick_cost_ns = 0, tick_cost_max = 0, ticks = 0;
+  u32 tick_start, tick_cost;
+  u32 bytes_before, total_frames;
+  u16 fifo_peak = 0, count;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "B:l:b:n:P:x:vu:N")) != -1) {
+    switch (opt) {
+    case 'B': cfg.baud = strtoul(optarg, NULL, 0); break;
+    case 'l': cfg.loop_ns = strtoull(optarg, NULL, 0); break;
+    case 'b': cfg.byte_ns = strtoull(optarg, NULL, 0); break;
+    case 'n': cfg.print_every = strtoul(optarg, NULL, 0); break;
+    case 'P': cfg.print_ns = strtoull(optarg, NULL, 0); break;
+    case 'x': cfg.speed = strtod(optarg, NULL); break;
+    case 'v': cfg.verbose = 1; break;
+    case 'u': cfg.upsample_path = optarg; break;
+    case 'N': cfg.upsample_source = UPSAMPLER_BASELINE_NED; break;
+    default:
+      fprintf(stderr, "usage: %s [-B baud] [-l ns] [-b ns] [-n loops] "
+                      "[-P ns] [-x speed] [-v] [-u out.csv] [-N] "
+                      "capture.sbp\n", argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || cfg.baud == 0) {
+    fprintf(stderr, "usage: %s [options] capture.sbp\n", argv[0]);
+    return 1;
+  }
+  cap = load_file(argv[optind], &len);
+  if (cap == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  if (cfg.upsample_path) {
+    upsample_out = fopen(cfg.upsample_path, "w");
+    if (upsample_out == NULL) {
+      perror(cfg.upsample_path);
+      return 1;
+    }
+    fprintf(upsample_out, "tow,age_ms,stale,e,n,u\n");
+  }
+
+  total_frames = count_frames(cap, len);
+
+  /* 8N1: a start bit, 8 data bits and a stop bit per byte. */
+  byte_period_ns = 10 * NS_PER_S / cfg.baud;
+
+  fifo_init(&rx_fifo);
+  usarts_setup(&rx_fifo);
+  receiver_setup(&receiver, &rx_fifo);
+  receiver_set_hook(&receiver, &receiver_hook, NULL);
+  upsampler_init(&upsampler, cfg.upsample_source);
+  if (upsample_out)
+    upsampler_set_hook(&upsampler, &upsample_hook, upsample_out);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (pos < len || !fifo_empty(&rx_fifo)) {
+    /* Timebase interrupts due while the main loop was busy. */
+    while (tick_ns <= now_ns) {
+      tick_start = cycle_count();
+      upsampler_tick(&upsampler, tick_ns / 1000000);
+      tick_cost = cycle_count() - tick_start;
+      tick_cost_ns += tick_cost;
+      if (tick_cost > tick_cost_max)
+        tick_cost_max = tick_cost;
+      ticks++;
+      tick_ns += UPSAMPLER_PERIOD_MS * 1000000ULL;
+    }
+
+    /* Deliver everything that arrived while the main loop was busy. */
+    while (pos < len && (pos + 1) * byte_period_ns <= now_ns)
+      usart1_rx(cap[pos++]);
+    count = fifo_count(&rx_fifo);
+    if (count > fifo_peak)
+      fifo_peak = count;
+
+    /* Nothing to do: idle until the next byte arrives. */
+    if (fifo_empty(&rx_fifo)) {
+      now_ns = (pos + 1) * byte_period_ns;
+      continue;
+    }
+
+    /* One pass of the main loop. */
+    bytes_before = rx_fifo.bytes_read;
+    receiver_process(&receiver);
+    now_ns += cfg.loop_ns + (rx_fifo.bytes_read - bytes_before) * cfg.byte_ns;
+    loops++;
+
+    if (cfg.print_every && loops % cfg.print_every == 0) {
+      now_ns += cfg.print_ns;
+      prints++;
+      if (cfg.verbose) {
+        status_format(str, &receiver.sol);
+        SH_SendString(str);
+      }
+    }
+
+    if (cfg.speed > 0)
+      pace(&start, now_ns, cfg.speed);
+  }
+  /* Let the parser finish the last frame. */
+  receiver_process(&receiver);
+
+  printf("Capture bytes\t\t: %zu\n", len);
+  printf("Baud rate\t\t: %u\n", cfg.baud);
+  printf("Simulated time (s)\t: %.3f\n", (double)now_ns / NS_PER_S);
+  printf("Main loop passes\t: %llu\n", (unsigned long long)loops);
+  printf("Status prints\t\t: %llu\n", (unsigned long long)prints);
+  printf("Frames in capture\t: %u\n", total_frames);
+  printf("Frames decoded\t\t: %u\n", receiver.n_frames);
+  printf("Frames lost\t\t: %d\n", (int)total_frames - (int)receiver.n_frames);
+  printf("CRC errors\t\t: %u\n", receiver.n_crc_errors);
+  printf("Short frames\t\t: %u\n", receiver.n_short_frames);
+  printf("Bytes dropped\t\t: %u\n", usart1_overruns);
+  printf("FIFO peak\t\t: %u / %u\n", fifo_peak, FIFO_LEN - 1);
+  printf("Upsampled fixes\t\t: %u\n", upsampler.n_fixes);
+  printf("Upsampler ticks\t\t: %llu\n", (unsigned long long)ticks);
+  if (ticks)
+    printf("Tick cost (ns)\t\t: %.1f mean, %llu max\n",
+           (double)tick_cost_ns / ticks, (unsigned long long)tick_cost_max);
+  printf("Residual (mm)\t\t: %.1f rms, %.1f max over %u fixes\n",
+         upsampler_residual_rms(&upsampler) * 1000,
+         upsampler.residual_max * 1000, upsampler.n_residuals);
+
+  if (upsample_out && fclose(upsample_out) != 0) {
+    perror(cfg.upsample_path);
+    return 1;
+  }
+
+  free(cap);
+  return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbp_shm.h"
+
+/* Retries before a reader starts yielding, the publisher is only ever in the
+ * middle of a write for the time it takes to copy one sbp_shm_data_t. */
+#define SPIN_RETRIES 100
+
+static u64 segment_size(u32 n_slots)
+{
+  return sizeof(sbp_shm_header_t) + (u64)n_slots * sizeof(sbp_shm_slot_t);
+}
+
+/*
+ * Create (or take over) the segment name with n_slots empty slots and map it.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int sbp_shm_create(sbp_shm_t *shm, const char *name, u32 n_slots)
+{
+  sbp_shm_header_t *h;
+  sbp_shm_data_t empty;
+  void *map;
+  u32 i;
+  int fd;
+
+  memset(shm, 0, sizeof(*shm));
+  fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+    return -1;
+  shm->size = segment_size(n_slots);
+  if (ftruncate(fd, shm->size) != 0) {
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  /* Readers ignore the segment until the magic is back. */
+  h = shm->header = map;
+  __atomic_store_n(&h->magic[0], 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  h->version = SBP_SHM_VERSION;
+  h->header_size = sizeof(sbp_shm_header_t);
+  h->slot_size = sizeof(sbp_shm_slot_t);
+  h->data_size = sizeof(sbp_shm_data_t);
+  h->n_slots = n_slots;
+  h->pid = getpid();
+  shm->slots = (sbp_shm_slot_t *)(h + 1);
+  snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+  /* Start from an even sequence number, and publish empty data through the
+   * seqlock so readers of an old segment see it go back to nothing. */
+  memset(&empty, 0, sizeof(empty));
+  for (i = 0; i < n_slots; i++) {
+    shm->slots[i].seq &= ~1U;
+    memset(shm->slots[i].name, 0, sizeof(shm->slots[i].name));
+    sbp_shm_publish(shm, i, &empty);
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(h->magic, SBP_SHM_MAGIC, sizeof(SBP_SHM_MAGIC));
+  return 0;
+}
+
+/* Label a slot with where its data comes from. */
+void sbp_shm_set_name(sbp_shm_t *shm, u32 slot, const char *name)
+{
+  snprintf(shm->slots[slot].name, sizeof(shm->slots[slot].name), "%s", name);
+}
+
+static long futex(u32 *addr, int op, u32 val, const struct timespec *timeout)
+{
+  return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+/*
+ * Replace a slot's data and wake any readers waiting on it. Only one thread
+ * may publish to a slot at a time.
+ */
+void sbp_shm_publish(sbp_shm_t *shm, u32 slot, const sbp_shm_data_t *data)
+{
+  sbp_shm_slot_t *s = &shm->slots[slot];
+  u32 seq = s->seq;
+
+  __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(&s->data, data, sizeof(*data));
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+
+  __atomic_fetch_add(&s->changes, 1, __ATOMIC_RELEASE);
+  futex(&s->changes, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/* Unmap and remove the segment. Readers keep what they have mapped. */
+void sbp_shm_destroy(sbp_shm_t *shm)
+{
+  if (shm->header == NULL)
+    return;
+  munmap(shm->header, shm->size);
+  shm_unlink(shm->name);
+  memset(shm, 0, sizeof(*shm));
+}
+
+/*
+ * Map the segment name read only. Returns 0 on success, -1 if it doesn't
+ * exist (errno set), isn't initialised yet, or has a layout other than the
+ * one this reader was built with (errno EPROTO).
+ */
+int sbp_shm_open(sbp_shm_t *shm, const char *name)
+{
+  const sbp_shm_header_t *h;
+  struct stat st;
+  void *map;
+  int fd;
+
+  memset(shm, 0, sizeof(*shm));
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  if ((u64)st.st_size < sizeof(sbp_shm_header_t)) {
+    close(fd);
+    errno = EPROTO;
+    return -1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  h = map;
+  if (memcmp(h->magic, SBP_SHM_MAGIC, sizeof(SBP_SHM_MAGIC)) != 0)
+    goto invalid;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (h->version != SBP_SHM_VERSION ||
+      h->header_size != sizeof(sbp_shm_header_t) ||
+      h->slot_size != sizeof(sbp_shm_slot_t) ||
+      h->data_size != sizeof(sbp_shm_data_t) ||
+      (u64)st.st_size < segment_size(h->n_slots))
+    goto invalid;
+  shm->header = map;
+  shm->slots = (sbp_shm_slot_t *)(shm->header + 1);
+  shm->size = st.st_size;
+  snprintf(shm->name, sizeof(shm->name), "%s", name);
+  return 0;
+
+invalid:
+  munmap(map, st.st_size);
+  errno = EPROTO;
+  return -1;
+}
+
+void sbp_shm_close(sbp_shm_t *shm)
+{
+  if (shm->header)
+    munmap(shm->header, shm->size);
+  memset(shm, 0, sizeof(*shm));
+}
+
+/*
+ * Copy a consistent snapshot of a slot's data. Returns the number of times
+ * the copy had to be retried because the publisher was writing.
+ */
+u32 sbp_shm_read(const sbp_shm_t *shm, u32 slot, sbp_shm_data_t *data)
+{
+  const sbp_shm_slot_t *s = &shm->slots[slot];
+  u32 seq, retries;
+
+  for (retries = 0; ; retries++) {
+    if (retries >= SPIN_RETRIES)
+      sched_yield();
+    seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+      continue;
+    memcpy(data, (const void *)&s->data, sizeof(*data));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+      return retries;
+  }
+}
+
+/* Change counter of a slot, to pass to sbp_shm_wait. */
+u32 sbp_shm_changes(const sbp_shm_t *shm, u32 slot)
+{
+  return __atomic_load_n(&shm->slots[slot].changes, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Sleep until a slot's change counter differs from changes, or for at most
+ * timeout_ms (negative to wait indefinitely). Returns 0 if it changed, -1 on
+ * timeout or a signal.
+ */
+int sbp_shm_wait(const sbp_shm_t *shm, u32 slot, u32 changes, int timeout_ms)
+{
+  struct timespec ts, *timeout = NULL;
+  u32 *addr = (u32 *)&shm->slots[slot].changes;
+
+  if (timeout_ms >= 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    timeout = &ts;
+  }
+  if (sbp_shm_changes(shm, slot) == changes)
+    futex(addr, FUTEX_WAIT, changes, timeout);
+  return sbp_shm_changes(shm, slot) != changes ? 0 : -1;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Latest solution in POSIX shared memory, so any number of local processes
+ * can read it without parsing the stream themselves.
+ *
+ * The segment is a header followed by one slot per receiver. A slot holds a
+ * seqlock protected copy of the receiver's solution and statistics: the
+ * publisher makes the sequence number odd, writes the data, and makes it even
+ * again, and a reader copies the data and retries if the sequence number was
+ * odd or changed meanwhile. Readers never block the publisher and map the
+ * segment read only.
+ *
+ * After each publish the slot's change counter is bumped and waiters are
+ * woken with a futex on it, so a reader can sleep until there is something
+ * new instead of polling.
+ *
+ * The header records the layout version and the sizes of a slot and of its
+ * data, and readers refuse a segment that doesn't match what they were built
+ * with.
+ *
+ * Besides the raw solution, a slot carries the smoothed position and
+ * velocity from the publisher's nav_filter (see nav_filter.h).
+ */
+
+#ifndef SBP_TUTORIAL_SBP_SHM_H
+#define SBP_TUTORIAL_SBP_SHM_H
+
+#include <libsbp/common.h>
+
+#include <nav_filter.h>
+#include <receiver.h>
+
+#define SBP_SHM_MAGIC    "SBPSHM"
+#define SBP_SHM_VERSION  2
+#define SBP_SHM_NAME_LEN 64
+/* Default segment name, appears as /dev/shm/sbp. */
+#define SBP_SHM_DEFAULT  "/sbp"
+
+/* What a slot publishes. */
+typedef struct {
+  u64 time_ns;        /* CLOCK_MONOTONIC at the publish. */
+  u64 publishes;      /* Publishes to this slot so far. */
+  u64 bytes;          /* Bytes received. */
+  u32 frames;         /* Frames with a good CRC. */
+  u32 crc_errors;     /* Frames with a bad CRC. */
+  u32 short_frames;   /* Frames too short for their message type. */
+  u32 open;           /* The source is still connected. */
+  solution_t sol;
+  nav_state_t nav;
+} sbp_shm_data_t;
+
+typedef struct {
+  u32 seq;            /* Odd while the data is being written. */
+  u32 changes;        /* Futex word, bumped after each publish. */
+  char name[SBP_SHM_NAME_LEN];   /* Source, e.g. the port. */
+  sbp_shm_data_t data;
+} __attribute__((aligned(64))) sbp_shm_slot_t;
+
+typedef struct {
+  char magic[8];
+  u32 version;
+  u32 header_size;
+  u32 slot_size;
+  u32 data_size;
+  u32 n_slots;
+  u32 pid;            /* Of the publisher. */
+} __attribute__((aligned(64))) sbp_shm_header_t;
+
+typedef struct {
+  sbp_shm_header_t *header;
+  sbp_shm_slot_t *slots;
+  u64 size;
+  char name[SBP_SHM_NAME_LEN];
+} sbp_shm_t;
+
+/* Publisher. */
+int sbp_shm_create(sbp_shm_t *shm, const char *name, u32 n_slots);
+void sbp_shm_set_name(sbp_shm_t *shm, u32 slot, const char *name);
+void sbp_shm_publish(sbp_shm_t *shm, u32 slot, const sbp_shm_data_t *data);
+void sbp_shm_destroy(sbp_shm_t *shm);
+
+/* Readers. */
+int sbp_shm_open(sbp_shm_t *shm, const char *name);
+void sbp_shm_close(sbp_shm_t *shm);
+u32 sbp_shm_read(const sbp_shm_t *shm, u32 slot, sbp_shm_data_t *data);
+u32 sbp_shm_changes(const sbp_shm_t *shm, u32 slot);
+int sbp_shm_wait(const sbp_shm_t *shm, u32 slot, u32 changes, int timeout_ms);
+
+#endif /* SBP_TUTORIAL_SBP_SHM_H */
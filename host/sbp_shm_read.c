@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Reads the latest solution that sbp_host or sbp_daemon publish in shared
+ * memory (see sbp_shm.h), as any local consumer would.
+ *
+ * Usage: sbp_shm_read [-s slot] [-f] [-n count] [name]
+ *        sbp_shm_read -B seconds
+ *   -s n  only slot n (default all slots, or slot 0 with -f)
+ *   -f    follow: sleep until the slot changes and print it each time
+ *   -n n  with -f, stop after n changes
+ *   -B n  benchmark for n seconds: a publisher thread against this reader
+ *         in a private segment, checking every snapshot is consistent
+ *
+ * name is the segment name given to the publisher with -m (default /sbp).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <status.h>
+
+#include "sbp_shm.h"
+
+static u64 now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static void print_slot(const sbp_shm_t *shm, u32 slot, u8 full)
+{
+  char str[STATUS_MAX_LEN];
+  sbp_shm_data_t d;
+
+  sbp_shm_read(shm, slot, &d);
+  printf("%-20.64s %4s %10llu %9u %6u %6u %10u %12.7f %12.7f %8.1f ms\n",
+         shm->slots[slot].name[0] ? shm->slots[slot].name : "-",
+         d.open ? "yes" : "no", (unsigned long long)d.bytes, d.frames,
+         d.crc_errors, d.short_frames, d.sol.gps_time.tow, d.sol.pos_llh.lat,
+         d.sol.pos_llh.lon,
+         d.time_ns ? (now_ns() - d.time_ns) / 1e6 : 0.0);
+  if (full && d.publishes) {
+    status_format(str, &d.sol);
+    fputs(str, stdout);
+  }
+  if (full && d.nav.valid) {
+    printf("Filtered (ENU from %.7f, %.7f, %.2f):\n", d.nav.ref_lat,
+           d.nav.ref_lon, d.nav.ref_height);
+    printf("\tPosition (m)\t: %10.3f %10.3f %10.3f\n", d.nav.pos[0],
+           d.nav.pos[1], d.nav.pos[2]);
+    printf("\tSigma (m)\t: %10.3f %10.3f %10.3f\n", d.nav.pos_sigma[0],
+           d.nav.pos_sigma[1], d.nav.pos_sigma[2]);
+    printf("\tVelocity (m/s)\t: %10.3f %10.3f %10.3f\n\n", d.nav.vel[0],
+           d.nav.vel[1], d.nav.vel[2]);
+  }
+}
+
+static void print_header(void)
+{
+  printf("%-20s %4s %10s %9s %6s %6s %10s %12s %12s %11s\n",
+         "source", "up", "bytes", "frames", "crc", "short", "tow (ms)", "lat",
+         "lon", "age");
+}
+
+/* Benchmark. The publisher stamps every field it can with the publish count,
+ * so a torn snapshot shows up as fields that disagree. */
+
+typedef struct {
+  sbp_shm_t *shm;
+  u64 interval_ns;    /* 0 to publish as fast as possible. */
+  volatile u8 stop;
+  u64 publishes;
+} bench_publisher_t;
+
+static void *bench_publish(void *arg)
+{
+  bench_publisher_t *p = arg;
+  sbp_shm_data_t d;
+  struct timespec ts = { 0, 0 };
+
+  memset(&d, 0, sizeof(d));
+  d.open = 1;
+  while (!p->stop) {
+    d.publishes = ++p->publishes;
+    d.frames = d.publishes;
+    d.sol.gps_time.tow = d.publishes;
+    d.sol.pos_llh.tow = d.publishes;
+    d.sol.pos_llh.lat = d.publishes;
+    d.sol.baseline_ned.tow = d.publishes;
+    d.sol.vel_ned.tow = d.publishes;
+    d.sol.dops.tow = d.publishes;
+    d.time_ns = now_ns();
+    sbp_shm_publish(p->shm, 0, &d);
+    if (p->interval_ns) {
+      ts.tv_nsec = p->interval_ns;
+      nanosleep(&ts, NULL);
+    }
+  }
+  return NULL;
+}
+
+static u8 consistent(const sbp_shm_data_t *d)
+{
+  u32 n = d->publishes;
+
+  return d->frames == n && d->sol.gps_time.tow == n &&
+         d->sol.pos_llh.tow == n && d->sol.pos_llh.lat == n &&
+         d->sol.baseline_ned.tow == n && d->sol.vel_ned.tow == n &&
+         d->sol.dops.tow == n;
+}
+
+static int benchmark(double seconds)
+{
+  char name[SBP_SHM_NAME_LEN];
+  bench_publisher_t pub;
+  pthread_t thread;
+  sbp_shm_t shm, reader;
+  sbp_shm_data_t d;
+  u64 reads = 0, retries = 0, torn = 0, wakes = 0, timeouts = 0;
+  u64 latency, latency_sum = 0, latency_max = 0, start, end;
+  u32 changes;
+
+  snprintf(name, sizeof(name), "/sbp_bench_%d", (int)getpid());
+  if (sbp_shm_create(&shm, name, 1) != 0 || sbp_shm_open(&reader, name) != 0) {
+    perror(name);
+    return 1;
+  }
+  memset(&pub, 0, sizeof(pub));
+  pub.shm = &shm;
+
+  /* Reads while the publisher writes flat out. */
+  pthread_create(&thread, NULL, bench_publish, &pub);
+  start = now_ns();
+  end = start + (u64)(seconds / 2 * 1e9);
+  do {
+    retries += sbp_shm_read(&reader, 0, &d);
+    torn += !consistent(&d);
+    reads++;
+  } while ((reads & 1023) || now_ns() < end);
+  end = now_ns();
+  pub.stop = 1;
+  pthread_join(thread, NULL);
+  printf("Publishes\t: %.2f M/s\n", pub.publishes / ((end - start) / 1e9) / 1e6);
+  printf("Reads\t\t: %.2f M/s, %.0f ns each, %llu retries, %llu torn\n",
+         reads / ((end - start) / 1e9) / 1e6, (double)(end - start) / reads,
+         (unsigned long long)retries, (unsigned long long)torn);
+
+  /* Wake up latency with a publish every millisecond. */
+  pub.stop = 0;
+  pub.interval_ns = 1000000;
+  pthread_create(&thread, NULL, bench_publish, &pub);
+  end = now_ns() + (u64)(seconds / 2 * 1e9);
+  changes = sbp_shm_changes(&reader, 0);
+  while (now_ns() < end) {
+    if (sbp_shm_wait(&reader, 0, changes, 100) != 0) {
+      timeouts++;
+      continue;
+    }
+    changes = sbp_shm_changes(&reader, 0);
+    sbp_shm_read(&reader, 0, &d);
+    latency = now_ns() - d.time_ns;
+    torn += !consistent(&d);
+    latency_sum += latency;
+    if (latency > latency_max)
+      latency_max = latency;
+    wakes++;
+  }
+  pub.stop = 1;
+  pthread_join(thread, NULL);
+  printf("Wake ups\t: %llu, mean latency %.1f us, max %.1f us, "
+         "%llu timeouts\n", (unsigned long long)wakes,
+         wakes ? latency_sum / 1e3 / wakes : 0.0, latency_max / 1e3,
+         (unsigned long long)timeouts);
+
+  sbp_shm_close(&reader);
+  sbp_shm_destroy(&shm);
+  if (torn)
+    printf("FAILED: %llu torn snapshots\n", (unsigned long long)torn);
+  return torn ? 2 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *name = SBP_SHM_DEFAULT;
+  long slot = -1, count = -1;
+  u8 follow = 0;
+  double bench = 0;
+  sbp_shm_t shm;
+  u32 i, changes;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:fn:B:")) != -1) {
+    switch (opt) {
+    case 's':
+      slot = strtol(optarg, NULL, 0);
+      break;
+    case 'f':
+      follow = 1;
+      break;
+    case 'n':
+      count = strtol(optarg, NULL, 0);
+      break;
+    case 'B':
+      bench = strtod(optarg, NULL);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (bench > 0)
+    return benchmark(bench);
+  if (optind < argc - 1)
+    goto usage;
+  if (optind == argc - 1)
+    name = argv[optind];
+
+  if (sbp_shm_open(&shm, name) != 0) {
+    perror(name);
+    return 1;
+  }
+  if (slot >= (long)shm.header->n_slots) {
+    fprintf(stderr, "%s has %u slots\n", name, shm.header->n_slots);
+    return 1;
+  }
+
+  if (!follow) {
+    print_header();
+    for (i = 0; i < shm.header->n_slots; i++)
+      if (slot < 0 || i == slot)
+        print_slot(&shm, i, slot >= 0);
+    sbp_shm_close(&shm);
+    return 0;
+  }
+
+  if (slot < 0)
+    slot = 0;
+  print_header();
+  changes = sbp_shm_changes(&shm, slot);
+  while (count != 0) {
+    if (sbp_shm_wait(&shm, slot, changes, -1) != 0)
+      continue;
+    changes = sbp_shm_changes(&shm, slot);
+    print_slot(&shm, slot, 0);
+    fflush(stdout);
+    if (count > 0)
+      count--;
+  }
+  sbp_shm_close(&shm);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-s slot] [-f] [-n count] [name]\n"
+          "       %s -B seconds\n", argv[0], argv[0]);
+  return 1;
+}
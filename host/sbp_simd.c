@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsbp/sbp.h>
+#include <libsbp/edc.h>
+
+#include "sbp_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+static u8 always(void)
+{
+  return 1;
+}
+
+/* Preamble search. Each returns the first preamble in [p, end), or end. */
+
+static const u8 *find_preamble_scalar(const u8 *p, const u8 *end)
+{
+  while (p < end && *p != SBP_PREAMBLE)
+    p++;
+  return p;
+}
+
+#ifdef SIMD_X86
+
+static u8 have_sse2(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2") != 0;
+}
+
+static u8 have_avx2(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+__attribute__ ((target("sse2")))
+static const u8 *find_preamble_sse2(const u8 *p, const u8 *end)
+{
+  const __m128i preamble = _mm_set1_epi8(SBP_PREAMBLE);
+  u32 mask;
+
+  for (; end - p >= 16; p += 16) {
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+             _mm_loadu_si128((const __m128i *)p), preamble));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+  return find_preamble_scalar(p, end);
+}
+
+__attribute__ ((target("avx2")))
+static const u8 *find_preamble_avx2(const u8 *p, const u8 *end)
+{
+  const __m256i preamble = _mm256_set1_epi8(SBP_PREAMBLE);
+  u32 lo, hi;
+
+  /* Two vectors per pass, preambles are usually tens of bytes apart. */
+  for (; end - p >= 64; p += 64) {
+    lo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+           _mm256_loadu_si256((const __m256i *)p), preamble));
+    hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+           _mm256_loadu_si256((const __m256i *)(p + 32)), preamble));
+    if (lo | hi) {
+      if (lo)
+        return p + __builtin_ctz(lo);
+      return p + 32 + __builtin_ctz(hi);
+    }
+  }
+  for (; end - p >= 32; p += 32) {
+    lo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+           _mm256_loadu_si256((const __m256i *)p), preamble));
+    if (lo)
+      return p + __builtin_ctz(lo);
+  }
+  return find_preamble_scalar(p, end);
+}
+
+#endif /* SIMD_X86 */
+
+#ifdef SIMD_NEON
+
+static const u8 *find_preamble_neon(const u8 *p, const u8 *end)
+{
+  const uint8x16_t preamble = vdupq_n_u8(SBP_PREAMBLE);
+  uint8x16_t eq;
+  u64 mask;
+
+  for (; end - p >= 16; p += 16) {
+    eq = vceqq_u8(vld1q_u8(p), preamble);
+    /* Narrow to 4 bits per byte so the mask fits in 64 bits. */
+    mask = vget_lane_u64(vreinterpret_u64_u8(
+             vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    if (mask)
+      return p + (__builtin_ctzll(mask) >> 2);
+  }
+  return find_preamble_scalar(p, end);
+}
+
+#endif /* SIMD_NEON */
+
+/* Fastest first. */
+static const sbp_scan_impl_t scan_impls[] = {
+#ifdef SIMD_X86
+  { "avx2", find_preamble_avx2, have_avx2 },
+  { "sse2", find_preamble_sse2, have_sse2 },
+#endif
+#ifdef SIMD_NEON
+  { "neon", find_preamble_neon, always },
+#endif
+  { "scalar", find_preamble_scalar, always },
+};
+
+/*
+ * CRC-16-CCITT as used by SBP (polynomial 0x1021, not reflected).
+ *
+ * The scalar version is the byte at a time table in libsbp. The sliced version
+ * processes 8 bytes per step with 8 tables: table k gives the effect of a byte
+ * followed by k zero bytes, so the 8 lookups are independent and the CPU can
+ * overlap them. Frames are at most 263 bytes, too short for carry-less
+ * multiply folding to pay for its setup, so there is no PCLMUL version.
+ */
+
+static u16 crc_tables[8][256];
+
+static void crc_tables_init(void)
+{
+  u32 b, k;
+  u16 c;
+
+  for (b = 0; b < 256; b++)
+    crc_tables[0][b] = crc16_ccitt((const u8 *)"\0", 1, b << 8);
+  for (k = 1; k < 8; k++) {
+    for (b = 0; b < 256; b++) {
+      c = crc_tables[k - 1][b];
+      crc_tables[k][b] = (c << 8) ^ crc_tables[0][c >> 8];
+    }
+  }
+}
+
+static u16 crc16_slice8(const u8 *buf, u32 len, u16 crc)
+{
+  while (len >= 8) {
+    crc = crc_tables[7][buf[0] ^ (crc >> 8)] ^
+          crc_tables[6][buf[1] ^ (crc & 0xFF)] ^
+          crc_tables[5][buf[2]] ^ crc_tables[4][buf[3]] ^
+          crc_tables[3][buf[4]] ^ crc_tables[2][buf[5]] ^
+          crc_tables[1][buf[6]] ^ crc_tables[0][buf[7]];
+    buf += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = (crc << 8) ^ crc_tables[0][(crc >> 8) ^ *buf++];
+  return crc;
+}
+
+static u16 crc16_scalar(const u8 *buf, u32 len, u16 crc)
+{
+  return crc16_ccitt(buf, len, crc);
+}
+
+static const sbp_crc_impl_t crc_impls[] = {
+  { "slice8", crc16_slice8, always },
+  { "scalar", crc16_scalar, always },
+};
+
+/* Runtime dispatch. The pointers start at resolvers that pick an
+ * implementation and then call it. */
+
+static const u8 *resolve_find_preamble(const u8 *p, const u8 *end);
+static u16 resolve_crc16(const u8 *buf, u32 len, u16 crc);
+
+static sbp_find_preamble_t find_preamble = resolve_find_preamble;
+static sbp_crc16_t crc16 = resolve_crc16;
+static const char *scan_name = "none";
+static const char *crc_name = "none";
+static pthread_once_t resolved = PTHREAD_ONCE_INIT;
+
+#define N_IMPLS(a) (sizeof(a) / sizeof((a)[0]))
+
+static u32 pick(const char *env, const char *const *names,
+                u8 (*const *supported)(void), u32 n)
+{
+  const char *want = getenv(env);
+  u32 i;
+
+  if (want) {
+    for (i = 0; i < n; i++)
+      if (strcmp(want, names[i]) == 0 && supported[i]())
+        return i;
+    fprintf(stderr, "%s=%s is not available here, ignored\n", env, want);
+  }
+  for (i = 0; i < n; i++)
+    if (supported[i]())
+      return i;
+  return n - 1;
+}
+
+static void resolve(void)
+{
+  const char *names[N_IMPLS(scan_impls)];
+  u8 (*supported[N_IMPLS(scan_impls)])(void);
+  u32 i;
+
+  for (i = 0; i < N_IMPLS(scan_impls); i++) {
+    names[i] = scan_impls[i].name;
+    supported[i] = scan_impls[i].supported;
+  }
+  i = pick("SBP_SIMD_SCAN", names, supported, N_IMPLS(scan_impls));
+  scan_name = scan_impls[i].name;
+  find_preamble = scan_impls[i].find_preamble;
+
+  crc_tables_init();
+  for (i = 0; i < N_IMPLS(crc_impls); i++) {
+    names[i] = crc_impls[i].name;
+    supported[i] = crc_impls[i].supported;
+  }
+  i = pick("SBP_SIMD_CRC", names, supported, N_IMPLS(crc_impls));
+  crc_name = crc_impls[i].name;
+  crc16 = crc_impls[i].crc16;
+}
+
+static const u8 *resolve_find_preamble(const u8 *p, const u8 *end)
+{
+  pthread_once(&resolved, resolve);
+  return find_preamble(p, end);
+}
+
+static u16 resolve_crc16(const u8 *buf, u32 len, u16 crc)
+{
+  pthread_once(&resolved, resolve);
+  return crc16(buf, len, crc);
+}
+
+/* Pointer to the first preamble in [p, end), or end if there is none. */
+const u8 *sbp_find_preamble(const u8 *p, const u8 *end)
+{
+  return find_preamble(p, end);
+}
+
+/* Same as crc16_ccitt in libsbp. */
+u16 sbp_crc16(const u8 *buf, u32 len, u16 crc)
+{
+  return crc16(buf, len, crc);
+}
+
+/* All preamble search implementations built in, fastest first, whether or
+ * not this CPU supports them. */
+const sbp_scan_impl_t *sbp_scan_impls(u32 *n)
+{
+  pthread_once(&resolved, resolve);
+  *n = N_IMPLS(scan_impls);
+  return scan_impls;
+}
+
+/* All CRC implementations built in, fastest first. */
+const sbp_crc_impl_t *sbp_crc_impls(u32 *n)
+{
+  pthread_once(&resolved, resolve);
+  *n = N_IMPLS(crc_impls);
+  return crc_impls;
+}
+
+/* Names of the implementations in use, e.g. "avx2 + slice8". */
+const char *sbp_simd_selected(void)
+{
+  static char name[64];
+
+  pthread_once(&resolved, resolve);
+  snprintf(name, sizeof(name), "%s + %s", scan_name, crc_name);
+  return name;
+}
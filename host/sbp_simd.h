@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Vectorised kernels for the capture tools: finding preamble candidates and
+ * computing the frame CRC. Each has a scalar version and faster ones for the
+ * instruction sets the host has; the fastest available is picked the first
+ * time a kernel is called. Every version gives the same result as the scalar
+ * one.
+ *
+ * The environment variables SBP_SIMD_SCAN and SBP_SIMD_CRC force a particular
+ * implementation by name (see sbp_scan_impls and sbp_crc_impls), e.g. to
+ * compare results or speed.
+ */
+
+#ifndef SBP_TUTORIAL_SBP_SIMD_H
+#define SBP_TUTORIAL_SBP_SIMD_H
+
+#include <libsbp/common.h>
+
+typedef const u8 *(*sbp_find_preamble_t)(const u8 *p, const u8 *end);
+typedef u16 (*sbp_crc16_t)(const u8 *buf, u32 len, u16 crc);
+
+typedef struct {
+  const char *name;
+  sbp_find_preamble_t find_preamble;
+  u8 (*supported)(void);
+} sbp_scan_impl_t;
+
+typedef struct {
+  const char *name;
+  sbp_crc16_t crc16;
+  u8 (*supported)(void);
+} sbp_crc_impl_t;
+
+const u8 *sbp_find_preamble(const u8 *p, const u8 *end);
+u16 sbp_crc16(const u8 *buf, u32 len, u16 crc);
+
+const sbp_scan_impl_t *sbp_scan_impls(u32 *n);
+const sbp_crc_impl_t *sbp_crc_impls(u32 *n);
+const char *sbp_simd_selected(void);
+
+#endif /* SBP_TUTORIAL_SBP_SIMD_H */
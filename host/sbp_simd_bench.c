@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Checks every preamble search and CRC implementation in sbp_simd.c that the
+ * CPU supports against the scalar one, then measures each in GB/s.
+ *
+ * Usage: sbp_simd_bench [-s mb] [capture.sbp]
+ *   -s n  size of the synthetic buffers in MB (default 64)
+ *
+ * With a capture, the preamble search is also timed on it, finding every
+ * preamble in turn as the frame scanner does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libsbp/sbp.h>
+
+#include "log_index.h"
+#include "sbp_simd.h"
+
+#define REPEATS 5
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static u32 rand_state = 2463534242U;
+
+static u32 xorshift(void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+/* Compare against the scalar versions (last in each list) on random data
+ * with preambles at every density, length and alignment. */
+static u32 self_check(void)
+{
+  u32 n_scan, n_crc, i, j, len, start, errors = 0;
+  const sbp_scan_impl_t *scan = sbp_scan_impls(&n_scan);
+  const sbp_crc_impl_t *crc = sbp_crc_impls(&n_crc);
+  u8 buf[1024];
+  u16 init;
+
+  for (j = 0; j < 20000; j++) {
+    len = xorshift() % 600;
+    start = xorshift() % 64;
+    for (i = 0; i < start + len; i++)
+      buf[i] = (xorshift() % (1 + j % 200)) ? (u8)xorshift() | 1 : 0x55;
+    for (i = 0; i < n_scan - 1; i++) {
+      if (!scan[i].supported())
+        continue;
+      if (scan[i].find_preamble(buf + start, buf + start + len) !=
+          scan[n_scan - 1].find_preamble(buf + start, buf + start + len)) {
+        if (errors++ < 10)
+          printf("%s: preamble search differs (len %u)\n", scan[i].name, len);
+      }
+    }
+    init = xorshift();
+    for (i = 0; i < n_crc - 1; i++) {
+      if (!crc[i].supported())
+        continue;
+      if (crc[i].crc16(buf + start, len, init) !=
+          crc[n_crc - 1].crc16(buf + start, len, init)) {
+        if (errors++ < 10)
+          printf("%s: CRC differs (len %u)\n", crc[i].name, len);
+      }
+    }
+  }
+  return errors;
+}
+
+/* Time scanning a whole buffer, preamble to preamble. Returns GB/s. */
+static double time_scan(sbp_find_preamble_t find, const u8 *buf, u64 size,
+                        u64 *found)
+{
+  double best = 1e30, t;
+  const u8 *p, *end = buf + size;
+  u32 r;
+
+  for (r = 0; r < REPEATS; r++) {
+    *found = 0;
+    t = now_s();
+    for (p = find(buf, end); p < end; p = find(p + 1, end))
+      (*found)++;
+    t = now_s() - t;
+    if (t < best)
+      best = t;
+  }
+  return size / best / 1e9;
+}
+
+static const u8 *find_memchr(const u8 *p, const u8 *end)
+{
+  const u8 *q = memchr(p, SBP_PREAMBLE, end - p);
+  return q ? q : end;
+}
+
+/* Time the CRC over a buffer in blocks of block bytes. Returns GB/s. */
+static double time_crc(sbp_crc16_t crc16, const u8 *buf, u64 size, u32 block,
+                       u16 *result)
+{
+  double best = 1e30, t;
+  u64 off;
+  u16 crc;
+  u32 r;
+
+  for (r = 0; r < REPEATS; r++) {
+    crc = 0;
+    t = now_s();
+    for (off = 0; off + block <= size; off += block)
+      crc ^= crc16(buf + off, block, 0);
+    t = now_s() - t;
+    if (t < best)
+      best = t;
+  }
+  *result = crc;
+  return size / best / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  static const u32 blocks[] = { 34, 263, 4096 };
+  u32 n_scan, n_crc, i, b, errors;
+  const sbp_scan_impl_t *scan = sbp_scan_impls(&n_scan);
+  const sbp_crc_impl_t *crc = sbp_crc_impls(&n_crc);
+  u64 size = 64 << 20, k, found;
+  char label[32];
+  double gbps;
+  log_index_t cap;
+  u8 *buf;
+  u16 result;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+    case 's':
+      size = strtoull(optarg, NULL, 0) << 20;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-s mb] [capture.sbp]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("Selected\t: %s\n", sbp_simd_selected());
+  errors = self_check();
+  printf("Self check\t: %s\n\n", errors ? "FAILED" : "all implementations agree");
+
+  /* Random bytes with no preamble, the longest possible search. */
+  buf = malloc(size);
+  for (k = 0; k < size; k++) {
+    buf[k] = xorshift();
+    if (buf[k] == SBP_PREAMBLE)
+      buf[k] = 0;
+  }
+
+  printf("%-24s %-8s %8s\n", "preamble search", "impl", "GB/s");
+  for (i = 0; i < n_scan; i++)
+    if (scan[i].supported())
+      printf("%-24s %-8s %8.2f\n", "no preambles", scan[i].name,
+             time_scan(scan[i].find_preamble, buf, size, &found));
+  printf("%-24s %-8s %8.2f\n", "no preambles", "memchr",
+         time_scan(find_memchr, buf, size, &found));
+
+  if (optind < argc) {
+    if (log_open(&cap, argv[optind]) != 0) {
+      perror(argv[optind]);
+      return 1;
+    }
+    for (i = 0; i < n_scan; i++) {
+      if (!scan[i].supported())
+        continue;
+      gbps = time_scan(scan[i].find_preamble, cap.data, cap.size, &found);
+      printf("%-24s %-8s %8.2f (%llu preambles)\n", "capture", scan[i].name,
+             gbps, (unsigned long long)found);
+    }
+    gbps = time_scan(find_memchr, cap.data, cap.size, &found);
+    printf("%-24s %-8s %8.2f (%llu preambles)\n", "capture", "memchr",
+           gbps, (unsigned long long)found);
+    log_close(&cap);
+  }
+
+  printf("\n%-24s %-8s %8s\n", "CRC-16-CCITT", "impl", "GB/s");
+  for (b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+    snprintf(label, sizeof(label), "%u byte blocks", blocks[b]);
+    for (i = 0; i < n_crc; i++) {
+      if (crc[i].supported())
+        printf("%-24s %-8s %8.2f\n", label, crc[i].name,
+               time_crc(crc[i].crc16, buf, size, blocks[b], &result));
+    }
+  }
+
+  free(buf);
+  return errors ? 2 : 0;
+}
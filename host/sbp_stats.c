@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Runs the statistics the board keeps (see stats.h) over a raw SBP capture,
+ * and writes the snapshot as CSV.
+ *
+ * Usage: sbp_stats [-a alpha] [-p n] [-o out.csv] capture.sbp
+ *   -a alpha  weight of the newest sample in the decayed statistics
+ *             (default 0.01)
+ *   -p n      also write a snapshot every n positions, each preceded by a
+ *             "# tow" line with the time of week of the last one
+ *   -o file   write to file instead of stdout
+ *
+ * A survey summary goes to stderr: the mean position and its spread in
+ * metres.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include <stats.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define M_PER_DEG 111320.0
+
+static stats_t stats;
+static stats_snapshot_t snap;
+static char csv[STATS_CSV_MAX_LEN];
+
+static void write_snapshot(FILE *out)
+{
+  stats_snapshot(&stats, &snap);
+  stats_format_csv(csv, &snap);
+  fputs(csv, out);
+}
+
+/* Store a frame's payload in sol as the receiver would. Returns 0 for
+ * messages stats doesn't use and frames too short for their type. */
+static u8 store(solution_t *sol, const sbp_frame_t *f)
+{
+  void *dst;
+  u32 size;
+
+  switch (f->msg_type) {
+  case SBP_MSG_POS_LLH:
+    dst = &sol->pos_llh;
+    size = sizeof(sol->pos_llh);
+    break;
+  case SBP_MSG_BASELINE_NED:
+    dst = &sol->baseline_ned;
+    size = sizeof(sol->baseline_ned);
+    break;
+  case SBP_MSG_DOPS:
+    dst = &sol->dops;
+    size = sizeof(sol->dops);
+    break;
+  default:
+    return 0;
+  }
+  if (f->len < size)
+    return 0;
+  memcpy(dst, f->payload, size);
+  return 1;
+}
+
+static void survey(void)
+{
+  const stats_summary_t *lat = &snap.ch[STATS_LAT];
+  const stats_summary_t *lon = &snap.ch[STATS_LON];
+  const stats_summary_t *h = &snap.ch[STATS_HEIGHT];
+
+  if (lat->n == 0)
+    return;
+  fprintf(stderr, "Mean position\t: %.9f, %.9f, %.3f\n", lat->mean, lon->mean,
+          h->mean);
+  fprintf(stderr, "Std (m)\t\t: %.3f north, %.3f east, %.3f up\n",
+          lat->std * M_PER_DEG,
+          lon->std * M_PER_DEG * cos(lat->mean * M_PI / 180), h->std);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out_path = NULL;
+  double alpha = STATS_DECAY_ALPHA;
+  u32 print_every = 0, positions = 0, messages = 0;
+  solution_t sol;
+  log_index_t cap;
+  sbp_frame_t f;
+  FILE *out = stdout;
+  u64 off = 0;
+  u8 ret;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "a:p:o:")) != -1) {
+    switch (opt) {
+    case 'a':
+      alpha = strtod(optarg, NULL);
+      if (alpha <= 0 || alpha > 1)
+        goto usage;
+      break;
+    case 'p':
+      print_every = strtoul(optarg, NULL, 0);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind != argc - 1)
+    goto usage;
+
+  if (log_open(&cap, argv[optind]) != 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (out_path && (out = fopen(out_path, "w")) == NULL) {
+    perror(out_path);
+    return 1;
+  }
+
+  memset(&sol, 0, sizeof(sol));
+  stats_init(&stats, alpha);
+  while ((ret = sbp_frame_next(cap.data, cap.size, off, &f)) !=
+         SBP_FRAME_END) {
+    off = f.end;
+    if (ret != SBP_FRAME_OK || !store(&sol, &f))
+      continue;
+    stats_message(&stats, &sol, f.msg_type);
+    messages++;
+    if (f.msg_type == SBP_MSG_POS_LLH && print_every &&
+        ++positions % print_every == 0) {
+      fprintf(out, "# tow %u\n", sol.pos_llh.tow);
+      write_snapshot(out);
+    }
+  }
+  if (print_every)
+    fprintf(out, "# end\n");
+  write_snapshot(out);
+  if (out != stdout && fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  fprintf(stderr, "%u messages\n", messages);
+  survey();
+  log_close(&cap);
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-a alpha] [-p n] [-o out.csv] capture.sbp\n",
+          argv[0]);
+  return 1;
+}
@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Decodes the binary telemetry from telemetry.c to CSV, and encodes SBP
+ * captures to it to check the round trip and measure its size.
+ *
+ * Usage: sbp_telemetry [-i port] [-o out.csv] [telemetry.bin]
+ *        sbp_telemetry -e [-f fields] [-k n] [-o out.bin] capture.sbp
+ *   -i port  the input is raw SWO, as captured from the debugger: take the
+ *            bytes sent on this ITM stimulus port and drop everything else
+ *   -o file  write to file instead of stdout
+ *   -e       encode a capture as the board would, checking that every frame
+ *            decodes back to the values it was made from, both with every
+ *            frame and with one in LOSS_EVERY lost, and compare its size to
+ *            the text status report and NMEA for the same epochs
+ *   -f list  groups to send, any of tow,pos,baseline,vel,dops,sats,rx
+ *            (default: all)
+ *   -k n     keyframe every n frames (default TELEMETRY_KEYFRAME_EVERY)
+ *
+ * The decoder reads from stdin if no file is given, and finds frames by
+ * their sync byte and CRC, so it can start anywhere in a stream. The CSV
+ * has a column per value, scaled back to degrees, metres and so on; delta
+ * frames that arrive after a lost frame are skipped until the next keyframe.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <libsbp/navigation.h>
+
+#include <nmea.h>
+#include <status.h>
+#include <telemetry.h>
+
+#include "log_index.h"
+#include "sbp_frame.h"
+
+#define LOSS_EVERY 37
+#define LINE_BAUD  115200
+
+typedef struct {
+  const char *name;
+  const char *columns;
+} group_t;
+
+static const group_t groups[TELEMETRY_N_GROUPS] = {
+  { "tow", "tow" },
+  { "pos", "lat,lon,height" },
+  { "baseline", "baseline_n,baseline_e,baseline_d" },
+  { "vel", "vel_n,vel_e,vel_d" },
+  { "dops", "gdop,pdop,tdop,hdop,vdop" },
+  { "sats", "n_sats,flags" },
+  { "rx", "frames,crc_errors" },
+};
+
+/* Divisor of each value, in the order of the groups. */
+static const double divisors[TELEMETRY_MAX_VALUES] = {
+  1, 1e7, 1e7, 1e3, 1e3, 1e3, 1e3, 1e3, 1e3, 1e3,
+  100, 100, 100, 100, 100, 1, 1, 1, 1,
+};
+
+static int parse_fields(const char *list, u8 *fields)
+{
+  const char *p = list;
+  size_t n;
+  u8 i;
+
+  *fields = 0;
+  while (*p) {
+    n = strcspn(p, ",");
+    for (i = 0; i < TELEMETRY_N_GROUPS; i++)
+      if (strlen(groups[i].name) == n && strncmp(p, groups[i].name, n) == 0)
+        break;
+    if (i == TELEMETRY_N_GROUPS)
+      return -1;
+    *fields |= 1 << i;
+    p += n + (p[n] == ',');
+  }
+  return *fields ? 0 : -1;
+}
+
+/* Read all of f, which may be a pipe. */
+static u8 *read_all(FILE *f, u32 *size)
+{
+  u8 *buf = NULL;
+  u32 n = 0, cap = 0;
+  size_t got;
+
+  do {
+    if (n == cap) {
+      cap = cap ? cap * 2 : 65536;
+      buf = realloc(buf, cap);
+      if (buf == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+    got = fread(buf + n, 1, cap - n, f);
+    n += got;
+  } while (got);
+  *size = n;
+  return buf;
+}
+
+/*
+ * Keep only the bytes sent on one ITM stimulus port from a raw SWO stream,
+ * in place. Each source packet is a header, port << 3 with bit 2 clear for
+ * software and the size in bits 0-1 (1, 2 or 4 bytes), then its payload.
+ * Hardware source packets are skipped over, and so are synchronisation
+ * (zeros, then 0x80) and the overflow, timestamp and extension packets, whose
+ * headers have bits 0-1 clear and which continue while bit 7 is set.
+ */
+static u32 itm_extract(u8 *buf, u32 size, u8 port)
+{
+  u32 i = 0, n = 0, len;
+  u8 h;
+
+  while (i < size) {
+    h = buf[i++];
+    if (h == 0) {
+      while (i < size && buf[i] == 0)
+        i++;
+      i += i < size && buf[i] == 0x80;
+      continue;
+    }
+    if ((h & 3) == 0) {
+      if (h & 0x80)
+        while (i < size && (buf[i++] & 0x80))
+          ;
+      continue;
+    }
+    len = 1 << ((h & 3) - 1);
+    if (i + len > size)
+      break;
+    if (!(h & 4) && (h >> 3) == port) {
+      memmove(buf + n, buf + i, len);
+      n += len;
+    }
+    i += len;
+  }
+  return n;
+}
+
+static void csv_header(FILE *out, u8 fields)
+{
+  u8 i, first = 1;
+
+  for (i = 0; i < TELEMETRY_N_GROUPS; i++) {
+    if (!(fields & (1 << i)))
+      continue;
+    fprintf(out, "%s%s", first ? "" : ",", groups[i].columns);
+    first = 0;
+  }
+  fprintf(out, "\n");
+}
+
+static void csv_row(FILE *out, u8 fields, const s32 *v)
+{
+  u8 g, j, i = 0, k = 0;
+
+  for (g = 0; g < TELEMETRY_N_GROUPS; g++) {
+    for (j = 0; j < telemetry_group_values[g]; j++, k++) {
+      if (!(fields & (1 << g)))
+        continue;
+      if (i)
+        fputc(',', out);
+      /* Counters and the time of week are unsigned. */
+      if (g == 0 || g == 6)
+        fprintf(out, "%u", (u32)v[i]);
+      else if (divisors[k] == 1)
+        fprintf(out, "%d", v[i]);
+      else
+        fprintf(out, "%.*f", divisors[k] == 1e7 ? 7 :
+                divisors[k] == 1e3 ? 3 : 2, v[i] / divisors[k]);
+      i++;
+    }
+  }
+  fputc('\n', out);
+}
+
+static int decode(FILE *in, FILE *out, int port)
+{
+  telemetry_decoder_t d;
+  s32 values[TELEMETRY_MAX_VALUES];
+  u32 size, i = 0, len, bad = 0;
+  u8 *buf, header_fields = 0;
+  s8 n;
+
+  buf = read_all(in, &size);
+  if (port >= 0)
+    size = itm_extract(buf, size, port);
+
+  telemetry_decoder_init(&d);
+  while (i + 3 <= size) {
+    if (buf[i] != TELEMETRY_SYNC) {
+      i++;
+      continue;
+    }
+    len = 5 + buf[i + 2];
+    if (i + len > size)
+      break;
+    n = telemetry_decode(&d, buf + i, len, values);
+    if (n < 0) {
+      /* Not a frame after all, or a damaged one: look for the next. */
+      bad++;
+      i++;
+      continue;
+    }
+    i += len;
+    if (n == 0)
+      continue;
+    if (d.fields != header_fields) {
+      csv_header(out, d.fields);
+      header_fields = d.fields;
+    }
+    csv_row(out, d.fields, values);
+  }
+  fprintf(stderr, "%u frames decoded, %u skipped waiting for a keyframe, "
+          "%u bad sync or CRC\n", d.frames, d.skipped, bad);
+  free(buf);
+  return 0;
+}
+
+/* Values as the decoder should give them back, worked out independently. */
+static u8 expected(const receiver_t *r, u8 fields, s32 *v)
+{
+  const solution_t *sol = &r->sol;
+  u8 n = 0;
+
+  if (fields & TELEMETRY_TOW)
+    v[n++] = sol->pos_llh.tow;
+  if (fields & TELEMETRY_POS) {
+    v[n++] = lround(sol->pos_llh.lat * 1e7);
+    v[n++] = lround(sol->pos_llh.lon * 1e7);
+    v[n++] = lround(sol->pos_llh.height * 1e3);
+  }
+  if (fields & TELEMETRY_BASELINE) {
+    v[n++] = sol->baseline_ned.n;
+    v[n++] = sol->baseline_ned.e;
+    v[n++] = sol->baseline_ned.d;
+  }
+  if (fields & TELEMETRY_VEL) {
+    v[n++] = sol->vel_ned.n;
+    v[n++] = sol->vel_ned.e;
+    v[n++] = sol->vel_ned.d;
+  }
+  if (fields & TELEMETRY_DOPS) {
+    v[n++] = sol->dops.gdop;
+    v[n++] = sol->dops.pdop;
+    v[n++] = sol->dops.tdop;
+    v[n++] = sol->dops.hdop;
+    v[n++] = sol->dops.vdop;
+  }
+  if (fields & TELEMETRY_SATS) {
+    v[n++] = sol->pos_llh.n_sats;
+    v[n++] = sol->pos_llh.flags;
+  }
+  if (fields & TELEMETRY_RX) {
+    v[n++] = r->n_frames;
+    v[n++] = r->n_crc_errors;
+  }
+  return n;
+}
+
+static u8 store(solution_t *sol, const sbp_frame_t *f)
+{
+  void *dst;
+  u32 size;
+
+  switch (f->msg_type) {
+  case SBP_MSG_GPS_TIME:
+    dst = &sol->gps_time;
+    size = sizeof(sol->gps_time);
+    break;
+  case SBP_MSG_POS_LLH:
+    dst = &sol->pos_llh;
+    size = sizeof(sol->pos_llh);
+    break;
+  case SBP_MSG_BASELINE_NED:
+    dst = &sol->baseline_ned;
+    size = sizeof(sol->baseline_ned);
+    break;
+  case SBP_MSG_VEL_NED:
+    dst = &sol->vel_ned;
+    size = sizeof(sol->vel_ned);
+    break;
+  case SBP_MSG_DOPS:
+    dst = &sol->dops;
+    size = sizeof(sol->dops);
+    break;
+  default:
+    return 0;
+  }
+  if (f->len < size)
+    return 0;
+  memcpy(dst, f->payload, size);
+  return 1;
+}
+
+static int encode(const log_index_t *cap, u8 fields, u8 keyframe_every,
+                  FILE *out)
+{
+  static receiver_t r;
+  static telemetry_t t;
+  static nmea_t nmea;
+  telemetry_decoder_t all, lossy;
+  s32 want[TELEMETRY_MAX_VALUES], got[TELEMETRY_MAX_VALUES];
+  char text[STATUS_MAX_LEN];
+  u64 key_bytes = 0, delta_bytes = 0, text_bytes = 0, nmea_bytes = 0;
+  u32 keys = 0, epochs = 0, errors = 0, recovered = 0, lost = 0;
+  sbp_frame_t f;
+  u64 off = 0;
+  u8 ret, len, n;
+  s8 dn;
+
+  telemetry_init(&t);
+  t.fields = fields;
+  t.keyframe_every = keyframe_every;
+  nmea_init(&nmea);
+  telemetry_decoder_init(&all);
+  telemetry_decoder_init(&lossy);
+
+  while ((ret = sbp_frame_next(cap->data, cap->size, off, &f)) !=
+         SBP_FRAME_END) {
+    off = f.end;
+    if (ret == SBP_FRAME_CRC_ERROR) {
+      r.n_crc_errors++;
+      continue;
+    }
+    r.n_frames++;
+    if (!store(&r.sol, &f))
+      continue;
+    len = telemetry_message(&t, &r, f.msg_type);
+    if (len == 0)
+      continue;
+    epochs++;
+    fwrite(t.frame, 1, len, out);
+    if (t.frame[1] & TELEMETRY_KEYFRAME) {
+      keys++;
+      key_bytes += len;
+    } else {
+      delta_bytes += len;
+    }
+    text_bytes += status_format(text, &r.sol);
+    nmea_bytes += nmea_epoch(&nmea, &r.sol);
+
+    n = expected(&r, fields, want);
+    dn = telemetry_decode(&all, t.frame, len, got);
+    if (dn != n || memcmp(got, want, n * sizeof(*got)) != 0) {
+      if (errors++ < 10)
+        fprintf(stderr, "epoch %u (tow %u): decoded wrongly\n", epochs,
+                r.sol.pos_llh.tow);
+    }
+    if (epochs % LOSS_EVERY == 0) {
+      lost++;
+      continue;
+    }
+    dn = telemetry_decode(&lossy, t.frame, len, got);
+    if (dn > 0) {
+      recovered++;
+      if (dn != n || memcmp(got, want, n * sizeof(*got)) != 0)
+        errors++;
+    }
+  }
+  if (epochs == 0) {
+    fprintf(stderr, "no epochs\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Epochs\t\t: %u, %u keyframes, %u errors\n", epochs, keys,
+          errors);
+  fprintf(stderr, "Lossy decode\t: %u lost, %u decoded, %u skipped\n", lost,
+          recovered, lossy.skipped);
+  fprintf(stderr, "Bytes/epoch\t: %.1f (keyframe %.1f, delta %.1f)\n",
+          (double)(key_bytes + delta_bytes) / epochs,
+          keys ? (double)key_bytes / keys : 0,
+          epochs > keys ? (double)delta_bytes / (epochs - keys) : 0);
+  fprintf(stderr, "\t\t  text status %.1f, NMEA %.1f\n",
+          (double)text_bytes / epochs, (double)nmea_bytes / epochs);
+  fprintf(stderr, "Epochs/s at %u baud: %.0f (text status %.0f, NMEA %.0f)\n",
+          LINE_BAUD, LINE_BAUD / 10.0 * epochs / (key_bytes + delta_bytes),
+          LINE_BAUD / 10.0 * epochs / text_bytes,
+          LINE_BAUD / 10.0 * epochs / nmea_bytes);
+  return errors != 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out_path = NULL;
+  u8 fields = TELEMETRY_ALL, keyframe_every = TELEMETRY_KEYFRAME_EVERY;
+  int opt, port = -1, enc = 0, ret, k;
+  log_index_t cap;
+  FILE *in = stdin, *out = stdout;
+
+  while ((opt = getopt(argc, argv, "i:o:ef:k:")) != -1) {
+    switch (opt) {
+    case 'i':
+      port = atoi(optarg);
+      if (port < 0 || port > 31)
+        goto usage;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'e':
+      enc = 1;
+      break;
+    case 'f':
+      if (parse_fields(optarg, &fields) != 0)
+        goto usage;
+      break;
+    case 'k':
+      k = atoi(optarg);
+      if (k < 1 || k > 255)
+        goto usage;
+      keyframe_every = k;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (enc ? optind != argc - 1 : optind < argc - 1)
+    goto usage;
+
+  if (out_path && (out = fopen(out_path, "w")) == NULL) {
+    perror(out_path);
+    return 1;
+  }
+  if (enc) {
+    if (log_open(&cap, argv[optind]) != 0) {
+      perror(argv[optind]);
+      return 1;
+    }
+    /* Frames are only written with -o, not to a terminal. */
+    if (out_path == NULL && (out = fopen("/dev/null", "w")) == NULL) {
+      perror("/dev/null");
+      return 1;
+    }
+    ret = encode(&cap, fields, keyframe_every, out);
+    log_close(&cap);
+  } else {
+    if (optind == argc - 1 && (in = fopen(argv[optind], "rb")) == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+    ret = decode(in, out, port);
+    if (in != stdin)
+      fclose(in);
+  }
+  if (out != stdout && fclose(out) != 0) {
+    perror(out_path ? out_path : "/dev/null");
+    return 1;
+  }
+  return ret;
+
+usage:
+  fprintf(stderr, "usage: %s [-i port] [-o out.csv] [telemetry.bin]\n"
+          "       %s -e [-f fields] [-k n] [-o out.bin] capture.sbp\n",
+          argv[0], argv[0]);
+  return 1;
+}
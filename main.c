@@ -17,106 +17,438 @@
 #include <libsbp/sbp.h>
 #include <libsbp/navigation.h>
 #include <tutorial_implementation.h>
+#include <fifo.h>
+#include <receiver.h>
+#include <status.h>
+#include <pps_clock.h>
+#include <sections.h>
+#include <arena.h>
+#include <stack_monitor.h>
+#include <bench.h>
+#include <nav_filter.h>
+#include <upsampler.h>
+#include <stats.h>
+#include <geofence.h>
+#include <nmea.h>
+#include <telemetry.h>
+#include <flash_log.h>
 
 /*
- * State of the SBP message parser.
- * Must be statically allocated.
+ * FIFO that the USART1 receive interrupt writes bytes from Piksi into, and the
+ * receiver that parses them. Both are touched for every received byte, so they
+ * live in CCM - apart from a FIFO sized for flash erases, which doesn't fit
+ * there next to the stack.
  */
-sbp_state_t sbp_state;
+#ifdef FLASH_LOG
+fifo_t rx_fifo;
+#else
+CCM_BSS fifo_t rx_fifo;
+#endif
+CCM_BSS receiver_t receiver;
 
-/* SBP structs that messages from Piksi will feed. */
-msg_pos_llh_t      pos_llh;
-msg_baseline_ned_t baseline_ned;
-msg_vel_ned_t      vel_ned;
-msg_dops_t         dops;
-msg_gps_time_t     gps_time;
+/* Relation between the PPS capture timer and GPS time. */
+pps_clock_t pps_clock;
 
 /*
- * SBP callback nodes must be statically allocated. Each message ID / callback
- * pair must have a unique sbp_msg_callbacks_node_t associated with it.
+ * Smoothed position and velocity in east, north and up relative to a survey
+ * point. Define SURVEY_LAT, SURVEY_LON (degrees) and SURVEY_HEIGHT (metres)
+ * to give the point, otherwise the first position received is used. The
+ * cycles taken by the most expensive update so far are kept to check
+ * against NAV_FILTER_BUDGET_CYCLES.
  */
-sbp_msg_callbacks_node_t pos_llh_node;
-sbp_msg_callbacks_node_t baseline_ned_node;
-sbp_msg_callbacks_node_t vel_ned_node;
-sbp_msg_callbacks_node_t dops_node;
-sbp_msg_callbacks_node_t gps_time_node;
+nav_filter_t nav_filter;
+u32 nav_filter_cycles_max;
+u32 nav_filter_overruns;
 
 /*
- * Callback functions to interpret SBP messages.
- * Every message ID has a callback associated with it to
- * receive and interpret the message payload.
+ * Positions at 1000 / UPSAMPLER_PERIOD_MS Hz between fixes, extrapolated
+ * from the SysTick interrupt. Define UPSAMPLE_BASELINE to extrapolate the
+ * baseline to the base station rather than the position relative to the
+ * survey point. Set a hook with upsampler_set_hook to pass each sample on,
+ * e.g. to a control loop; it runs in the interrupt.
  */
-void sbp_pos_llh_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+upsampler_t upsampler;
+u32 upsampler_cycles_max;
+u32 upsampler_overruns;
+
+void upsampler_task(u32 now_ms)
+{
+  u32 start = cycle_count(), cycles;
+
+  upsampler_tick(&upsampler, now_ms);
+  cycles = cycle_count() - start;
+  if (cycles > upsampler_cycles_max)
+    upsampler_cycles_max = cycles;
+  if (cycles > UPSAMPLER_BUDGET_CYCLES)
+    upsampler_overruns++;
+}
+
+/*
+ * Fences tested against every position as it arrives, around the survey
+ * point. With SURVEY_LAT undefined there are none, and geofence_t (over 20 KB
+ * with the default limits) isn't built in at all. geofence_event is called
+ * straight from the receiver hook on each enter and exit, so that is the
+ * place to react. The cycles taken by the most expensive test are kept.
+ */
+#ifdef SURVEY_LAT
+geofence_t geofence;
+u32 geofence_cycles_max;
+u32 geofence_enters;
+u32 geofence_exits;
+u16 geofence_last_id;
+
+void geofence_event(geofence_t *g, u16 id, u8 event, u32 tow, void *context)
+{
+  (void)g;
+  (void)tow;
+  (void)context;
+  if (event == GEOFENCE_ENTER)
+    geofence_enters++;
+  else
+    geofence_exits++;
+  geofence_last_id = id;
+}
+#endif
+
+/* The geofence part of the report, if there are fences. */
+int geofence_report(char *str)
+{
+#ifdef SURVEY_LAT
+  int n = 0;
+
+  n += sprintf(str + n, "Geofence:\n");
+  n += sprintf(str + n, "\tEvents\t\t: %6d enter, %d exit\n",
+               (int)geofence_enters, (int)geofence_exits);
+  n += sprintf(str + n, "\tInside\t\t: %6d fences, last %d\n",
+               (int)geofence.n_inside, (int)geofence_last_id);
+  n += sprintf(str + n, "\tCycles\t\t: %6d max\n",
+               (int)geofence_cycles_max);
+  n += sprintf(str + n, "\n");
+  return n;
+#else
+  (void)str;
+  return 0;
+#endif
+}
+
+/*
+ * NMEA sentences for each epoch, sent on USART2 by DMA. The cycles taken to
+ * write the most expensive epoch, queueing included, are kept.
+ */
+nmea_t nmea;
+u32 nmea_cycles_max;
+
+/*
+ * Compact binary telemetry for each epoch (see telemetry.h), small enough to
+ * send at the full solution rate, on ITM stimulus port TELEMETRY_ITM_PORT to
+ * a debugger reading SWO. Define TELEMETRY_USART2 to send it on USART2 in
+ * place of the NMEA sentences. Frames that couldn't be sent are counted.
+ */
+#define TELEMETRY_ITM_PORT 1
+telemetry_t telemetry;
+u32 telemetry_cycles_max;
+u32 telemetry_dropped;
+
+/*
+ * Define STATUS_DIFF to send only the solution fields that changed, as
+ * key=value lines every STATUS_DIFF_EVERY main loop passes, instead of with
+ * the rest of the report. Most passes then format and send nothing.
+ */
+#ifdef STATUS_DIFF
+#define STATUS_DIFF_EVERY 1000
+status_diff_t status_diff;
+char status_diff_str[STATUS_DIFF_MAX_LEN];
+#endif
+
+/* The solution part of the report, unless it is sent as it changes. */
+int solution_format(char *str)
 {
-  pos_llh = *(msg_pos_llh_t *)msg;
+#ifdef STATUS_DIFF
+  (void)str;
+  return 0;
+#else
+  return status_format(str, &receiver.sol);
+#endif
 }
-void sbp_baseline_ned_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+
+/*
+ * Define FLASH_LOG to record every frame received with a good CRC in the
+ * upper half of flash (see flash_log.h), to read back later with
+ * host/sbp_flash_log. The receiver stages each frame, and the main loop
+ * writes FLASH_LOG_POLL_WORDS words of them per pass. Moving on to a new
+ * sector holds the main loop up for up to 2 s while it is erased, so build
+ * with -DFIFO_LEN=32768 as well (tutorial_implementation.h checks it). The
+ * cycles taken by the most expensive pass are kept.
+ */
+#ifdef FLASH_LOG
+#define FLASH_LOG_POLL_WORDS 16
+flash_log_t flash_log;
+u32 flash_log_cycles_max;
+
+s8 log_erase(void *context, u32 sector)
 {
-  baseline_ned = *(msg_baseline_ned_t *)msg;
+  (void)context;
+  return flash_erase_sector(sector);
 }
-void sbp_vel_ned_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+
+s8 log_program(void *context, u32 offset, u32 word)
+{
+  (void)context;
+  return flash_program_word(offset, word);
+}
+
+void log_frame(receiver_t *r, void *context)
 {
-  vel_ned = *(msg_vel_ned_t *)msg;
+  sbp_state_t *s = &r->sbp_state;
+
+  (void)context;
+  flash_log_frame(&flash_log, s->msg_type, s->sender_id, s->msg_len,
+                  s->msg_buff, s->crc);
+}
+
+void flash_log_setup(void)
+{
+  flash_log_region_t region = {
+    (const u8 *)FLASH_LOG_BASE, FLASH_LOG_SECTOR_SIZE, FLASH_LOG_N_SECTORS
+  };
+  flash_log_ops_t ops = { &log_erase, &log_program, NULL };
+
+  flash_setup();
+  flash_log_open(&flash_log, &region, &ops);
+  receiver_set_frame_hook(&receiver, &log_frame, NULL);
+}
+
+void flash_log_write(void)
+{
+  u32 start = cycle_count(), cycles;
+
+  if (flash_log_poll(&flash_log, FLASH_LOG_POLL_WORDS)) {
+    cycles = cycle_count() - start;
+    if (cycles > flash_log_cycles_max)
+      flash_log_cycles_max = cycles;
+  }
 }
-void sbp_dops_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+#endif
+
+/* The flash log part of the report, if there is a log. */
+int flash_log_report(char *str)
 {
-  dops = *(msg_dops_t *)msg;
+#ifdef FLASH_LOG
+  int n = 0;
+
+  n += sprintf(str + n, "Flash Log:\n");
+  n += sprintf(str + n, "\tRecords\t\t: %6d, %d dropped\n",
+               (int)flash_log.records, (int)flash_log.dropped);
+  n += sprintf(str + n, "\tSector\t\t: %6d, seq %d, %d bytes used\n",
+               (int)flash_log.sector, (int)flash_log.seq,
+               (int)flash_log.offset);
+  n += sprintf(str + n, "\tErases\t\t: %6d, %d errors\n",
+               (int)flash_log.erases, (int)flash_log.errors);
+  n += sprintf(str + n, "\tCycles\t\t: %6d max\n",
+               (int)flash_log_cycles_max);
+  n += sprintf(str + n, "\n");
+  return n;
+#else
+  (void)str;
+  return 0;
+#endif
 }
-void sbp_gps_time_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+
+/*
+ * Running statistics of the baseline, position and DOPs, e.g. for surveying
+ * the base station, exported as CSV every STATS_PRINT_EVERY main loop passes.
+ */
+#define STATS_PRINT_EVERY 100000
+stats_t stats;
+stats_snapshot_t stats_snap;
+char *stats_csv;
+
+/*
+ * Buffers the reports are written into, carved out of a static arena at
+ * startup, so that nothing calls malloc for them and the status report isn't
+ * on the stack. Each allocation is rounded up to ARENA_ALIGN.
+ */
+#define REPORT_LEN 2048
+#define ARENA_SIZE (REPORT_LEN + STATS_CSV_MAX_LEN + 2 * ARENA_ALIGN)
+u8 arena_mem[ARENA_SIZE] __attribute__ ((aligned(ARENA_ALIGN)));
+arena_t arena;
+char *report_str;
+
+/* Returns 0 if ARENA_SIZE is too small for the buffers. */
+u8 memory_setup(void)
 {
-  gps_time = *(msg_gps_time_t *)msg;
+  arena_init(&arena, arena_mem, sizeof(arena_mem));
+  report_str = arena_alloc(&arena, REPORT_LEN);
+  stats_csv = arena_alloc(&arena, STATS_CSV_MAX_LEN);
+  return report_str != NULL && stats_csv != NULL;
 }
 
 /*
- * Set up SwiftNav Binary Protocol (SBP) nodes; the sbp_process function will
- * search through these to find the callback for a particular message ID.
- *
- * Example: sbp_pos_llh_callback is registered with sbp_state, and is associated
- * with both a unique sbp_msg_callbacks_node_t and the message ID SBP_POS_LLH.
- * When a valid SBP message with the ID SBP_POS_LLH comes through the UART, written
- * to the FIFO, and then parsed by sbp_process, sbp_pos_llh_callback is called
- * with the data carried by that message.
+ * Called by the receiver after each message it handles, see receiver.c for the
+ * SBP callbacks themselves.
  */
-void sbp_setup(void)
+void receiver_hook(receiver_t *r, u16 msg_type, void *context)
+{
+  u32 start, cycles;
+  u16 len;
+
+  /* Label the PPS edge this solution belongs to with its GPS time. */
+  if (msg_type == SBP_MSG_GPS_TIME)
+    pps_clock_label(&pps_clock, r->sol.gps_time.wn, r->sol.gps_time.tow,
+                    pps_ticks());
+
+  /* Smooth the position, timing each update. */
+  start = cycle_count();
+  if (nav_filter_message(&nav_filter, &r->sol, msg_type)) {
+    cycles = cycle_count() - start;
+    if (cycles > nav_filter_cycles_max)
+      nav_filter_cycles_max = cycles;
+    if (cycles > NAV_FILTER_BUDGET_CYCLES)
+      nav_filter_overruns++;
+  }
+
+  /* Snap the upsampled output back to each new fix. */
+  upsampler_message(&upsampler, &r->sol, msg_type, timebase_ms());
+
+  stats_message(&stats, &r->sol, msg_type);
+
+#ifndef TELEMETRY_USART2
+  /* Send NMEA as soon as each epoch is complete. */
+  start = cycle_count();
+  len = nmea_message(&nmea, &r->sol, msg_type);
+  if (len) {
+    usart2_tx_write((const u8 *)nmea.buf, len);
+    cycles = cycle_count() - start;
+    if (cycles > nmea_cycles_max)
+      nmea_cycles_max = cycles;
+  }
+#endif
+
+  /* And telemetry for the same epochs. */
+  start = cycle_count();
+  len = telemetry_message(&telemetry, r, msg_type);
+  if (len) {
+#ifdef TELEMETRY_USART2
+    if (!usart2_tx_write(telemetry.frame, len))
+      telemetry_dropped++;
+#else
+    if (!itm_write(TELEMETRY_ITM_PORT, telemetry.frame, len))
+      telemetry_dropped++;
+#endif
+    cycles = cycle_count() - start;
+    if (cycles > telemetry_cycles_max)
+      telemetry_cycles_max = cycles;
+  }
+
+#ifdef SURVEY_LAT
+  /* Check the fences as soon as each position arrives. */
+  if (msg_type == SBP_MSG_POS_LLH) {
+    start = cycle_count();
+    geofence_message(&geofence, &r->sol, msg_type);
+    cycles = cycle_count() - start;
+    if (cycles > geofence_cycles_max)
+      geofence_cycles_max = cycles;
+  }
+#endif
+}
+
+#ifdef RUN_BENCHMARKS
+/* Stream for the receive path benchmarks, see bench.h. */
+#define BENCH_BUF_SIZE 8192
+#define BENCH_REPEATS  8
+u8 bench_buf[BENCH_BUF_SIZE];
+
+void run_benchmarks(void)
 {
-  /* SBP parser state must be initialized before sbp_process is called. */
-  sbp_state_init(&sbp_state);
-
-  /* Register a node and callback, and associate them with a specific message ID. */
-  sbp_register_callback(&sbp_state, SBP_MSG_GPS_TIME, &sbp_gps_time_callback,
-                        NULL, &gps_time_node);
-  sbp_register_callback(&sbp_state, SBP_MSG_POS_LLH, &sbp_pos_llh_callback,
-                        NULL, &pos_llh_node);
-  sbp_register_callback(&sbp_state, SBP_MSG_BASELINE_NED, &sbp_baseline_ned_callback,
-                        NULL, &baseline_ned_node);
-  sbp_register_callback(&sbp_state, SBP_MSG_VEL_NED, &sbp_vel_ned_callback,
-                        NULL, &vel_ned_node);
-  sbp_register_callback(&sbp_state, SBP_MSG_DOPS, &sbp_dops_callback,
-                        NULL, &dops_node);
+  bench_config_t cfg = { &cycle_count, SystemCoreClock, BENCH_REPEATS,
+                         &SH_SendString };
+
+  bench_run(&cfg, bench_buf, sizeof(bench_buf));
 }
+#endif
 
 int main(void){
 
+  /* Paint the stack first so the watermark covers everything else. */
+  stack_paint();
+
   /* Set unbuffered mode for stdout (newlib) */
   setvbuf(stdout, 0, _IONBF, 0);
 
+  timebase_setup();
+  cycle_counter_setup();
+  if (!memory_setup()) {
+    SH_SendString("Arena too small for the report buffers\n");
+    while (1)
+      ;
+  }
+#ifdef RUN_BENCHMARKS
+  /* Before the USART interrupt is enabled, so nothing disturbs the timing. */
+  run_benchmarks();
+#endif
   leds_setup();
-  usarts_setup();
-  sbp_setup();
+  fifo_init(&rx_fifo);
+  usarts_setup(&rx_fifo);
+  usart2_tx_setup();
+  nmea_init(&nmea);
+  telemetry_init(&telemetry);
+  pps_setup();
+  pps_clock_init(&pps_clock, pps_tick_hz());
+  nav_filter_init(&nav_filter);
+#ifdef SURVEY_LAT
+  nav_filter_set_reference(&nav_filter, SURVEY_LAT, SURVEY_LON, SURVEY_HEIGHT);
+#endif
+#ifdef UPSAMPLE_BASELINE
+  upsampler_init(&upsampler, UPSAMPLER_BASELINE_NED);
+#else
+  upsampler_init(&upsampler, UPSAMPLER_POS_LLH);
+#endif
+#ifdef SURVEY_LAT
+  upsampler_set_reference(&upsampler, SURVEY_LAT, SURVEY_LON, SURVEY_HEIGHT);
+#endif
+  timebase_set_task(&upsampler_task, UPSAMPLER_PERIOD_MS);
+  stats_init(&stats, STATS_DECAY_ALPHA);
+#ifdef STATUS_DIFF
+  status_diff_init(&status_diff, STATUS_DIFF_KV);
+#endif
+#ifdef SURVEY_LAT
+  /* For example, a circle of 10 m around the survey point. */
+  geofence_init(&geofence, SURVEY_LAT, SURVEY_LON, SURVEY_HEIGHT);
+  geofence_add_circle(&geofence, 1, SURVEY_LAT, SURVEY_LON, 10);
+  geofence_compile(&geofence);
+  geofence_set_hook(&geofence, &geofence_event, NULL);
+#endif
+  receiver_setup(&receiver, &rx_fifo);
+  receiver_set_hook(&receiver, &receiver_hook, NULL);
+#ifdef FLASH_LOG
+  flash_log_setup();
+#endif
 
-  /* Use sprintf to right justify floating point prints. */
-  char rj[30];
   /* Only want 1 call to SH_SendString as semihosting is quite slow.
    * sprintf everything to this array and then print using array. */
-  char str[1000];
+  char *str = report_str;
   int str_i;
+  u32 pps_edge;
+  gps_stamp_t local_time;
+  /* Cycles spent in calls to sbp_process that consumed bytes, and the number
+   * of bytes they consumed. */
+  u32 parse_cycles = 0;
+  u32 parse_bytes = 0;
+  u32 parse_start, bytes_before;
+  nav_state_t nav;
+  upsample_t upsample;
 
   while(1){
 
+    /* Feed new PPS edges into the local clock model. */
+    if (pps_capture_read(&pps_edge))
+      pps_clock_edge(&pps_clock, pps_edge);
+
     /*
      * sbp_process must be called periodically in your
      * main program loop to consume the received bytes
-     * from Piksi and parse the SBP messages from them.
+     * from Piksi and parse the SBP messages from them;
+     * receiver_process does this for us.
      *
      * In this tutorial we use a FIFO structure to hold the data
      * before it is consumed by sbp_process; this helps ensure that no
@@ -127,70 +459,146 @@ int main(void){
      * sbp_process must be passed a function that conforms to the definition
      *     u32 get_bytes(u8 *buff, u32 n, void *context);
      * that provides access to the bytes received from Piksi. See fifo_read and
-     * related code in tutorial_implementation.c for a reference.
+     * related code in fifo.c for a reference.
      */
-    s8 ret = sbp_process(&sbp_state, &fifo_read);
+    bytes_before = rx_fifo.bytes_read;
+    parse_start = cycle_count();
+    s8 ret = receiver_process(&receiver);
+    if (rx_fifo.bytes_read != bytes_before) {
+      parse_cycles += cycle_count() - parse_start;
+      parse_bytes += rx_fifo.bytes_read - bytes_before;
+    }
     /* Semihosting is slow - each loop the FIFO fills up and packets get
      * dropped, so we don't check the return value from sbp_process. It's a good
      * idea to incorporate this check into your host's code, though. */
     //if (ret < 0)
     //  printf("sbp_process error: %d\n", (int)ret);
 
+#ifdef FLASH_LOG
+    /* Write out some of the frames staged for the flash log. */
+    flash_log_write();
+#endif
+
     /* Print data from messages received from Piksi. */
     DO_EVERY(10000,
 
       str_i = 0;
-      memset(str, 0, sizeof(str));
+      memset(str, 0, REPORT_LEN);
 
-      str_i += sprintf(str + str_i, "\n\n\n\n");
+      str_i += solution_format(str + str_i);
 
-      /* Print GPS time. */
-      str_i += sprintf(str + str_i, "GPS Time:\n");
-      str_i += sprintf(str + str_i, "\tWeek\t\t: %6d\n", (int)gps_time.wn);
-      sprintf(rj, "%6.2f", ((float)gps_time.tow)/1e3);
-      str_i += sprintf(str + str_i, "\tSeconds\t: %9s\n", rj);
+      /* Print the position relative to the survey point, as measured and
+       * filtered, and the filtered velocity. */
+      nav_filter_snapshot(&nav_filter, &nav);
+      str_i += sprintf(str + str_i, "Local ENU (mm, raw / filtered):\n");
+      str_i += sprintf(str + str_i, "\tEast\t\t: %9d / %9d\n",
+                       (int)(nav.raw_pos[0] * 1000), (int)(nav.pos[0] * 1000));
+      str_i += sprintf(str + str_i, "\tNorth\t\t: %9d / %9d\n",
+                       (int)(nav.raw_pos[1] * 1000), (int)(nav.pos[1] * 1000));
+      str_i += sprintf(str + str_i, "\tUp\t\t: %9d / %9d\n",
+                       (int)(nav.raw_pos[2] * 1000), (int)(nav.pos[2] * 1000));
+      str_i += sprintf(str + str_i, "\tVelocity (mm/s)\t: %6d %6d %6d\n",
+                       (int)(nav.vel[0] * 1000), (int)(nav.vel[1] * 1000),
+                       (int)(nav.vel[2] * 1000));
+      str_i += sprintf(str + str_i, "\tCycles\t\t: %6d max, %d over budget\n",
+                       (int)nav_filter_cycles_max, (int)nav_filter_overruns);
       str_i += sprintf(str + str_i, "\n");
 
-      /* Print absolute position. */
-      str_i += sprintf(str + str_i, "Absolute Position:\n");
-      sprintf(rj, "%4.10lf", pos_llh.lat);
-      str_i += sprintf(str + str_i, "\tLatitude\t: %17s\n", rj);
-      sprintf(rj, "%4.10lf", pos_llh.lon);
-      str_i += sprintf(str + str_i, "\tLongitude\t: %17s\n", rj);
-      sprintf(rj, "%4.10lf", pos_llh.height);
-      str_i += sprintf(str + str_i, "\tHeight\t: %17s\n", rj);
-      str_i += sprintf(str + str_i, "\tSatellites\t:     %02d\n", pos_llh.n_sats);
+      /* Print the latest upsampled position and how far the extrapolation
+       * had drifted from each new fix. */
+      upsampler_snapshot(&upsampler, &upsample);
+      str_i += sprintf(str + str_i, "Upsampled ENU (mm):\n");
+      str_i += sprintf(str + str_i, "\tPosition\t: %9d %9d %9d%s\n",
+                       (int)(upsample.pos[0] * 1000),
+                       (int)(upsample.pos[1] * 1000),
+                       (int)(upsample.pos[2] * 1000),
+                       upsample.stale ? " (stale)" : "");
+      str_i += sprintf(str + str_i, "\tAge (ms)\t: %6d\n",
+                       (int)upsample.age_ms);
+      str_i += sprintf(str + str_i, "\tResidual\t: %6d rms, %d max\n",
+                       (int)(upsampler_residual_rms(&upsampler) * 1000),
+                       (int)(upsampler.residual_max * 1000));
+      str_i += sprintf(str + str_i, "\tCycles\t\t: %6d max, %d over budget\n",
+                       (int)upsampler_cycles_max, (int)upsampler_overruns);
       str_i += sprintf(str + str_i, "\n");
 
-      /* Print NED (North/East/Down) baseline (position vector from base to rover). */
-      str_i += sprintf(str + str_i, "Baseline (mm):\n");
-      str_i += sprintf(str + str_i, "\tNorth\t\t: %6d\n", (int)baseline_ned.n);
-      str_i += sprintf(str + str_i, "\tEast\t\t: %6d\n", (int)baseline_ned.e);
-      str_i += sprintf(str + str_i, "\tDown\t\t: %6d\n", (int)baseline_ned.d);
+      /* Print geofence events. */
+      str_i += geofence_report(str + str_i);
+
+      /* Print the NMEA output. */
+      str_i += sprintf(str + str_i, "NMEA:\n");
+      str_i += sprintf(str + str_i, "\tEpochs\t\t: %6d, %d bytes dropped\n",
+                       (int)nmea.epochs, (int)usart2_tx_dropped);
+      str_i += sprintf(str + str_i, "\tCycles\t\t: %6d max\n",
+                       (int)nmea_cycles_max);
       str_i += sprintf(str + str_i, "\n");
 
-      /* Print NED velocity. */
-      str_i += sprintf(str + str_i, "Velocity (mm/s):\n");
-      str_i += sprintf(str + str_i, "\tNorth\t\t: %6d\n", (int)vel_ned.n);
-      str_i += sprintf(str + str_i, "\tEast\t\t: %6d\n", (int)vel_ned.e);
-      str_i += sprintf(str + str_i, "\tDown\t\t: %6d\n", (int)vel_ned.d);
+      /* Print the telemetry output. */
+      str_i += sprintf(str + str_i, "Telemetry:\n");
+      str_i += sprintf(str + str_i, "\tFrames\t\t: %6d, %d dropped\n",
+                       (int)telemetry.frames, (int)telemetry_dropped);
+      if (telemetry.frames)
+        str_i += sprintf(str + str_i, "\tBytes/frame\t: %6d\n",
+                         (int)(telemetry.bytes / telemetry.frames));
+      str_i += sprintf(str + str_i, "\tCycles\t\t: %6d max\n",
+                       (int)telemetry_cycles_max);
       str_i += sprintf(str + str_i, "\n");
 
-      /* Print Dilution of Precision metrics. */
-      str_i += sprintf(str + str_i, "Dilution of Precision:\n");
-      sprintf(rj, "%4.2f", ((float)dops.gdop/100));
-      str_i += sprintf(str + str_i, "\tGDOP\t\t: %7s\n", rj);
-      sprintf(rj, "%4.2f", ((float)dops.hdop/100));
-      str_i += sprintf(str + str_i, "\tHDOP\t\t: %7s\n", rj);
-      sprintf(rj, "%4.2f", ((float)dops.pdop/100));
-      str_i += sprintf(str + str_i, "\tPDOP\t\t: %7s\n", rj);
-      sprintf(rj, "%4.2f", ((float)dops.tdop/100));
-      str_i += sprintf(str + str_i, "\tTDOP\t\t: %7s\n", rj);
-      sprintf(rj, "%4.2f", ((float)dops.vdop/100));
-      str_i += sprintf(str + str_i, "\tVDOP\t\t: %7s\n", rj);
+      str_i += flash_log_report(str + str_i);
+
+      /* Print GPS time according to the PPS disciplined local clock. */
+      str_i += sprintf(str + str_i, "Local Clock:\n");
+      if (pps_clock_gps_time(&pps_clock, pps_ticks(), &local_time)) {
+        str_i += sprintf(str + str_i, "\tWeek\t\t: %6d\n", (int)local_time.wn);
+        str_i += sprintf(str + str_i, "\tSeconds\t: %6d.%09d\n",
+                         (int)(local_time.tow / 1000),
+                         (int)((local_time.tow % 1000) * 1000000 + local_time.ns));
+      } else {
+        str_i += sprintf(str + str_i, "\tNo PPS lock\n");
+      }
+      str_i += sprintf(str + str_i, "\tDrift (ppb)\t: %6d\n",
+                       (int)pps_clock_drift_ppb(&pps_clock));
+      str_i += sprintf(str + str_i, "\n");
+
+      /* Print the cost of parsing since the last print. Build with
+       * DISABLE_MEMORY_PLACEMENT defined to compare against code in flash
+       * and data in SRAM. */
+      str_i += sprintf(str + str_i, "Parser:\n");
+      if (parse_bytes)
+        str_i += sprintf(str + str_i, "\tCycles/byte\t: %6d\n",
+                         (int)(parse_cycles / parse_bytes));
+      str_i += sprintf(str + str_i, "\n");
+      parse_cycles = 0;
+      parse_bytes = 0;
+
+      /* Print arena occupancy. */
+      str_i += sprintf(str + str_i, "Arena (bytes):\n");
+      str_i += sprintf(str + str_i, "\tUsed\t\t: %6d / %6d\n",
+                       (int)arena.used, (int)arena.size);
+      str_i += sprintf(str + str_i, "\n");
+
+      /* Print the stack high watermark. */
+      str_i += sprintf(str + str_i, "Stack (bytes):\n");
+      str_i += sprintf(str + str_i, "\tUsed\t\t: %6d / %6d\n",
+                       (int)stack_watermark(), (int)stack_size());
       str_i += sprintf(str + str_i, "\n");
 
       SH_SendString(str);
     );
+
+#ifdef STATUS_DIFF
+    /* Send the solution fields that changed. */
+    DO_EVERY(STATUS_DIFF_EVERY,
+      if (status_diff_format(&status_diff, status_diff_str, &receiver.sol))
+        SH_SendString(status_diff_str);
+    );
+#endif
+
+    /* Export the statistics. */
+    DO_EVERY(STATS_PRINT_EVERY,
+      stats_snapshot(&stats, &stats_snap);
+      stats_format_csv(stats_csv, &stats_snap);
+      SH_SendString(stats_csv);
+    );
   }
 }
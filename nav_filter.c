@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <nav_filter.h>
+
+#define MS_PER_WEEK    604800000U
+/* Velocity variance to start from when there is no velocity measurement,
+ * (10 m/s)^2. */
+#define INIT_VEL_VAR   100.0f
+
+/* Set up a filter with the default tuning and no reference point. */
+void nav_filter_init(nav_filter_t *f)
+{
+  memset(f, 0, sizeof(*f));
+  f->accel_psd = NAV_FILTER_ACCEL_PSD;
+  f->uere = NAV_FILTER_UERE;
+  f->vel_sigma = NAV_FILTER_VEL_SIGMA;
+}
+
+/*
+ * Fix the reference point for the east, north and up state, latitude and
+ * longitude in degrees. Without it, the first position received is used.
+ */
+void nav_filter_set_reference(nav_filter_t *f, double lat, double lon,
+                              double height)
+{
+  enu_init(&f->ref, lat, lon, height);
+  f->ref_set = 1;
+  f->valid = 0;
+}
+
+static inline void axis_predict(nav_filter_t *f, u8 i, float dt, float q1,
+                                float q2, float q3)
+{
+  f->x[i] += dt * f->v[i];
+  f->p00[i] += dt * (2 * f->p01[i] + dt * f->p11[i]) + q3;
+  f->p01[i] += dt * f->p11[i] + q2;
+  f->p11[i] += q1;
+}
+
+static inline void axis_position(nav_filter_t *f, u8 i, float z, float r)
+{
+  float s_inv = 1 / (f->p00[i] + r);
+  float k0 = f->p00[i] * s_inv, k1 = f->p01[i] * s_inv;
+  float y = z - f->x[i];
+
+  f->x[i] += k0 * y;
+  f->v[i] += k1 * y;
+  f->p11[i] -= k1 * f->p01[i];
+  f->p01[i] *= 1 - k0;
+  f->p00[i] *= 1 - k0;
+}
+
+static inline void axis_velocity(nav_filter_t *f, u8 i, float z, float r)
+{
+  float s_inv = 1 / (f->p11[i] + r);
+  float k0 = f->p01[i] * s_inv, k1 = f->p11[i] * s_inv;
+  float y = z - f->v[i];
+
+  f->x[i] += k0 * y;
+  f->v[i] += k1 * y;
+  f->p00[i] -= k0 * f->p01[i];
+  f->p01[i] *= 1 - k1;
+  f->p11[i] *= 1 - k1;
+}
+
+/*
+ * One epoch: position pos in metres from the reference, and the velocity of
+ * the same epoch or NULL. Measurement variances come from dops.
+ */
+void nav_filter_update(nav_filter_t *f, u32 tow, const enu_t *pos,
+                       const msg_vel_ned_t *vel, const msg_dops_t *dops)
+{
+  float z[3] = { pos->e, pos->n, pos->u };
+  float zv[3] = { 0, 0, 0 };
+  float hdop, vdop, r[3], rv, dt, q1, q2, q3;
+  u32 dt_ms;
+  u8 i;
+
+  /* Horizontal variance is split between east and north. */
+  hdop = (dops->hdop ? dops->hdop : NAV_FILTER_DEFAULT_DOP) * 0.01f * f->uere;
+  vdop = (dops->vdop ? dops->vdop : NAV_FILTER_DEFAULT_DOP) * 0.01f * f->uere;
+  r[0] = r[1] = hdop * hdop * 0.5f;
+  r[2] = vdop * vdop;
+  rv = f->vel_sigma * f->vel_sigma;
+  if (vel) {
+    zv[0] = vel->e * 0.001f;
+    zv[1] = vel->n * 0.001f;
+    zv[2] = vel->d * -0.001f;
+  }
+
+  dt_ms = tow >= f->tow ? tow - f->tow : tow + MS_PER_WEEK - f->tow;
+  f->tow = tow;
+  f->updates++;
+
+  if (!f->valid || dt_ms == 0 || dt_ms > NAV_FILTER_MAX_GAP_MS) {
+    for (i = 0; i < 3; i++) {
+      f->x[i] = z[i];
+      f->v[i] = zv[i];
+      f->p00[i] = r[i];
+      f->p01[i] = 0;
+      f->p11[i] = vel ? rv : INIT_VEL_VAR;
+    }
+    f->resets += f->valid;
+    f->valid = 1;
+    return;
+  }
+
+  dt = dt_ms * 0.001f;
+  q1 = f->accel_psd * dt;
+  q2 = q1 * dt * 0.5f;
+  q3 = q2 * dt * (2.0f / 3);
+  for (i = 0; i < 3; i++) {
+    axis_predict(f, i, dt, q1, q2, q3);
+    axis_position(f, i, z[i], r[i]);
+    if (vel)
+      axis_velocity(f, i, zv[i], rv);
+  }
+}
+
+/*
+ * Feed a message the receiver has just stored in sol, from the receiver hook.
+ * Runs an update once an epoch's position and velocity are both in, or a
+ * position only update if the next position arrives first. Returns 1 if it
+ * ran an update.
+ */
+u8 nav_filter_message(nav_filter_t *f, const solution_t *sol, u16 msg_type)
+{
+  u8 ran = 0;
+
+  if (msg_type == SBP_MSG_POS_LLH) {
+    if (f->meas_pending) {
+      nav_filter_update(f, f->meas_tow, &f->meas, NULL, &sol->dops);
+      ran = 1;
+    }
+    if (!f->ref_set) {
+      enu_init(&f->ref, sol->pos_llh.lat, sol->pos_llh.lon,
+               sol->pos_llh.height);
+      f->ref_set = 1;
+    }
+    enu_from_llh(&f->ref, sol->pos_llh.lat, sol->pos_llh.lon,
+                 sol->pos_llh.height, &f->meas);
+    f->meas_tow = sol->pos_llh.tow;
+    f->meas_pending = 1;
+  } else if (msg_type == SBP_MSG_VEL_NED && f->meas_pending &&
+             sol->vel_ned.tow == f->meas_tow) {
+    nav_filter_update(f, f->meas_tow, &f->meas, &sol->vel_ned, &sol->dops);
+    f->meas_pending = 0;
+    ran = 1;
+  }
+  return ran;
+}
+
+/* Copy out the filtered state. */
+void nav_filter_snapshot(const nav_filter_t *f, nav_state_t *s)
+{
+  u8 i;
+
+  s->tow = f->tow;
+  s->updates = f->updates;
+  s->resets = f->resets;
+  s->valid = f->valid;
+  for (i = 0; i < 3; i++) {
+    s->pos[i] = f->x[i];
+    s->vel[i] = f->v[i];
+    s->pos_sigma[i] = sqrtf(f->p00[i]);
+    s->vel_sigma[i] = sqrtf(f->p11[i]);
+  }
+  s->raw_pos[0] = f->meas.e;
+  s->raw_pos[1] = f->meas.n;
+  s->raw_pos[2] = f->meas.u;
+  s->ref_lat = f->ref.lat;
+  s->ref_lon = f->ref.lon;
+  s->ref_height = f->ref.height;
+}
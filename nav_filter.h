@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * nav_filter smooths the position and velocity from Piksi with a constant
+ * velocity Kalman filter, in east, north and up relative to a reference point
+ * (see enu.h).
+ *
+ * Each axis is filtered on its own, with a position and a velocity state
+ * driven by white acceleration noise. Every epoch fuses the MSG_POS_LLH
+ * position, with a variance worked out from the latest MSG_DOPS (HDOP or VDOP
+ * times an assumed range error), and the MSG_VEL_NED velocity of the same
+ * time of week. If no velocity arrives for an epoch, its position is used on
+ * its own.
+ *
+ * All the arithmetic is single precision, done on the FPU. An update is
+ * straight line code apart from whether there is a velocity, so its cost is
+ * fixed: NAV_FILTER_BUDGET_CYCLES or fewer per epoch, ENU conversion
+ * included. A gap of more than NAV_FILTER_MAX_GAP_MS restarts the filter
+ * from the next measurement.
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_NAV_FILTER_H
+#define SBP_TUTORIAL_NAV_FILTER_H
+
+#include <libsbp/common.h>
+#include <libsbp/navigation.h>
+
+#include <enu.h>
+#include <receiver.h>
+
+/* Defaults for the tuning in nav_filter_t. */
+#define NAV_FILTER_ACCEL_PSD   1.0f /* Acceleration noise, m^2/s^3 per axis. */
+#define NAV_FILTER_UERE        1.5f /* Range error that DOPs scale, m. */
+#define NAV_FILTER_VEL_SIGMA   0.1f /* Velocity measurement noise, m/s. */
+/* DOP (times 100) assumed until the first MSG_DOPS. */
+#define NAV_FILTER_DEFAULT_DOP 200
+#define NAV_FILTER_MAX_GAP_MS  5000
+/* Upper bound on an update on the board, checked by main.c. */
+#define NAV_FILTER_BUDGET_CYCLES 2000
+
+/* Filtered state, as handed to consumers. */
+typedef struct {
+  u32 tow;            /* GPS time of week of the last update, ms. */
+  u32 updates;        /* Updates since the filter was set up. */
+  u32 resets;         /* Restarts after a gap. */
+  u8 valid;           /* The filter has been started. */
+  float pos[3];       /* East, north and up, m. */
+  float vel[3];       /* m/s. */
+  float pos_sigma[3]; /* Standard deviations of pos, m. */
+  float vel_sigma[3]; /* Standard deviations of vel, m/s. */
+  float raw_pos[3];   /* Last measured position, m. */
+  double ref_lat;     /* Reference point, degrees and m. */
+  double ref_lon;
+  double ref_height;
+} nav_state_t;
+
+typedef struct {
+  /* Tuning, set to the defaults by nav_filter_init. */
+  float accel_psd;
+  float uere;
+  float vel_sigma;
+
+  enu_ref_t ref;
+  u8 ref_set;
+
+  /* Position waiting for the velocity of the same epoch. */
+  enu_t meas;
+  u32 meas_tow;
+  u8 meas_pending;
+
+  /* Per axis state and covariance [p00 p01; p01 p11]. */
+  float x[3];
+  float v[3];
+  float p00[3];
+  float p01[3];
+  float p11[3];
+
+  u32 tow;
+  u8 valid;
+  u32 updates;
+  u32 resets;
+} nav_filter_t;
+
+void nav_filter_init(nav_filter_t *f);
+void nav_filter_set_reference(nav_filter_t *f, double lat, double lon,
+                              double height);
+u8 nav_filter_message(nav_filter_t *f, const solution_t *sol, u16 msg_type);
+void nav_filter_update(nav_filter_t *f, u32 tow, const enu_t *pos,
+                       const msg_vel_ned_t *vel, const msg_dops_t *dops);
+void nav_filter_snapshot(const nav_filter_t *f, nav_state_t *s);
+
+#endif /* SBP_TUTORIAL_NAV_FILTER_H */
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+
+#include <libsbp/navigation.h>
+
+#include <nmea.h>
+
+#define MS_PER_DAY  86400000U
+#define MS_PER_WEEK 604800000U
+/* Days from 1970-01-01 to the start of GPS time, 1980-01-06. */
+#define GPS_EPOCH_DAYS 3657
+
+/* MSG_POS_LLH flags, bits 0-2. */
+#define POS_MODE_MASK  0x07
+#define POS_MODE_SPP   0
+#define POS_MODE_FIXED 1
+#define POS_MODE_FLOAT 2
+
+/* Field limits, so no sentence can exceed NMEA_MAX_SENTENCE. */
+#define MAX_ALT_MM       99999999  /* 99999.999 m */
+#define MAX_SPEED_CENTI  9999999   /* 99999.99 knots or km/h */
+
+#define KNOTS_PER_MM_S  0.0019438445f
+#define KMH_PER_MM_S    0.0036f
+#define DECIDEG_PER_RAD 572.95780f
+
+/* Sentence being written, with its running checksum. */
+typedef struct {
+  char *p;
+  u8 cs;
+} out_t;
+
+static const char hex[] = "0123456789ABCDEF";
+
+static inline void put_char(out_t *o, char c)
+{
+  *o->p++ = c;
+  o->cs ^= c;
+}
+
+static inline void put_str(out_t *o, const char *s)
+{
+  while (*s)
+    put_char(o, *s++);
+}
+
+/* v in decimal, zero padded to at least width digits. */
+static void put_uint(out_t *o, u32 v, u8 width)
+{
+  char digits[10];
+  u8 n = 0;
+
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (width > n) {
+    put_char(o, '0');
+    width--;
+  }
+  while (n)
+    put_char(o, digits[--n]);
+}
+
+/* v / 10^decimals, with exactly that many decimals. */
+static void put_fixed(out_t *o, s32 v, u8 decimals)
+{
+  static const u32 scale[] = { 1, 10, 100, 1000 };
+  u32 u;
+
+  if (v < 0) {
+    put_char(o, '-');
+    u = -(u32)v;
+  } else {
+    u = v;
+  }
+  put_uint(o, u / scale[decimals], 1);
+  put_char(o, '.');
+  put_uint(o, u % scale[decimals], decimals);
+}
+
+/* Latitude or longitude as (d)ddmm.mmmmm followed by the hemisphere. */
+static void put_angle(out_t *o, double deg, u8 deg_width, char pos, char neg)
+{
+  /* Minutes times 10^5; 180 degrees is 1.08e9, which fits. Anything past
+   * that (or NaN) from a corrupt solution is clamped so the cast is defined. */
+  double a = fabs(deg);
+  u32 total, rem;
+
+  if (!(a <= 180))
+    a = 180;
+  total = (u32)(a * 6e6 + 0.5);
+  rem = total % 6000000;
+
+  put_uint(o, total / 6000000, deg_width);
+  put_uint(o, rem / 100000, 2);
+  put_char(o, '.');
+  put_uint(o, rem % 100000, 5);
+  put_char(o, ',');
+  put_char(o, deg < 0 ? neg : pos);
+}
+
+/* hhmmss.ss */
+static void put_time(out_t *o, u32 ms_of_day)
+{
+  u32 s = ms_of_day / 1000;
+
+  put_uint(o, s / 3600, 2);
+  put_uint(o, s / 60 % 60, 2);
+  put_uint(o, s % 60, 2);
+  put_char(o, '.');
+  put_uint(o, ms_of_day % 1000 / 10, 2);
+}
+
+/* ddmmyy, days counted from 1970-01-01. */
+static void put_date(out_t *o, u32 days)
+{
+  /* Gregorian date from a day number, see Howard Hinnant's
+   * civil_from_days. */
+  u32 z = days + 719468;
+  u32 era = z / 146097;
+  u32 doe = z - era * 146097;
+  u32 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  u32 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  u32 mp = (5 * doy + 2) / 153;
+  u32 d = doy - (153 * mp + 2) / 5 + 1;
+  u32 m = mp < 10 ? mp + 3 : mp - 9;
+  u32 y = yoe + era * 400 + (m <= 2);
+
+  put_uint(o, d, 2);
+  put_uint(o, m, 2);
+  put_uint(o, y % 100, 2);
+}
+
+static inline void begin(out_t *o, const char *type)
+{
+  *o->p++ = '$';
+  o->cs = 0;
+  put_str(o, "GP");
+  put_str(o, type);
+}
+
+static inline void end(out_t *o)
+{
+  u8 cs = o->cs;
+
+  *o->p++ = '*';
+  *o->p++ = hex[cs >> 4];
+  *o->p++ = hex[cs & 0xF];
+  *o->p++ = '\r';
+  *o->p++ = '\n';
+}
+
+static inline s32 clamp(s32 v, s32 limit)
+{
+  return v > limit ? limit : v < -limit ? -limit : v;
+}
+
+/* Set up to write every sentence. */
+void nmea_init(nmea_t *n)
+{
+  n->sentences = NMEA_ALL;
+  n->epochs = 0;
+}
+
+/*
+ * Write the sentences for the epoch in sol into n->buf. Returns the number
+ * of characters written, at most NMEA_MAX_EPOCH; the text isn't terminated.
+ */
+u16 nmea_epoch(nmea_t *n, const solution_t *sol)
+{
+  const msg_pos_llh_t *pos = &sol->pos_llh;
+  const msg_vel_ned_t *vel = &sol->vel_ned;
+  const msg_dops_t *dops = &sol->dops;
+  out_t o = { n->buf, 0 };
+  u32 wn = sol->gps_time.wn, tow, ms_of_day, days;
+  u8 mode = pos->flags & POS_MODE_MASK, fix = pos->n_sats > 0, quality;
+  s32 alt_mm, course, knots, kmh;
+  float speed, heading;
+
+  /* UTC from GPS time. */
+  if (pos->tow >= NMEA_LEAP_SECONDS * 1000U) {
+    tow = pos->tow - NMEA_LEAP_SECONDS * 1000U;
+  } else {
+    tow = pos->tow + MS_PER_WEEK - NMEA_LEAP_SECONDS * 1000U;
+    wn--;
+  }
+  ms_of_day = tow % MS_PER_DAY;
+  days = GPS_EPOCH_DAYS + wn * 7 + tow / MS_PER_DAY;
+
+  if (!fix)
+    quality = 0;
+  else if (mode == POS_MODE_FIXED)
+    quality = 4;
+  else if (mode == POS_MODE_FLOAT)
+    quality = 5;
+  else
+    quality = 1;
+
+  /* Course over ground in tenths of a degree, speeds in hundredths. */
+  speed = sqrtf((float)vel->n * vel->n + (float)vel->e * vel->e);
+  heading = atan2f(vel->e, vel->n);
+  if (heading < 0)
+    heading += 2 * (float)M_PI;
+  course = (s32)(heading * DECIDEG_PER_RAD + 0.5f);
+  if (course >= 3600)
+    course -= 3600;
+  knots = clamp((s32)(speed * KNOTS_PER_MM_S * 100 + 0.5f), MAX_SPEED_CENTI);
+  kmh = clamp((s32)(speed * KMH_PER_MM_S * 100 + 0.5f), MAX_SPEED_CENTI);
+  alt_mm = fabs(pos->height) < MAX_ALT_MM / 1000.0 ?
+           (s32)floor(pos->height * 1000 + 0.5) :
+           pos->height < 0 ? -MAX_ALT_MM : MAX_ALT_MM;
+
+  if (n->sentences & NMEA_GGA) {
+    begin(&o, "GGA,");
+    put_time(&o, ms_of_day);
+    put_char(&o, ',');
+    put_angle(&o, pos->lat, 2, 'N', 'S');
+    put_char(&o, ',');
+    put_angle(&o, pos->lon, 3, 'E', 'W');
+    put_char(&o, ',');
+    put_uint(&o, quality, 1);
+    put_char(&o, ',');
+    put_uint(&o, pos->n_sats, 2);
+    put_char(&o, ',');
+    put_fixed(&o, dops->hdop, 2);
+    put_char(&o, ',');
+    put_fixed(&o, alt_mm, 3);
+    put_str(&o, ",M,0.0,M,,");
+    end(&o);
+  }
+
+  if (n->sentences & NMEA_RMC) {
+    begin(&o, "RMC,");
+    put_time(&o, ms_of_day);
+    put_str(&o, fix ? ",A," : ",V,");
+    put_angle(&o, pos->lat, 2, 'N', 'S');
+    put_char(&o, ',');
+    put_angle(&o, pos->lon, 3, 'E', 'W');
+    put_char(&o, ',');
+    put_fixed(&o, knots, 2);
+    put_char(&o, ',');
+    put_fixed(&o, course, 1);
+    put_char(&o, ',');
+    put_date(&o, days);
+    put_str(&o, ",,,");
+    put_char(&o, !fix ? 'N' : quality == 1 ? 'A' : 'D');
+    end(&o);
+  }
+
+  if (n->sentences & NMEA_VTG) {
+    begin(&o, "VTG,");
+    put_fixed(&o, course, 1);
+    put_str(&o, ",T,,M,");
+    put_fixed(&o, knots, 2);
+    put_str(&o, ",N,");
+    put_fixed(&o, kmh, 2);
+    put_str(&o, ",K,");
+    put_char(&o, !fix ? 'N' : quality == 1 ? 'A' : 'D');
+    end(&o);
+  }
+
+  if (n->sentences & NMEA_GSA) {
+    begin(&o, "GSA,A,");
+    put_char(&o, !fix ? '1' : pos->n_sats >= 4 ? '3' : '2');
+    put_str(&o, ",,,,,,,,,,,,,");
+    put_fixed(&o, dops->pdop, 2);
+    put_char(&o, ',');
+    put_fixed(&o, dops->hdop, 2);
+    put_char(&o, ',');
+    put_fixed(&o, dops->vdop, 2);
+    end(&o);
+  }
+
+  n->epochs++;
+  return o.p - n->buf;
+}
+
+/*
+ * Feed a message the receiver has just stored in sol, from the receiver hook.
+ * Writes an epoch once the velocity of the latest position arrives, and
+ * returns its length, or 0.
+ */
+u16 nmea_message(nmea_t *n, const solution_t *sol, u16 msg_type)
+{
+  if (msg_type != SBP_MSG_VEL_NED || sol->vel_ned.tow != sol->pos_llh.tow)
+    return 0;
+  return nmea_epoch(n, sol);
+}
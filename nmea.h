@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * nmea turns each epoch of the solution into NMEA 0183 sentences for
+ * consumers that don't speak SBP: GGA (fix), RMC (minimum navigation data),
+ * VTG (course and speed) and GSA (DOPs).
+ *
+ * An epoch is complete when the MSG_VEL_NED with the time of week of the
+ * last MSG_POS_LLH arrives; the week comes from MSG_GPS_TIME and the DOPs
+ * from the latest MSG_DOPS. Times and dates are UTC, NMEA_LEAP_SECONDS behind
+ * GPS time. Heights are above the ellipsoid, with a geoid separation of 0,
+ * and GSA leaves the satellite numbers empty since SBP doesn't list them
+ * here.
+ *
+ * Sentences are written into the buffer in nmea_t with no sprintf, floating
+ * point formatting or heap: every field is scaled to an integer and written
+ * digit by digit, and the checksum is XORed in as each character goes out.
+ * The fields have fixed widths or bounded ranges, so the cost per epoch is
+ * bounded too.
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_NMEA_H
+#define SBP_TUTORIAL_NMEA_H
+
+#include <libsbp/common.h>
+
+#include <receiver.h>
+
+/* GPS - UTC, in seconds. */
+#ifndef NMEA_LEAP_SECONDS
+#define NMEA_LEAP_SECONDS 18
+#endif
+
+/* Sentences to write, for nmea_t.sentences. */
+#define NMEA_GGA 0x01
+#define NMEA_RMC 0x02
+#define NMEA_VTG 0x04
+#define NMEA_GSA 0x08
+#define NMEA_ALL (NMEA_GGA | NMEA_RMC | NMEA_VTG | NMEA_GSA)
+
+/* Longest sentence allowed by NMEA 0183, from '$' to "\r\n". */
+#define NMEA_MAX_SENTENCE 82
+#define NMEA_MAX_EPOCH    (4 * NMEA_MAX_SENTENCE)
+
+typedef struct {
+  u8 sentences;    /* Which to write, NMEA_ALL by default. */
+  u32 epochs;      /* Epochs written. */
+  char buf[NMEA_MAX_EPOCH];
+} nmea_t;
+
+void nmea_init(nmea_t *n);
+u16 nmea_message(nmea_t *n, const solution_t *sol, u16 msg_type);
+u16 nmea_epoch(nmea_t *n, const solution_t *sol);
+
+#endif /* SBP_TUTORIAL_NMEA_H */
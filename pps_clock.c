@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <pps_clock.h>
+
+#define NS_PER_S       1000000000ULL
+#define NS_PER_MS      1000000ULL
+#define SECS_PER_WEEK  604800
+#define NS_PER_WEEK    ((s64)SECS_PER_WEEK * (s64)NS_PER_S)
+/* Edges missing for longer than this restart the model. */
+#define MAX_GAP_S      4
+
+/*
+ * Initialize the model for a counter nominally running at nominal_hz.
+ * The tick to nanosecond conversion is exact for tick rates up to 1 GHz.
+ */
+void pps_clock_init(pps_clock_t *c, u32 nominal_hz)
+{
+  c->nominal_hz = nominal_hz;
+  c->period_q16 = 0;
+  c->edge_ticks = 0;
+  c->edge_valid = 0;
+  c->rejects = 0;
+  c->locked = 0;
+  c->ref_wn = 0;
+  c->ref_tow_s = 0;
+  c->n_edges = 0;
+  c->n_rejected = 0;
+}
+
+static u64 period_estimate(const pps_clock_t *c)
+{
+  if (c->period_q16)
+    return c->period_q16;
+  return (u64)c->nominal_hz << 16;
+}
+
+/*
+ * Feed the tick count captured at a PPS edge into the model.
+ * Edges must be fed in the order they occurred. Missed edges are tolerated,
+ * edges that are not a whole number of seconds after the previous one are
+ * rejected.
+ */
+void pps_clock_edge(pps_clock_t *c, u32 ticks)
+{
+  u32 dt, period, n;
+  u64 expected, err, measured;
+
+  if (!c->edge_valid) {
+    c->edge_ticks = ticks;
+    c->edge_valid = 1;
+    c->n_edges++;
+    return;
+  }
+
+  dt = ticks - c->edge_ticks;
+  period = (u32)(period_estimate(c) >> 16);
+  n = (dt + period / 2) / period;
+  expected = (u64)n * period;
+  err = (dt > expected) ? dt - expected : expected - dt;
+
+  if (n == 0 || n > MAX_GAP_S ||
+      err * 1000000 > (u64)PPS_CLOCK_TOLERANCE_PPM * expected) {
+    c->n_rejected++;
+    if (++c->rejects >= PPS_CLOCK_MAX_REJECTS) {
+      /* Either the edges or the counter are not what we think they are,
+       * start again from this edge. */
+      c->edge_ticks = ticks;
+      c->period_q16 = 0;
+      c->locked = 0;
+      c->rejects = 0;
+    }
+    return;
+  }
+
+  measured = ((u64)dt << 16) / n;
+  if (c->period_q16 == 0)
+    c->period_q16 = measured;
+  else
+    c->period_q16 += (s64)(measured - c->period_q16) /
+                     (1 << PPS_CLOCK_FILTER_SHIFT);
+
+  c->edge_ticks = ticks;
+  c->rejects = 0;
+  c->n_edges++;
+
+  /* Carry the GPS time label forward to the new edge. */
+  if (c->locked) {
+    c->ref_tow_s += n;
+    if (c->ref_tow_s >= SECS_PER_WEEK) {
+      c->ref_tow_s -= SECS_PER_WEEK;
+      c->ref_wn++;
+    }
+  }
+}
+
+/*
+ * Label the most recent PPS edge with the GPS time from a MSG_GPS_TIME.
+ * Only whole second solutions are used, and only if they arrive within a
+ * second of the edge they belong to (now_ticks is the receive time).
+ * Returns 1 if the label was applied, 0 otherwise.
+ */
+u8 pps_clock_label(pps_clock_t *c, u16 wn, u32 tow, u32 now_ticks)
+{
+  if (!c->edge_valid || tow % 1000 != 0)
+    return 0;
+
+  if ((u64)(now_ticks - c->edge_ticks) << 16 >= period_estimate(c))
+    return 0;
+
+  c->ref_wn = wn;
+  c->ref_tow_s = tow / 1000;
+  c->locked = 1;
+  return 1;
+}
+
+/*
+ * Convert a local tick count to GPS time. ticks may be before or after the
+ * most recent edge, as long as it is within 2^31 ticks of it.
+ * Returns 1 if t was filled in, 0 if the model has no GPS time label yet.
+ */
+u8 pps_clock_gps_time(const pps_clock_t *c, u32 ticks, gps_stamp_t *t)
+{
+  u64 period, q, secs, rem;
+  s64 dt_ns, tow_ns;
+  s32 dt;
+  u16 wn;
+
+  if (!c->locked)
+    return 0;
+
+  period = period_estimate(c);
+  dt = (s32)(ticks - c->edge_ticks);
+  q = (u64)(dt < 0 ? -(s64)dt : dt) << 16;
+  secs = q / period;
+  rem = q - secs * period;
+  /* Drop 12 fractional bits so the multiply stays inside 64 bits. */
+  dt_ns = secs * NS_PER_S + ((rem >> 12) * NS_PER_S) / (period >> 12);
+  if (dt < 0)
+    dt_ns = -dt_ns;
+
+  wn = c->ref_wn;
+  tow_ns = (s64)c->ref_tow_s * NS_PER_S + dt_ns;
+  while (tow_ns < 0) {
+    tow_ns += NS_PER_WEEK;
+    wn--;
+  }
+  while (tow_ns >= NS_PER_WEEK) {
+    tow_ns -= NS_PER_WEEK;
+    wn++;
+  }
+
+  t->wn = wn;
+  t->tow = (u32)(tow_ns / NS_PER_MS);
+  t->ns = (u32)(tow_ns % NS_PER_MS);
+  return 1;
+}
+
+/*
+ * Frequency error of the local counter relative to GPS time, in parts per
+ * billion. Positive means the local counter runs fast.
+ */
+s32 pps_clock_drift_ppb(const pps_clock_t *c)
+{
+  s64 nominal_q16, diff;
+
+  if (c->period_q16 == 0)
+    return 0;
+
+  nominal_q16 = (s64)c->nominal_hz << 16;
+  diff = (s64)c->period_q16 - nominal_q16;
+  /* diff * 1e9 / nominal_q16, rearranged to stay inside 64 bits. */
+  return (s32)(diff * 15625000 / (nominal_q16 >> 6));
+}
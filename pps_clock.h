@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * pps_clock relates a free running local tick counter to GPS time, using the
+ * PPS edges from Piksi (captured by a timer) and the GPS week / time of week
+ * carried by MSG_GPS_TIME.
+ *
+ * The model is a straight line: an offset (the tick count of the most recent
+ * labelled PPS edge) plus a drift estimate (the measured number of local ticks
+ * per GPS second). It contains no hardware access so it can be exercised on a
+ * host with synthetic edge sequences.
+ */
+
+#ifndef SBP_TUTORIAL_PPS_CLOCK_H
+#define SBP_TUTORIAL_PPS_CLOCK_H
+
+#include <libsbp/common.h>
+
+/* PPS edges further than this from a whole number of nominal seconds apart
+ * are rejected as glitches, in parts per million. */
+#define PPS_CLOCK_TOLERANCE_PPM 1000
+/* Number of consecutive rejected edges after which the model restarts. */
+#define PPS_CLOCK_MAX_REJECTS   3
+/* The period estimate moves 1/2^PPS_CLOCK_FILTER_SHIFT of the way towards
+ * each new measurement. */
+#define PPS_CLOCK_FILTER_SHIFT  3
+
+/* A point in GPS time, split the same way as MSG_GPS_TIME. */
+typedef struct {
+  u16 wn;  /* GPS week number. */
+  u32 tow; /* GPS time of week, milliseconds. */
+  u32 ns;  /* Sub-millisecond part, nanoseconds (0 - 999999). */
+} gps_stamp_t;
+
+typedef struct {
+  u32 nominal_hz;  /* Expected local tick rate. */
+  u64 period_q16;  /* Estimated local ticks per GPS second, Q48.16. */
+  u32 edge_ticks;  /* Tick count of the most recent accepted PPS edge. */
+  u8  edge_valid;  /* edge_ticks holds an edge. */
+  u8  rejects;     /* Consecutive rejected edges. */
+  u8  locked;      /* Most recent edge has a GPS time label. */
+  u16 ref_wn;      /* GPS week of the most recent edge. */
+  u32 ref_tow_s;   /* GPS time of week of the most recent edge, seconds. */
+  u32 n_edges;     /* Accepted edges. */
+  u32 n_rejected;  /* Rejected edges. */
+} pps_clock_t;
+
+void pps_clock_init(pps_clock_t *c, u32 nominal_hz);
+void pps_clock_edge(pps_clock_t *c, u32 ticks);
+u8 pps_clock_label(pps_clock_t *c, u16 wn, u32 tow, u32 now_ticks);
+u8 pps_clock_gps_time(const pps_clock_t *c, u32 ticks, gps_stamp_t *t);
+s32 pps_clock_drift_ppb(const pps_clock_t *c);
+
+#endif /* SBP_TUTORIAL_PPS_CLOCK_H */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stddef.h>
+
+#include <receiver.h>
+
+/*
+ * A frame with a good CRC can still be shorter than the message it claims to
+ * be (or the wrong message altogether), so check the payload length before
+ * copying it. Longer payloads are accepted, later firmware may append fields.
+ * Returns 1 if the payload holds at least size bytes.
+ */
+static u8 check_len(receiver_t *r, u8 len, u32 size)
+{
+  if (len >= size)
+    return 1;
+  r->n_short_frames++;
+  return 0;
+}
+
+static void run_hook(receiver_t *r, u16 msg_type)
+{
+  if (r->hook)
+    r->hook(r, msg_type, r->hook_context);
+}
+
+/*
+ * Callback functions to interpret SBP messages.
+ * Every message ID has a callback associated with it to
+ * receive and interpret the message payload. The callback
+ * context is the receiver_t the message was received by.
+ */
+static void sbp_pos_llh_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  receiver_t *r = context;
+  if (!check_len(r, len, sizeof(msg_pos_llh_t)))
+    return;
+  r->sol.pos_llh = *(msg_pos_llh_t *)msg;
+  run_hook(r, SBP_MSG_POS_LLH);
+}
+static void sbp_baseline_ned_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  receiver_t *r = context;
+  if (!check_len(r, len, sizeof(msg_baseline_ned_t)))
+    return;
+  r->sol.baseline_ned = *(msg_baseline_ned_t *)msg;
+  run_hook(r, SBP_MSG_BASELINE_NED);
+}
+static void sbp_vel_ned_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  receiver_t *r = context;
+  if (!check_len(r, len, sizeof(msg_vel_ned_t)))
+    return;
+  r->sol.vel_ned = *(msg_vel_ned_t *)msg;
+  run_hook(r, SBP_MSG_VEL_NED);
+}
+static void sbp_dops_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  receiver_t *r = context;
+  if (!check_len(r, len, sizeof(msg_dops_t)))
+    return;
+  r->sol.dops = *(msg_dops_t *)msg;
+  run_hook(r, SBP_MSG_DOPS);
+}
+static void sbp_gps_time_callback(u16 sender_id, u8 len, u8 msg[], void *context)
+{
+  receiver_t *r = context;
+  if (!check_len(r, len, sizeof(msg_gps_time_t)))
+    return;
+  r->sol.gps_time = *(msg_gps_time_t *)msg;
+  run_hook(r, SBP_MSG_GPS_TIME);
+}
+
+/*
+ * Set up SwiftNav Binary Protocol (SBP) nodes; the sbp_process function will
+ * search through these to find the callback for a particular message ID.
+ *
+ * Example: sbp_pos_llh_callback is registered with sbp_state, and is associated
+ * with both a unique sbp_msg_callbacks_node_t and the message ID SBP_POS_LLH.
+ * When a valid SBP message with the ID SBP_POS_LLH comes through the UART, written
+ * to the FIFO, and then parsed by sbp_process, sbp_pos_llh_callback is called
+ * with the data carried by that message.
+ */
+void receiver_setup(receiver_t *r, fifo_t *fifo)
+{
+  sbp_state_t *s = &r->sbp_state;
+
+  r->hook = NULL;
+  r->hook_context = NULL;
+  r->frame_hook = NULL;
+  r->frame_hook_context = NULL;
+  r->n_frames = 0;
+  r->n_crc_errors = 0;
+  r->n_short_frames = 0;
+
+  /* SBP parser state must be initialized before sbp_process is called. */
+  sbp_state_init(s);
+  /* fifo_read is passed the FIFO to read from through the io context. */
+  sbp_state_set_io_context(s, fifo);
+
+  /* Register a node and callback, and associate them with a specific message ID. */
+  sbp_register_callback(s, SBP_MSG_GPS_TIME, &sbp_gps_time_callback,
+                        r, &r->gps_time_node);
+  sbp_register_callback(s, SBP_MSG_POS_LLH, &sbp_pos_llh_callback,
+                        r, &r->pos_llh_node);
+  sbp_register_callback(s, SBP_MSG_BASELINE_NED, &sbp_baseline_ned_callback,
+                        r, &r->baseline_ned_node);
+  sbp_register_callback(s, SBP_MSG_VEL_NED, &sbp_vel_ned_callback,
+                        r, &r->vel_ned_node);
+  sbp_register_callback(s, SBP_MSG_DOPS, &sbp_dops_callback,
+                        r, &r->dops_node);
+}
+
+/* Have hook called after each message is stored in the solution. */
+void receiver_set_hook(receiver_t *r, receiver_hook_t hook, void *context)
+{
+  r->hook = hook;
+  r->hook_context = context;
+}
+
+/* Have hook called after every frame with a good CRC. */
+void receiver_set_frame_hook(receiver_t *r, receiver_frame_hook_t hook,
+                             void *context)
+{
+  r->frame_hook = hook;
+  r->frame_hook_context = context;
+}
+
+/*
+ * Consume received bytes from the FIFO and parse the SBP messages in them.
+ * Must be called periodically. Returns the result of sbp_process.
+ */
+s8 receiver_process(receiver_t *r)
+{
+  s8 ret = sbp_process(&r->sbp_state, &fifo_read);
+
+  if (ret == SBP_OK_CALLBACK_EXECUTED || ret == SBP_OK_CALLBACK_UNDEFINED) {
+    r->n_frames++;
+    if (r->frame_hook)
+      r->frame_hook(r, r->frame_hook_context);
+  } else if (ret == SBP_CRC_ERROR)
+    r->n_crc_errors++;
+  return ret;
+}
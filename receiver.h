@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * receiver ties an SBP parser to a FIFO of received bytes and keeps the
+ * latest copy of each message we're interested in. It contains no hardware
+ * access, so the same code runs on the board and on a host.
+ */
+
+#ifndef SBP_TUTORIAL_RECEIVER_H
+#define SBP_TUTORIAL_RECEIVER_H
+
+#include <libsbp/common.h>
+#include <libsbp/sbp.h>
+#include <libsbp/navigation.h>
+
+#include <fifo.h>
+
+/* SBP structs that messages from Piksi will feed. */
+typedef struct {
+  msg_gps_time_t     gps_time;
+  msg_pos_llh_t      pos_llh;
+  msg_baseline_ned_t baseline_ned;
+  msg_vel_ned_t      vel_ned;
+  msg_dops_t         dops;
+} solution_t;
+
+typedef struct receiver receiver_t;
+
+/* Called after a message has been stored in the solution. */
+typedef void (*receiver_hook_t)(receiver_t *r, u16 msg_type, void *context);
+
+/*
+ * Called after every frame with a good CRC, whatever its type. The frame's
+ * type, sender, length, payload and CRC are in r->sbp_state.
+ */
+typedef void (*receiver_frame_hook_t)(receiver_t *r, void *context);
+
+struct receiver {
+  /*
+   * State of the SBP message parser.
+   * Must be statically allocated.
+   */
+  sbp_state_t sbp_state;
+
+  /*
+   * SBP callback nodes must be statically allocated. Each message ID / callback
+   * pair must have a unique sbp_msg_callbacks_node_t associated with it.
+   */
+  sbp_msg_callbacks_node_t gps_time_node;
+  sbp_msg_callbacks_node_t pos_llh_node;
+  sbp_msg_callbacks_node_t baseline_ned_node;
+  sbp_msg_callbacks_node_t vel_ned_node;
+  sbp_msg_callbacks_node_t dops_node;
+
+  solution_t sol;
+
+  receiver_hook_t hook;
+  void *hook_context;
+  receiver_frame_hook_t frame_hook;
+  void *frame_hook_context;
+
+  u32 n_frames;       /* Frames with a good CRC. */
+  u32 n_crc_errors;   /* Frames with a bad CRC. */
+  u32 n_short_frames; /* Frames too short for their message type. */
+};
+
+void receiver_setup(receiver_t *r, fifo_t *fifo);
+void receiver_set_hook(receiver_t *r, receiver_hook_t hook, void *context);
+void receiver_set_frame_hook(receiver_t *r, receiver_frame_hook_t hook,
+                             void *context);
+s8 receiver_process(receiver_t *r);
+
+#endif /* SBP_TUTORIAL_RECEIVER_H */
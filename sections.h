@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Memory placement attributes, see arm-gcc-link.ld.
+ *
+ * CCM_BSS puts a zero initialised variable in the core coupled memory. CCM has
+ * no wait states and is off the bus matrix, so the CPU never contends with DMA
+ * for it - but DMA can't reach it either. Variables must not have a non-zero
+ * initializer.
+ *
+ * RAMFUNC puts a function in SRAM, copied from flash at reset, so it runs
+ * without flash wait states.
+ *
+ * Define DISABLE_MEMORY_PLACEMENT to link everything in the default sections,
+ * e.g. to compare cycle counts with and without placement. Placement is always
+ * disabled when building for a host.
+ */
+
+#ifndef SBP_TUTORIAL_SECTIONS_H
+#define SBP_TUTORIAL_SECTIONS_H
+
+#if defined(DISABLE_MEMORY_PLACEMENT) || !defined(__arm__)
+#define CCM_BSS
+#define RAMFUNC
+#else
+#define CCM_BSS __attribute__ ((section(".ccmbss")))
+#define RAMFUNC __attribute__ ((section(".ramfunc"), noinline))
+#endif
+
+#endif /* SBP_TUTORIAL_SECTIONS_H */
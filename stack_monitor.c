@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stm32f4xx.h>
+
+#include <stack_monitor.h>
+
+/* Stack bounds, from arm-gcc-link.ld. */
+extern unsigned long __StackLimit;
+extern unsigned long __StackTop;
+
+/* First word of the stack that is usable (above the guard region, if any). */
+static u32 *stack_bottom(void)
+{
+#ifdef STACK_GUARD
+  u32 guard = ((u32)&__StackLimit + STACK_GUARD_SIZE - 1) &
+              ~(u32)(STACK_GUARD_SIZE - 1);
+  return (u32 *)(guard + STACK_GUARD_SIZE);
+#else
+  return (u32 *)&__StackLimit;
+#endif
+}
+
+#ifdef STACK_GUARD
+/* Use MPU region 0 to make the bottom of the stack inaccessible. */
+static void stack_guard_setup(void)
+{
+  u32 guard = ((u32)&__StackLimit + STACK_GUARD_SIZE - 1) &
+              ~(u32)(STACK_GUARD_SIZE - 1);
+
+  MPU->RNR = 0;
+  MPU->RBAR = guard;
+  /* No access, execute never, 2^(4+1) = 32 bytes. */
+  MPU->RASR = (1UL << 28) | (0UL << 24) | (4UL << MPU_RASR_SIZE_Pos) |
+              MPU_RASR_ENABLE_Msk;
+  /* Everything else keeps the default memory map. */
+  MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+  SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+  __DSB();
+  __ISB();
+}
+#endif
+
+/*
+ * Paint everything below the current stack pointer.
+ * Call first thing in main, before anything has used much stack.
+ */
+void stack_paint(void)
+{
+  u32 *p = stack_bottom();
+  u32 *sp = (u32 *)__get_MSP();
+
+  while (p < sp)
+    *p++ = STACK_PAINT;
+
+#ifdef STACK_GUARD
+  stack_guard_setup();
+#endif
+}
+
+/* Usable stack size in bytes. */
+u32 stack_size(void)
+{
+  return (u32)&__StackTop - (u32)stack_bottom();
+}
+
+/* Most stack ever used, in bytes. */
+u32 stack_watermark(void)
+{
+  u32 *p = stack_bottom();
+  u32 *top = (u32 *)&__StackTop;
+
+  while (p < top && *p == STACK_PAINT)
+    p++;
+  return (u32)top - (u32)p;
+}
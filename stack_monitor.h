@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * stack_monitor measures how much of the stack (pulStack, see
+ * startup_stm32f4xx.c) has ever been used, so STACK_SIZE can be trimmed
+ * with confidence.
+ *
+ * stack_paint fills the unused part of the stack with a known pattern and must
+ * be called first thing in main. stack_watermark then finds the deepest point
+ * the stack has reached by looking for the first word the pattern has been
+ * overwritten in, scanning up from the bottom. Its cost is proportional to the
+ * amount of stack never used.
+ *
+ * Build with STACK_GUARD defined to also make the bottom STACK_GUARD_SIZE
+ * bytes of the stack inaccessible with the MPU, so an overflow raises a
+ * MemManage fault instead of silently corrupting memory below the stack.
+ */
+
+#ifndef SBP_TUTORIAL_STACK_MONITOR_H
+#define SBP_TUTORIAL_STACK_MONITOR_H
+
+#include <stm32f4xx.h>
+
+#define STACK_PAINT      0xC5C5C5C5
+#define STACK_GUARD_SIZE 32
+
+void stack_paint(void);
+u32 stack_size(void);
+u32 stack_watermark(void);
+
+#endif /* SBP_TUTORIAL_STACK_MONITOR_H */
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libsbp/navigation.h>
+
+#include <stats.h>
+
+const char *stats_channel_names[STATS_N_CHANNELS] = {
+  "baseline_n", "baseline_e", "baseline_d", "lat", "lon", "height",
+  "gdop", "pdop", "tdop", "hdop", "vdop",
+};
+
+const char *stats_channel_units[STATS_N_CHANNELS] = {
+  "m", "m", "m", "deg", "deg", "m", "", "", "", "", "",
+};
+
+/* Set up empty statistics, alpha the weight of the newest sample in the
+ * decayed ones. */
+void stats_init(stats_t *s, double alpha)
+{
+  memset(s, 0, sizeof(*s));
+  s->alpha = alpha;
+}
+
+static void running_add(stats_running_t *r, double x)
+{
+  double d = x - r->mean;
+
+  r->n++;
+  r->mean += d / r->n;
+  r->m2 += d * (x - r->mean);
+  if (r->n == 1 || x < r->min)
+    r->min = x;
+  if (r->n == 1 || x > r->max)
+    r->max = x;
+}
+
+static void window_add(stats_window_t *w, double x)
+{
+  u32 seq = w->seq;
+  double d, old, mean;
+
+  if (w->n == STATS_WINDOW) {
+    /* Replace the oldest sample. */
+    old = w->x[seq & STATS_WINDOW_MASK];
+    mean = w->mean + (x - old) / STATS_WINDOW;
+    w->m2 += (x - old) * (x - mean + old - w->mean);
+    w->mean = mean;
+    if (w->m2 < 0)
+      w->m2 = 0;
+  } else {
+    w->n++;
+    d = x - w->mean;
+    w->mean += d / w->n;
+    w->m2 += d * (x - w->mean);
+  }
+  w->x[seq & STATS_WINDOW_MASK] = x;
+
+  /* Drop the sample leaving the window from the front of the queues, and
+   * samples the new one supersedes from the back. */
+  if (w->min_head != w->min_tail &&
+      w->minq[w->min_head & STATS_WINDOW_MASK] + STATS_WINDOW <= seq)
+    w->min_head++;
+  while (w->min_head != w->min_tail &&
+         w->x[w->minq[(w->min_tail - 1) & STATS_WINDOW_MASK] &
+              STATS_WINDOW_MASK] >= x)
+    w->min_tail--;
+  w->minq[w->min_tail++ & STATS_WINDOW_MASK] = seq;
+
+  if (w->max_head != w->max_tail &&
+      w->maxq[w->max_head & STATS_WINDOW_MASK] + STATS_WINDOW <= seq)
+    w->max_head++;
+  while (w->max_head != w->max_tail &&
+         w->x[w->maxq[(w->max_tail - 1) & STATS_WINDOW_MASK] &
+              STATS_WINDOW_MASK] <= x)
+    w->max_tail--;
+  w->maxq[w->max_tail++ & STATS_WINDOW_MASK] = seq;
+
+  w->seq = seq + 1;
+}
+
+static void decay_add(stats_decay_t *e, double x, double alpha)
+{
+  double d, incr;
+
+  e->n++;
+  if (alpha < 1.0 / e->n)
+    alpha = 1.0 / e->n;
+  d = x - e->mean;
+  incr = alpha * d;
+  e->mean += incr;
+  e->var = (1 - alpha) * (e->var + d * incr);
+}
+
+/* Add a sample to one channel. */
+void stats_add(stats_t *s, u8 channel, double x)
+{
+  stats_channel_t *c = &s->ch[channel];
+
+  running_add(&c->all, x);
+  window_add(&c->window, x);
+  decay_add(&c->decay, x, s->alpha);
+}
+
+/* Feed a message the receiver has just stored in sol, from the receiver
+ * hook. */
+void stats_message(stats_t *s, const solution_t *sol, u16 msg_type)
+{
+  switch (msg_type) {
+  case SBP_MSG_BASELINE_NED:
+    stats_add(s, STATS_BASELINE_N, sol->baseline_ned.n * 1e-3);
+    stats_add(s, STATS_BASELINE_E, sol->baseline_ned.e * 1e-3);
+    stats_add(s, STATS_BASELINE_D, sol->baseline_ned.d * 1e-3);
+    break;
+  case SBP_MSG_POS_LLH:
+    stats_add(s, STATS_LAT, sol->pos_llh.lat);
+    stats_add(s, STATS_LON, sol->pos_llh.lon);
+    stats_add(s, STATS_HEIGHT, sol->pos_llh.height);
+    break;
+  case SBP_MSG_DOPS:
+    stats_add(s, STATS_GDOP, sol->dops.gdop * 0.01);
+    stats_add(s, STATS_PDOP, sol->dops.pdop * 0.01);
+    stats_add(s, STATS_TDOP, sol->dops.tdop * 0.01);
+    stats_add(s, STATS_HDOP, sol->dops.hdop * 0.01);
+    stats_add(s, STATS_VDOP, sol->dops.vdop * 0.01);
+    break;
+  }
+}
+
+/* Copy out the summaries. Sample variances, divided by n - 1. */
+void stats_snapshot(const stats_t *s, stats_snapshot_t *snap)
+{
+  const stats_channel_t *c;
+  stats_summary_t *o;
+  u8 i;
+
+  for (i = 0; i < STATS_N_CHANNELS; i++) {
+    c = &s->ch[i];
+    o = &snap->ch[i];
+    o->n = c->all.n;
+    o->mean = c->all.mean;
+    o->std = c->all.n > 1 ? sqrt(c->all.m2 / (c->all.n - 1)) : 0;
+    o->min = c->all.min;
+    o->max = c->all.max;
+    o->window_n = c->window.n;
+    o->window_mean = c->window.mean;
+    o->window_std = c->window.n > 1 ?
+                    sqrt(c->window.m2 / (c->window.n - 1)) : 0;
+    o->window_min = c->window.n ?
+      c->window.x[c->window.minq[c->window.min_head & STATS_WINDOW_MASK] &
+                  STATS_WINDOW_MASK] : 0;
+    o->window_max = c->window.n ?
+      c->window.x[c->window.maxq[c->window.max_head & STATS_WINDOW_MASK] &
+                  STATS_WINDOW_MASK] : 0;
+    o->decay_mean = c->decay.mean;
+    o->decay_std = sqrt(c->decay.var);
+  }
+}
+
+/*
+ * sprintf snap as CSV, header included, into str, which must have room for
+ * STATS_CSV_MAX_LEN characters. Returns the number of characters written.
+ */
+int stats_format_csv(char *str, const stats_snapshot_t *snap)
+{
+  const stats_summary_t *o;
+  int str_i = 0;
+  u8 i;
+
+  str_i += sprintf(str + str_i, "%s\n", STATS_CSV_HEADER);
+  for (i = 0; i < STATS_N_CHANNELS; i++) {
+    o = &snap->ch[i];
+    str_i += sprintf(str + str_i,
+                     "%s,%s,%u,%.12g,%.4g,%.12g,%.12g,%u,%.12g,%.4g,%.12g,"
+                     "%.12g,%.12g,%.4g\n",
+                     stats_channel_names[i], stats_channel_units[i],
+                     (unsigned)o->n, o->mean, o->std, o->min, o->max,
+                     (unsigned)o->window_n, o->window_mean, o->window_std,
+                     o->window_min, o->window_max, o->decay_mean,
+                     o->decay_std);
+  }
+  return str_i;
+}
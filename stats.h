@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * stats keeps running statistics of the solution as it arrives, e.g. to
+ * survey a base station without logging everything: the MSG_BASELINE_NED
+ * north, east and down, the MSG_POS_LLH latitude, longitude and height, and
+ * the five MSG_DOPS values are each a channel.
+ *
+ * Every channel is summarised three ways:
+ *
+ *   all     mean, variance, min and max of every sample (Welford's method)
+ *   window  the same over the last STATS_WINDOW samples, updated by adding
+ *           the new sample and removing the oldest; min and max come from
+ *           monotonic queues
+ *   decay   exponentially weighted mean and variance, weight alpha for the
+ *           newest sample (or 1 / n while that is larger, so it starts out
+ *           as the plain mean)
+ *
+ * An update is a fixed amount of work per channel, apart from the min and max
+ * queues, which pop at most one entry per sample on average. It's all done
+ * in double, since latitude and longitude need it; on the board that is
+ * software floating point, well within budget at 10 Hz.
+ *
+ * stats_snapshot copies the summaries out and stats_format_csv writes them
+ * as CSV, one line per channel:
+ *
+ *   channel,unit,n,mean,std,min,max,window_n,window_mean,window_std,
+ *   window_min,window_max,decay_mean,decay_std
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_STATS_H
+#define SBP_TUTORIAL_STATS_H
+
+#include <libsbp/common.h>
+
+#include <receiver.h>
+
+/* Samples in the window, a power of two. */
+#ifndef STATS_WINDOW
+#define STATS_WINDOW 64
+#endif
+#define STATS_WINDOW_MASK (STATS_WINDOW - 1)
+
+/* Default weight of the newest sample in the decayed statistics, a time
+ * constant of 100 samples. */
+#define STATS_DECAY_ALPHA 0.01
+
+#define STATS_BASELINE_N 0
+#define STATS_BASELINE_E 1
+#define STATS_BASELINE_D 2
+#define STATS_LAT        3
+#define STATS_LON        4
+#define STATS_HEIGHT     5
+#define STATS_GDOP       6
+#define STATS_PDOP       7
+#define STATS_TDOP       8
+#define STATS_HDOP       9
+#define STATS_VDOP       10
+#define STATS_N_CHANNELS 11
+
+#define STATS_CSV_HEADER "channel,unit,n,mean,std,min,max,window_n," \
+                         "window_mean,window_std,window_min,window_max," \
+                         "decay_mean,decay_std"
+/* Upper bound on the length of the text written by stats_format_csv. */
+#define STATS_CSV_MAX_LEN (150 + 260 * STATS_N_CHANNELS)
+
+typedef struct {
+  u32 n;
+  double mean;
+  double m2;     /* Sum of squared differences from the mean. */
+  double min;
+  double max;
+} stats_running_t;
+
+typedef struct {
+  double x[STATS_WINDOW]; /* Sample k is in x[k & STATS_WINDOW_MASK]. */
+  u32 seq;                /* Samples ever added. */
+  u32 n;                  /* Samples in the window. */
+  double mean;
+  double m2;
+  /* Sample numbers in the window whose values increase (min) or decrease
+   * (max) from head to tail; the head is the min or max. */
+  u32 minq[STATS_WINDOW], min_head, min_tail;
+  u32 maxq[STATS_WINDOW], max_head, max_tail;
+} stats_window_t;
+
+typedef struct {
+  u32 n;
+  double mean;
+  double var;
+} stats_decay_t;
+
+typedef struct {
+  stats_running_t all;
+  stats_window_t window;
+  stats_decay_t decay;
+} stats_channel_t;
+
+typedef struct {
+  double alpha;
+  stats_channel_t ch[STATS_N_CHANNELS];
+} stats_t;
+
+/* Summary of one channel, as handed to consumers. */
+typedef struct {
+  u32 n;
+  double mean, std, min, max;
+  u32 window_n;
+  double window_mean, window_std, window_min, window_max;
+  double decay_mean, decay_std;
+} stats_summary_t;
+
+typedef struct {
+  stats_summary_t ch[STATS_N_CHANNELS];
+} stats_snapshot_t;
+
+extern const char *stats_channel_names[STATS_N_CHANNELS];
+extern const char *stats_channel_units[STATS_N_CHANNELS];
+
+void stats_init(stats_t *s, double alpha);
+void stats_add(stats_t *s, u8 channel, double x);
+void stats_message(stats_t *s, const solution_t *sol, u16 msg_type);
+void stats_snapshot(const stats_t *s, stats_snapshot_t *snap);
+int stats_format_csv(char *str, const stats_snapshot_t *snap);
+
+#endif /* SBP_TUTORIAL_STATS_H */
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <status.h>
+
+/*
+ * sprintf the report for sol into str, which must have room for
+ * STATUS_MAX_LEN characters. Returns the number of characters written.
+ */
+int status_format(char *str, const solution_t *sol)
+{
+  /* Use snprintf to right justify floating point prints. A value too long
+   * for rj, e.g. a latitude of 1e300 from a corrupt frame, is cut short. */
+  char rj[30];
+  int str_i = 0;
+
+  str_i += sprintf(str + str_i, "\n\n\n\n");
+
+  /* Print GPS time. */
+  str_i += sprintf(str + str_i, "GPS Time:\n");
+  str_i += sprintf(str + str_i, "\tWeek\t\t: %6d\n", (int)sol->gps_time.wn);
+  snprintf(rj, sizeof(rj), "%6.2f", ((float)sol->gps_time.tow)/1e3);
+  str_i += sprintf(str + str_i, "\tSeconds\t: %9s\n", rj);
+  str_i += sprintf(str + str_i, "\n");
+
+  /* Print absolute position. */
+  str_i += sprintf(str + str_i, "Absolute Position:\n");
+  snprintf(rj, sizeof(rj), "%4.10lf", sol->pos_llh.lat);
+  str_i += sprintf(str + str_i, "\tLatitude\t: %17s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.10lf", sol->pos_llh.lon);
+  str_i += sprintf(str + str_i, "\tLongitude\t: %17s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.10lf", sol->pos_llh.height);
+  str_i += sprintf(str + str_i, "\tHeight\t: %17s\n", rj);
+  str_i += sprintf(str + str_i, "\tSatellites\t:     %02d\n", sol->pos_llh.n_sats);
+  str_i += sprintf(str + str_i, "\n");
+
+  /* Print NED (North/East/Down) baseline (position vector from base to rover). */
+  str_i += sprintf(str + str_i, "Baseline (mm):\n");
+  str_i += sprintf(str + str_i, "\tNorth\t\t: %6d\n", (int)sol->baseline_ned.n);
+  str_i += sprintf(str + str_i, "\tEast\t\t: %6d\n", (int)sol->baseline_ned.e);
+  str_i += sprintf(str + str_i, "\tDown\t\t: %6d\n", (int)sol->baseline_ned.d);
+  str_i += sprintf(str + str_i, "\n");
+
+  /* Print NED velocity. */
+  str_i += sprintf(str + str_i, "Velocity (mm/s):\n");
+  str_i += sprintf(str + str_i, "\tNorth\t\t: %6d\n", (int)sol->vel_ned.n);
+  str_i += sprintf(str + str_i, "\tEast\t\t: %6d\n", (int)sol->vel_ned.e);
+  str_i += sprintf(str + str_i, "\tDown\t\t: %6d\n", (int)sol->vel_ned.d);
+  str_i += sprintf(str + str_i, "\n");
+
+  /* Print Dilution of Precision metrics. */
+  str_i += sprintf(str + str_i, "Dilution of Precision:\n");
+  snprintf(rj, sizeof(rj), "%4.2f", ((float)sol->dops.gdop/100));
+  str_i += sprintf(str + str_i, "\tGDOP\t\t: %7s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.2f", ((float)sol->dops.hdop/100));
+  str_i += sprintf(str + str_i, "\tHDOP\t\t: %7s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.2f", ((float)sol->dops.pdop/100));
+  str_i += sprintf(str + str_i, "\tPDOP\t\t: %7s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.2f", ((float)sol->dops.tdop/100));
+  str_i += sprintf(str + str_i, "\tTDOP\t\t: %7s\n", rj);
+  snprintf(rj, sizeof(rj), "%4.2f", ((float)sol->dops.vdop/100));
+  str_i += sprintf(str + str_i, "\tVDOP\t\t: %7s\n", rj);
+  str_i += sprintf(str + str_i, "\n");
+
+  return str_i;
+}
+
+/*
+ * The fields of the report, where status_format puts each value (1 based,
+ * with 8 column tab stops) and its width there. Every value ends its line.
+ */
+enum {
+  F_WN, F_TOW, F_LAT, F_LON, F_HEIGHT, F_SATS, F_BASE_N, F_BASE_E, F_BASE_D,
+  F_VEL_N, F_VEL_E, F_VEL_D, F_GDOP, F_HDOP, F_PDOP, F_TDOP, F_VDOP,
+};
+
+typedef struct {
+  const char *key;
+  u8 row;
+  u8 col;
+  u8 width;
+} field_t;
+
+static const field_t fields[STATUS_N_FIELDS] = {
+  { "wn",      6, 27,  6 },
+  { "tow",     7, 19,  9 },
+  { "lat",    10, 27, 17 },
+  { "lon",    11, 27, 17 },
+  { "height", 12, 19, 17 },
+  { "sats",   13, 31,  2 },
+  { "base_n", 16, 27,  6 },
+  { "base_e", 17, 27,  6 },
+  { "base_d", 18, 27,  6 },
+  { "vel_n",  21, 27,  6 },
+  { "vel_e",  22, 27,  6 },
+  { "vel_d",  23, 27,  6 },
+  { "gdop",   26, 27,  7 },
+  { "hdop",   27, 27,  7 },
+  { "pdop",   28, 27,  7 },
+  { "tdop",   29, 27,  7 },
+  { "vdop",   30, 27,  7 },
+};
+
+/* First row below the report, where the cursor is left. */
+#define STATUS_ROWS_END 32
+
+static u64 double_bits(double v)
+{
+  u64 bits;
+
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+/* The value of field i, for comparison. */
+static u64 field_raw(const solution_t *sol, u8 i)
+{
+  switch (i) {
+  case F_WN:     return sol->gps_time.wn;
+  case F_TOW:    return sol->gps_time.tow;
+  case F_LAT:    return double_bits(sol->pos_llh.lat);
+  case F_LON:    return double_bits(sol->pos_llh.lon);
+  case F_HEIGHT: return double_bits(sol->pos_llh.height);
+  case F_SATS:   return sol->pos_llh.n_sats;
+  case F_BASE_N: return (u32)sol->baseline_ned.n;
+  case F_BASE_E: return (u32)sol->baseline_ned.e;
+  case F_BASE_D: return (u32)sol->baseline_ned.d;
+  case F_VEL_N:  return (u32)sol->vel_ned.n;
+  case F_VEL_E:  return (u32)sol->vel_ned.e;
+  case F_VEL_D:  return (u32)sol->vel_ned.d;
+  case F_GDOP:   return sol->dops.gdop;
+  case F_HDOP:   return sol->dops.hdop;
+  case F_PDOP:   return sol->dops.pdop;
+  case F_TDOP:   return sol->dops.tdop;
+  default:       return sol->dops.vdop;
+  }
+}
+
+/* Field i as status_format writes it, without the padding. */
+static void field_text(const solution_t *sol, u8 i, char *buf)
+{
+  switch (i) {
+  case F_WN:
+    snprintf(buf, STATUS_FIELD_LEN, "%d", (int)sol->gps_time.wn);
+    break;
+  case F_TOW:
+    snprintf(buf, STATUS_FIELD_LEN, "%.2f", ((float)sol->gps_time.tow)/1e3);
+    break;
+  case F_LAT:
+    snprintf(buf, STATUS_FIELD_LEN, "%.10lf", sol->pos_llh.lat);
+    break;
+  case F_LON:
+    snprintf(buf, STATUS_FIELD_LEN, "%.10lf", sol->pos_llh.lon);
+    break;
+  case F_HEIGHT:
+    snprintf(buf, STATUS_FIELD_LEN, "%.10lf", sol->pos_llh.height);
+    break;
+  case F_SATS:
+    snprintf(buf, STATUS_FIELD_LEN, "%02d", sol->pos_llh.n_sats);
+    break;
+  default:
+    /* The rest are integers, the DOPs in hundredths. */
+    if (i >= F_GDOP)
+      snprintf(buf, STATUS_FIELD_LEN, "%.2f",
+               ((float)field_raw(sol, i)/100));
+    else
+      snprintf(buf, STATUS_FIELD_LEN, "%d", (int)(s32)field_raw(sol, i));
+    break;
+  }
+}
+
+/* Start with nothing sent, in mode (STATUS_DIFF_KV or STATUS_DIFF_ANSI). */
+void status_diff_init(status_diff_t *d, u8 mode)
+{
+  memset(d, 0, sizeof(*d));
+  d->mode = mode;
+}
+
+/* Send everything again on the next call, e.g. after the terminal was
+ * cleared or a consumer reconnected. */
+void status_diff_reset(status_diff_t *d)
+{
+  d->valid = 0;
+}
+
+/*
+ * Write the fields of sol that changed since the last call into str, which
+ * must have room for STATUS_DIFF_MAX_LEN characters. The first call after
+ * status_diff_init or status_diff_reset writes all of them: in ANSI mode
+ * that is the whole report from status_format, on a cleared screen. Returns
+ * the number of characters written, 0 if nothing changed.
+ */
+int status_diff_format(status_diff_t *d, char *str, const solution_t *sol)
+{
+  char text[STATUS_FIELD_LEN];
+  int str_i = 0;
+  u64 raw;
+  u8 i, full = !d->valid;
+
+  if (full && d->mode == STATUS_DIFF_ANSI) {
+    str_i += sprintf(str, "\x1b[H\x1b[2J");
+    str_i += status_format(str + str_i, sol);
+  }
+
+  for (i = 0; i < STATUS_N_FIELDS; i++) {
+    /* Most fields don't change between calls, and aren't formatted. */
+    raw = field_raw(sol, i);
+    if (!full && raw == d->raw[i])
+      continue;
+    d->raw[i] = raw;
+    field_text(sol, i, text);
+    d->formatted++;
+    /* Changes below the printed precision aren't sent. */
+    if (!full && strcmp(text, d->text[i]) == 0)
+      continue;
+    strcpy(d->text[i], text);
+    d->sent++;
+    if (d->mode == STATUS_DIFF_KV)
+      str_i += sprintf(str + str_i, "%s%s=%s", str_i ? " " : "",
+                       fields[i].key, text);
+    else if (!full)
+      str_i += sprintf(str + str_i, "\x1b[%d;%dH%*s\x1b[K", fields[i].row,
+                       fields[i].col, fields[i].width, text);
+  }
+  d->valid = 1;
+  if (str_i == 0)
+    return 0;
+
+  if (d->mode == STATUS_DIFF_KV)
+    str_i += sprintf(str + str_i, "\n");
+  else if (!full)
+    str_i += sprintf(str + str_i, "\x1b[%d;1H", STATUS_ROWS_END);
+  d->renders++;
+  return str_i;
+}
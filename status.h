@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * status formats the latest solution received from Piksi as a human readable
+ * report.
+ *
+ * status_diff_format renders the same fields differentially: it remembers
+ * what it last sent for each one and sends only those that changed since,
+ * either as key=value pairs on a line (STATUS_DIFF_KV) or as updates in place
+ * on a terminal showing the full report (STATUS_DIFF_ANSI), with the cursor
+ * moved to each value. Fields are compared as raw values before any
+ * formatting, so the cost of a call follows the number of fields that
+ * changed rather than the size of the report.
+ */
+
+#ifndef SBP_TUTORIAL_STATUS_H
+#define SBP_TUTORIAL_STATUS_H
+
+#include <receiver.h>
+
+/* Upper bound on the length of the text written by status_format. */
+#define STATUS_MAX_LEN 700
+
+/* Rendering modes for status_diff_format. */
+#define STATUS_DIFF_KV   0 /* "key=value key=value\n" */
+#define STATUS_DIFF_ANSI 1 /* VT100 cursor addressed updates */
+
+#define STATUS_N_FIELDS  17
+/* Longest value of a field, with its terminator. */
+#define STATUS_FIELD_LEN 24
+/* Upper bound on the length of the text written by status_diff_format. */
+#define STATUS_DIFF_MAX_LEN (STATUS_MAX_LEN + 16)
+
+typedef struct {
+  u8 mode;
+  u8 valid;                 /* Everything has been sent once. */
+  u64 raw[STATUS_N_FIELDS];
+  char text[STATUS_N_FIELDS][STATUS_FIELD_LEN];
+  u32 renders;              /* Calls that wrote something. */
+  u32 formatted;            /* Fields formatted. */
+  u32 sent;                 /* Fields sent. */
+} status_diff_t;
+
+int status_format(char *str, const solution_t *sol);
+void status_diff_init(status_diff_t *d, u8 mode);
+void status_diff_reset(status_diff_t *d);
+int status_diff_format(status_diff_t *d, char *str, const solution_t *sol);
+
+#endif /* SBP_TUTORIAL_STATUS_H */
@@ -9,22 +9,44 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
 
 #include <semihosting.h>
 
 #undef errno
 extern int errno;
 extern int  _end;
+extern int  _eram;
+
+/* Most the heap may grow to, in bytes from _end. It is also bounded by the
+ * end of SRAM. Buffers come from a static arena (see arena.h), the heap is
+ * only for newlib's own use. */
+#ifndef SBRK_LIMIT
+#define SBRK_LIMIT 0x4000
+#endif
 
 __attribute__ ((used))
 caddr_t _sbrk ( int incr )
 {
   static unsigned char *heap = NULL;
   unsigned char *prev_heap;
+  unsigned char *limit;
 
   if (heap == NULL) {
     heap = (unsigned char *)&_end;
   }
+
+  limit = (unsigned char *)&_end + SBRK_LIMIT;
+  if (limit > (unsigned char *)&_eram) {
+    limit = (unsigned char *)&_eram;
+  }
+
+  /* Fail cleanly rather than run into whatever is above the heap. */
+  if (incr > limit - heap || incr < (unsigned char *)&_end - heap) {
+    errno = ENOMEM;
+    return (caddr_t) -1;
+  }
+
   prev_heap = heap;
 
   heap += incr;
@@ -69,13 +91,20 @@ int _read(int file, char *ptr, int len)
 __attribute__ ((used))
 int _write(int file, char *ptr, int len)
 {
-  /* Copy the chars into a 0 delimited string. Not
-   * using strcpy as not sure ptr[] is null terminated. */
-  char *str = malloc((len+1)*sizeof(char));
-  str[len] = 0;
-  memcpy(str, ptr, len);
-  SH_SendString(str);
-  free(str);
+  /* Copy the chars into 0 delimited strings, a chunk at a time. Not
+   * using strcpy as not sure ptr[] is null terminated, and not using
+   * malloc so that printing never touches the heap. */
+  char str[64];
+  int n, sent = 0;
+  while (sent < len) {
+    n = len - sent;
+    if (n > (int)sizeof(str) - 1)
+      n = sizeof(str) - 1;
+    memcpy(str, ptr + sent, n);
+    str[n] = 0;
+    SH_SendString(str);
+    sent += n;
+  }
   return len;
 }
 
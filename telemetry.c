@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <libsbp/edc.h>
+#include <libsbp/navigation.h>
+
+#include <telemetry.h>
+
+/* Values in each group, in the order of the TELEMETRY_ bits. */
+const u8 telemetry_group_values[TELEMETRY_N_GROUPS] = { 1, 3, 3, 3, 5, 2, 2 };
+
+/* Latitude and longitude to 1e-7 degrees, height to mm, saturating. */
+static s32 scale(double v, double factor)
+{
+  v = floor(v * factor + 0.5);
+  if (v > 2147483647.0)
+    return 2147483647;
+  if (v < -2147483648.0)
+    return -2147483647 - 1;
+  return (s32)v;
+}
+
+static inline u32 zigzag(s32 v)
+{
+  return ((u32)v << 1) ^ (u32)(v >> 31);
+}
+
+static inline s32 unzigzag(u32 v)
+{
+  return (s32)(v >> 1) ^ -(s32)(v & 1);
+}
+
+static inline u8 *put_varint(u8 *p, u32 v)
+{
+  while (v >= 0x80) {
+    *p++ = (u8)v | 0x80;
+    v >>= 7;
+  }
+  *p++ = (u8)v;
+  return p;
+}
+
+/* Read a varint from p, before end. Returns just past it, or NULL if it
+ * runs off the end or is too long. */
+static const u8 *get_varint(const u8 *p, const u8 *end, u32 *v)
+{
+  u8 shift = 0;
+
+  *v = 0;
+  do {
+    if (p == end || shift > 28)
+      return NULL;
+    *v |= (u32)(*p & 0x7F) << shift;
+    shift += 7;
+  } while (*p++ & 0x80);
+  return p;
+}
+
+/* Set up to send every field, with a keyframe first. */
+void telemetry_init(telemetry_t *t)
+{
+  memset(t, 0, sizeof(*t));
+  t->fields = TELEMETRY_ALL;
+  t->keyframe_every = TELEMETRY_KEYFRAME_EVERY;
+}
+
+/* Number of values sent for a field set. */
+u8 telemetry_count_values(u8 fields)
+{
+  u8 i, n = 0;
+
+  for (i = 0; i < TELEMETRY_N_GROUPS; i++)
+    if (fields & (1 << i))
+      n += telemetry_group_values[i];
+  return n;
+}
+
+/* The values of the groups in fields, in order. Returns how many. */
+static u8 gather(const receiver_t *r, u8 fields, s32 *v)
+{
+  const solution_t *sol = &r->sol;
+  u8 n = 0;
+
+  if (fields & TELEMETRY_TOW)
+    v[n++] = (s32)sol->pos_llh.tow;
+  if (fields & TELEMETRY_POS) {
+    v[n++] = scale(sol->pos_llh.lat, 1e7);
+    v[n++] = scale(sol->pos_llh.lon, 1e7);
+    v[n++] = scale(sol->pos_llh.height, 1e3);
+  }
+  if (fields & TELEMETRY_BASELINE) {
+    v[n++] = sol->baseline_ned.n;
+    v[n++] = sol->baseline_ned.e;
+    v[n++] = sol->baseline_ned.d;
+  }
+  if (fields & TELEMETRY_VEL) {
+    v[n++] = sol->vel_ned.n;
+    v[n++] = sol->vel_ned.e;
+    v[n++] = sol->vel_ned.d;
+  }
+  if (fields & TELEMETRY_DOPS) {
+    v[n++] = sol->dops.gdop;
+    v[n++] = sol->dops.pdop;
+    v[n++] = sol->dops.tdop;
+    v[n++] = sol->dops.hdop;
+    v[n++] = sol->dops.vdop;
+  }
+  if (fields & TELEMETRY_SATS) {
+    v[n++] = sol->pos_llh.n_sats;
+    v[n++] = sol->pos_llh.flags;
+  }
+  if (fields & TELEMETRY_RX) {
+    v[n++] = (s32)r->n_frames;
+    v[n++] = (s32)r->n_crc_errors;
+  }
+  return n;
+}
+
+/*
+ * Write a frame for the current solution into t->frame and return its
+ * length. Differences are taken modulo 2^32, so counters and the time of
+ * week wrap cleanly.
+ */
+u8 telemetry_epoch(telemetry_t *t, const receiver_t *r)
+{
+  s32 cur[TELEMETRY_MAX_VALUES];
+  u8 *p = t->frame, *payload;
+  u8 fields = t->fields & TELEMETRY_ALL;
+  u8 i, n, key;
+  u32 changed = 0;
+  u16 crc;
+
+  n = gather(r, fields, cur);
+  key = fields != t->last_fields || t->since_keyframe + 1 >= t->keyframe_every;
+
+  *p++ = TELEMETRY_SYNC;
+  *p++ = (key ? TELEMETRY_KEYFRAME : 0) | (t->seq & TELEMETRY_SEQ_MASK);
+  p++;
+  payload = p;
+  *p++ = fields;
+  if (key) {
+    for (i = 0; i < n; i++)
+      p = put_varint(p, zigzag(cur[i]));
+  } else {
+    for (i = 0; i < n; i++)
+      if (cur[i] != t->prev[i])
+        changed |= 1UL << i;
+    p = put_varint(p, changed);
+    for (i = 0; i < n; i++)
+      if (changed & (1UL << i))
+        p = put_varint(p, zigzag((s32)((u32)cur[i] - (u32)t->prev[i])));
+  }
+  memcpy(t->prev, cur, n * sizeof(*cur));
+  t->frame[2] = p - payload;
+  crc = crc16_ccitt(&t->frame[1], p - &t->frame[1], 0);
+  *p++ = crc & 0xFF;
+  *p++ = crc >> 8;
+
+  t->seq++;
+  t->since_keyframe = key ? 0 : t->since_keyframe + 1;
+  t->last_fields = fields;
+  t->frames++;
+  t->bytes += p - t->frame;
+  return p - t->frame;
+}
+
+/*
+ * Feed a message the receiver has just stored, from the receiver hook.
+ * Writes a frame once the velocity of the latest position arrives, and
+ * returns its length, or 0.
+ */
+u8 telemetry_message(telemetry_t *t, const receiver_t *r, u16 msg_type)
+{
+  if (msg_type != SBP_MSG_VEL_NED ||
+      r->sol.vel_ned.tow != r->sol.pos_llh.tow)
+    return 0;
+  return telemetry_epoch(t, r);
+}
+
+void telemetry_decoder_init(telemetry_decoder_t *d)
+{
+  memset(d, 0, sizeof(*d));
+}
+
+/*
+ * Decode one whole frame, from the sync byte to the CRC, into values, which
+ * must have room for TELEMETRY_MAX_VALUES; d->fields says which groups they
+ * are. Returns the number of values, 0 for a delta frame that can't be
+ * applied because frames were lost (it waits for the next keyframe), or -1
+ * if the frame is malformed or fails its CRC.
+ */
+s8 telemetry_decode(telemetry_decoder_t *d, const u8 *frame, u32 len,
+                    s32 *values)
+{
+  const u8 *p, *end;
+  u8 flags, fields, key, seq, i, n;
+  u32 changed = 0xFFFFFFFF, v;
+
+  if (len < 6 || frame[0] != TELEMETRY_SYNC || len != 5 + (u32)frame[2])
+    return -1;
+  if (crc16_ccitt(&frame[1], len - 3, 0) !=
+      (frame[len - 2] | (u16)frame[len - 1] << 8))
+    return -1;
+
+  flags = frame[1];
+  key = flags & TELEMETRY_KEYFRAME;
+  seq = flags & TELEMETRY_SEQ_MASK;
+  fields = frame[3];
+  if (fields & ~TELEMETRY_ALL)
+    return -1;
+
+  if (!key && (!d->synced || fields != d->fields ||
+               seq != ((d->seq + 1) & TELEMETRY_SEQ_MASK))) {
+    d->synced = 0;
+    d->skipped++;
+    return 0;
+  }
+
+  n = telemetry_count_values(fields);
+  p = &frame[4];
+  end = &frame[len - 2];
+  if (!key && (p = get_varint(p, end, &changed)) == NULL)
+    return -1;
+  for (i = 0; i < n; i++) {
+    if (!(changed & (1UL << i))) {
+      values[i] = d->prev[i];
+    } else if ((p = get_varint(p, end, &v)) == NULL) {
+      return -1;
+    } else {
+      values[i] = key ? unzigzag(v) :
+                  (s32)((u32)d->prev[i] + (u32)unzigzag(v));
+    }
+  }
+  if (p != end)
+    return -1;
+
+  memcpy(d->prev, values, n * sizeof(*values));
+  d->fields = fields;
+  d->seq = seq;
+  d->synced = 1;
+  d->frames++;
+  return n;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * telemetry packs each epoch of the solution into a small binary frame, a
+ * compact alternative to the text status report, small enough to stream at
+ * the full solution rate.
+ *
+ * The fields sent are chosen by groups (TELEMETRY_TOW and so on). Each is
+ * scaled to an integer: degrees times 10^7, millimetres, mm/s, DOPs times
+ * 100. A keyframe carries every value, and the frames in between only the
+ * values that changed, as the difference from the previous frame, so most
+ * take a byte. Values and differences are zigzag encoded (small magnitudes
+ * of either sign give small numbers) and written as base 128 varints. A
+ * keyframe is sent every keyframe_every frames and whenever the field set
+ * changes, so a decoder that misses a frame picks up again at the next one.
+ *
+ * Frame:
+ *
+ *   0xA5  flags  length  payload  crc
+ *
+ * flags has TELEMETRY_KEYFRAME set on keyframes and a 7 bit sequence number
+ * in the rest. The payload is the field set byte followed by the values of
+ * those groups in order. crc is the CRC-16 CCITT that SBP uses, over flags,
+ * length and payload, little endian.
+ *
+ * In a delta frame the field set is followed by a varint with bit i set for
+ * each value i that changed, and only those values follow.
+ *
+ * telemetry_decode reverses this, on the host or anywhere else. It contains
+ * no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_TELEMETRY_H
+#define SBP_TUTORIAL_TELEMETRY_H
+
+#include <libsbp/common.h>
+
+#include <receiver.h>
+
+/* Field groups, and the values each one adds. */
+#define TELEMETRY_TOW      0x01 /* Time of week, ms. */
+#define TELEMETRY_POS      0x02 /* Lat, lon (1e-7 deg), height (mm). */
+#define TELEMETRY_BASELINE 0x04 /* North, east, down, mm. */
+#define TELEMETRY_VEL      0x08 /* North, east, down, mm/s. */
+#define TELEMETRY_DOPS     0x10 /* GDOP, PDOP, TDOP, HDOP, VDOP, x100. */
+#define TELEMETRY_SATS     0x20 /* Satellites and position flags. */
+#define TELEMETRY_RX       0x40 /* Frames received and CRC errors. */
+#define TELEMETRY_ALL      0x7F
+#define TELEMETRY_N_GROUPS 7
+
+/* Values in all the groups. */
+#define TELEMETRY_MAX_VALUES 19
+
+#define TELEMETRY_SYNC     0xA5
+#define TELEMETRY_KEYFRAME 0x80
+#define TELEMETRY_SEQ_MASK 0x7F
+/* Sync, flags, length, field set, changed values, values of up to 5 bytes
+ * each, CRC. */
+#define TELEMETRY_MAX_FRAME (3 + 1 + 3 + 5 * TELEMETRY_MAX_VALUES + 2)
+
+#define TELEMETRY_KEYFRAME_EVERY 10
+
+typedef struct {
+  u8 fields;           /* Groups to send, TELEMETRY_ALL by default. */
+  u8 keyframe_every;
+  u8 seq;
+  u8 since_keyframe;
+  u8 last_fields;      /* Field set of the previous frame, 0 for none. */
+  s32 prev[TELEMETRY_MAX_VALUES];
+  u32 frames;
+  u32 bytes;
+  u8 frame[TELEMETRY_MAX_FRAME];
+} telemetry_t;
+
+typedef struct {
+  u8 synced;           /* prev holds the values of the previous frame. */
+  u8 seq;
+  u8 fields;
+  s32 prev[TELEMETRY_MAX_VALUES];
+  u32 frames;
+  u32 skipped;         /* Delta frames dropped while waiting for a key. */
+} telemetry_decoder_t;
+
+extern const u8 telemetry_group_values[TELEMETRY_N_GROUPS];
+
+void telemetry_init(telemetry_t *t);
+u8 telemetry_epoch(telemetry_t *t, const receiver_t *r);
+u8 telemetry_message(telemetry_t *t, const receiver_t *r, u16 msg_type);
+u8 telemetry_count_values(u8 fields);
+
+void telemetry_decoder_init(telemetry_decoder_t *d);
+s8 telemetry_decode(telemetry_decoder_t *d, const u8 *frame, u32 len,
+                    s32 *values);
+
+#endif /* SBP_TUTORIAL_TELEMETRY_H */
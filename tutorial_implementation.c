@@ -15,6 +15,8 @@
  * specific to this tutorial, to keep main.c as simple as possible.
  */
 
+#include <string.h>
+
 #include <stm32f4xx_gpio.h>
 #include <stm32f4xx.h>
 #include <stm32f4xx_usart.h>
@@ -22,82 +24,194 @@
 #include <misc.h>
 
 #include <tutorial_implementation.h>
+#include <sections.h>
+
+/* FIFO the USART1 receive interrupt writes to, see usarts_setup. */
+fifo_t *usart1_rx_fifo;
 
 /*
- * FIFO to hold received UART bytes before libsbp parses them.
+ * Keep this handler as short as possible: at 115200 baud a byte arrives every
+ * 87us. Read SR then DR, which clears RXNE and also the error flags - an
+ * overrun left set would raise this interrupt again straight away, forever.
+ * A byte received with an overrun, noise or framing error is dropped, others
+ * go to fifo_write, which stores them and publishes the new tail. If the FIFO
+ * is full the byte is dropped.
  */
-#define FIFO_LEN 512
-char sbp_msg_fifo[FIFO_LEN];
-u16 head = 0;
-u16 tail = 0;
+RAMFUNC void USART1_IRQHandler(void)
+{
+  u16 sr = USART1->SR;
+  u8 c = USART1->DR;
 
-/* Return 1 if true, 0 otherwise. */
-u8 fifo_empty(void){
-  if (head == tail)
-    return 1;
-  return 0;
+  if (!(sr & (USART_SR_ORE | USART_SR_NE | USART_SR_FE)))
+    fifo_write(usart1_rx_fifo, c);
 }
 
 /*
- * Append a character to our SBP message fifo.
- * Returns 1 if char successfully appended to fifo.
- * Returns 0 if fifo is full.
+ * Millisecond timebase, driven by SysTick.
+ * The LED heartbeat also runs from here: every HEARTBEAT_MS the LEDs toggle
+ * if any bytes were received from Piksi since the last toggle. So does the
+ * task set with timebase_set_task, every period milliseconds.
  */
-u8 fifo_write(char c){
-  if (fifo_full())
-    return 0;
+#define HEARTBEAT_MS 250
+volatile u32 timebase_count_ms = 0;
+u32 heartbeat_countdown = HEARTBEAT_MS;
+u16 heartbeat_tail = 0;
+volatile timebase_task_t timebase_task = 0;
+u32 timebase_task_period = 0;
+u32 timebase_task_countdown = 0;
 
-  sbp_msg_fifo[tail] = c;
-  tail = (tail+1) % FIFO_LEN;
-  return 1;
+void SysTick_Handler(void)
+{
+  timebase_count_ms++;
+  if (timebase_task && --timebase_task_countdown == 0) {
+    timebase_task_countdown = timebase_task_period;
+    timebase_task(timebase_count_ms);
+  }
+  if (--heartbeat_countdown == 0) {
+    heartbeat_countdown = HEARTBEAT_MS;
+    if (usart1_rx_fifo && usart1_rx_fifo->tail != heartbeat_tail) {
+      heartbeat_tail = usart1_rx_fifo->tail;
+      leds_toggle();
+    }
+  }
+}
+
+void timebase_setup(void){
+  /* SystemInit isn't called at reset, so work out what we're running at. */
+  SystemCoreClockUpdate();
+  SysTick_Config(SystemCoreClock / 1000);
 }
 
 /*
- * Read 1 char from fifo.
- * Returns 0 if fifo is empty, otherwise 1.
+ * Run task from the SysTick interrupt every period milliseconds, or stop
+ * running it if task is NULL. It runs at SysTick priority, so keep it short.
  */
-u8 fifo_read_char(char *c) {
-  if (fifo_empty())
-    return 0;
+void timebase_set_task(timebase_task_t task, u32 period_ms){
+  timebase_task = 0;
+  timebase_task_period = period_ms;
+  timebase_task_countdown = period_ms;
+  timebase_task = task;
+}
 
-  *c = sbp_msg_fifo[head];
-  head = (head+1) % FIFO_LEN;
-  return 1;
+/* Milliseconds since timebase_setup, wraps after 49 days. */
+u32 timebase_ms(void){
+  return timebase_count_ms;
 }
 
 /*
- * Read arbitrary number of chars from FIFO. Must conform to
- * function definition that is passed to the function
- * sbp_process().
- * Returns the number of characters successfully read.
+ * DWT cycle counter, for measuring how long things take.
+ * The DWT registers aren't described by this version of core_cm4.h.
  */
-u32 fifo_read(u8 *buff, u32 n, void *context) {
-  int i;
-  for (i=0; i<n; i++)
-    if (!fifo_read_char((char *)(buff + i)))
-      break;
-  return i;
-}
-
-/* Return 1 if true, 0 otherwise. */
-u8 fifo_full(void){
-  if (((tail+1)%FIFO_LEN) == head) {
-    return 1;
-  }
-  return 0;
+#define DWT_CTRL   (*(__IO u32 *)0xE0001000)
+#define DWT_CYCCNT (*(__IO u32 *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA 0x00000001
+
+void cycle_counter_setup(void){
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
 }
 
-void USART1_IRQHandler(void)
+/* Core clock cycles since cycle_counter_setup, wraps every 2^32 cycles. */
+u32 cycle_count(void){
+  return DWT_CYCCNT;
+}
+
+
+/*
+ * PPS capture. TIM2 is a free running 32 bit counter, and its channel 2 input
+ * (PA1) latches the counter on each rising edge of the PPS output from Piksi.
+ * The interrupt only records the captured value; the clock model is updated
+ * from the main loop (see pps_clock.c).
+ */
+volatile u32 pps_capture = 0;
+volatile u32 pps_capture_count = 0;
+u32 pps_capture_seen = 0;
+
+void TIM2_IRQHandler(void)
 {
-  fifo_write(USART1->DR);
-  DO_EVERY(250,
-    leds_toggle();
-  );
-  USART1->SR &= ~(USART_FLAG_RXNE);
+  if (TIM2->SR & TIM_SR_CC2IF) {
+    /* Reading CCR2 clears CC2IF. */
+    pps_capture = TIM2->CCR2;
+    pps_capture_count++;
+  }
+}
+
+void pps_setup(void){
+  GPIO_InitTypeDef GPIOA_InitStructure;
+  NVIC_InitTypeDef NVIC_InitStructure;
+
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOA, ENABLE);
+
+  /* GPIOA Configuration:  TIM2 CH2 on PA1 */
+  GPIOA_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+  GPIOA_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+  GPIOA_InitStructure.GPIO_OType = GPIO_OType_PP;
+  GPIOA_InitStructure.GPIO_PuPd = GPIO_PuPd_DOWN;
+  GPIO_PinAFConfig(GPIOA, GPIO_PinSource1, GPIO_AF_TIM2);
+  GPIOA_InitStructure.GPIO_Pin = GPIO_Pin_1;
+  GPIO_Init(GPIOA, &GPIOA_InitStructure);
+
+  /* The TIM stdperiph driver isn't part of this project, so configure the
+   * timer registers directly. Count at the full timer clock over the whole
+   * 32 bit range, capture CH2 on the rising edge of TI2 with a short filter. */
+  TIM2->CR1 = 0;
+  TIM2->PSC = 0;
+  TIM2->ARR = 0xFFFFFFFF;
+  TIM2->CCMR1 = TIM_CCMR1_CC2S_0 | TIM_CCMR1_IC2F_1 | TIM_CCMR1_IC2F_0;
+  TIM2->CCER = TIM_CCER_CC2E;
+  TIM2->EGR = TIM_EGR_UG;
+  TIM2->SR = 0;
+  TIM2->DIER = TIM_DIER_CC2IE;
+
+  NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQn;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 3;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+
+  TIM2->CR1 = TIM_CR1_CEN;
 }
 
+/* Current value of the PPS capture timer. */
+u32 pps_ticks(void){
+  return TIM2->CNT;
+}
+
+/* Rate of the PPS capture timer in Hz. */
+u32 pps_tick_hz(void){
+  RCC_ClocksTypeDef clocks;
+
+  RCC_GetClocksFreq(&clocks);
+  /* APB1 timers run at twice PCLK1 unless the APB1 prescaler is 1. */
+  if (RCC->CFGR & RCC_CFGR_PPRE1_2)
+    return 2 * clocks.PCLK1_Frequency;
+  return clocks.PCLK1_Frequency;
+}
 
-void usarts_setup(void){
+/*
+ * Fetch the most recent PPS capture.
+ * Returns 1 and writes the captured tick count if there has been an edge since
+ * the last call, otherwise 0. Edges that arrive faster than this is called are
+ * dropped, which the clock model tolerates.
+ */
+u8 pps_capture_read(u32 *ticks){
+  u32 count;
+
+  do {
+    count = pps_capture_count;
+    *ticks = pps_capture;
+  } while (count != pps_capture_count);
+
+  if (count == pps_capture_seen)
+    return 0;
+  pps_capture_seen = count;
+  return 1;
+}
+
+/* Set up USART1 to receive from Piksi into rx_fifo. */
+void usarts_setup(fifo_t *rx_fifo){
 
   /* USART1 to Piksi. */
   GPIO_InitTypeDef GPIOA_InitStructure;
@@ -121,7 +235,9 @@ void usarts_setup(void){
   GPIOA_InitStructure.GPIO_Pin = GPIO_Pin_9 | GPIO_Pin_10;
   GPIO_Init(GPIOA, &GPIOA_InitStructure);
 
-  USART1_InitStructure.USART_BaudRate = 115200;
+  usart1_rx_fifo = rx_fifo;
+
+  USART1_InitStructure.USART_BaudRate = USART1_BAUD;
   USART1_InitStructure.USART_WordLength = USART_WordLength_8b;
   USART1_InitStructure.USART_StopBits = USART_StopBits_1;
   USART1_InitStructure.USART_Parity = USART_Parity_No;
@@ -140,34 +256,272 @@ void usarts_setup(void){
   USART_Cmd(USART1, ENABLE);
 }
 
+/*
+ * USART2 transmit (TX on PA2), for NMEA output to other equipment. Bytes are
+ * queued in a ring and DMA1 stream 6, channel 4, sends them straight out of
+ * it, one contiguous run at a time. The transfer complete interrupt moves the
+ * tail past the run and starts the next one. Only that interrupt touches the
+ * stream: usart2_tx_write queues bytes, publishes the new head and pends the
+ * interrupt to start a transfer if none is under way. The standard peripheral
+ * DMA driver isn't part of this project, so the stream is set up through its
+ * registers.
+ */
+#define USART2_TX_BAUD 115200
+#define USART2_TX_LEN  1024 /* Must be a power of two. */
+#define USART2_TX_MASK (USART2_TX_LEN - 1)
+#define DMA_STREAM6_FLAGS (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | \
+                           DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | \
+                           DMA_HIFCR_CFEIF6)
+u8 usart2_tx_buf[USART2_TX_LEN];
+volatile u16 usart2_tx_head = 0;
+volatile u16 usart2_tx_tail = 0;
+u16 usart2_tx_run = 0;
+/* Bytes not queued because the ring was full. */
+u32 usart2_tx_dropped = 0;
+
+void DMA1_Stream6_IRQHandler(void)
+{
+  u16 head = usart2_tx_head, tail = usart2_tx_tail, run;
+
+  if (DMA1->HISR & DMA_HISR_TCIF6) {
+    DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+    tail = (tail + usart2_tx_run) & USART2_TX_MASK;
+    usart2_tx_tail = tail;
+    usart2_tx_run = 0;
+  }
+  if (usart2_tx_run || head == tail)
+    return;
+
+  /* Up to the head, or to the end of the ring if it has wrapped. */
+  run = head > tail ? head - tail : USART2_TX_LEN - tail;
+  DMA1->HIFCR = DMA_STREAM6_FLAGS;
+  DMA1_Stream6->M0AR = (u32)&usart2_tx_buf[tail];
+  DMA1_Stream6->NDTR = run;
+  usart2_tx_run = run;
+  DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+void usart2_tx_setup(void){
+  GPIO_InitTypeDef GPIOA_InitStructure;
+  USART_InitTypeDef USART2_InitStructure;
+  NVIC_InitTypeDef NVIC_InitStructure;
+
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOA | RCC_AHB1Periph_DMA1, ENABLE);
+
+  /* GPIOA Configuration:  USART2 TX on PA2 */
+  GPIOA_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+  GPIOA_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+  GPIOA_InitStructure.GPIO_OType = GPIO_OType_PP;
+  GPIOA_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+  GPIO_PinAFConfig(GPIOA, GPIO_PinSource2, GPIO_AF_USART2);
+  GPIOA_InitStructure.GPIO_Pin = GPIO_Pin_2;
+  GPIO_Init(GPIOA, &GPIOA_InitStructure);
+
+  USART2_InitStructure.USART_BaudRate = USART2_TX_BAUD;
+  USART2_InitStructure.USART_WordLength = USART_WordLength_8b;
+  USART2_InitStructure.USART_StopBits = USART_StopBits_1;
+  USART2_InitStructure.USART_Parity = USART_Parity_No;
+  USART2_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+  USART2_InitStructure.USART_Mode = USART_Mode_Tx;
+  USART_Init(USART2, &USART2_InitStructure);
+  USART_DMACmd(USART2, USART_DMAReq_Tx, ENABLE);
+
+  /* Memory to peripheral, byte at a time, incrementing through the ring,
+   * interrupt at the end of each run. */
+  DMA1_Stream6->CR = 0;
+  while (DMA1_Stream6->CR & DMA_SxCR_EN)
+    ;
+  DMA1->HIFCR = DMA_STREAM6_FLAGS;
+  DMA1_Stream6->PAR = (u32)&USART2->DR;
+  DMA1_Stream6->CR = DMA_SxCR_CHSEL_2 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 |
+                     DMA_SxCR_TCIE;
+
+  /* Below the USART1 receive interrupt, which mustn't be held up. */
+  NVIC_InitStructure.NVIC_IRQChannel = DMA1_Stream6_IRQn;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 4;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+
+  USART_Cmd(USART2, ENABLE);
+}
+
+/*
+ * Queue len bytes to send on USART2. Either all of them are queued, or, if
+ * the ring doesn't have room, none are and 0 is returned, so a consumer never
+ * sees half a message.
+ */
+u8 usart2_tx_write(const u8 *buf, u32 len){
+  u16 head = usart2_tx_head, first;
+
+  if (len > ((usart2_tx_tail - head - 1) & USART2_TX_MASK)) {
+    usart2_tx_dropped += len;
+    return 0;
+  }
+  first = len < USART2_TX_LEN - head ? len : USART2_TX_LEN - head;
+  memcpy(&usart2_tx_buf[head], buf, first);
+  memcpy(usart2_tx_buf, buf + first, len - first);
+  /* The bytes must be in memory before the DMA can be told about them. */
+  __DMB();
+  usart2_tx_head = (head + len) & USART2_TX_MASK;
+  NVIC_SetPendingIRQ(DMA1_Stream6_IRQn);
+  return 1;
+}
+
+/*
+ * Send len bytes on ITM stimulus port port, out of the SWO pin to the
+ * debugger. The debugger sets up the trace clock and pin and enables the
+ * ports it wants, so if the ITM or this port is off nothing is sent and 0 is
+ * returned. Whole words go out four bytes at a time, which the SWO packet
+ * format carries with a quarter of the overhead of single bytes.
+ */
+u8 itm_write(u8 port, const u8 *buf, u32 len){
+  u32 word;
+
+  if (port > 31 || !(ITM->TCR & ITM_TCR_ITMENA_Msk) ||
+      !(ITM->TER & (1UL << port)))
+    return 0;
+  for (; len >= 4; buf += 4, len -= 4) {
+    memcpy(&word, buf, 4);
+    while (ITM->PORT[port].u32 == 0)
+      ;
+    ITM->PORT[port].u32 = word;
+  }
+  for (; len; buf++, len--) {
+    while (ITM->PORT[port].u32 == 0)
+      ;
+    ITM->PORT[port].u8 = *buf;
+  }
+  return 1;
+}
+
+/*
+ * Flash log region: the upper half of flash, sectors 8 to 11 of 128 KB each.
+ * arm-gcc-link.ld keeps the program out of it.
+ *
+ * The F407 has one flash bank, so while a sector is being erased (1 to 2 s
+ * for 128 KB) nothing can be fetched from flash at all. flash_setup moves the
+ * vector table to SRAM, and the erase waits in an SRAM function with every
+ * interrupt but USART1's held off, so bytes from Piksi keep going into the
+ * FIFO throughout: the vector, USART1_IRQHandler and fifo_write are all in
+ * SRAM. Everything else waits, and the SysTick ticks missed are made up
+ * afterwards from the cycle counter. The FIFO has to hold what arrives
+ * meanwhile, see FLASH_ERASE_MAX_BYTES. Programming a word stalls flash for
+ * 16 us or so, well inside a byte time, so that is done from flash.
+ */
+#define N_VECTORS (16 + FPU_IRQn + 1)
+#define FLASH_KEY1 0x45670123
+#define FLASH_KEY2 0xCDEF89AB
+#define FLASH_SR_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | \
+                         FLASH_SR_PGSERR)
+/* VTOR needs the table aligned to its size rounded up to a power of two. */
+u32 ram_vectors[128] __attribute__ ((aligned(512)));
+extern void (* const g_pfnVectors[])(void);
+
+void flash_setup(void){
+  memcpy(ram_vectors, g_pfnVectors, N_VECTORS * sizeof(u32));
+  __DSB();
+  SCB->VTOR = (u32)ram_vectors;
+  __DSB();
+}
+
+static void flash_unlock(void){
+  if (FLASH->CR & FLASH_CR_LOCK) {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+  }
+  FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+}
+
+/*
+ * Runs from SRAM and calls nothing in flash. Returns the cycles it took, and
+ * the status register.
+ */
+RAMFUNC static u32 flash_erase_wait(u32 cr, u32 *sr){
+  u32 enabled[3], systick = SysTick->CTRL & SysTick_CTRL_TICKINT_Msk;
+  u32 start, cycles, i;
+
+  for (i = 0; i < 3; i++) {
+    enabled[i] = NVIC->ISER[i];
+    NVIC->ICER[i] = i == USART1_IRQn / 32 ?
+                    enabled[i] & ~(1UL << (USART1_IRQn % 32)) : enabled[i];
+  }
+  SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+  __DSB();
+  __ISB();
+
+  start = DWT_CYCCNT;
+  FLASH->CR = cr;
+  FLASH->CR = cr | FLASH_CR_STRT;
+  while (FLASH->SR & FLASH_SR_BSY)
+    ;
+  *sr = FLASH->SR;
+  FLASH->CR = FLASH_CR_LOCK;
+  /* The data cache may still hold what was in the sector. */
+  FLASH->ACR &= ~FLASH_ACR_DCEN;
+  FLASH->ACR |= FLASH_ACR_DCRST;
+  FLASH->ACR &= ~FLASH_ACR_DCRST;
+  FLASH->ACR |= FLASH_ACR_DCEN;
+  cycles = DWT_CYCCNT - start;
+
+  SysTick->CTRL |= systick;
+  for (i = 0; i < 3; i++)
+    NVIC->ISER[i] = enabled[i];
+  return cycles;
+}
+
+/* Erase sector n of the region. Returns 0, or -1 if it failed. */
+s8 flash_erase_sector(u32 n){
+  u32 sr, cycles;
+
+  if (n >= FLASH_LOG_N_SECTORS)
+    return -1;
+  flash_unlock();
+  cycles = flash_erase_wait(FLASH_CR_PSIZE_1 | FLASH_CR_SER |
+                            (FLASH_LOG_FIRST_SECTOR + n) * FLASH_CR_SNB_0,
+                            &sr);
+  timebase_count_ms += cycles / (SystemCoreClock / 1000);
+  return sr & FLASH_SR_ERRORS ? -1 : 0;
+}
+
+/*
+ * Program the erased word at offset in the region. Returns 0, or -1 if it
+ * failed.
+ */
+s8 flash_program_word(u32 offset, u32 word){
+  u32 sr;
+
+  if (offset >= FLASH_LOG_N_SECTORS * FLASH_LOG_SECTOR_SIZE || offset & 3)
+    return -1;
+  flash_unlock();
+  FLASH->CR = FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+  *(__IO u32 *)(FLASH_LOG_BASE + offset) = word;
+  while (FLASH->SR & FLASH_SR_BSY)
+    ;
+  sr = FLASH->SR;
+  FLASH->CR = FLASH_CR_LOCK;
+  return sr & FLASH_SR_ERRORS ? -1 : 0;
+}
+
+/*
+ * The LEDs are driven through BSRR so each function is a single store with no
+ * read-modify-write of ODR. BSRRL sets pins, BSRRH resets them, and a 32 bit
+ * store to BSRRL writes both halves at once.
+ */
+#define LEDS_ALL (GPIO_Pin_12 | GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15)
+
 void leds_set(void){
-  GPIO_SetBits(GPIOD, GPIO_Pin_12 | GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15);
+  GPIOD->BSRRL = LEDS_ALL;
 }
 
 void leds_unset(void){
-  GPIO_ResetBits(GPIOD, GPIO_Pin_12 | GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15);
+  GPIOD->BSRRH = LEDS_ALL;
 }
 
 void leds_toggle(void){
-  if (GPIO_ReadOutputDataBit(GPIOD, GPIO_Pin_12))
-    GPIO_ResetBits(GPIOD, GPIO_Pin_12);
-  else
-    GPIO_SetBits(GPIOD, GPIO_Pin_12);
-
-  if (GPIO_ReadOutputDataBit(GPIOD, GPIO_Pin_13))
-    GPIO_ResetBits(GPIOD, GPIO_Pin_13);
-  else
-    GPIO_SetBits(GPIOD, GPIO_Pin_13);
-
-  if (GPIO_ReadOutputDataBit(GPIOD, GPIO_Pin_14))
-    GPIO_ResetBits(GPIOD, GPIO_Pin_14);
-  else
-    GPIO_SetBits(GPIOD, GPIO_Pin_14);
-
-  if (GPIO_ReadOutputDataBit(GPIOD, GPIO_Pin_15))
-    GPIO_ResetBits(GPIOD, GPIO_Pin_15);
-  else
-    GPIO_SetBits(GPIOD, GPIO_Pin_15);
+  u32 on = GPIOD->ODR & LEDS_ALL;
+  *(__IO u32 *)&GPIOD->BSRRL = (on << 16) | (~on & LEDS_ALL);
 }
 
 void leds_setup(void)
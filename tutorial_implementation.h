@@ -13,10 +13,16 @@
 /*
  * tutorial_implementation contains functions and definitions that are
  * implementation specific to this tutorial, to keep main.c as simple as possible.
+ *
+ * This is the board layer: everything that touches the STM32F4DISCOVERY
+ * hardware lives here. The FIFO, parser setup, callbacks and status formatting
+ * are in fifo.c, receiver.c and status.c, which build for a host as well.
  */
 
 #include <stm32f4xx.h>
 
+#include <fifo.h>
+
 #define DO_EVERY(n, cmd) do { \
   static u32 do_every_count = 0; \
   if (do_every_count % (n) == 0) { \
@@ -25,15 +31,50 @@
   do_every_count++; \
 } while(0)
 
-/* FIFO functions */
-u8 fifo_empty(void);
-u8 fifo_full(void);
-u8 fifo_write(char c);
-u8 fifo_read_char(char *c);
-u32 fifo_read(u8 *buff, u32 n, void *context);
-
 /* UART functions */
-void usarts_setup(void);
+void usarts_setup(fifo_t *rx_fifo);
+void usart2_tx_setup(void);
+u8 usart2_tx_write(const u8 *buf, u32 len);
+extern u32 usart2_tx_dropped;
+
+/* ITM (SWO) functions */
+u8 itm_write(u8 port, const u8 *buf, u32 len);
+
+/* Flash log region functions */
+#define FLASH_LOG_BASE         0x08080000
+#define FLASH_LOG_FIRST_SECTOR 8
+#define FLASH_LOG_SECTOR_SIZE  0x20000
+#define FLASH_LOG_N_SECTORS    4
+/*
+ * Longest erase of a 128 KB sector (STM32F407 datasheet, 32 bit parallelism),
+ * and what USART1 receives meanwhile at 10 bits a byte. The FIFO has to hold
+ * all of it, see flash_setup.
+ */
+#define FLASH_ERASE_MAX_MS     2000
+#define USART1_BAUD            115200
+#define FLASH_ERASE_MAX_BYTES  (USART1_BAUD / 10 * FLASH_ERASE_MAX_MS / 1000)
+#if defined(FLASH_LOG) && FIFO_LEN < FLASH_ERASE_MAX_BYTES
+#error "FLASH_LOG loses bytes during erases with this FIFO, build with -DFIFO_LEN=32768"
+#endif
+void flash_setup(void);
+s8 flash_erase_sector(u32 n);
+s8 flash_program_word(u32 offset, u32 word);
+
+/* Timebase functions */
+typedef void (*timebase_task_t)(u32 now_ms);
+void timebase_setup(void);
+void timebase_set_task(timebase_task_t task, u32 period_ms);
+u32 timebase_ms(void);
+
+/* Cycle counter functions */
+void cycle_counter_setup(void);
+u32 cycle_count(void);
+
+/* PPS capture functions */
+void pps_setup(void);
+u32 pps_ticks(void);
+u32 pps_tick_hz(void);
+u8 pps_capture_read(u32 *ticks);
 
 /* LED functions */
 void leds_set(void);
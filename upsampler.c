@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <libsbp/navigation.h>
+
+#include <upsampler.h>
+
+#define MS_PER_WEEK 604800000U
+
+/* Keeps the compiler from moving memory accesses across it. The tick runs on
+ * the same core as the main loop, so nothing stronger is needed. */
+#define BARRIER() __asm__ volatile ("" ::: "memory")
+
+/* Set up an upsampler taking its fixes from source, UPSAMPLER_POS_LLH or
+ * UPSAMPLER_BASELINE_NED. */
+void upsampler_init(upsampler_t *u, u8 source)
+{
+  memset(u, 0, sizeof(*u));
+  u->source = source;
+  u->max_age_ms = UPSAMPLER_MAX_AGE_MS;
+}
+
+/*
+ * Fix the reference point for MSG_POS_LLH fixes, latitude and longitude in
+ * degrees. Without it, the first position received is used.
+ */
+void upsampler_set_reference(upsampler_t *u, double lat, double lon,
+                             double height)
+{
+  enu_init(&u->ref, lat, lon, height);
+  u->ref_set = 1;
+}
+
+void upsampler_set_hook(upsampler_t *u, upsampler_hook_t hook, void *context)
+{
+  u->hook = hook;
+  u->hook_context = context;
+}
+
+/* Compare the extrapolation from the current fix with a new fix. */
+static void residual(upsampler_t *u, const upsampler_fix_t *f, u32 tow,
+                     const float pos[3])
+{
+  u32 dt_ms = tow >= f->tow ? tow - f->tow : tow + MS_PER_WEEK - f->tow;
+  float dt = dt_ms * 0.001f, len2 = 0, len;
+  u8 i;
+
+  /* A repeat of the same epoch, or too long a gap to say anything. */
+  if (dt_ms == 0 || dt_ms > u->max_age_ms)
+    return;
+  for (i = 0; i < 3; i++) {
+    u->residual[i] = f->pos[i] + f->vel[i] * dt - pos[i];
+    len2 += u->residual[i] * u->residual[i];
+  }
+  len = sqrtf(len2);
+  if (len > u->residual_max)
+    u->residual_max = len;
+  u->residual_sq += len2;
+  u->n_residuals++;
+}
+
+/* Start extrapolating from a new fix, keeping the current velocity. */
+static void take_fix(upsampler_t *u, u32 tow, const float pos[3], u32 now_ms)
+{
+  const upsampler_fix_t *cur = &u->fix[u->current];
+  upsampler_fix_t *next = &u->fix[!u->current];
+
+  if (u->have_fix)
+    residual(u, cur, tow, pos);
+  next->tow = tow;
+  next->ms = now_ms;
+  memcpy(next->pos, pos, sizeof(next->pos));
+  memcpy(next->vel, cur->vel, sizeof(next->vel));
+  u->n_fixes++;
+  BARRIER();
+  u->current = !u->current;
+  BARRIER();
+  u->have_fix = 1;
+}
+
+/* Extrapolate the current fix with a new velocity from now on. */
+static void take_velocity(upsampler_t *u, const msg_vel_ned_t *vel)
+{
+  upsampler_fix_t *next = &u->fix[!u->current];
+
+  *next = u->fix[u->current];
+  next->vel[0] = vel->e * 0.001f;
+  next->vel[1] = vel->n * 0.001f;
+  next->vel[2] = vel->d * -0.001f;
+  BARRIER();
+  u->current = !u->current;
+}
+
+/*
+ * Feed a message the receiver has just stored in sol, from the receiver hook.
+ * now_ms is the timebase when it was received, the same clock the ticks are
+ * given.
+ */
+void upsampler_message(upsampler_t *u, const solution_t *sol, u16 msg_type,
+                       u32 now_ms)
+{
+  enu_t enu;
+  float pos[3];
+
+  if (msg_type == SBP_MSG_VEL_NED) {
+    take_velocity(u, &sol->vel_ned);
+  } else if (msg_type == SBP_MSG_POS_LLH &&
+             u->source == UPSAMPLER_POS_LLH) {
+    if (!u->ref_set)
+      upsampler_set_reference(u, sol->pos_llh.lat, sol->pos_llh.lon,
+                              sol->pos_llh.height);
+    enu_from_llh(&u->ref, sol->pos_llh.lat, sol->pos_llh.lon,
+                 sol->pos_llh.height, &enu);
+    pos[0] = enu.e;
+    pos[1] = enu.n;
+    pos[2] = enu.u;
+    take_fix(u, sol->pos_llh.tow, pos, now_ms);
+  } else if (msg_type == SBP_MSG_BASELINE_NED &&
+             u->source == UPSAMPLER_BASELINE_NED) {
+    pos[0] = sol->baseline_ned.e * 0.001f;
+    pos[1] = sol->baseline_ned.n * 0.001f;
+    pos[2] = sol->baseline_ned.d * -0.001f;
+    take_fix(u, sol->baseline_ned.tow, pos, now_ms);
+  }
+}
+
+/*
+ * Work out the sample for now_ms and hand it to the hook. Called from the
+ * timebase every UPSAMPLER_PERIOD_MS; must not be interrupted by
+ * upsampler_message.
+ */
+void upsampler_tick(upsampler_t *u, u32 now_ms)
+{
+  const upsampler_fix_t *f = &u->fix[u->current];
+  u32 age = now_ms - f->ms;
+  u8 stale = age > u->max_age_ms;
+  float dt = (stale ? u->max_age_ms : age) * 0.001f;
+  u32 tow = f->tow + age;
+  u8 i;
+
+  u->out_seq++;
+  BARRIER();
+  u->out.tow = tow >= MS_PER_WEEK ? tow - MS_PER_WEEK : tow;
+  u->out.age_ms = age;
+  u->out.ticks++;
+  u->out.valid = u->have_fix;
+  u->out.stale = stale;
+  for (i = 0; i < 3; i++) {
+    u->out.pos[i] = f->pos[i] + f->vel[i] * dt;
+    u->out.vel[i] = stale ? 0 : f->vel[i];
+  }
+  BARRIER();
+  u->out_seq++;
+
+  if (u->hook && u->out.valid)
+    u->hook(u, &u->out, u->hook_context);
+}
+
+/* Copy out the latest sample, from outside the timebase interrupt. */
+void upsampler_snapshot(const upsampler_t *u, upsample_t *out)
+{
+  u32 seq;
+
+  do {
+    seq = u->out_seq;
+    BARRIER();
+    *out = u->out;
+    BARRIER();
+  } while (seq != u->out_seq);
+}
+
+/* Root mean square length of the residuals so far, m. */
+float upsampler_residual_rms(const upsampler_t *u)
+{
+  return u->n_residuals ? sqrtf(u->residual_sq / u->n_residuals) : 0;
+}
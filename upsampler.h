@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Swift Navigation Inc.
+ * Contact: Colin Beighley <colin@swift-nav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * upsampler turns the 1-10 Hz solutions from Piksi into a steady stream of
+ * positions at a higher rate, e.g. 100 Hz for a control loop, by dead
+ * reckoning along the last MSG_VEL_NED from the last fix.
+ *
+ * The fix is either MSG_POS_LLH, converted to east, north and up relative to a
+ * reference point (see enu.h), or MSG_BASELINE_NED, which already is relative
+ * to the base station. Each new fix replaces the one being extrapolated from,
+ * so the output snaps back to the measurement rather than drifting. Before it
+ * does, the extrapolation to the time of week of the new fix is compared with
+ * it, and the difference kept as the residual: how far off the output was by
+ * the time the next fix arrived.
+ *
+ * upsampler_message is called from the main loop with each message received,
+ * and upsampler_tick from the timebase interrupt every UPSAMPLER_PERIOD_MS.
+ * The tick only reads the fix, which upsampler_message double buffers, so
+ * neither side has to mask interrupts. A tick is a handful of multiply-adds
+ * whatever the state, so its cost is fixed. Its output goes to the hook, and
+ * upsampler_snapshot copies the latest one out from the main loop.
+ *
+ * Beyond max_age_ms of the fix, the output stops moving and is marked stale.
+ *
+ * It contains no hardware access, so the same code runs on a host.
+ */
+
+#ifndef SBP_TUTORIAL_UPSAMPLER_H
+#define SBP_TUTORIAL_UPSAMPLER_H
+
+#include <libsbp/common.h>
+
+#include <enu.h>
+#include <receiver.h>
+
+#define UPSAMPLER_PERIOD_MS  10
+#define UPSAMPLER_MAX_AGE_MS 1000
+/* Upper bound on a tick on the board, hook excluded, checked by main.c. */
+#define UPSAMPLER_BUDGET_CYCLES 200
+
+/* Which message the fixes come from. */
+#define UPSAMPLER_POS_LLH      0
+#define UPSAMPLER_BASELINE_NED 1
+
+/* One output sample. */
+typedef struct {
+  u32 tow;      /* GPS time of week the sample is for, ms. */
+  u32 age_ms;   /* Time extrapolated past the fix. */
+  u32 ticks;    /* Ticks since the upsampler was set up. */
+  u8 valid;     /* There has been a fix. */
+  u8 stale;     /* The fix is older than max_age_ms. */
+  float pos[3]; /* East, north and up, m. */
+  float vel[3]; /* m/s. */
+} upsample_t;
+
+/* A fix and the velocity to extrapolate it with. */
+typedef struct {
+  u32 tow;      /* GPS time of week of the fix, ms. */
+  u32 ms;       /* Timebase when it was received, ms. */
+  float pos[3];
+  float vel[3];
+} upsampler_fix_t;
+
+typedef struct upsampler upsampler_t;
+
+/* Called with each output sample, from upsampler_tick. */
+typedef void (*upsampler_hook_t)(upsampler_t *u, const upsample_t *out,
+                                 void *context);
+
+struct upsampler {
+  u8 source;
+  u32 max_age_ms;
+
+  enu_ref_t ref;
+  u8 ref_set;
+
+  /* upsampler_message fills in the fix the tick isn't using, then flips
+   * current to it. */
+  upsampler_fix_t fix[2];
+  volatile u8 current;
+  u8 have_fix;
+
+  upsampler_hook_t hook;
+  void *hook_context;
+
+  /* Latest output, and a count bumped before and after each write to it. */
+  upsample_t out;
+  volatile u32 out_seq;
+
+  /* Extrapolation residuals, predicted minus measured, m. */
+  float residual[3];    /* At the last fix. */
+  float residual_max;   /* Largest length so far. */
+  float residual_sq;    /* Sum of the squared lengths. */
+  u32 n_residuals;
+  u32 n_fixes;
+};
+
+void upsampler_init(upsampler_t *u, u8 source);
+void upsampler_set_reference(upsampler_t *u, double lat, double lon,
+                             double height);
+void upsampler_set_hook(upsampler_t *u, upsampler_hook_t hook, void *context);
+void upsampler_message(upsampler_t *u, const solution_t *sol, u16 msg_type,
+                       u32 now_ms);
+void upsampler_tick(upsampler_t *u, u32 now_ms);
+void upsampler_snapshot(const upsampler_t *u, upsample_t *out);
+float upsampler_residual_rms(const upsampler_t *u);
+
+#endif /* SBP_TUTORIAL_UPSAMPLER_H */